@@ -0,0 +1,222 @@
+/***********************************************************************
+*    crc32c.cpp:                                                       *
+*    Namespace CRC32C, for Castagnoli CRC32 checksums                  *
+*    Copyright (c) 2017 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the implementation of a CRC32C namespace          *
+*    It is used to compute CRC32C (Castagnoli, polynomial 0x82F63B78)  *
+*    checksums, using the SSE4.2/ARMv8 crc32 instructions when the CPU *
+*    has them and a table driven slice-by-8 implementation otherwise   *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#include <cstring>
+
+#include "crc32c.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #define TJLUTILS_CRC32C_X86
+    #include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+    #define TJLUTILS_CRC32C_ARM
+    #include <arm_acle.h>
+#endif
+
+namespace CRC32C
+{
+    namespace
+    {
+        const size_t constexpr SLICE_COUNT{8};
+
+        struct SliceTables
+        {
+            uint32_t table[SLICE_COUNT][256];
+
+            SliceTables()
+            {
+                for (uint32_t i = 0; i < 256; i++) {
+                    uint32_t crc{i};
+                    for (int bit = 0; bit < 8; bit++) {
+                        crc = (crc & 1) ? ((crc >> 1) ^ POLYNOMIAL) : (crc >> 1);
+                    }
+                    this->table[0][i] = crc;
+                }
+                for (uint32_t i = 0; i < 256; i++) {
+                    for (size_t slice = 1; slice < SLICE_COUNT; slice++) {
+                        uint32_t previous{this->table[slice - 1][i]};
+                        this->table[slice][i] = (previous >> 8) ^ this->table[0][previous & 0xFF];
+                    }
+                }
+            }
+        };
+
+        const SliceTables &sliceTables()
+        {
+            static const SliceTables tables{};
+            return tables;
+        }
+
+        inline uint32_t loadLittleEndian32(const uint8_t *data)
+        {
+            return static_cast<uint32_t>(data[0])
+                   | (static_cast<uint32_t>(data[1]) << 8)
+                   | (static_cast<uint32_t>(data[2]) << 16)
+                   | (static_cast<uint32_t>(data[3]) << 24);
+        }
+
+#if defined(TJLUTILS_CRC32C_X86)
+        __attribute__((target("sse4.2")))
+        uint32_t extendHardware(uint32_t crc, const uint8_t *data, size_t length)
+        {
+            while ((length != 0) && ((reinterpret_cast<uintptr_t>(data) & 7) != 0)) {
+                crc = _mm_crc32_u8(crc, *data++);
+                length--;
+            }
+    #if defined(__x86_64__)
+            uint64_t crc64{crc};
+            while (length >= 8) {
+                uint64_t chunk{0};
+                memcpy(&chunk, data, sizeof(chunk));
+                crc64 = _mm_crc32_u64(crc64, chunk);
+                data += 8;
+                length -= 8;
+            }
+            crc = static_cast<uint32_t>(crc64);
+    #endif
+            while (length >= 4) {
+                uint32_t chunk{0};
+                memcpy(&chunk, data, sizeof(chunk));
+                crc = _mm_crc32_u32(crc, chunk);
+                data += 4;
+                length -= 4;
+            }
+            while (length-- != 0) {
+                crc = _mm_crc32_u8(crc, *data++);
+            }
+            return crc;
+        }
+
+        bool detectHardwareSupport()
+        {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse4.2");
+        }
+#elif defined(TJLUTILS_CRC32C_ARM)
+        uint32_t extendHardware(uint32_t crc, const uint8_t *data, size_t length)
+        {
+            while (length >= 8) {
+                uint64_t chunk{0};
+                memcpy(&chunk, data, sizeof(chunk));
+                crc = __crc32cd(crc, chunk);
+                data += 8;
+                length -= 8;
+            }
+            while (length-- != 0) {
+                crc = __crc32cb(crc, *data++);
+            }
+            return crc;
+        }
+
+        bool detectHardwareSupport()
+        {
+            return true;
+        }
+#endif
+
+        uint32_t extendTableDriven(uint32_t crc, const uint8_t *data, size_t length)
+        {
+            const auto &table = sliceTables().table;
+            while ((length != 0) && ((reinterpret_cast<uintptr_t>(data) & 7) != 0)) {
+                crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xFF];
+                length--;
+            }
+            while (length >= 8) {
+                uint32_t low{loadLittleEndian32(data) ^ crc};
+                uint32_t high{loadLittleEndian32(data + 4)};
+                crc = table[7][low & 0xFF]
+                      ^ table[6][(low >> 8) & 0xFF]
+                      ^ table[5][(low >> 16) & 0xFF]
+                      ^ table[4][low >> 24]
+                      ^ table[3][high & 0xFF]
+                      ^ table[2][(high >> 8) & 0xFF]
+                      ^ table[1][(high >> 16) & 0xFF]
+                      ^ table[0][high >> 24];
+                data += 8;
+                length -= 8;
+            }
+            while (length-- != 0) {
+                crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xFF];
+            }
+            return crc;
+        }
+    }
+
+    bool isHardwareAccelerated()
+    {
+#if defined(TJLUTILS_CRC32C_X86) || defined(TJLUTILS_CRC32C_ARM)
+        static const bool hardwareAccelerated{detectHardwareSupport()};
+        return hardwareAccelerated;
+#else
+        return false;
+#endif
+    }
+
+    uint32_t extend(uint32_t crc, const void *data, size_t length)
+    {
+#if defined(TJLUTILS_CRC32C_X86) || defined(TJLUTILS_CRC32C_ARM)
+        if (isHardwareAccelerated()) {
+            return ~extendHardware(~crc, static_cast<const uint8_t *>(data), length);
+        }
+#endif
+        return ~extendTableDriven(~crc, static_cast<const uint8_t *>(data), length);
+    }
+
+    uint32_t extendSoftware(uint32_t crc, const void *data, size_t length)
+    {
+        return ~extendTableDriven(~crc, static_cast<const uint8_t *>(data), length);
+    }
+
+    uint32_t compute(const void *data, size_t length)
+    {
+        return extend(0, data, length);
+    }
+
+    uint32_t compute(const std::string &str)
+    {
+        return extend(0, str.data(), str.length());
+    }
+
+    std::string appendTrailer(const std::string &str)
+    {
+        uint32_t crc{compute(str)};
+        std::string returnString{};
+        returnString.reserve(str.length() + TRAILER_SIZE);
+        returnString.append(str);
+        for (size_t i = 0; i < TRAILER_SIZE; i++) {
+            returnString.push_back(static_cast<char>((crc >> (8 * i)) & 0xFF));
+        }
+        return returnString;
+    }
+
+    bool verifyAndStripTrailer(std::string *str)
+    {
+        if ((!str) || (str->length() < TRAILER_SIZE)) {
+            return false;
+        }
+        size_t payloadLength{str->length() - TRAILER_SIZE};
+        uint32_t receivedCrc{loadLittleEndian32(reinterpret_cast<const uint8_t *>(str->data() + payloadLength))};
+        if (compute(str->data(), payloadLength) != receivedCrc) {
+            return false;
+        }
+        str->resize(payloadLength);
+        return true;
+    }
+}
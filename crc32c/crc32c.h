@@ -0,0 +1,50 @@
+/***********************************************************************
+*    crc32c.h:                                                         *
+*    Namespace CRC32C, for Castagnoli CRC32 checksums                  *
+*    Copyright (c) 2017 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the declarations of a CRC32C namespace            *
+*    It is used to compute CRC32C (Castagnoli, polynomial 0x82F63B78)  *
+*    checksums, using the SSE4.2/ARMv8 crc32 instructions when the CPU *
+*    has them and a table driven slice-by-8 implementation otherwise   *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#ifndef TJLUTILS_CRC32C_H
+#define TJLUTILS_CRC32C_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace CRC32C
+{
+    const uint32_t constexpr POLYNOMIAL{0x82F63B78};
+    const size_t constexpr TRAILER_SIZE{sizeof(uint32_t)};
+
+    //Checksum of a whole buffer
+    uint32_t compute(const void *data, size_t length);
+    uint32_t compute(const std::string &str);
+
+    //Continue a checksum over more data, starting from a previous result (or 0)
+    uint32_t extend(uint32_t crc, const void *data, size_t length);
+
+    //Always use the table driven implementation, mostly for testing/benchmarking
+    uint32_t extendSoftware(uint32_t crc, const void *data, size_t length);
+
+    bool isHardwareAccelerated();
+
+    //Append/strip a 4 byte little endian checksum trailer
+    std::string appendTrailer(const std::string &str);
+    bool verifyAndStripTrailer(std::string *str);
+}
+
+#endif //TJLUTILS_CRC32C_H
@@ -0,0 +1,91 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <crc32c.h>
+
+//Known answer checks, then throughput of the accelerated and table driven paths
+static const std::vector<size_t> BUFFER_SIZES{64, 1500, 65536, 1048576};
+static const size_t BYTES_PER_RUN{1024UL * 1024UL * 1024UL};
+
+bool checkKnownAnswers()
+{
+    bool allPassed{true};
+    //Test vectors from RFC 3720 (iSCSI), appendix B.4
+    std::string zeroes(32, '\x00');
+    std::string ones(32, '\xFF');
+    std::string incrementing(32, '\x00');
+    for (size_t i = 0; i < incrementing.size(); i++) {
+        incrementing[i] = static_cast<char>(i);
+    }
+    std::vector<std::pair<std::string, uint32_t>> knownAnswers{
+        {"123456789", 0xE3069283},
+        {zeroes, 0x8A9136AA},
+        {ones, 0x62A8AB43},
+        {incrementing, 0x46DD794E}
+    };
+    for (auto &it : knownAnswers) {
+        uint32_t hardware{CRC32C::compute(it.first)};
+        uint32_t software{CRC32C::extendSoftware(0, it.first.data(), it.first.length())};
+        if ((hardware != it.second) || (software != it.second)) {
+            std::cout << "FAILED: expected 0x" << std::hex << it.second << ", got 0x" << hardware << " (accelerated) and 0x" << software << " (table)" << std::dec << std::endl;
+            allPassed = false;
+        }
+    }
+    std::mt19937 randomEngine{1234};
+    std::vector<uint8_t> randomBuffer(4096);
+    for (auto &it : randomBuffer) {
+        it = static_cast<uint8_t>(randomEngine());
+    }
+    for (size_t offset = 0; offset < 16; offset++) {
+        for (size_t length : {0, 1, 7, 8, 9, 63, 1000, 4000}) {
+            uint32_t hardware{CRC32C::compute(randomBuffer.data() + offset, length)};
+            uint32_t software{CRC32C::extendSoftware(0, randomBuffer.data() + offset, length)};
+            uint32_t split{CRC32C::extend(CRC32C::compute(randomBuffer.data() + offset, length / 2), randomBuffer.data() + offset + length / 2, length - length / 2)};
+            if ((hardware != software) || (hardware != split)) {
+                std::cout << "FAILED: mismatch at offset " << offset << ", length " << length << std::endl;
+                allPassed = false;
+            }
+        }
+    }
+    std::string withTrailer{CRC32C::appendTrailer("payload")};
+    if ((!CRC32C::verifyAndStripTrailer(&withTrailer)) || (withTrailer != "payload")) {
+        std::cout << "FAILED: trailer round trip" << std::endl;
+        allPassed = false;
+    }
+    withTrailer = CRC32C::appendTrailer("payload");
+    withTrailer[2] ^= 0x01;
+    if (CRC32C::verifyAndStripTrailer(&withTrailer)) {
+        std::cout << "FAILED: corrupted trailer was accepted" << std::endl;
+        allPassed = false;
+    }
+    return allPassed;
+}
+
+double measureGigabytesPerSecond(const std::function<uint32_t(uint32_t, const void *, size_t)> &crcFunction, const std::vector<uint8_t> &buffer)
+{
+    size_t iterations{std::max<size_t>(1, BYTES_PER_RUN / buffer.size())};
+    volatile uint32_t sink{0};
+    auto startTime = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        sink = crcFunction(sink, buffer.data(), buffer.size());
+    }
+    double elapsedSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()};
+    return (static_cast<double>(iterations) * buffer.size()) / elapsedSeconds / 1e9;
+}
+
+int main()
+{
+    bool knownAnswersPassed{checkKnownAnswers()};
+    std::cout << "known_answers=" << (knownAnswersPassed ? "pass" : "fail")
+              << " hardware_accelerated=" << (CRC32C::isHardwareAccelerated() ? "true" : "false") << std::endl;
+    for (size_t bufferSize : BUFFER_SIZES) {
+        std::vector<uint8_t> buffer(bufferSize, 0xA5);
+        std::cout << "buffer_bytes=" << bufferSize
+                  << " accelerated_gb_per_s=" << measureGigabytesPerSecond(CRC32C::extend, buffer)
+                  << " slice_by_8_gb_per_s=" << measureGigabytesPerSecond(CRC32C::extendSoftware, buffer) << std::endl;
+    }
+    return (knownAnswersPassed ? 0 : 1);
+}
@@ -153,7 +153,8 @@ namespace IByteStreamUtilities {
         if (beginning == ending) {
             size_t tempFound{findString.find(beginning)};
             foundPosition = findString.find(beginning);
-            foundEndPosition = foundPosition + (findString.substr(tempFound+1).find(ending));
+            size_t foundEndOffset{findString.substr(tempFound+1).find(ending)};
+            foundEndPosition = ((tempFound == std::string::npos) || (foundEndOffset == std::string::npos)) ? std::string::npos : foundPosition + 1 + foundEndOffset;
         } else {
             foundPosition = findString.find(beginning);
             foundEndPosition = findString.find(ending);
@@ -224,6 +225,9 @@ namespace IByteStreamUtilities {
 
 using namespace IByteStreamUtilities;
 
+const constexpr ssize_t IByteStream::WRITE_UNSUPPORTED;
+const constexpr long long IByteStreamScriptExecutor::DEFAULT_DELAY_SPIN_MICROSECONDS;
+
 IByteStreamScriptReader::IByteStreamScriptReader(const std::string &scriptFilePath) :
     m_scriptFilePath{scriptFilePath},
     m_commands{std::make_shared<std::vector<IByteStreamCommand>>()}
@@ -298,7 +302,7 @@ IByteStreamScriptReader::IByteStreamScriptReader(const std::string &scriptFilePa
                         int temp{std::stoi(targetLoopCount)};
                         loopCount = temp > 0 ? temp : temp*-1;
                         loops++;
-                        this->m_commands->emplace_back(IByteStreamCommandType::LOOP_START, toStdString(loopCount));
+                        this->m_commands->emplace_back(IByteStreamCommandType::LOOP_START, static_cast<long long>(loopCount));
                     } catch (std::exception &e) {
                         std::cout << GENERIC_CONFIG_WARNING_BASE_STRING << currentLine << GENERIC_CONFIG_WARNING_TAIL_STRING << std::endl;
                         std::cout << LOOP_COUNT_PARAMETER_NOT_AN_INTEGER_STRING << std::endl;
@@ -349,7 +353,7 @@ IByteStreamScriptReader::IByteStreamScriptReader(const std::string &scriptFilePa
                 targetDelay = getBetween("(", ")", copyString);
                 try {
                     long long int delay{std::stol(targetDelay)};
-                    this->m_commands->emplace_back(commandType, toStdString(delay));
+                    this->m_commands->emplace_back(commandType, delay);
                 } catch (std::exception &e) {
                     std::cout << GENERIC_CONFIG_WARNING_BASE_STRING << currentLine << GENERIC_CONFIG_WARNING_TAIL_STRING << std::endl;
                     if (commandType == IByteStreamCommandType::DELAY_SECONDS) {
@@ -452,9 +456,14 @@ std::shared_ptr<std::vector<IByteStreamCommand>> IByteStreamScriptReader::comman
 }
 
 IByteStreamScriptExecutor::IByteStreamScriptExecutor(const std::string &iByteStreamScriptFilePath) :
-    m_iByteStreamScriptReader{std::make_shared<IByteStreamScriptReader>(iByteStreamScriptFilePath)}
+    m_iByteStreamScriptReader{std::make_shared<IByteStreamScriptReader>(iByteStreamScriptFilePath)},
+    m_instructions{},
+    m_maximumLoopDepth{0},
+    m_encodedLineEnding{""},
+    m_delaySpinThreshold{IByteStreamScriptExecutor::DEFAULT_DELAY_SPIN_MICROSECONDS},
+    m_delayTimingCallback{nullptr}
 {
-
+    this->compileCommands();
 }
 
 std::string IByteStreamScriptExecutor::scriptFilePath() const
@@ -472,72 +481,110 @@ size_t IByteStreamScriptExecutor::numberOfCommands() const
     return this->m_iByteStreamScriptReader->commands()->size();
 }
 
+std::chrono::microseconds IByteStreamScriptExecutor::delaySpinThreshold() const
+{
+    return this->m_delaySpinThreshold;
+}
+
+void IByteStreamScriptExecutor::setDelaySpinThreshold(std::chrono::microseconds delaySpinThreshold)
+{
+    if (delaySpinThreshold.count() < 0) {
+        throw std::runtime_error("In IByteStreamScriptExecutor::setDelaySpinThreshold(std::chrono::microseconds): The spin threshold cannot be negative");
+    }
+    this->m_delaySpinThreshold = delaySpinThreshold;
+}
+
+void IByteStreamScriptExecutor::setDelayTimingCallback(const IByteStreamDelayTimingCallback &delayTimingCallback)
+{
+    this->m_delayTimingCallback = delayTimingCallback;
+}
+
 void IByteStreamScriptExecutor::setScriptFilePath(const std::string &iByteStreamScriptFilePath)
 {
     this->m_iByteStreamScriptReader.reset();
     this->m_iByteStreamScriptReader = std::make_shared<IByteStreamScriptReader>(iByteStreamScriptFilePath);
+    this->compileCommands();
 }
 
-std::vector<IByteStreamCommand> IByteStreamScriptExecutor::doUnrollLoopCommands(const std::vector<IByteStreamCommand> &IByteStreamCommands)
+void IByteStreamScriptExecutor::compileCommands()
 {
-    std::vector<IByteStreamCommand> copyCommands{IByteStreamCommands};
-    if (!IByteStreamScriptExecutor::containsLoopStart(copyCommands)) {
-        return copyCommands;
-    }
-    while (IByteStreamScriptExecutor::containsLoopStart(copyCommands)) {
-        std::pair<int, int> innerLoopPositions = findInnerLoopIndexes(copyCommands);
-        std::vector<IByteStreamCommand> toUnroll{};
-        std::vector<IByteStreamCommand> temp{};
-        int numberOfLoops{std::stoi(copyCommands.at(innerLoopPositions.first).commandArgument())};
-        for (int loops = 0; loops < numberOfLoops; loops++) {
-            for (int i = innerLoopPositions.first+1; i < innerLoopPositions.second; i++) {
-                toUnroll.emplace_back(copyCommands.at(i));
+    const std::vector<IByteStreamCommand> &commands = *this->m_iByteStreamScriptReader->commands();
+    std::vector<IByteStreamInstruction> instructions{};
+    instructions.reserve(commands.size());
+    std::vector<size_t> openLoops{};
+    size_t maximumLoopDepth{0};
+    for (auto &it : commands) {
+        IByteStreamInstruction instruction{it.commandType(),
+                                           it.commandArgument(),
+                                           (it.commandType() == IByteStreamCommandType::WRITE) ? it.commandArgument() : "",
+                                           it.integerArgument(),
+                                           it.duration(),
+                                           0};
+        if (it.commandType() == IByteStreamCommandType::LOOP_START) {
+            openLoops.push_back(instructions.size());
+            maximumLoopDepth = std::max(maximumLoopDepth, openLoops.size());
+        } else if (it.commandType() == IByteStreamCommandType::LOOP_END) {
+            if (openLoops.empty()) {
+                throw std::runtime_error(UNEXPECTED_LOOP_CLOSING_STRING);
             }
+            size_t loopStart{openLoops.back()};
+            openLoops.pop_back();
+            instruction.jumpTarget = loopStart + 1;
+            instructions[loopStart].jumpTarget = instructions.size() + 1;
         }
-        for (int i = 0; i < innerLoopPositions.first; i++) {
-            temp.emplace_back(copyCommands.at(i));
-        }
-        for (auto &it : toUnroll) {
-            temp.emplace_back(it);
-        }
-        for (unsigned int i = innerLoopPositions.second+1; i < copyCommands.size(); i++) {
-            temp.emplace_back(copyCommands.at(i));
-        }
-        copyCommands = temp; 
+        instructions.push_back(std::move(instruction));
     }
-    return copyCommands;
+    if (!openLoops.empty()) {
+        throw std::runtime_error(UNTERMINATED_LOOP_STRING);
+    }
+    this->m_instructions = std::move(instructions);
+    this->m_maximumLoopDepth = maximumLoopDepth;
+    this->m_encodedLineEnding = "";
 }
-std::pair<int, int> IByteStreamScriptExecutor::findInnerLoopIndexes(const std::vector<IByteStreamCommand> &IByteStreamCommands)
+
+//Done once per line ending, rather than by writeLine() on every write
+void IByteStreamScriptExecutor::encodeWrites(const std::string &lineEnding)
 {
-    int lastLoopStartPosition{0};
-    int lastLoopEndPosition{0};
-    for (unsigned int i = 0; i < IByteStreamCommands.size(); i++) {
-        if (IByteStreamCommands.at(i).commandType() == IByteStreamCommandType::LOOP_START) {
-            lastLoopStartPosition = i;
+    for (auto &it : this->m_instructions) {
+        if (it.commandType != IByteStreamCommandType::WRITE) {
+            continue;
         }
-    }
-
-    for (unsigned int i = lastLoopStartPosition; i < IByteStreamCommands.size(); i++) {
-        if (IByteStreamCommands.at(i).commandType() == IByteStreamCommandType::LOOP_END) {
-            if (lastLoopStartPosition == 0) {
-                lastLoopEndPosition = lastLoopStartPosition + i;
-            } else {
-                lastLoopEndPosition = lastLoopStartPosition + i - 1;
-            }
-            break;
+        it.encodedPayload = it.commandArgument;
+        if ((it.encodedPayload.length() < lineEnding.length()) ||
+            (it.encodedPayload.compare(it.encodedPayload.length() - lineEnding.length(), lineEnding.length(), lineEnding) != 0)) {
+            it.encodedPayload += lineEnding;
         }
     }
-    return std::make_pair(lastLoopStartPosition, lastLoopEndPosition);
+    this->m_encodedLineEnding = lineEnding;
 }
 
-bool IByteStreamScriptExecutor::containsLoopStart(const std::vector<IByteStreamCommand> &commands) 
+//Sleeps until shortly before the deadline, since sleeps tend to run over by tens of
+//microseconds, then spins the rest of the way. *timeline is moved on to the deadline
+void IByteStreamScriptExecutor::waitForDeadline(DelayType delayType, std::chrono::microseconds duration, std::chrono::steady_clock::time_point *timeline)
 {
-    for (auto &it : commands) {
-        if (it.commandType() == IByteStreamCommandType::LOOP_START) {
-            return true;
+    std::chrono::steady_clock::time_point previousDeadline{*timeline};
+    std::chrono::steady_clock::time_point deadline{previousDeadline + duration};
+    std::chrono::steady_clock::time_point intendedDeadline{deadline};
+    std::chrono::steady_clock::time_point now{std::chrono::steady_clock::now()};
+    bool rescheduled{now >= deadline};
+    if (rescheduled) {
+        deadline = now;
+    } else {
+        std::chrono::steady_clock::time_point sleepUntil{deadline - this->m_delaySpinThreshold};
+        if (sleepUntil > now) {
+            std::this_thread::sleep_until(sleepUntil);
         }
+        do {
+            now = std::chrono::steady_clock::now();
+        } while (now < deadline);
+    }
+    *timeline = deadline;
+    if (this->m_delayTimingCallback) {
+        IByteStreamDelayTiming delayTiming{delayType,
+                                           duration,
+                                           std::chrono::duration_cast<std::chrono::nanoseconds>(now - previousDeadline),
+                                           std::chrono::duration_cast<std::chrono::nanoseconds>(now - intendedDeadline),
+                                           rescheduled};
+        this->m_delayTimingCallback(delayTiming);
     }
-    return false;
 }
-
-
@@ -30,6 +30,7 @@
 #include <tuple>
 #include <cstdlib>
 #include <utility>
+#include <stdexcept>
 
 #if defined(_WIN32) && !defined(__CYGWIN__)
     //using ssize_t = long;
@@ -45,16 +46,41 @@ class IByteStreamCommand
 public:
     inline IByteStreamCommand(IByteStreamCommandType commandType, const std::string &commandArgument) :
         m_commandType{commandType},
-        m_commandArgument{commandArgument} { }
+        m_commandArgument{commandArgument},
+        m_integerArgument{0},
+        m_duration{0} { }
+    //For delays (the count in the command's own unit) and loops (the iteration count), so
+    //the value is parsed once, when the script is read
+    inline IByteStreamCommand(IByteStreamCommandType commandType, long long integerArgument) :
+        m_commandType{commandType},
+        m_commandArgument{std::to_string(integerArgument)},
+        m_integerArgument{integerArgument},
+        m_duration{durationOf(commandType, integerArgument)} { }
     
     inline IByteStreamCommandType commandType() const { return this->m_commandType; }
     inline std::string commandArgument() const { return this->m_commandArgument; }
+    inline long long integerArgument() const { return this->m_integerArgument; }
+    //How long a delay command waits, zero for every other command
+    inline std::chrono::microseconds duration() const { return this->m_duration; }
     inline void setCommandType(const IByteStreamCommandType &commandType) { this->m_commandType = commandType; }
     inline void setCommandArgument(const std::string &commandArgument) { this->m_commandArgument = commandArgument; }
 
 private:
     IByteStreamCommandType m_commandType;
     std::string m_commandArgument;
+    long long m_integerArgument;
+    std::chrono::microseconds m_duration;
+
+    static inline std::chrono::microseconds durationOf(IByteStreamCommandType commandType, long long integerArgument) {
+        if (commandType == IByteStreamCommandType::DELAY_SECONDS) {
+            return std::chrono::seconds(integerArgument);
+        } else if (commandType == IByteStreamCommandType::DELAY_MILLISECONDS) {
+            return std::chrono::milliseconds(integerArgument);
+        } else if (commandType == IByteStreamCommandType::DELAY_MICROSECONDS) {
+            return std::chrono::microseconds(integerArgument);
+        }
+        return std::chrono::microseconds(0);
+    }
 };
 
 class IByteStream
@@ -69,6 +95,9 @@ public:
 
     virtual ssize_t writeLine(const std::string &str) = 0;
     virtual ssize_t writeLine(const char *str) = 0;
+    //Writes exactly length bytes, with no line ending added. A stream that cannot keeps
+    //this default, which writes nothing and returns WRITE_UNSUPPORTED
+    virtual ssize_t write(const void *data, size_t length) { (void)data; (void)length; return IByteStream::WRITE_UNSUPPORTED; }
     virtual ssize_t available() = 0;
     virtual bool isOpen() const = 0;
     virtual void openPort() = 0;
@@ -91,6 +120,7 @@ public:
     virtual std::string readUntil(const char *until) = 0;
     virtual std::string readUntil(char until) = 0;
 
+    static const constexpr ssize_t WRITE_UNSUPPORTED{-2};
 };
 
 const char * const DELAY_IDENTIFIER{"delay"};
@@ -144,11 +174,38 @@ private:
     }
 };
 
+//One step of a compiled script. Loops are kept as jumps instead of being unrolled: a
+//LOOP_START holds its iteration count and jumps to just past its LOOP_END when that count
+//is 0, and a LOOP_END jumps back to the first instruction of its body. A WRITE holds its
+//line already followed by the line ending of the stream the script last ran on
+struct IByteStreamInstruction
+{
+    IByteStreamCommandType commandType;
+    std::string commandArgument;
+    std::string encodedPayload;
+    long long integerArgument;
+    std::chrono::microseconds duration;
+    size_t jumpTarget;
+};
+
+//How one delay of a running script went. achieved is the time since the previous delay's
+//deadline (or since the script started), and lateness how long after its own deadline
+//the delay returned. rescheduled is set when the deadline had already passed by the time the
+//delay was reached, in which case it returns at once and the timeline restarts from there
+struct IByteStreamDelayTiming
+{
+    DelayType delayType;
+    std::chrono::microseconds intended;
+    std::chrono::nanoseconds achieved;
+    std::chrono::nanoseconds lateness;
+    bool rescheduled;
+};
+
+using IByteStreamDelayTimingCallback = std::function<void(const IByteStreamDelayTiming &)>;
+
 class IByteStreamScriptExecutor
 {
 private:
-    static inline void delayMilliseconds(unsigned long long howLong) { std::this_thread::sleep_for(std::chrono::milliseconds(howLong)); }
-    static inline void delaySeconds(unsigned long long howLong) { std::this_thread::sleep_for(std::chrono::seconds(howLong)); }
     template <typename T> static inline std::string toStdString(const T &t) { 
         return dynamic_cast<std::stringstream &>(std::stringstream{} << t).str(); 
     }
@@ -161,6 +218,17 @@ public:
     std::string scriptFilePath() const;
     bool hasCommands() const;
     size_t numberOfCommands() const;
+
+    //Delays are waited out against deadlines on a steady timeline that starts when the
+    //script does, so the time taken by the commands in between (and any oversleep) is not
+    //added to every iteration of a loop. The last delaySpinThreshold() of each wait is
+    //spun instead of slept, trading that much CPU for accuracy; 0 turns spinning off
+    std::chrono::microseconds delaySpinThreshold() const;
+    void setDelaySpinThreshold(std::chrono::microseconds delaySpinThreshold);
+    //Called after every delay, on the thread running the script
+    void setDelayTimingCallback(const IByteStreamDelayTimingCallback &delayTimingCallback);
+
+    static const constexpr long long DEFAULT_DELAY_SPIN_MICROSECONDS{200};
     
     template <typename ... RxArgs, typename ... TxArgs, typename ... DelayArgs, typename ... FlushArgs, typename ... LoopArgs>
     void execute(std::shared_ptr<IByteStream> ioStream, 
@@ -170,51 +238,12 @@ public:
                  const std::function<void(FlushArgs...)> &printFlushResult,
                  const std::function<void(LoopArgs...)> &printLoopResult)
     {
-        if (!ioStream) {
-            throw std::runtime_error(NULL_IO_STREAM_PASSED_TO_EXECUTE_STRING);
-        }
-        if (!ioStream->isOpen()) {
-            try {
-                ioStream->openPort();
-            } catch (std::exception &e) {
-                throw std::runtime_error(e.what());
-            }
-        }
-        int loop {false};
-        int loopCount{0};
-        this->m_iByteStreamScriptCommands = doUnrollLoopCommands(*this->m_iByteStreamScriptReader->commands());
-        for (auto &it : this->m_iByteStreamScriptCommands) {
-            try {
-                if (it.commandType() == IByteStreamCommandType::WRITE) {
-                    ioStream->writeLine(it.commandArgument());
-                    printTxResult(it.commandArgument());
-                } else if (it.commandType() == IByteStreamCommandType::READ) {
-                    printRxResult(ioStream->readLine());
-                } else if (it.commandType() == IByteStreamCommandType::DELAY_SECONDS) {
-                    printDelayResult(DelayType::SECONDS, std::stoi(it.commandArgument()));
-                    delaySeconds(std::stoi(it.commandArgument()));
-                } else if (it.commandType() == IByteStreamCommandType::DELAY_MILLISECONDS) {
-                    printDelayResult(DelayType::MILLISECONDS, std::stoi(it.commandArgument()));
-                    delayMilliseconds(std::stoi(it.commandArgument()));
-                } else if (it.commandType() == IByteStreamCommandType::DELAY_MICROSECONDS) {
-                    printDelayResult(DelayType::MICROSECONDS, std::stoi(it.commandArgument()));
-                    delayMilliseconds(std::stoi(it.commandArgument()));
-                } else if (it.commandType() == IByteStreamCommandType::FLUSH_RX) {
-                    printFlushResult(FlushType::RX);
-                    ioStream->flushRX();
-                } else if (it.commandType() == IByteStreamCommandType::FLUSH_TX) {
-                    printFlushResult(FlushType::TX);
-                    ioStream->flushTX();
-                } else if (it.commandType() == IByteStreamCommandType::FLUSH_RX_TX) {
-                    printFlushResult(FlushType::RX_TX);
-                    ioStream->flushRXTX();
-                } else {
-                    throw std::runtime_error(COMMAND_TYPE_NOT_IMPLEMENTED_STRING + it.commandArgument());
-                }
-            } catch (std::exception &e) {
-                throw std::runtime_error(e.what());
-            }
-        }
+        (void)printLoopResult;
+        this->run(ioStream,
+                  [&printRxResult](const std::string &str) { printRxResult(str); },
+                  [&printTxResult](const std::string &str) { printTxResult(str); },
+                  [&printDelayResult](DelayType delayType, int howLong) { printDelayResult(delayType, howLong); },
+                  [&printFlushResult](FlushType flushType) { printFlushResult(flushType); });
     }
 
 
@@ -228,6 +257,34 @@ public:
                  const std::function<void(InstanceArg *, LoopArgs...)> &printLoopResult)
     {
         (void)printLoopResult;
+        this->run(ioStream,
+                  [instanceArg, &printRxResult](const std::string &str) { printRxResult(instanceArg, str); },
+                  [instanceArg, &printTxResult](const std::string &str) { printTxResult(instanceArg, str); },
+                  [instanceArg, &printDelayResult](DelayType delayType, int howLong) { printDelayResult(instanceArg, delayType, howLong); },
+                  [instanceArg, &printFlushResult](FlushType flushType) { printFlushResult(instanceArg, flushType); });
+    }
+private:
+    std::shared_ptr<IByteStreamScriptReader> m_iByteStreamScriptReader;
+    std::vector<IByteStreamInstruction> m_instructions;
+    size_t m_maximumLoopDepth;
+    std::string m_encodedLineEnding;
+    std::chrono::microseconds m_delaySpinThreshold;
+    IByteStreamDelayTimingCallback m_delayTimingCallback;
+
+    void compileCommands();
+    void encodeWrites(const std::string &lineEnding);
+    void waitForDeadline(DelayType delayType, std::chrono::microseconds duration, std::chrono::steady_clock::time_point *timeline);
+
+    //Steps through the compiled instructions, keeping one counter per loop currently being
+    //run, so memory use does not depend on how many times a loop goes around. Nothing is
+    //parsed or allocated per instruction, apart from the lines returned by readLine()
+    template <typename RxHandler, typename TxHandler, typename DelayHandler, typename FlushHandler>
+    void run(std::shared_ptr<IByteStream> ioStream,
+             const RxHandler &printRxResult,
+             const TxHandler &printTxResult,
+             const DelayHandler &printDelayResult,
+             const FlushHandler &printFlushResult)
+    {
         if (!ioStream) {
             throw std::runtime_error(NULL_IO_STREAM_PASSED_TO_EXECUTE_STRING);
         }
@@ -238,51 +295,65 @@ public:
                 throw std::runtime_error(e.what());
             }
         }
-        int loop {false};
-        int loopCount{0};
-        this->m_iByteStreamScriptCommands = doUnrollLoopCommands(*this->m_iByteStreamScriptReader->commands());
-        (void)loop;
-        (void)loopCount;
-        for (auto &it : this->m_iByteStreamScriptCommands) {
+        std::string lineEnding{ioStream->lineEnding()};
+        if (lineEnding != this->m_encodedLineEnding) {
+            this->encodeWrites(lineEnding);
+        }
+        //Set once the stream turns out not to take raw bytes (see IByteStream::write())
+        bool writesLines{false};
+        std::vector<unsigned long long> loopCounters{};
+        loopCounters.reserve(this->m_maximumLoopDepth);
+        std::chrono::steady_clock::time_point timeline{std::chrono::steady_clock::now()};
+        size_t programCounter{0};
+        while (programCounter < this->m_instructions.size()) {
+            const IByteStreamInstruction &it = this->m_instructions[programCounter++];
             try {
-                if (it.commandType() == IByteStreamCommandType::WRITE) {
-                    ioStream->writeLine(it.commandArgument());
-                    printTxResult(instanceArg, it.commandArgument());
-                } else if (it.commandType() == IByteStreamCommandType::READ) {
-                    printRxResult(instanceArg, ioStream->readLine());
-                } else if (it.commandType() == IByteStreamCommandType::DELAY_SECONDS) {
-                    printDelayResult(instanceArg, DelayType::SECONDS, std::stoi(it.commandArgument()));
-                    delaySeconds(std::stoi(it.commandArgument()));
-                } else if (it.commandType() == IByteStreamCommandType::DELAY_MILLISECONDS) {
-                    printDelayResult(instanceArg, DelayType::MILLISECONDS, std::stoi(it.commandArgument()));
-                    delayMilliseconds(std::stoi(it.commandArgument()));
-                } else if (it.commandType() == IByteStreamCommandType::DELAY_MICROSECONDS) {
-                    printDelayResult(instanceArg, DelayType::MICROSECONDS, std::stoi(it.commandArgument()));
-                    delayMilliseconds(std::stoi(it.commandArgument()));
-                } else if (it.commandType() == IByteStreamCommandType::FLUSH_RX) {
-                    printFlushResult(instanceArg, FlushType::RX);
+                if (it.commandType == IByteStreamCommandType::WRITE) {
+                    if ((writesLines) || (ioStream->write(it.encodedPayload.data(), it.encodedPayload.length()) == IByteStream::WRITE_UNSUPPORTED)) {
+                        writesLines = true;
+                        ioStream->writeLine(it.commandArgument);
+                    }
+                    printTxResult(it.commandArgument);
+                } else if (it.commandType == IByteStreamCommandType::READ) {
+                    printRxResult(ioStream->readLine());
+                } else if (it.commandType == IByteStreamCommandType::LOOP_START) {
+                    if (it.integerArgument == 0) {
+                        programCounter = it.jumpTarget;
+                    } else {
+                        loopCounters.push_back(static_cast<unsigned long long>(it.integerArgument));
+                    }
+                } else if (it.commandType == IByteStreamCommandType::LOOP_END) {
+                    if (--loopCounters.back() != 0) {
+                        programCounter = it.jumpTarget;
+                    } else {
+                        loopCounters.pop_back();
+                    }
+                } else if (it.commandType == IByteStreamCommandType::DELAY_SECONDS) {
+                    printDelayResult(DelayType::SECONDS, static_cast<int>(it.integerArgument));
+                    this->waitForDeadline(DelayType::SECONDS, it.duration, &timeline);
+                } else if (it.commandType == IByteStreamCommandType::DELAY_MILLISECONDS) {
+                    printDelayResult(DelayType::MILLISECONDS, static_cast<int>(it.integerArgument));
+                    this->waitForDeadline(DelayType::MILLISECONDS, it.duration, &timeline);
+                } else if (it.commandType == IByteStreamCommandType::DELAY_MICROSECONDS) {
+                    printDelayResult(DelayType::MICROSECONDS, static_cast<int>(it.integerArgument));
+                    this->waitForDeadline(DelayType::MICROSECONDS, it.duration, &timeline);
+                } else if (it.commandType == IByteStreamCommandType::FLUSH_RX) {
+                    printFlushResult(FlushType::RX);
                     ioStream->flushRX();
-                } else if (it.commandType() == IByteStreamCommandType::FLUSH_TX) {
-                    printFlushResult(instanceArg, FlushType::TX);
+                } else if (it.commandType == IByteStreamCommandType::FLUSH_TX) {
+                    printFlushResult(FlushType::TX);
                     ioStream->flushTX();
-                } else if (it.commandType() == IByteStreamCommandType::FLUSH_RX_TX) {
-                    printFlushResult(instanceArg, FlushType::RX_TX);
+                } else if (it.commandType == IByteStreamCommandType::FLUSH_RX_TX) {
+                    printFlushResult(FlushType::RX_TX);
                     ioStream->flushRXTX();
                 } else {
-                    throw std::runtime_error(COMMAND_TYPE_NOT_IMPLEMENTED_STRING + it.commandArgument());
+                    throw std::runtime_error(COMMAND_TYPE_NOT_IMPLEMENTED_STRING + it.commandArgument);
                 }
             } catch (std::exception &e) {
                 throw std::runtime_error(e.what());
             }
         }
     }
-private:
-    std::shared_ptr<IByteStreamScriptReader> m_iByteStreamScriptReader;
-    std::vector<IByteStreamCommand> m_iByteStreamScriptCommands;
-
-    std::vector<IByteStreamCommand> doUnrollLoopCommands(const std::vector<IByteStreamCommand> &iByteStreamCommands);
-    bool containsLoopStart(const std::vector<IByteStreamCommand> &commands);
-    std::pair<int, int> findInnerLoopIndexes(const std::vector<IByteStreamCommand> &iByteStreamCommands);
 };
 
 
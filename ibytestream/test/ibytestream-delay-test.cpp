@@ -0,0 +1,189 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdio>
+#include <ibytestream.h>
+
+//Runs paced IByteStream scripts against an in-memory stream whose writes take a while:
+//checks that a write/delay loop keeps to its period instead of drifting by the write
+//time every iteration, reports how far past their deadlines the delays returned, and
+//compares the total time against the same loop paced with sleep_for(). The median is
+//checked against 50us; the tail is reported only, since on a loaded or single CPU machine
+//it is set by preemption, which no waiter can avoid
+static const char *PACED_SCRIPT_PATH{"/tmp/ibytestream-delay-paced.txt"};
+static const char *MICROSECOND_SCRIPT_PATH{"/tmp/ibytestream-delay-microseconds.txt"};
+static const char *OVERRUN_SCRIPT_PATH{"/tmp/ibytestream-delay-overrun.txt"};
+static const int PACED_LOOP_COUNT{500};
+static const int PACED_PERIOD_MICROSECONDS{1000};
+static const int WRITE_MICROSECONDS{150};
+static const int OVERRUN_LOOP_COUNT{5};
+static const int OVERRUN_WRITE_MICROSECONDS{3000};
+static const double MAXIMUM_P50_LATENESS_MICROSECONDS{50.0};
+//Generous, since preemption can add milliseconds: the point is that it is not 1000 times longer
+static const double MAXIMUM_MICROSECOND_DELAY_OVERRUN{20000.0};
+
+void spinFor(std::chrono::microseconds howLong)
+{
+    auto until = std::chrono::steady_clock::now() + howLong;
+    while (std::chrono::steady_clock::now() < until) { }
+}
+
+class SlowByteStream : public IByteStream
+{
+public:
+    SlowByteStream(std::chrono::microseconds writeTime) : m_writeTime{writeTime}, m_lineEnding{"\n"} { }
+
+    void setTimeout(long timeout) { (void)timeout; }
+    long timeout() const { return 0; }
+    std::string lineEnding() const { return this->m_lineEnding; }
+    void setLineEnding(const std::string &str) { this->m_lineEnding = str; }
+
+    ssize_t writeLine(const std::string &str) { return this->write(str.data(), str.length()); }
+    ssize_t writeLine(const char *str) { return this->writeLine(std::string{str}); }
+    ssize_t write(const void *data, size_t length)
+    {
+        (void)data;
+        spinFor(this->m_writeTime);
+        return static_cast<ssize_t>(length);
+    }
+    ssize_t available() { return 0; }
+    bool isOpen() const { return true; }
+    void openPort() { }
+    void closePort() { }
+
+    std::string portName() const { return "slow"; }
+    void flushRX() { }
+    void flushTX() { }
+    void flushRXTX() { }
+
+    std::string peek() { return ""; }
+    char peekByte() { return '\0'; }
+
+    void putBack(const std::string &str) { (void)str; }
+    void putBack(const char *str) { (void)str; }
+    void putBack(char back) { (void)back; }
+
+    std::string readLine() { return ""; }
+    std::string readUntil(const std::string &until) { (void)until; return ""; }
+    std::string readUntil(const char *until) { (void)until; return ""; }
+    std::string readUntil(char until) { (void)until; return ""; }
+
+private:
+    std::chrono::microseconds m_writeTime;
+    std::string m_lineEnding;
+};
+
+void writeScript(const char *scriptPath, const std::string &script)
+{
+    std::ofstream scriptFile{scriptPath};
+    scriptFile << script;
+}
+
+//Returns how long the script took, in microseconds
+double runScript(IByteStreamScriptExecutor &executor, std::chrono::microseconds writeTime)
+{
+    std::shared_ptr<IByteStream> byteStream{std::make_shared<SlowByteStream>(writeTime)};
+    std::function<void(const std::string &)> printRxResult{[](const std::string &) { }};
+    std::function<void(const std::string &)> printTxResult{[](const std::string &) { }};
+    std::function<void(DelayType, int)> printDelayResult{[](DelayType, int) { }};
+    std::function<void(FlushType)> printFlushResult{[](FlushType) { }};
+    std::function<void(LoopType, int)> printLoopResult{[](LoopType, int) { }};
+    auto startTime = std::chrono::steady_clock::now();
+    executor.execute(byteStream, printRxResult, printTxResult, printDelayResult, printFlushResult, printLoopResult);
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+double percentile(std::vector<double> values, double fraction)
+{
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[static_cast<size_t>(fraction * static_cast<double>(values.size() - 1))];
+}
+
+int main()
+{
+    bool passed{true};
+
+    writeScript(PACED_SCRIPT_PATH,
+                "loop(" + std::to_string(PACED_LOOP_COUNT) + ") {\n"
+                "    write(\"tick\")\n"
+                "    delaymicroseconds(" + std::to_string(PACED_PERIOD_MICROSECONDS) + ")\n"
+                "}\n");
+    {
+        //The same loop paced with relative sleeps, for comparison
+        std::shared_ptr<IByteStream> byteStream{std::make_shared<SlowByteStream>(std::chrono::microseconds(WRITE_MICROSECONDS))};
+        auto startTime = std::chrono::steady_clock::now();
+        for (int i = 0; i < PACED_LOOP_COUNT; i++) {
+            byteStream->write("tick\n", 5);
+            std::this_thread::sleep_for(std::chrono::microseconds(PACED_PERIOD_MICROSECONDS));
+        }
+        double sleepForDrift{std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count() - static_cast<double>(PACED_LOOP_COUNT * PACED_PERIOD_MICROSECONDS)};
+        std::cout << "test=paced_sleep_for total_drift_us=" << sleepForDrift << std::endl;
+
+        IByteStreamScriptExecutor executor{PACED_SCRIPT_PATH};
+        std::vector<double> latenessMicroseconds{};
+        std::vector<double> achievedMicroseconds{};
+        int rescheduledCount{0};
+        executor.setDelayTimingCallback([&](const IByteStreamDelayTiming &delayTiming) {
+            latenessMicroseconds.push_back(std::chrono::duration<double, std::micro>(delayTiming.lateness).count());
+            achievedMicroseconds.push_back(std::chrono::duration<double, std::micro>(delayTiming.achieved).count());
+            rescheduledCount += delayTiming.rescheduled ? 1 : 0;
+        });
+        double elapsedMicroseconds{runScript(executor, std::chrono::microseconds(WRITE_MICROSECONDS))};
+        double driftMicroseconds{elapsedMicroseconds - static_cast<double>(PACED_LOOP_COUNT * PACED_PERIOD_MICROSECONDS)};
+        double p50Lateness{percentile(latenessMicroseconds, 0.5)};
+        bool accurate{(p50Lateness < MAXIMUM_P50_LATENESS_MICROSECONDS) && (driftMicroseconds < (sleepForDrift / 2.0))};
+        std::cout << "test=paced delays=" << latenessMicroseconds.size()
+                  << " intended_us=" << PACED_PERIOD_MICROSECONDS
+                  << " achieved_p50_us=" << percentile(achievedMicroseconds, 0.5)
+                  << " lateness_p50_us=" << p50Lateness
+                  << " lateness_p99_us=" << percentile(latenessMicroseconds, 0.99)
+                  << " lateness_max_us=" << percentile(latenessMicroseconds, 1.0)
+                  << " rescheduled=" << rescheduledCount
+                  << " total_drift_us=" << driftMicroseconds
+                  << " result=" << (accurate ? "pass" : "fail") << std::endl;
+        passed = passed && accurate;
+    }
+
+    writeScript(MICROSECOND_SCRIPT_PATH, "delaymicroseconds(2000)\n");
+    {
+        IByteStreamScriptExecutor executor{MICROSECOND_SCRIPT_PATH};
+        double elapsedMicroseconds{runScript(executor, std::chrono::microseconds(0))};
+        bool accurate{(elapsedMicroseconds >= 2000.0) && (elapsedMicroseconds < 2000.0 + MAXIMUM_MICROSECOND_DELAY_OVERRUN)};
+        std::cout << "test=microseconds intended_us=2000 elapsed_us=" << elapsedMicroseconds << " result=" << (accurate ? "pass" : "fail") << std::endl;
+        passed = passed && accurate;
+    }
+
+    //Writes that take longer than the delay: every delay is already late, so none of them
+    //wait, and the script takes about as long as the writes do
+    writeScript(OVERRUN_SCRIPT_PATH,
+                "loop(" + std::to_string(OVERRUN_LOOP_COUNT) + ") {\n"
+                "    write(\"slow\")\n"
+                "    delaymilliseconds(1)\n"
+                "}\n");
+    {
+        IByteStreamScriptExecutor executor{OVERRUN_SCRIPT_PATH};
+        int rescheduledCount{0};
+        executor.setDelayTimingCallback([&rescheduledCount](const IByteStreamDelayTiming &delayTiming) {
+            rescheduledCount += delayTiming.rescheduled ? 1 : 0;
+        });
+        double elapsedMicroseconds{runScript(executor, std::chrono::microseconds(OVERRUN_WRITE_MICROSECONDS))};
+        double writeMicroseconds{static_cast<double>(OVERRUN_LOOP_COUNT * OVERRUN_WRITE_MICROSECONDS)};
+        bool caughtUp{rescheduledCount == OVERRUN_LOOP_COUNT};
+        std::cout << "test=overrun rescheduled=" << rescheduledCount << " write_us=" << writeMicroseconds << " elapsed_us=" << elapsedMicroseconds << " result=" << (caughtUp ? "pass" : "fail") << std::endl;
+        passed = passed && caughtUp;
+    }
+
+    std::remove(PACED_SCRIPT_PATH);
+    std::remove(MICROSECOND_SCRIPT_PATH);
+    std::remove(OVERRUN_SCRIPT_PATH);
+    std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+    return (passed ? 0 : 1);
+}
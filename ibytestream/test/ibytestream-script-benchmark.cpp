@@ -0,0 +1,292 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <ibytestream.h>
+
+//Runs IByteStream scripts against an in-memory stream: checks that nested and empty
+//loops run the right commands in the right order, also on a stream that only takes whole
+//lines through writeLine(), then times a script with ten million writes in nested loops
+//and reports how long it takes to get to the first write and how much the process grew
+//while running it. Last, it runs a tight write/read loop, counting heap allocations, next
+//to the same commands sent through writeLine() one at a time
+static const char *ORDER_SCRIPT_PATH{"/tmp/ibytestream-script-order.txt"};
+static const char *LARGE_SCRIPT_PATH{"/tmp/ibytestream-script-large.txt"};
+static const char *WRITE_READ_SCRIPT_PATH{"/tmp/ibytestream-script-write-read.txt"};
+static const long long OUTER_LOOP_COUNT{1000000};
+static const long long INNER_LOOP_COUNT{10};
+static const long long WRITE_READ_LOOP_COUNT{2000000};
+static const long long MAXIMUM_GROWTH_KB{4096};
+static const long long MAXIMUM_ALLOCATIONS_PER_RUN{64};
+static const char *WRITE_READ_LINE{"status line long enough that it has to live on the heap"};
+
+static long long allocationCount{0};
+
+void *operator new(size_t size)
+{
+    allocationCount++;
+    void *allocated{std::malloc(size ? size : 1)};
+    if (!allocated) {
+        throw std::bad_alloc{};
+    }
+    return allocated;
+}
+
+void operator delete(void *allocated) noexcept
+{
+    std::free(allocated);
+}
+
+void operator delete(void *allocated, size_t) noexcept
+{
+    std::free(allocated);
+}
+
+class MemoryByteStream : public IByteStream
+{
+public:
+    MemoryByteStream() : m_written{""}, m_writeCount{0}, m_firstWriteTime{}, m_lineEnding{"\n"} { }
+
+    void setTimeout(long timeout) { (void)timeout; }
+    long timeout() const { return 0; }
+    std::string lineEnding() const { return this->m_lineEnding; }
+    void setLineEnding(const std::string &str) { this->m_lineEnding = str; }
+
+    //Appends the line ending the way the real streams do
+    ssize_t writeLine(const std::string &str)
+    {
+        std::string line{str};
+        line += this->m_lineEnding;
+        return this->write(line.data(), line.length());
+    }
+    ssize_t writeLine(const char *str) { return this->writeLine(std::string{str}); }
+    ssize_t write(const void *data, size_t length)
+    {
+        if (this->m_writeCount++ == 0) {
+            this->m_firstWriteTime = std::chrono::steady_clock::now();
+        }
+        if (this->m_written.length() < 64) {
+            this->m_written.append(static_cast<const char *>(data), length);
+        }
+        return static_cast<ssize_t>(length);
+    }
+    ssize_t available() { return 0; }
+    bool isOpen() const { return true; }
+    void openPort() { }
+    void closePort() { }
+
+    std::string portName() const { return "memory"; }
+    void flushRX() { }
+    void flushTX() { }
+    void flushRXTX() { }
+
+    std::string peek() { return ""; }
+    char peekByte() { return '\0'; }
+
+    void putBack(const std::string &str) { (void)str; }
+    void putBack(const char *str) { (void)str; }
+    void putBack(char back) { (void)back; }
+
+    std::string readLine() { return ""; }
+    std::string readUntil(const std::string &until) { (void)until; return ""; }
+    std::string readUntil(const char *until) { (void)until; return ""; }
+    std::string readUntil(char until) { (void)until; return ""; }
+
+    std::string written() const { return this->m_written; }
+    long long writeCount() const { return this->m_writeCount; }
+    std::chrono::steady_clock::time_point firstWriteTime() const { return this->m_firstWriteTime; }
+
+private:
+    std::string m_written;
+    long long m_writeCount;
+    std::chrono::steady_clock::time_point m_firstWriteTime;
+    std::string m_lineEnding;
+};
+
+//Only takes whole lines, so it keeps the default IByteStream::write()
+class LineByteStream : public IByteStream
+{
+public:
+    LineByteStream() : m_written{""}, m_lineEnding{"\r\n"} { }
+
+    void setTimeout(long timeout) { (void)timeout; }
+    long timeout() const { return 0; }
+    std::string lineEnding() const { return this->m_lineEnding; }
+    void setLineEnding(const std::string &str) { this->m_lineEnding = str; }
+
+    ssize_t writeLine(const std::string &str)
+    {
+        this->m_written += str + this->m_lineEnding;
+        return static_cast<ssize_t>(str.length() + this->m_lineEnding.length());
+    }
+    ssize_t writeLine(const char *str) { return this->writeLine(std::string{str}); }
+    ssize_t available() { return 0; }
+    bool isOpen() const { return true; }
+    void openPort() { }
+    void closePort() { }
+
+    std::string portName() const { return "lines"; }
+    void flushRX() { }
+    void flushTX() { }
+    void flushRXTX() { }
+
+    std::string peek() { return ""; }
+    char peekByte() { return '\0'; }
+
+    void putBack(const std::string &str) { (void)str; }
+    void putBack(const char *str) { (void)str; }
+    void putBack(char back) { (void)back; }
+
+    std::string readLine() { return ""; }
+    std::string readUntil(const std::string &until) { (void)until; return ""; }
+    std::string readUntil(const char *until) { (void)until; return ""; }
+    std::string readUntil(char until) { (void)until; return ""; }
+
+    std::string written() const { return this->m_written; }
+
+private:
+    std::string m_written;
+    std::string m_lineEnding;
+};
+
+void writeScript(const char *scriptPath, const std::string &script)
+{
+    std::ofstream scriptFile{scriptPath};
+    scriptFile << script;
+}
+
+long peakResidentKilobytes()
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void runScript(IByteStreamScriptExecutor &executor, std::shared_ptr<IByteStream> byteStream)
+{
+    std::function<void(const std::string &)> printRxResult{[](const std::string &) { }};
+    std::function<void(const std::string &)> printTxResult{[](const std::string &) { }};
+    std::function<void(DelayType, int)> printDelayResult{[](DelayType, int) { }};
+    std::function<void(FlushType)> printFlushResult{[](FlushType) { }};
+    std::function<void(LoopType, int)> printLoopResult{[](LoopType, int) { }};
+    executor.execute(byteStream, printRxResult, printTxResult, printDelayResult, printFlushResult, printLoopResult);
+}
+
+int main()
+{
+    bool passed{true};
+
+    writeScript(ORDER_SCRIPT_PATH,
+                "write(\"<\")\n"
+                "loop(3) {\n"
+                "    write(\"a\")\n"
+                "    loop(2) {\n"
+                "        write(\"b\")\n"
+                "    }\n"
+                "    loop(0) {\n"
+                "        write(\"never\")\n"
+                "    }\n"
+                "}\n"
+                "write(\">\")\n");
+    {
+        IByteStreamScriptExecutor executor{ORDER_SCRIPT_PATH};
+        std::shared_ptr<MemoryByteStream> memoryByteStream{std::make_shared<MemoryByteStream>()};
+        runScript(executor, memoryByteStream);
+        //Running twice checks that nothing is left over from the first run
+        runScript(executor, memoryByteStream);
+        std::string expected{"<\na\nb\nb\na\nb\nb\na\nb\nb\n>\n<\na\nb\nb\na\nb\nb\na\nb\nb\n>\n"};
+        bool ordered{memoryByteStream->written() == expected};
+        std::cout << "test=order writes=" << memoryByteStream->writeCount() << " result=" << (ordered ? "pass" : "fail") << std::endl;
+        passed = passed && ordered;
+
+        //Falls back to writeLine(), which adds the stream's own line ending
+        std::shared_ptr<LineByteStream> lineByteStream{std::make_shared<LineByteStream>()};
+        runScript(executor, lineByteStream);
+        std::string expectedLines{"<\r\na\r\nb\r\nb\r\na\r\nb\r\nb\r\na\r\nb\r\nb\r\n>\r\n"};
+        bool linesOrdered{lineByteStream->written() == expectedLines};
+        std::cout << "test=order_write_line result=" << (linesOrdered ? "pass" : "fail") << std::endl;
+        passed = passed && linesOrdered;
+    }
+
+    writeScript(LARGE_SCRIPT_PATH,
+                "loop(" + std::to_string(OUTER_LOOP_COUNT) + ") {\n"
+                "    loop(" + std::to_string(INNER_LOOP_COUNT) + ") {\n"
+                "        write(\"x\")\n"
+                "    }\n"
+                "}\n");
+    {
+        long residentBefore{peakResidentKilobytes()};
+        auto startTime = std::chrono::steady_clock::now();
+        IByteStreamScriptExecutor executor{LARGE_SCRIPT_PATH};
+        std::shared_ptr<MemoryByteStream> memoryByteStream{std::make_shared<MemoryByteStream>()};
+        runScript(executor, memoryByteStream);
+        auto endTime = std::chrono::steady_clock::now();
+        long growth{peakResidentKilobytes() - residentBefore};
+        double firstWriteMicroseconds{std::chrono::duration<double, std::micro>(memoryByteStream->firstWriteTime() - startTime).count()};
+        double seconds{std::chrono::duration<double>(endTime - startTime).count()};
+        bool complete{memoryByteStream->writeCount() == OUTER_LOOP_COUNT * INNER_LOOP_COUNT};
+        bool bounded{growth < MAXIMUM_GROWTH_KB};
+        std::cout << "test=large writes=" << memoryByteStream->writeCount()
+                  << " first_write_us=" << firstWriteMicroseconds
+                  << " seconds=" << seconds
+                  << " writes_per_s=" << (static_cast<double>(memoryByteStream->writeCount()) / seconds)
+                  << " peak_rss_growth_kb=" << growth
+                  << " result=" << ((complete && bounded) ? "pass" : "fail") << std::endl;
+        passed = passed && complete && bounded;
+    }
+
+    writeScript(WRITE_READ_SCRIPT_PATH,
+                "loop(" + std::to_string(WRITE_READ_LOOP_COUNT) + ") {\n"
+                "    write(\"" + std::string{WRITE_READ_LINE} + "\")\n"
+                "    read()\n"
+                "}\n");
+    {
+        IByteStreamScriptExecutor executor{WRITE_READ_SCRIPT_PATH};
+        std::shared_ptr<MemoryByteStream> memoryByteStream{std::make_shared<MemoryByteStream>()};
+        long long allocationsBefore{allocationCount};
+        auto startTime = std::chrono::steady_clock::now();
+        runScript(executor, memoryByteStream);
+        auto endTime = std::chrono::steady_clock::now();
+        long long allocations{allocationCount - allocationsBefore};
+        double seconds{std::chrono::duration<double>(endTime - startTime).count()};
+        //Every iteration is a loop end, a write and a read
+        double commandsPerSecond{static_cast<double>(WRITE_READ_LOOP_COUNT * 3) / seconds};
+
+        //The same writes and reads through writeLine(), with the argument held as a string
+        std::shared_ptr<MemoryByteStream> baselineByteStream{std::make_shared<MemoryByteStream>()};
+        std::string commandArgument{WRITE_READ_LINE};
+        long long baselineAllocationsBefore{allocationCount};
+        auto baselineStartTime = std::chrono::steady_clock::now();
+        for (long long i = 0; i < WRITE_READ_LOOP_COUNT; i++) {
+            baselineByteStream->writeLine(commandArgument);
+            baselineByteStream->readLine();
+        }
+        auto baselineEndTime = std::chrono::steady_clock::now();
+        long long baselineAllocations{allocationCount - baselineAllocationsBefore};
+        double baselineSeconds{std::chrono::duration<double>(baselineEndTime - baselineStartTime).count()};
+        double baselineCommandsPerSecond{static_cast<double>(WRITE_READ_LOOP_COUNT * 2) / baselineSeconds};
+
+        bool complete{memoryByteStream->writeCount() == WRITE_READ_LOOP_COUNT};
+        bool allocationFree{allocations < MAXIMUM_ALLOCATIONS_PER_RUN};
+        std::cout << "test=write_read commands=" << (WRITE_READ_LOOP_COUNT * 3)
+                  << " commands_per_s=" << commandsPerSecond
+                  << " allocations=" << allocations
+                  << " write_line_commands_per_s=" << baselineCommandsPerSecond
+                  << " write_line_allocations=" << baselineAllocations
+                  << " result=" << ((complete && allocationFree) ? "pass" : "fail") << std::endl;
+        passed = passed && complete && allocationFree;
+    }
+
+    std::remove(ORDER_SCRIPT_PATH);
+    std::remove(LARGE_SCRIPT_PATH);
+    std::remove(WRITE_READ_SCRIPT_PATH);
+    std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+    return (passed ? 0 : 1);
+}
@@ -0,0 +1,244 @@
+/***********************************************************************
+*    lzcodec.cpp:                                                      *
+*    Namespace LZCodec, for fast LZ77 style block compression          *
+*    Copyright (c) 2017 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the implementation of a LZCodec namespace         *
+*    It is used to compress small blocks (such as single datagrams)    *
+*    quickly, trading ratio for speed, in the style of LZ4             *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#include <algorithm>
+#include <cstring>
+
+#include "lzcodec.h"
+
+namespace LZCodec
+{
+    namespace
+    {
+        const size_t constexpr TOKEN_NIBBLE_MAX{15};
+        //Matches stop this far from the end, and blocks shorter than this are stored as literals
+        const size_t constexpr END_LITERAL_LENGTH{5};
+        const size_t constexpr MINIMUM_BLOCK_LENGTH{12};
+        const size_t constexpr HASH_TABLE_SIZE{1UL << HASH_TABLE_BITS};
+        const size_t constexpr MINIMUM_HASH_TABLE_BITS{6};
+        const size_t constexpr MAXIMUM_VARINT_LENGTH{10};
+
+        inline uint32_t read32(const uint8_t *data)
+        {
+            uint32_t value{0};
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+
+        inline uint32_t hashOf(uint32_t sequence, unsigned int hashBits)
+        {
+            return (sequence * 2654435761U) >> (32 - hashBits);
+        }
+
+        inline uint8_t *writeLength(uint8_t *output, size_t length)
+        {
+            while (length >= 255) {
+                *output++ = 255;
+                length -= 255;
+            }
+            *output++ = static_cast<uint8_t>(length);
+            return output;
+        }
+
+        inline bool readLength(const uint8_t **input, const uint8_t *inputEnd, size_t *length)
+        {
+            uint8_t next{255};
+            while (next == 255) {
+                if (*input >= inputEnd) {
+                    return false;
+                }
+                next = *(*input)++;
+                *length += next;
+            }
+            return true;
+        }
+
+        uint8_t *writeSequence(uint8_t *output, const uint8_t *literals, size_t literalLength, size_t offset, size_t matchLength)
+        {
+            uint8_t *token{output++};
+            *token = static_cast<uint8_t>(std::min(literalLength, TOKEN_NIBBLE_MAX) << 4);
+            if (literalLength >= TOKEN_NIBBLE_MAX) {
+                output = writeLength(output, literalLength - TOKEN_NIBBLE_MAX);
+            }
+            memcpy(output, literals, literalLength);
+            output += literalLength;
+            if (matchLength == 0) {
+                return output;
+            }
+            *output++ = static_cast<uint8_t>(offset & 0xFF);
+            *output++ = static_cast<uint8_t>(offset >> 8);
+            size_t encodedMatchLength{matchLength - MINIMUM_MATCH_LENGTH};
+            *token |= static_cast<uint8_t>(std::min(encodedMatchLength, TOKEN_NIBBLE_MAX));
+            if (encodedMatchLength >= TOKEN_NIBBLE_MAX) {
+                output = writeLength(output, encodedMatchLength - TOKEN_NIBBLE_MAX);
+            }
+            return output;
+        }
+    }
+
+    size_t maximumCompressedLength(size_t length)
+    {
+        return MAXIMUM_VARINT_LENGTH + 1 + length + (length / 255) + 1;
+    }
+
+    std::string compress(const std::string &input)
+    {
+        return compress(input.data(), input.length());
+    }
+
+    std::string compress(const void *input, size_t length)
+    {
+        const uint8_t *source{static_cast<const uint8_t *>(input)};
+        std::string returnString(maximumCompressedLength(length), '\0');
+        uint8_t *outputStart{reinterpret_cast<uint8_t *>(&returnString[0])};
+        uint8_t *output{outputStart};
+
+        size_t remaining{length};
+        do {
+            uint8_t next{static_cast<uint8_t>(remaining & 0x7F)};
+            remaining >>= 7;
+            *output++ = static_cast<uint8_t>(next | (remaining ? 0x80 : 0x00));
+        } while (remaining != 0);
+
+        const uint8_t *anchor{source};
+        if (length >= MINIMUM_BLOCK_LENGTH) {
+            //Small blocks (a single datagram) get a smaller table, so clearing it stays cheap
+            unsigned int hashBits{static_cast<unsigned int>(MINIMUM_HASH_TABLE_BITS)};
+            while ((hashBits < HASH_TABLE_BITS) && ((1UL << hashBits) < length)) {
+                hashBits++;
+            }
+            uint32_t hashTable[HASH_TABLE_SIZE];
+            memset(hashTable, 0xFF, sizeof(uint32_t) << hashBits);
+            const uint8_t *position{source};
+            const uint8_t *matchLimit{source + length - END_LITERAL_LENGTH};
+            const uint8_t *searchLimit{source + length - MINIMUM_BLOCK_LENGTH};
+            unsigned int missCount{0};
+            while (position < searchLimit) {
+                uint32_t sequence{read32(position)};
+                uint32_t &slot = hashTable[hashOf(sequence, hashBits)];
+                uint32_t candidateIndex{slot};
+                slot = static_cast<uint32_t>(position - source);
+                if ((candidateIndex == 0xFFFFFFFF)
+                    || (static_cast<size_t>(position - source) - candidateIndex > MAXIMUM_OFFSET)
+                    || (read32(source + candidateIndex) != sequence)) {
+                    //Step faster through data that is not compressing
+                    position += 1 + (missCount++ >> 5);
+                    continue;
+                }
+                missCount = 0;
+                const uint8_t *match{source + candidateIndex};
+                while ((position > anchor) && (match > source) && (position[-1] == match[-1])) {
+                    position--;
+                    match--;
+                }
+                size_t matchLength{MINIMUM_MATCH_LENGTH};
+                while ((position + matchLength < matchLimit) && (position[matchLength] == match[matchLength])) {
+                    matchLength++;
+                }
+                output = writeSequence(output, anchor, position - anchor, position - match, matchLength);
+                position += matchLength;
+                anchor = position;
+            }
+        }
+        output = writeSequence(output, anchor, (source + length) - anchor, 0, 0);
+        returnString.resize(output - outputStart);
+        return returnString;
+    }
+
+    bool decompress(const std::string &input, std::string *output, size_t maximumLength)
+    {
+        return decompress(input.data(), input.length(), output, maximumLength);
+    }
+
+    bool decompress(const void *input, size_t length, std::string *output, size_t maximumLength)
+    {
+        if (!output) {
+            return false;
+        }
+        const uint8_t *position{static_cast<const uint8_t *>(input)};
+        const uint8_t *inputEnd{position + length};
+
+        size_t originalLength{0};
+        for (unsigned int shift = 0; ; shift += 7) {
+            if ((position >= inputEnd) || (shift >= 64)) {
+                return false;
+            }
+            uint8_t next{*position++};
+            originalLength |= static_cast<size_t>(next & 0x7F) << shift;
+            if ((next & 0x80) == 0) {
+                break;
+            }
+        }
+        if (originalLength > maximumLength) {
+            return false;
+        }
+
+        std::string decompressed(originalLength, '\0');
+        uint8_t *outputStart{reinterpret_cast<uint8_t *>(&decompressed[0])};
+        uint8_t *outputPosition{outputStart};
+        uint8_t *outputEnd{outputStart + originalLength};
+        while (true) {
+            if (position >= inputEnd) {
+                return false;
+            }
+            uint8_t token{*position++};
+            size_t literalLength{static_cast<size_t>(token >> 4)};
+            if ((literalLength == TOKEN_NIBBLE_MAX) && (!readLength(&position, inputEnd, &literalLength))) {
+                return false;
+            }
+            if ((literalLength > static_cast<size_t>(inputEnd - position)) || (literalLength > static_cast<size_t>(outputEnd - outputPosition))) {
+                return false;
+            }
+            memcpy(outputPosition, position, literalLength);
+            outputPosition += literalLength;
+            position += literalLength;
+            if (position == inputEnd) {
+                break;
+            }
+            if (inputEnd - position < 2) {
+                return false;
+            }
+            size_t offset{static_cast<size_t>(position[0]) | (static_cast<size_t>(position[1]) << 8)};
+            position += 2;
+            size_t matchLength{static_cast<size_t>(token & 0x0F)};
+            if ((matchLength == TOKEN_NIBBLE_MAX) && (!readLength(&position, inputEnd, &matchLength))) {
+                return false;
+            }
+            matchLength += MINIMUM_MATCH_LENGTH;
+            if ((offset == 0) || (offset > static_cast<size_t>(outputPosition - outputStart)) || (matchLength > static_cast<size_t>(outputEnd - outputPosition))) {
+                return false;
+            }
+            const uint8_t *match{outputPosition - offset};
+            if (offset >= matchLength) {
+                memcpy(outputPosition, match, matchLength);
+                outputPosition += matchLength;
+            } else {
+                //Overlapping match, repeats the last offset bytes
+                for (size_t i = 0; i < matchLength; i++) {
+                    *outputPosition++ = *match++;
+                }
+            }
+        }
+        if (outputPosition != outputEnd) {
+            return false;
+        }
+        output->swap(decompressed);
+        return true;
+    }
+}
@@ -0,0 +1,52 @@
+/***********************************************************************
+*    lzcodec.h:                                                        *
+*    Namespace LZCodec, for fast LZ77 style block compression          *
+*    Copyright (c) 2017 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the declarations of a LZCodec namespace           *
+*    It is used to compress small blocks (such as single datagrams)    *
+*    quickly, trading ratio for speed, in the style of LZ4: a single   *
+*    hash table lookup per position and byte aligned sequences         *
+*                                                                      *
+*    Block format: original length (LEB128 varint), then sequences of  *
+*    [token][extra literal length][literals][offset, 2 bytes LE]       *
+*    [extra match length]. The token holds the literal length in the  *
+*    high nibble and (match length - 4) in the low nibble; a nibble   *
+*    of 15 is followed by 255 bytes until a byte less than 255. The   *
+*    final sequence holds only literals                                *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#ifndef TJLUTILS_LZCODEC_H
+#define TJLUTILS_LZCODEC_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace LZCodec
+{
+    const size_t constexpr MINIMUM_MATCH_LENGTH{4};
+    const size_t constexpr MAXIMUM_OFFSET{65535};
+    const size_t constexpr HASH_TABLE_BITS{12};
+
+    std::string compress(const std::string &input);
+    std::string compress(const void *input, size_t length);
+
+    //Returns false (leaving output untouched) if the block is malformed or
+    //would decompress to more than maximumLength bytes
+    bool decompress(const std::string &input, std::string *output, size_t maximumLength = 1UL << 24);
+    bool decompress(const void *input, size_t length, std::string *output, size_t maximumLength = 1UL << 24);
+
+    size_t maximumCompressedLength(size_t length);
+}
+
+#endif //TJLUTILS_LZCODEC_H
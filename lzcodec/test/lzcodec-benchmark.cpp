@@ -0,0 +1,119 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <lzcodec.h>
+
+//The compressed and decompressed lengths end up here, so the codec calls are not
+//optimized out of the timed loops
+static volatile size_t benchmarkSink{0};
+
+//Round trip checks, then compress/decompress throughput and ratio on sample
+//key=value telemetry, one record per datagram and batched records per datagram
+static const size_t BYTES_PER_RUN{256UL * 1024UL * 1024UL};
+
+std::string telemetryRecord(std::mt19937 &randomEngine, unsigned int sequenceNumber)
+{
+    std::uniform_real_distribution<double> temperature{20.0, 25.0};
+    std::uniform_real_distribution<double> humidity{30.0, 60.0};
+    std::uniform_int_distribution<int> pressure{1000, 1030};
+    return "device=sensor-node-07,seq=" + std::to_string(sequenceNumber)
+           + ",temperature=" + std::to_string(temperature(randomEngine))
+           + ",humidity=" + std::to_string(humidity(randomEngine))
+           + ",pressure=" + std::to_string(pressure(randomEngine))
+           + ",status=OK\r\n";
+}
+
+bool checkRoundTrips()
+{
+    std::mt19937 randomEngine{42};
+    std::vector<std::string> samples{"", "a", "abcabcabcabcabcabcabc", std::string(100000, 'z')};
+    for (size_t length : {11, 12, 13, 100, 1000, 70000}) {
+        std::string randomBytes(length, '\0');
+        std::string fewSymbols(length, '\0');
+        for (size_t i = 0; i < length; i++) {
+            randomBytes[i] = static_cast<char>(randomEngine());
+            fewSymbols[i] = "ab\r\n"[randomEngine() % 4];
+        }
+        samples.push_back(randomBytes);
+        samples.push_back(fewSymbols);
+    }
+    for (auto &it : samples) {
+        std::string compressed{LZCodec::compress(it)};
+        std::string decompressed{};
+        if ((compressed.length() > LZCodec::maximumCompressedLength(it.length())) || (!LZCodec::decompress(compressed, &decompressed)) || (decompressed != it)) {
+            std::cout << "FAILED: round trip of " << it.length() << " bytes" << std::endl;
+            return false;
+        }
+        //Truncated blocks must be rejected rather than read past the end
+        if ((compressed.length() > 2) && (LZCodec::decompress(compressed.substr(0, compressed.length() - 1), &decompressed))) {
+            std::cout << "FAILED: truncated block of " << it.length() << " bytes was accepted" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void runBenchmark(const std::string &name, const std::vector<std::string> &datagrams)
+{
+    size_t totalBytes{0};
+    size_t totalCompressedBytes{0};
+    std::vector<std::string> compressedDatagrams{};
+    for (auto &it : datagrams) {
+        compressedDatagrams.push_back(LZCodec::compress(it));
+        totalBytes += it.length();
+        totalCompressedBytes += compressedDatagrams.back().length();
+    }
+    size_t rounds{std::max<size_t>(1, BYTES_PER_RUN / totalBytes)};
+
+    auto startTime = std::chrono::steady_clock::now();
+    size_t sink{0};
+    for (size_t round = 0; round < rounds; round++) {
+        for (auto &it : datagrams) {
+            sink += LZCodec::compress(it).length();
+        }
+    }
+    double compressSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()};
+
+    startTime = std::chrono::steady_clock::now();
+    std::string decompressed{};
+    for (size_t round = 0; round < rounds; round++) {
+        for (auto &it : compressedDatagrams) {
+            LZCodec::decompress(it, &decompressed);
+            sink += decompressed.length();
+        }
+    }
+    double decompressSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()};
+
+    double megabytes{static_cast<double>(totalBytes) * rounds / 1e6};
+    benchmarkSink = sink;
+    std::cout << "sample=" << name
+              << " datagrams=" << datagrams.size()
+              << " mean_datagram_bytes=" << (totalBytes / datagrams.size())
+              << " ratio=" << (static_cast<double>(totalBytes) / totalCompressedBytes)
+              << " compress_mb_per_s=" << (megabytes / compressSeconds)
+              << " decompress_mb_per_s=" << (megabytes / decompressSeconds) << std::endl;
+}
+
+int main()
+{
+    bool roundTripsPassed{checkRoundTrips()};
+    std::cout << "round_trips=" << (roundTripsPassed ? "pass" : "fail") << std::endl;
+
+    std::mt19937 randomEngine{7};
+    unsigned int sequenceNumber{0};
+    std::vector<std::string> singleRecords{};
+    std::vector<std::string> batchedRecords{};
+    for (int i = 0; i < 1000; i++) {
+        singleRecords.push_back(telemetryRecord(randomEngine, sequenceNumber++));
+        std::string batch{};
+        for (int j = 0; j < 12; j++) {
+            batch += telemetryRecord(randomEngine, sequenceNumber++);
+        }
+        batchedRecords.push_back(batch);
+    }
+    runBenchmark("single_record", singleRecords);
+    runBenchmark("batched_12_records", batchedRecords);
+    return (roundTripsPassed ? 0 : 1);
+}
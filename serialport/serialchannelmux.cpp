@@ -0,0 +1,658 @@
+/***********************************************************************
+*    serialchannelmux.cpp:                                             *
+*    SerialChannelMux, logical channels over a single SerialPort       *
+*    Copyright (c) 2017 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the implementation of the SerialChannelMux and    *
+*    SerialChannel classes                                             *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "serialchannelmux.h"
+
+const constexpr unsigned int SerialChannelMux::DEFAULT_PRIORITY;
+const constexpr size_t SerialChannelMux::DEFAULT_MAXIMUM_PAYLOAD_LENGTH;
+const constexpr size_t SerialChannelMux::DEFAULT_MAXIMUM_QUEUED_BYTES;
+const constexpr size_t SerialChannelMux::DEFAULT_RECEIVE_CAPACITY;
+const constexpr size_t SerialChannelMux::MAXIMUM_WRITE_LENGTH;
+
+SerialChannel::SerialChannel(SerialChannelMux *mux, uint8_t channelId, unsigned int priority, size_t receiveCapacity) :
+    m_channelId{channelId},
+    m_portName{mux->m_serialPort->portName() + "#" + std::to_string(channelId)},
+    m_mux{mux},
+    m_receiveQueue{receiveCapacity},
+    m_lineEnding{"\n"},
+    m_timeout{mux->m_serialPort->timeout()},
+    m_bytesReceived{0},
+    m_framesReceived{0},
+    m_bytesDropped{0},
+    m_priority{std::max(priority, 1u)},
+    m_transmitQueue{},
+    m_queuedBytes{0},
+    m_deficit{0},
+    m_isScheduled{false},
+    m_inTurn{false},
+    m_isClosed{false},
+    m_bytesSent{0},
+    m_framesSent{0},
+    m_framesFailed{0},
+    m_queueLatency{}
+{
+
+}
+
+SerialChannel::~SerialChannel()
+{
+
+}
+
+uint8_t SerialChannel::channelId() const
+{
+    return this->m_channelId;
+}
+
+unsigned int SerialChannel::priority() const
+{
+    std::lock_guard<std::mutex> muxLock{this->m_muxMutex};
+    if (!this->m_mux) {
+        return this->m_priority;
+    }
+    std::lock_guard<std::mutex> transmitLock{this->m_mux->m_transmitMutex};
+    return this->m_priority;
+}
+
+void SerialChannel::setPriority(unsigned int priority)
+{
+    std::lock_guard<std::mutex> muxLock{this->m_muxMutex};
+    if (!this->m_mux) {
+        this->m_priority = std::max(priority, 1u);
+        return;
+    }
+    std::lock_guard<std::mutex> transmitLock{this->m_mux->m_transmitMutex};
+    this->m_priority = std::max(priority, 1u);
+}
+
+SerialChannelStatistics SerialChannel::statistics() const
+{
+    SerialChannelStatistics statistics{};
+    {
+        std::lock_guard<std::mutex> receiveLock{this->m_receiveMutex};
+        statistics.bytesReceived = this->m_bytesReceived;
+        statistics.framesReceived = this->m_framesReceived;
+        statistics.bytesDropped = this->m_bytesDropped;
+    }
+    std::lock_guard<std::mutex> muxLock{this->m_muxMutex};
+    std::unique_lock<std::mutex> transmitLock{};
+    if (this->m_mux) {
+        transmitLock = std::unique_lock<std::mutex>{this->m_mux->m_transmitMutex};
+    }
+    statistics.bytesSent = this->m_bytesSent;
+    statistics.framesSent = this->m_framesSent;
+    statistics.framesFailed = this->m_framesFailed;
+    statistics.queueLatency = this->m_queueLatency;
+    return statistics;
+}
+
+void SerialChannel::resetStatistics()
+{
+    {
+        std::lock_guard<std::mutex> receiveLock{this->m_receiveMutex};
+        this->m_bytesReceived = 0;
+        this->m_framesReceived = 0;
+        this->m_bytesDropped = 0;
+    }
+    std::lock_guard<std::mutex> muxLock{this->m_muxMutex};
+    std::unique_lock<std::mutex> transmitLock{};
+    if (this->m_mux) {
+        transmitLock = std::unique_lock<std::mutex>{this->m_mux->m_transmitMutex};
+    }
+    this->m_bytesSent = 0;
+    this->m_framesSent = 0;
+    this->m_framesFailed = 0;
+    this->m_queueLatency.clear();
+}
+
+ssize_t SerialChannel::write(const void *data, size_t length)
+{
+    //Held for the whole write, so writes to one channel are never interleaved
+    std::lock_guard<std::mutex> muxLock{this->m_muxMutex};
+    if (!this->m_mux) {
+        throw std::runtime_error("In SerialChannel::write(const void *, size_t): Channel " + this->m_portName + " is closed");
+    }
+    return static_cast<ssize_t>(this->m_mux->enqueue(this, static_cast<const char *>(data), length, this->m_timeout));
+}
+
+ssize_t SerialChannel::write(const std::string &str)
+{
+    return this->write(str.data(), str.length());
+}
+
+ssize_t SerialChannel::read(uint8_t *buffer, size_t length)
+{
+    if ((!buffer) || (length == 0)) {
+        return 0;
+    }
+    std::unique_lock<std::mutex> receiveLock{this->m_receiveMutex};
+    this->m_receivedCondition.wait_for(receiveLock, std::chrono::milliseconds(this->m_timeout), [this]() {
+        return !this->m_receiveQueue.empty();
+    });
+    return static_cast<ssize_t>(this->m_receiveQueue.read(reinterpret_cast<char *>(buffer), length));
+}
+
+void SerialChannel::setTimeout(long timeout)
+{
+    this->m_timeout = timeout;
+}
+
+long SerialChannel::timeout() const
+{
+    return this->m_timeout;
+}
+
+std::string SerialChannel::lineEnding() const
+{
+    std::lock_guard<std::mutex> receiveLock{this->m_receiveMutex};
+    return this->m_lineEnding;
+}
+
+void SerialChannel::setLineEnding(const std::string &str)
+{
+    if (str.empty()) {
+        throw std::runtime_error("In SerialChannel::setLineEnding(const std::string &): Cannot set the line ending of channel " + this->m_portName + " to an empty string");
+    }
+    std::lock_guard<std::mutex> receiveLock{this->m_receiveMutex};
+    this->m_lineEnding = str;
+}
+
+ssize_t SerialChannel::writeLine(const std::string &str)
+{
+    std::string lineEnding{this->lineEnding()};
+    if ((str.length() >= lineEnding.length()) && (str.compare(str.length() - lineEnding.length(), lineEnding.length(), lineEnding) == 0)) {
+        return this->write(str);
+    }
+    return this->write(str + lineEnding);
+}
+
+ssize_t SerialChannel::writeLine(const char *str)
+{
+    return this->writeLine(std::string{str});
+}
+
+ssize_t SerialChannel::available()
+{
+    std::lock_guard<std::mutex> receiveLock{this->m_receiveMutex};
+    return static_cast<ssize_t>(this->m_receiveQueue.size());
+}
+
+bool SerialChannel::isOpen() const
+{
+    std::lock_guard<std::mutex> muxLock{this->m_muxMutex};
+    return (this->m_mux != nullptr);
+}
+
+void SerialChannel::openPort()
+{
+    if (!this->isOpen()) {
+        throw std::runtime_error("In SerialChannel::openPort(): Channel " + this->m_portName + " has been closed, and can only be opened again through its SerialChannelMux");
+    }
+}
+
+void SerialChannel::closePort()
+{
+    SerialChannelMux *mux{nullptr};
+    {
+        std::lock_guard<std::mutex> muxLock{this->m_muxMutex};
+        mux = this->m_mux;
+    }
+    if (mux) {
+        mux->closeChannel(this->m_channelId);
+    }
+}
+
+std::string SerialChannel::portName() const
+{
+    return this->m_portName;
+}
+
+void SerialChannel::flushRX()
+{
+    std::lock_guard<std::mutex> receiveLock{this->m_receiveMutex};
+    this->m_receiveQueue.clear();
+}
+
+//Drops what is still queued on this channel, frames already handed to the port are sent
+void SerialChannel::flushTX()
+{
+    std::lock_guard<std::mutex> muxLock{this->m_muxMutex};
+    if (this->m_mux) {
+        this->m_mux->clearTransmitQueue(this);
+    }
+}
+
+void SerialChannel::flushRXTX()
+{
+    this->flushRX();
+    this->flushTX();
+}
+
+std::string SerialChannel::peek()
+{
+    std::lock_guard<std::mutex> receiveLock{this->m_receiveMutex};
+    std::string contents(this->m_receiveQueue.size(), '\0');
+    this->m_receiveQueue.read(&contents[0], contents.length());
+    this->m_receiveQueue.push_front(contents);
+    return contents;
+}
+
+char SerialChannel::peekByte()
+{
+    std::lock_guard<std::mutex> receiveLock{this->m_receiveMutex};
+    return this->m_receiveQueue.front();
+}
+
+void SerialChannel::putBack(const std::string &str)
+{
+    std::lock_guard<std::mutex> receiveLock{this->m_receiveMutex};
+    this->m_receiveQueue.push_front(str);
+}
+
+void SerialChannel::putBack(const char *str)
+{
+    this->putBack(std::string{str});
+}
+
+void SerialChannel::putBack(char back)
+{
+    this->putBack(std::string(1, back));
+}
+
+std::string SerialChannel::readLine()
+{
+    return this->readUntil(this->lineEnding());
+}
+
+std::string SerialChannel::readUntil(const std::string &until)
+{
+    std::string returnString{""};
+    std::unique_lock<std::mutex> receiveLock{this->m_receiveMutex};
+    this->m_receivedCondition.wait_for(receiveLock, std::chrono::milliseconds(this->m_timeout), [this, &until, &returnString]() {
+        return this->m_receiveQueue.extractUntil(until, &returnString);
+    });
+    return returnString;
+}
+
+std::string SerialChannel::readUntil(const char *until)
+{
+    return this->readUntil(std::string{until});
+}
+
+std::string SerialChannel::readUntil(char until)
+{
+    return this->readUntil(std::string(1, until));
+}
+
+//Called from the listener thread of the port. Nobody may be reading the channel, so the
+//oldest bytes make way for new ones once the receive queue is full
+void SerialChannel::receive(const char *data, size_t length)
+{
+    {
+        std::lock_guard<std::mutex> receiveLock{this->m_receiveMutex};
+        if (length > this->m_receiveQueue.capacity()) {
+            this->m_bytesDropped += length - this->m_receiveQueue.capacity();
+            data += length - this->m_receiveQueue.capacity();
+            length = this->m_receiveQueue.capacity();
+        }
+        if (length > this->m_receiveQueue.freeSpace()) {
+            size_t overflow{length - this->m_receiveQueue.freeSpace()};
+            this->m_receiveQueue.discard(overflow);
+            this->m_bytesDropped += overflow;
+        }
+        this->m_receiveQueue.append(data, length);
+        this->m_bytesReceived += length;
+        this->m_framesReceived++;
+    }
+    this->m_receivedCondition.notify_all();
+}
+
+//Waits for a write in progress on the channel to give up, and cuts it off from the mux
+void SerialChannel::detach()
+{
+    std::lock_guard<std::mutex> muxLock{this->m_muxMutex};
+    this->m_mux = nullptr;
+}
+
+SerialChannelMux::SerialChannelMux(std::shared_ptr<SerialPort> serialPort) :
+    SerialChannelMux{serialPort, SerialFraming::Format::COBS}
+{
+
+}
+
+SerialChannelMux::SerialChannelMux(std::shared_ptr<SerialPort> serialPort, SerialFraming::Format frameFormat) :
+    SerialChannelMux{serialPort, frameFormat, ThreadConfiguration{}}
+{
+
+}
+
+SerialChannelMux::SerialChannelMux(std::shared_ptr<SerialPort> serialPort, SerialFraming::Format frameFormat, const ThreadConfiguration &transmitterThreadConfiguration) :
+    m_serialPort{serialPort},
+    m_frameFormat{frameFormat},
+    m_channels{},
+    m_unroutedFrameCount{0},
+    m_scheduledChannels{},
+    m_maximumPayloadLength{SerialChannelMux::DEFAULT_MAXIMUM_PAYLOAD_LENGTH},
+    m_maximumQueuedBytes{SerialChannelMux::DEFAULT_MAXIMUM_QUEUED_BYTES},
+    m_shutEmDown{false}
+{
+    if (!this->m_serialPort) {
+        throw std::runtime_error("In SerialChannelMux::SerialChannelMux(std::shared_ptr<SerialPort>, SerialFraming::Format, const ThreadConfiguration &): SerialPort is a nullptr");
+    }
+    if (this->m_frameFormat == SerialFraming::Format::NONE) {
+        throw std::runtime_error("In SerialChannelMux::SerialChannelMux(std::shared_ptr<SerialPort>, SerialFraming::Format, const ThreadConfiguration &): Channels need a frame format to be told apart");
+    }
+    if (!this->m_serialPort->isOpen()) {
+        throw std::runtime_error("In SerialChannelMux::SerialChannelMux(std::shared_ptr<SerialPort>, SerialFraming::Format, const ThreadConfiguration &): Serial port " + this->m_serialPort->portName() + " is not open");
+    }
+    try {
+#if defined(__ANDROID__)
+        this->m_asyncFuture = transmitterThreadConfiguration.launchThread([this]() { this->asyncTransmitter(); });
+#else
+        this->m_asyncFuture = transmitterThreadConfiguration.launch([this]() { this->asyncTransmitter(); });
+#endif
+    } catch (std::exception &e) {
+        throw std::runtime_error("In SerialChannelMux::SerialChannelMux(std::shared_ptr<SerialPort>, SerialFraming::Format, const ThreadConfiguration &): Unable to start the transmitter: " + std::string{e.what()});
+    }
+    this->m_serialPort->setFrameFormat(this->m_frameFormat);
+    this->m_serialPort->onFrame([this](const char *frame, size_t length) { this->handleFrame(frame, length); });
+    if (!this->m_serialPort->isListening()) {
+        this->m_serialPort->startListening();
+    }
+}
+
+//Frames still queued on the channels are dropped
+SerialChannelMux::~SerialChannelMux()
+{
+    this->m_serialPort->onFrame(nullptr);
+    this->m_serialPort->stopListening();
+    {
+        std::lock_guard<std::mutex> transmitLock{this->m_transmitMutex};
+        this->m_shutEmDown = true;
+    }
+    this->m_transmitCondition.notify_all();
+    this->m_spaceCondition.notify_all();
+#if defined(__ANDROID__)
+    if (this->m_asyncFuture) {
+        this->m_asyncFuture->join();
+        delete this->m_asyncFuture;
+    }
+#else
+    if (this->m_asyncFuture.valid()) {
+        this->m_asyncFuture.wait();
+    }
+#endif
+    std::lock_guard<std::mutex> channelLock{this->m_channelMutex};
+    for (auto &it : this->m_channels) {
+        if (it) {
+            it->detach();
+            it.reset();
+        }
+    }
+}
+
+std::shared_ptr<SerialChannel> SerialChannelMux::openChannel(uint8_t channelId)
+{
+    return this->openChannel(channelId, SerialChannelMux::DEFAULT_PRIORITY);
+}
+
+std::shared_ptr<SerialChannel> SerialChannelMux::openChannel(uint8_t channelId, unsigned int priority)
+{
+    std::shared_ptr<SerialChannel> channel{new SerialChannel{this, channelId, priority, SerialChannelMux::DEFAULT_RECEIVE_CAPACITY}};
+    std::lock_guard<std::mutex> channelLock{this->m_channelMutex};
+    if (this->m_channels[channelId]) {
+        throw std::runtime_error("In SerialChannelMux::openChannel(uint8_t, unsigned int): Channel " + std::to_string(channelId) + " is already open");
+    }
+    this->m_channels[channelId] = channel;
+    return channel;
+}
+
+std::shared_ptr<SerialChannel> SerialChannelMux::channel(uint8_t channelId) const
+{
+    std::lock_guard<std::mutex> channelLock{this->m_channelMutex};
+    return this->m_channels[channelId];
+}
+
+void SerialChannelMux::closeChannel(uint8_t channelId)
+{
+    std::shared_ptr<SerialChannel> channel{};
+    {
+        std::lock_guard<std::mutex> channelLock{this->m_channelMutex};
+        channel = std::move(this->m_channels[channelId]);
+    }
+    if (!channel) {
+        return;
+    }
+    //Fails a write waiting for room on the channel, so detach() does not have to wait it out
+    {
+        std::lock_guard<std::mutex> transmitLock{this->m_transmitMutex};
+        channel->m_isClosed = true;
+    }
+    this->clearTransmitQueue(channel.get());
+    channel->detach();
+}
+
+SerialFraming::Format SerialChannelMux::frameFormat() const
+{
+    return this->m_frameFormat;
+}
+
+size_t SerialChannelMux::maximumPayloadLength() const
+{
+    std::lock_guard<std::mutex> transmitLock{this->m_transmitMutex};
+    return this->m_maximumPayloadLength;
+}
+
+void SerialChannelMux::setMaximumPayloadLength(size_t maximumPayloadLength)
+{
+    //The decoder on the far end must take the payload and the channel number
+    if ((maximumPayloadLength == 0) || (maximumPayloadLength >= SerialFraming::DEFAULT_MAXIMUM_FRAME_LENGTH)) {
+        throw std::runtime_error("In SerialChannelMux::setMaximumPayloadLength(size_t): The maximum payload length must be between 1 and " + std::to_string(SerialFraming::DEFAULT_MAXIMUM_FRAME_LENGTH - 1));
+    }
+    std::lock_guard<std::mutex> transmitLock{this->m_transmitMutex};
+    this->m_maximumPayloadLength = maximumPayloadLength;
+}
+
+size_t SerialChannelMux::maximumQueuedBytes() const
+{
+    std::lock_guard<std::mutex> transmitLock{this->m_transmitMutex};
+    return this->m_maximumQueuedBytes;
+}
+
+void SerialChannelMux::setMaximumQueuedBytes(size_t maximumQueuedBytes)
+{
+    {
+        std::lock_guard<std::mutex> transmitLock{this->m_transmitMutex};
+        this->m_maximumQueuedBytes = std::max<size_t>(maximumQueuedBytes, 1);
+    }
+    this->m_spaceCondition.notify_all();
+}
+
+unsigned long long SerialChannelMux::unroutedFrameCount() const
+{
+    std::lock_guard<std::mutex> channelLock{this->m_channelMutex};
+    return this->m_unroutedFrameCount;
+}
+
+//Called from the listener thread of the port, with its receive buffer locked
+void SerialChannelMux::handleFrame(const char *frame, size_t length)
+{
+    std::shared_ptr<SerialChannel> channel{};
+    {
+        std::lock_guard<std::mutex> channelLock{this->m_channelMutex};
+        if (length > 0) {
+            channel = this->m_channels[static_cast<uint8_t>(frame[0])];
+        }
+        if (!channel) {
+            this->m_unroutedFrameCount++;
+            return;
+        }
+    }
+    channel->receive(frame + 1, length - 1);
+}
+
+//Encodes the data into frames before taking the transmit lock, then queues them as the
+//channel has room. Returns the number of bytes queued
+size_t SerialChannelMux::enqueue(SerialChannel *channel, const char *data, size_t length, long timeout)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    size_t maximumPayloadLength{this->maximumPayloadLength()};
+    std::deque<SerialChannel::QueuedFrame> frames{};
+    std::string payload{};
+    for (size_t offset = 0; offset < length; offset += maximumPayloadLength) {
+        size_t payloadLength{std::min(length - offset, maximumPayloadLength)};
+        payload.assign(1, static_cast<char>(channel->m_channelId));
+        payload.append(data + offset, payloadLength);
+        SerialChannel::QueuedFrame frame{};
+        SerialFraming::encode(this->m_frameFormat, payload.data(), payload.length(), &frame.encoded);
+        frame.payloadLength = payloadLength;
+        frames.push_back(std::move(frame));
+    }
+    size_t queuedBytes{0};
+    std::unique_lock<std::mutex> transmitLock{this->m_transmitMutex};
+    while (!frames.empty()) {
+        bool hasRoom{this->m_spaceCondition.wait_until(transmitLock, deadline, [this, channel]() {
+            return (this->m_shutEmDown) || (channel->m_isClosed) || (channel->m_queuedBytes < this->m_maximumQueuedBytes);
+        })};
+        if ((!hasRoom) || (this->m_shutEmDown) || (channel->m_isClosed)) {
+            break;
+        }
+        frames.front().queuedTime = std::chrono::steady_clock::now();
+        channel->m_queuedBytes += frames.front().payloadLength;
+        queuedBytes += frames.front().payloadLength;
+        channel->m_transmitQueue.push_back(std::move(frames.front()));
+        frames.pop_front();
+        if (!channel->m_isScheduled) {
+            channel->m_isScheduled = true;
+            this->m_scheduledChannels.push_back(channel->shared_from_this());
+        }
+        this->m_transmitCondition.notify_one();
+    }
+    return queuedBytes;
+}
+
+void SerialChannelMux::clearTransmitQueue(SerialChannel *channel)
+{
+    {
+        std::lock_guard<std::mutex> transmitLock{this->m_transmitMutex};
+        channel->m_transmitQueue.clear();
+        channel->m_queuedBytes = 0;
+        channel->m_deficit = 0;
+        channel->m_inTurn = false;
+        if (channel->m_isScheduled) {
+            channel->m_isScheduled = false;
+            this->m_scheduledChannels.erase(std::remove_if(this->m_scheduledChannels.begin(), this->m_scheduledChannels.end(), [channel](const std::shared_ptr<SerialChannel> &scheduled) {
+                return scheduled.get() == channel;
+            }), this->m_scheduledChannels.end());
+        }
+    }
+    this->m_spaceCondition.notify_all();
+}
+
+//Deficit round robin: at the start of its turn a channel is credited its priority times
+//one full frame, and sends frames from the front of its queue for as long as the credit
+//covers them. Credit left over carries to its next turn, unless its queue ran empty. A
+//write that fills up mid turn leaves the channel at the front to carry on next time.
+//m_transmitMutex must already be held
+void SerialChannelMux::collectFrames(std::string *toWrite, std::vector<SentFrame> *sentFrames)
+{
+    while (!this->m_scheduledChannels.empty()) {
+        std::shared_ptr<SerialChannel> channel{this->m_scheduledChannels.front()};
+        if (!channel->m_inTurn) {
+            channel->m_deficit += this->quantum() * channel->m_priority;
+            channel->m_inTurn = true;
+        }
+        while (!channel->m_transmitQueue.empty()) {
+            SerialChannel::QueuedFrame &frame = channel->m_transmitQueue.front();
+            if (frame.encoded.length() > channel->m_deficit) {
+                break;
+            }
+            if ((!toWrite->empty()) && (toWrite->length() + frame.encoded.length() > SerialChannelMux::MAXIMUM_WRITE_LENGTH)) {
+                return;
+            }
+            toWrite->append(frame.encoded);
+            channel->m_deficit -= frame.encoded.length();
+            channel->m_queuedBytes -= frame.payloadLength;
+            sentFrames->push_back(SentFrame{channel, frame.payloadLength, frame.encoded.length(), frame.queuedTime});
+            channel->m_transmitQueue.pop_front();
+        }
+        this->m_scheduledChannels.pop_front();
+        channel->m_inTurn = false;
+        if (channel->m_transmitQueue.empty()) {
+            channel->m_deficit = 0;
+            channel->m_isScheduled = false;
+        } else {
+            this->m_scheduledChannels.push_back(channel);
+        }
+    }
+}
+
+//Enough credit for the largest frame, so every turn sends at least one
+size_t SerialChannelMux::quantum() const
+{
+    return SerialFraming::maximumEncodedLength(this->m_frameFormat, this->m_maximumPayloadLength + 1);
+}
+
+void SerialChannelMux::asyncTransmitter()
+{
+    std::string toWrite{};
+    std::vector<SentFrame> sentFrames{};
+    std::unique_lock<std::mutex> transmitLock{this->m_transmitMutex};
+    while (true) {
+        this->m_transmitCondition.wait(transmitLock, [this]() {
+            return (this->m_shutEmDown) || (!this->m_scheduledChannels.empty());
+        });
+        if (this->m_shutEmDown) {
+            return;
+        }
+        toWrite.clear();
+        sentFrames.clear();
+        this->collectFrames(&toWrite, &sentFrames);
+        transmitLock.unlock();
+        this->m_spaceCondition.notify_all();
+        ssize_t writtenBytes{-1};
+        try {
+            writtenBytes = this->m_serialPort->write(reinterpret_cast<const uint8_t *>(toWrite.data()), toWrite.length());
+            if ((writtenBytes > 0) && (this->m_serialPort->outputBufferEnabled()) && (this->m_serialPort->flushOutputBuffer() < 0)) {
+                writtenBytes = -1;
+            }
+        } catch (std::exception &) {
+            //The frames are lost, but the other channels keep going
+            writtenBytes = -1;
+        }
+        size_t writtenLength{(writtenBytes > 0) ? static_cast<size_t>(writtenBytes) : 0};
+        auto writtenTime = std::chrono::steady_clock::now();
+        transmitLock.lock();
+        size_t frameEnd{0};
+        for (auto &it : sentFrames) {
+            frameEnd += it.encodedLength;
+            if (frameEnd > writtenLength) {
+                //Cut short or not written at all, either way the far end cannot decode it
+                it.channel->m_framesFailed++;
+                continue;
+            }
+            it.channel->m_bytesSent += it.payloadLength;
+            it.channel->m_framesSent++;
+            it.channel->m_queueLatency.record(writtenTime - it.queuedTime);
+        }
+    }
+}
@@ -0,0 +1,231 @@
+/***********************************************************************
+*    serialchannelmux.h:                                               *
+*    SerialChannelMux, logical channels over a single SerialPort       *
+*    Copyright (c) 2017 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the declarations of the SerialChannelMux and      *
+*    SerialChannel classes. The mux frames traffic on one SerialPort   *
+*    (COBS or SLIP) with a one byte channel number in front of every   *
+*    payload, and presents each channel as an IByteStream with its     *
+*    own receive queue. Outgoing frames are queued per channel and     *
+*    written by one transmitter thread, which shares the link between  *
+*    the channels with data waiting in proportion to their priorities  *
+*    (deficit round robin), so no channel can starve another           *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#ifndef TJLUTILS_SERIALCHANNELMUX_H
+#define TJLUTILS_SERIALCHANNELMUX_H
+
+#include <array>
+#include <memory>
+#include <string>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <chrono>
+#include <cstdint>
+
+#include "ibytestream.h"
+#include "serialframing.h"
+#include "serialtiming.h"
+#include "serialport.h"
+
+//queueLatency runs from a frame being queued on the channel to the port having taken it.
+//framesFailed counts frames the port did not take whole, which the far end will not see
+struct SerialChannelStatistics
+{
+    unsigned long long bytesSent;
+    unsigned long long framesSent;
+    unsigned long long framesFailed;
+    unsigned long long bytesReceived;
+    unsigned long long framesReceived;
+    unsigned long long bytesDropped;
+    SerialLatencyHistogram queueLatency;
+};
+
+class SerialChannelMux;
+
+//A channel is opened by its mux and stays usable until it is closed or the mux is
+//destroyed, after which writes throw and reads time out. Writes queue the bytes and
+//return, waiting up to timeout() only while the channel already has too much queued
+class SerialChannel : public IByteStream, public std::enable_shared_from_this<SerialChannel>
+{
+    friend class SerialChannelMux;
+public:
+    ~SerialChannel();
+
+    SerialChannel(const SerialChannel &other) = delete;
+    SerialChannel &operator=(const SerialChannel &rhs) = delete;
+
+    uint8_t channelId() const;
+    unsigned int priority() const;
+    void setPriority(unsigned int priority);
+    SerialChannelStatistics statistics() const;
+    void resetStatistics();
+
+    //Returns the number of bytes queued, which is less than length if timeout() ran out
+    ssize_t write(const void *data, size_t length);
+    ssize_t write(const std::string &str);
+    //Returns the number of bytes copied into buffer, 0 on timeout
+    ssize_t read(uint8_t *buffer, size_t length);
+
+    void setTimeout(long timeout);
+    long timeout() const;
+    std::string lineEnding() const;
+    void setLineEnding(const std::string &str);
+
+    ssize_t writeLine(const std::string &str);
+    ssize_t writeLine(const char *str);
+    ssize_t available();
+    bool isOpen() const;
+    void openPort();
+    void closePort();
+
+    std::string portName() const;
+    void flushRX();
+    void flushTX();
+    void flushRXTX();
+
+    std::string peek();
+    char peekByte();
+
+    void putBack(const std::string &str);
+    void putBack(const char *str);
+    void putBack(char back);
+
+    std::string readLine();
+    std::string readUntil(const std::string &until);
+    std::string readUntil(const char *until);
+    std::string readUntil(char until);
+
+private:
+    using steady_time_point = std::chrono::steady_clock::time_point;
+
+    struct QueuedFrame
+    {
+        std::string encoded;
+        size_t payloadLength;
+        steady_time_point queuedTime;
+    };
+
+    SerialChannel(SerialChannelMux *mux, uint8_t channelId, unsigned int priority, size_t receiveCapacity);
+
+    const uint8_t m_channelId;
+    std::string m_portName;
+    mutable std::mutex m_muxMutex;
+    SerialChannelMux *m_mux;
+
+    mutable std::mutex m_receiveMutex;
+    std::condition_variable m_receivedCondition;
+    SerialLineBuffer m_receiveQueue;
+    std::string m_lineEnding;
+    long m_timeout;
+    unsigned long long m_bytesReceived;
+    unsigned long long m_framesReceived;
+    unsigned long long m_bytesDropped;
+
+    //Guarded by the mux's transmit mutex
+    unsigned int m_priority;
+    std::deque<QueuedFrame> m_transmitQueue;
+    size_t m_queuedBytes;
+    size_t m_deficit;
+    bool m_isScheduled;
+    bool m_inTurn;
+    bool m_isClosed;
+    unsigned long long m_bytesSent;
+    unsigned long long m_framesSent;
+    unsigned long long m_framesFailed;
+    SerialLatencyHistogram m_queueLatency;
+
+    void receive(const char *data, size_t length);
+    void detach();
+};
+
+//The mux sets the frame format of the port and takes over its onFrame() callback, and
+//listens on it for as long as the mux exists; destroying the mux stops the port listening.
+//Both ends of the link have to use the same frame format and channel numbers. The thread
+//that writes the frames out is started with transmitterThreadConfiguration, if given
+class SerialChannelMux
+{
+    friend class SerialChannel;
+public:
+    SerialChannelMux(std::shared_ptr<SerialPort> serialPort);
+    SerialChannelMux(std::shared_ptr<SerialPort> serialPort, SerialFraming::Format frameFormat);
+    SerialChannelMux(std::shared_ptr<SerialPort> serialPort, SerialFraming::Format frameFormat, const ThreadConfiguration &transmitterThreadConfiguration);
+    ~SerialChannelMux();
+
+    SerialChannelMux(const SerialChannelMux &other) = delete;
+    SerialChannelMux &operator=(const SerialChannelMux &rhs) = delete;
+
+    //A channel of priority 2 gets twice the share of the link of one of priority 1 while
+    //both have data queued. Opening a channel number that is already open throws
+    std::shared_ptr<SerialChannel> openChannel(uint8_t channelId);
+    std::shared_ptr<SerialChannel> openChannel(uint8_t channelId, unsigned int priority);
+    std::shared_ptr<SerialChannel> channel(uint8_t channelId) const;
+    void closeChannel(uint8_t channelId);
+
+    SerialFraming::Format frameFormat() const;
+    size_t maximumPayloadLength() const;
+    void setMaximumPayloadLength(size_t maximumPayloadLength);
+    size_t maximumQueuedBytes() const;
+    void setMaximumQueuedBytes(size_t maximumQueuedBytes);
+    //Frames for channels that are not open, and frames too short to carry a channel number
+    unsigned long long unroutedFrameCount() const;
+
+    static const constexpr unsigned int DEFAULT_PRIORITY{1};
+    static const constexpr size_t DEFAULT_MAXIMUM_PAYLOAD_LENGTH{256};
+    static const constexpr size_t DEFAULT_MAXIMUM_QUEUED_BYTES{64 * 1024};
+    static const constexpr size_t DEFAULT_RECEIVE_CAPACITY{64 * 1024};
+    static const constexpr size_t MAXIMUM_WRITE_LENGTH{4096};
+
+private:
+    using steady_time_point = std::chrono::steady_clock::time_point;
+
+    struct SentFrame
+    {
+        std::shared_ptr<SerialChannel> channel;
+        size_t payloadLength;
+        size_t encodedLength;
+        steady_time_point queuedTime;
+    };
+
+    std::shared_ptr<SerialPort> m_serialPort;
+    SerialFraming::Format m_frameFormat;
+    mutable std::mutex m_channelMutex;
+    std::array<std::shared_ptr<SerialChannel>, 256> m_channels;
+    unsigned long long m_unroutedFrameCount;
+
+    mutable std::mutex m_transmitMutex;
+    std::condition_variable m_transmitCondition;
+    std::condition_variable m_spaceCondition;
+    std::deque<std::shared_ptr<SerialChannel>> m_scheduledChannels;
+    size_t m_maximumPayloadLength;
+    size_t m_maximumQueuedBytes;
+    bool m_shutEmDown;
+
+#if defined(__ANDROID__)
+    std::thread *m_asyncFuture;
+#else
+    std::future<void> m_asyncFuture;
+#endif
+
+    void asyncTransmitter();
+    void handleFrame(const char *frame, size_t length);
+    size_t enqueue(SerialChannel *channel, const char *data, size_t length, long timeout);
+    void clearTransmitQueue(SerialChannel *channel);
+    void collectFrames(std::string *toWrite, std::vector<SentFrame> *sentFrames);
+    size_t quantum() const;
+};
+
+#endif //TJLUTILS_SERIALCHANNELMUX_H
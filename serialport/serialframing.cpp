@@ -0,0 +1,286 @@
+/***********************************************************************
+*    serialframing.cpp:                                                *
+*    Namespace SerialFraming, for COBS and SLIP framed byte streams    *
+*    Copyright (c) 2016 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the implementation of a SerialFraming namespace   *
+*    It is used to carry binary frames over a byte stream, such as a   *
+*    serial port, using Consistent Overhead Byte Stuffing (each frame  *
+*    ends with a 0x00) or SLIP (RFC 1055, frames between 0xC0 bytes)   *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "serialframing.h"
+
+namespace SerialFraming
+{
+    namespace
+    {
+        const size_t constexpr COBS_MAXIMUM_BLOCK_CODE{0xFF};
+    }
+
+    size_t maximumEncodedLength(Format format, size_t length)
+    {
+        if (format == Format::COBS) {
+            //One code byte per 254 data bytes, plus the leading code and the delimiter
+            return length + (length / 254) + 2;
+        } else if (format == Format::SLIP) {
+            //Every byte escaped, between two SLIP_END bytes
+            return (2 * length) + 2;
+        }
+        return length;
+    }
+
+    std::string encode(Format format, const std::string &frame)
+    {
+        std::string returnString{};
+        encode(format, frame.data(), frame.length(), &returnString);
+        return returnString;
+    }
+
+    void encode(Format format, const void *frame, size_t length, std::string *output)
+    {
+        const uint8_t *source{static_cast<const uint8_t *>(frame)};
+        size_t startLength{output->length()};
+        output->resize(startLength + maximumEncodedLength(format, length));
+        uint8_t *outputStart{reinterpret_cast<uint8_t *>(&(*output)[startLength])};
+        uint8_t *position{outputStart};
+        if (format == Format::COBS) {
+            uint8_t *codePosition{position++};
+            uint8_t code{1};
+            for (size_t i = 0; i < length; i++) {
+                if (source[i] == COBS_DELIMITER) {
+                    *codePosition = code;
+                    codePosition = position++;
+                    code = 1;
+                    continue;
+                }
+                *position++ = source[i];
+                if (++code == COBS_MAXIMUM_BLOCK_CODE) {
+                    *codePosition = code;
+                    codePosition = position++;
+                    code = 1;
+                }
+            }
+            *codePosition = code;
+            *position++ = COBS_DELIMITER;
+        } else if (format == Format::SLIP) {
+            //The leading SLIP_END flushes any line noise received before the frame
+            *position++ = SLIP_END;
+            for (size_t i = 0; i < length; i++) {
+                if (source[i] == SLIP_END) {
+                    *position++ = SLIP_ESC;
+                    *position++ = SLIP_ESC_END;
+                } else if (source[i] == SLIP_ESC) {
+                    *position++ = SLIP_ESC;
+                    *position++ = SLIP_ESC_ESC;
+                } else {
+                    *position++ = source[i];
+                }
+            }
+            *position++ = SLIP_END;
+        } else {
+            memcpy(position, source, length);
+            position += length;
+        }
+        output->resize(startLength + (position - outputStart));
+    }
+
+    Decoder::Decoder(Format format, size_t maximumFrameLength) :
+        m_format{format},
+        m_frame(maximumFrameLength),
+        m_frameLength{0},
+        m_frameCount{0},
+        m_invalidFrameCount{0},
+        m_inFrame{false},
+        m_discarding{false},
+        m_blockRemaining{0},
+        m_pendingZero{false},
+        m_escaped{false}
+    {
+        if (format == Format::NONE) {
+            throw std::runtime_error("In SerialFraming::Decoder::Decoder(Format, size_t): Format::NONE has no frames to decode");
+        }
+    }
+
+    size_t Decoder::feed(const char *data, size_t length, const FrameCallback &callback)
+    {
+        return ((this->m_format == Format::COBS) ? this->feedCOBS(data, length, callback) : this->feedSLIP(data, length, callback));
+    }
+
+    void Decoder::reset()
+    {
+        this->startFrame();
+        this->m_discarding = false;
+    }
+
+    Format Decoder::format() const
+    {
+        return this->m_format;
+    }
+
+    size_t Decoder::frameCount() const
+    {
+        return this->m_frameCount;
+    }
+
+    size_t Decoder::invalidFrameCount() const
+    {
+        return this->m_invalidFrameCount;
+    }
+
+    void Decoder::startFrame()
+    {
+        this->m_frameLength = 0;
+        this->m_inFrame = false;
+        this->m_blockRemaining = 0;
+        this->m_pendingZero = false;
+        this->m_escaped = false;
+    }
+
+    //Counts the frame as invalid and skips the rest of it
+    void Decoder::invalidateFrame()
+    {
+        this->m_invalidFrameCount++;
+        this->m_discarding = true;
+        this->startFrame();
+    }
+
+    bool Decoder::appendToFrame(const char *data, size_t length)
+    {
+        if (this->m_frameLength + length > this->m_frame.size()) {
+            this->invalidateFrame();
+            return false;
+        }
+        memcpy(this->m_frame.data() + this->m_frameLength, data, length);
+        this->m_frameLength += length;
+        return true;
+    }
+
+    size_t Decoder::feedCOBS(const char *data, size_t length, const FrameCallback &callback)
+    {
+        const char *position{data};
+        const char *end{data + length};
+        size_t completedFrames{0};
+        while (position < end) {
+            if (this->m_discarding) {
+                const char *delimiter{static_cast<const char *>(memchr(position, COBS_DELIMITER, end - position))};
+                if (!delimiter) {
+                    break;
+                }
+                position = delimiter + 1;
+                this->m_discarding = false;
+                continue;
+            }
+            if (this->m_blockRemaining > 0) {
+                //Data bytes of a block are copied in one run, a delimiter inside one means
+                //the frame was cut short
+                size_t run{std::min(this->m_blockRemaining, static_cast<size_t>(end - position))};
+                const char *delimiter{static_cast<const char *>(memchr(position, COBS_DELIMITER, run))};
+                if (delimiter) {
+                    this->invalidateFrame();
+                    this->m_discarding = false;
+                    position = delimiter + 1;
+                    continue;
+                }
+                if (!this->appendToFrame(position, run)) {
+                    continue;
+                }
+                position += run;
+                this->m_blockRemaining -= run;
+                continue;
+            }
+            uint8_t code{static_cast<uint8_t>(*position++)};
+            if (code == COBS_DELIMITER) {
+                if (this->m_inFrame) {
+                    this->m_frameCount++;
+                    completedFrames++;
+                    callback(this->m_frame.data(), this->m_frameLength);
+                }
+                this->startFrame();
+                continue;
+            }
+            //Every block but the last is followed by a zero, which is only known to be
+            //real once another block starts
+            if (this->m_pendingZero) {
+                char zero{0};
+                if (!this->appendToFrame(&zero, 1)) {
+                    continue;
+                }
+            }
+            this->m_inFrame = true;
+            this->m_blockRemaining = code - 1;
+            this->m_pendingZero = (code != COBS_MAXIMUM_BLOCK_CODE);
+        }
+        return completedFrames;
+    }
+
+    size_t Decoder::feedSLIP(const char *data, size_t length, const FrameCallback &callback)
+    {
+        const char *position{data};
+        const char *end{data + length};
+        size_t completedFrames{0};
+        while (position < end) {
+            if (this->m_discarding) {
+                const char *frameEnd{static_cast<const char *>(memchr(position, SLIP_END, end - position))};
+                if (!frameEnd) {
+                    break;
+                }
+                position = frameEnd + 1;
+                this->m_discarding = false;
+                continue;
+            }
+            uint8_t byte{static_cast<uint8_t>(*position)};
+            if (this->m_escaped) {
+                this->m_escaped = false;
+                position++;
+                if ((byte != SLIP_ESC_END) && (byte != SLIP_ESC_ESC)) {
+                    this->invalidateFrame();
+                    //The bad byte may itself be the end of the frame
+                    this->m_discarding = (byte != SLIP_END);
+                    continue;
+                }
+                char unescaped{static_cast<char>((byte == SLIP_ESC_END) ? SLIP_END : SLIP_ESC)};
+                this->appendToFrame(&unescaped, 1);
+                continue;
+            }
+            if (byte == SLIP_END) {
+                position++;
+                //Back to back SLIP_END bytes are empty frames, which are ignored
+                if (this->m_frameLength > 0) {
+                    this->m_frameCount++;
+                    completedFrames++;
+                    callback(this->m_frame.data(), this->m_frameLength);
+                }
+                this->startFrame();
+                continue;
+            }
+            if (byte == SLIP_ESC) {
+                position++;
+                this->m_escaped = true;
+                continue;
+            }
+            //Copy the run of ordinary bytes up to the next special one in one go
+            const char *runEnd{position + 1};
+            while ((runEnd < end) && (static_cast<uint8_t>(*runEnd) != SLIP_END) && (static_cast<uint8_t>(*runEnd) != SLIP_ESC)) {
+                runEnd++;
+            }
+            if (this->appendToFrame(position, runEnd - position)) {
+                position = runEnd;
+            }
+        }
+        return completedFrames;
+    }
+}
@@ -0,0 +1,87 @@
+/***********************************************************************
+*    serialframing.h:                                                  *
+*    Namespace SerialFraming, for COBS and SLIP framed byte streams    *
+*    Copyright (c) 2016 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the declarations of a SerialFraming namespace     *
+*    It is used to carry binary frames over a byte stream, such as a   *
+*    serial port, using Consistent Overhead Byte Stuffing (each frame  *
+*    ends with a 0x00) or SLIP (RFC 1055, frames between 0xC0 bytes)   *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#ifndef TJLUTILS_SERIALFRAMING_H
+#define TJLUTILS_SERIALFRAMING_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+namespace SerialFraming
+{
+    enum class Format { NONE, COBS, SLIP };
+
+    const size_t constexpr DEFAULT_MAXIMUM_FRAME_LENGTH{4096};
+    const uint8_t constexpr COBS_DELIMITER{0x00};
+    const uint8_t constexpr SLIP_END{0xC0};
+    const uint8_t constexpr SLIP_ESC{0xDB};
+    const uint8_t constexpr SLIP_ESC_END{0xDC};
+    const uint8_t constexpr SLIP_ESC_ESC{0xDD};
+
+    //The frame is a view into the decoder, only valid until the callback returns
+    using FrameCallback = std::function<void(const char *, size_t)>;
+
+    size_t maximumEncodedLength(Format format, size_t length);
+    //Appends the encoded frame, delimiters included, to output
+    void encode(Format format, const void *frame, size_t length, std::string *output);
+    std::string encode(Format format, const std::string &frame);
+
+    //Decodes a stream fed in arbitrary chunks, in a single pass from the caller's buffer
+    //into one frame buffer that is reused for every frame. Frames that are malformed or
+    //longer than maximumFrameLength are dropped (up to the next delimiter) and counted
+    class Decoder
+    {
+    public:
+        explicit Decoder(Format format, size_t maximumFrameLength = DEFAULT_MAXIMUM_FRAME_LENGTH);
+
+        //Returns the number of complete frames passed to callback
+        size_t feed(const char *data, size_t length, const FrameCallback &callback);
+        void reset();
+
+        Format format() const;
+        size_t frameCount() const;
+        size_t invalidFrameCount() const;
+
+    private:
+        Format m_format;
+        std::vector<char> m_frame;
+        size_t m_frameLength;
+        size_t m_frameCount;
+        size_t m_invalidFrameCount;
+        bool m_inFrame;
+        bool m_discarding;
+        //COBS: bytes left in the current block, whether the block ends in an implied zero
+        size_t m_blockRemaining;
+        bool m_pendingZero;
+        //SLIP: the last byte was SLIP_ESC
+        bool m_escaped;
+
+        size_t feedCOBS(const char *data, size_t length, const FrameCallback &callback);
+        size_t feedSLIP(const char *data, size_t length, const FrameCallback &callback);
+        bool appendToFrame(const char *data, size_t length);
+        void invalidateFrame();
+        void startFrame();
+    };
+}
+
+#endif //TJLUTILS_SERIALFRAMING_H
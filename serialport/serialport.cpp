@@ -30,6 +30,7 @@
 #include <future>
 #include <deque>
 #include <mutex>
+#include <unordered_map>
 #include <wchar.h>
 #if (defined(_WIN32) || defined(__CYGWIN__))
     #include <Windows.h>
@@ -42,10 +43,19 @@
     #include <sys/stat.h>
     #include <limits.h>
     #include <sys/file.h>
+    #include <sys/uio.h>
+    #include <poll.h>
+    #include <dirent.h>
+    #if defined(__linux__)
+        #include <sys/eventfd.h>
+    #endif
     #include <errno.h>
 #endif
 
 #include "serialport.h"
+#if defined(__linux__)
+    #include "serialportmanager.h"
+#endif
 
 const DataBits SerialPort::DEFAULT_DATA_BITS{DataBits::EIGHT};
 const StopBits SerialPort::DEFAULT_STOP_BITS{StopBits::ONE};
@@ -54,6 +64,8 @@ const BaudRate SerialPort::DEFAULT_BAUD_RATE{BaudRate::BAUD115200};
 const std::string SerialPort::DEFAULT_LINE_ENDING{"\r\n"};
 const long SerialPort::DEFAULT_TIMEOUT{100};
 const long SerialPort::DEFAULT_RETRY_COUNT{0};
+const long SerialLineBuffer::DEFAULT_TERMINATOR_HOLD_MILLISECONDS{10};
+const constexpr size_t SerialLineTerminators::MAXIMUM_SEPARATE_SEARCHES;
 const std::string SerialPort::DEFAULT_DATA_BITS_STRING{"8"};
 const std::string SerialPort::DEFAULT_STOP_BITS_STRING{"1"};
 const std::string SerialPort::DEFAULT_PARITY_STRING{"None"};
@@ -72,7 +84,8 @@ const unsigned int SerialPort::ASCII_LOW_LIMIT{0};
 #else
     const std::vector<const char *> SerialPort::AVAILABLE_PORT_NAMES_BASE{"/dev/ttyS", "/dev/ttyACM", "/dev/ttyUSB", 
                                                                             "/dev/ttyAMA", "/dev/ttyrfserialm", "/dev/irserialm",
-                                                                            "/dev/cuau", "/dev/cuaU", "/dev/rfcomm"};
+                                                                            "/dev/cuau", "/dev/cuaU", "/dev/rfcomm",
+                                                                            "/dev/pts/"};
 #endif
 
 #if defined(_WIN32) || defined(__CYGWIN__)
@@ -87,7 +100,513 @@ const unsigned int SerialPort::ASCII_LOW_LIMIT{0};
                                                                     "2000000", "2500000", "3000000", "3500000", "4000000"};
 #endif
 
-const std::vector<std::string> SerialPort::SERIAL_PORT_NAMES{SerialPort::generateSerialPortNames()};
+SerialLineTerminators::SerialLineTerminators() :
+    m_terminators{},
+    m_firstBytes{""},
+    m_firstByteSlot{},
+    m_startingWith{}
+{
+
+}
+
+SerialLineTerminators::SerialLineTerminators(const std::vector<std::string> &terminators) :
+    m_terminators{terminators},
+    m_firstBytes{""},
+    m_firstByteSlot{},
+    m_startingWith{}
+{
+    for (size_t i = 0; i < this->m_terminators.size(); i++) {
+        const std::string &terminator{this->m_terminators[i]};
+        if (terminator.empty()) {
+            throw std::runtime_error("In SerialLineTerminators::SerialLineTerminators(const std::vector<std::string> &): line terminators cannot be empty strings");
+        }
+        unsigned char firstByte{static_cast<unsigned char>(terminator[0])};
+        if (this->m_firstByteSlot[firstByte] == 0) {
+            this->m_firstBytes.push_back(terminator[0]);
+            this->m_startingWith.emplace_back();
+            this->m_firstByteSlot[firstByte] = static_cast<unsigned char>(this->m_firstBytes.length());
+        }
+        this->m_startingWith[this->m_firstByteSlot[firstByte] - 1].push_back(i);
+    }
+    for (auto &it : this->m_startingWith) {
+        std::stable_sort(it.begin(), it.end(), [this](size_t lhs, size_t rhs) {
+            return this->m_terminators[lhs].length() > this->m_terminators[rhs].length();
+        });
+    }
+}
+
+bool SerialLineTerminators::empty() const
+{
+    return this->m_terminators.empty();
+}
+
+size_t SerialLineTerminators::size() const
+{
+    return this->m_terminators.size();
+}
+
+const std::string &SerialLineTerminators::terminator(size_t index) const
+{
+    return this->m_terminators.at(index);
+}
+
+const std::vector<std::string> &SerialLineTerminators::terminators() const
+{
+    return this->m_terminators;
+}
+
+const std::vector<size_t> &SerialLineTerminators::startingWith(char firstByte) const
+{
+    return this->m_startingWith[this->m_firstByteSlot[static_cast<unsigned char>(firstByte)] - 1];
+}
+
+//Looks for each first byte with memchr (vectorized by the C library), each search
+//only as far as the earliest match so far, so the bytes before a line's terminator
+//are read at most once per distinct first byte. Large sets use the first byte table
+size_t SerialLineTerminators::findStart(const char *data, size_t length) const
+{
+    const size_t firstByteCount{this->m_firstBytes.length()};
+    const char *firstBytes{this->m_firstBytes.data()};
+    if (firstByteCount <= SerialLineTerminators::MAXIMUM_SEPARATE_SEARCHES) {
+        size_t found{length};
+        for (size_t i = 0; (i < firstByteCount) && (found > 0); i++) {
+            const char *match{static_cast<const char *>(memchr(data, firstBytes[i], found))};
+            if (match) {
+                found = static_cast<size_t>(match - data);
+            }
+        }
+        return found;
+    }
+    const unsigned char *firstByteSlot{this->m_firstByteSlot.data()};
+    for (size_t position = 0; position < length; position++) {
+        if (firstByteSlot[static_cast<unsigned char>(data[position])] != 0) {
+            return position;
+        }
+    }
+    return length;
+}
+
+SerialLineBuffer::SerialLineBuffer(size_t capacity) :
+    m_buffer(capacity),
+    m_head{0},
+    m_size{0},
+    m_scannedLength{0},
+    m_scannedDelimiter{""},
+    m_scannedForTerminators{false},
+    m_pendingTerminatorTail{""},
+    m_terminatorHoldTime{std::chrono::milliseconds(SerialLineBuffer::DEFAULT_TERMINATOR_HOLD_MILLISECONDS)},
+    m_terminatorHeldSince{},
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+    m_arrivals{new SerialLineArrivals{{}, 0, 0}}
+#else
+    m_arrivals{nullptr}
+#endif
+{
+
+}
+
+size_t SerialLineBuffer::size() const
+{
+    return this->m_size;
+}
+
+size_t SerialLineBuffer::capacity() const
+{
+    return this->m_buffer.size();
+}
+
+size_t SerialLineBuffer::freeSpace() const
+{
+    return this->m_buffer.size() - this->m_size;
+}
+
+bool SerialLineBuffer::empty() const
+{
+    return (this->m_size == 0);
+}
+
+void SerialLineBuffer::clear()
+{
+    this->m_head = 0;
+    this->m_size = 0;
+    this->m_scannedLength = 0;
+    this->m_pendingTerminatorTail.clear();
+    this->m_terminatorHeldSince = std::chrono::steady_clock::time_point{};
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+    this->m_arrivals->marks.clear();
+    this->m_arrivals->consumedTotal = this->m_arrivals->appendedTotal;
+#endif
+}
+
+void SerialLineBuffer::restartScan()
+{
+    this->m_scannedLength = 0;
+    this->m_scannedDelimiter.clear();
+    this->m_pendingTerminatorTail.clear();
+    this->m_terminatorHeldSince = std::chrono::steady_clock::time_point{};
+}
+
+size_t SerialLineBuffer::physicalIndex(size_t offset) const
+{
+    size_t index{this->m_head + offset};
+    return ((index >= this->m_buffer.size()) ? (index - this->m_buffer.size()) : index);
+}
+
+void SerialLineBuffer::push_back(char byte)
+{
+    if (this->m_buffer.empty()) {
+        return;
+    }
+    if (this->m_size == this->m_buffer.size()) {
+        this->consume(1);
+    }
+    this->m_buffer[this->physicalIndex(this->m_size)] = byte;
+    this->m_size++;
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+    this->m_arrivals->appendedTotal++;
+#endif
+}
+
+size_t SerialLineBuffer::append(const char *data, size_t length)
+{
+    size_t appended{0};
+    length = std::min(length, this->freeSpace());
+    while (appended < length) {
+        size_t tail{this->physicalIndex(this->m_size)};
+        size_t contiguous{std::min(length - appended, this->m_buffer.size() - tail)};
+        memcpy(this->m_buffer.data() + tail, data + appended, contiguous);
+        this->m_size += contiguous;
+        appended += contiguous;
+    }
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+    this->m_arrivals->appendedTotal += appended;
+#endif
+    return appended;
+}
+
+size_t SerialLineBuffer::read(char *destination, size_t length)
+{
+    length = std::min(length, this->m_size);
+    size_t copied{0};
+    while (copied < length) {
+        size_t head{this->physicalIndex(copied)};
+        size_t contiguous{std::min(length - copied, this->m_buffer.size() - head)};
+        memcpy(destination + copied, this->m_buffer.data() + head, contiguous);
+        copied += contiguous;
+    }
+    this->consume(length);
+    return length;
+}
+
+void SerialLineBuffer::discard(size_t length)
+{
+    this->consume(std::min(length, this->m_size));
+}
+
+void SerialLineBuffer::push_front(const std::string &str)
+{
+    size_t length{std::min(str.length(), this->m_buffer.size())};
+    if (this->m_size + length > this->m_buffer.size()) {
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+        this->m_arrivals->appendedTotal -= this->m_size - (this->m_buffer.size() - length);
+#endif
+        this->m_size = this->m_buffer.size() - length;
+    }
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+    //Put back bytes are taken to have arrived with the oldest bytes still waiting
+    this->m_arrivals->consumedTotal -= std::min<unsigned long long>(length, this->m_arrivals->consumedTotal);
+#endif
+    this->m_head = this->physicalIndex(this->m_buffer.size() - length);
+    for (size_t i = 0; i < length; i++) {
+        this->m_buffer[this->physicalIndex(i)] = str[i];
+    }
+    this->m_size += length;
+    this->m_scannedLength = 0;
+    this->m_pendingTerminatorTail.clear();
+    this->m_terminatorHeldSince = std::chrono::steady_clock::time_point{};
+}
+
+char SerialLineBuffer::front() const
+{
+    return (this->m_size == 0) ? '\0' : this->m_buffer[this->m_head];
+}
+
+void SerialLineBuffer::pop_front()
+{
+    if (this->m_size > 0) {
+        this->consume(1);
+    }
+}
+
+void SerialLineBuffer::consume(size_t length)
+{
+    this->m_head = this->physicalIndex(length);
+    this->m_size -= length;
+    this->m_scannedLength = ((this->m_scannedLength > length) ? (this->m_scannedLength - length) : 0);
+    if (this->m_size == 0) {
+        this->m_head = 0;
+    }
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+    this->m_arrivals->consumedTotal += length;
+    while ((this->m_arrivals->marks.size() > 1) && (this->m_arrivals->marks[1].first <= this->m_arrivals->consumedTotal)) {
+        this->m_arrivals->marks.pop_front();
+    }
+#endif
+}
+
+bool SerialLineBuffer::matchesAt(size_t offset, const std::string &delimiter) const
+{
+    for (size_t i = 1; i < delimiter.length(); i++) {
+        if (this->m_buffer[this->physicalIndex(offset + i)] != delimiter[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SerialLineBuffer::matchesPrefix(size_t offset, const std::string &str, size_t length) const
+{
+    const char *buffer{this->m_buffer.data()};
+    const size_t capacity{this->m_buffer.size()};
+    const char *expected{str.data()};
+    size_t physical{this->physicalIndex(offset)};
+    for (size_t i = 0; i < length; i++) {
+        if (buffer[physical] != expected[i]) {
+            return false;
+        }
+        physical = ((physical + 1 == capacity) ? 0 : (physical + 1));
+    }
+    return true;
+}
+
+size_t SerialLineBuffer::findDelimiter(const std::string &delimiter)
+{
+    if ((delimiter != this->m_scannedDelimiter) || (this->m_scannedForTerminators)) {
+        this->m_scannedDelimiter = delimiter;
+        this->m_scannedForTerminators = false;
+        this->m_scannedLength = 0;
+        this->m_terminatorHeldSince = std::chrono::steady_clock::time_point{};
+    }
+    if ((delimiter.empty()) || (this->m_size < delimiter.length())) {
+        return std::string::npos;
+    }
+    size_t lastStart{this->m_size - delimiter.length()};
+    size_t position{this->m_scannedLength};
+    while (position <= lastStart) {
+        size_t physical{this->physicalIndex(position)};
+        size_t contiguous{std::min(lastStart - position + 1, this->m_buffer.size() - physical)};
+        const char *segment{this->m_buffer.data() + physical};
+        const char *match{static_cast<const char *>(memchr(segment, delimiter[0], contiguous))};
+        if (!match) {
+            position += contiguous;
+            continue;
+        }
+        position += (match - segment);
+        if ((delimiter.length() == 1) || (this->matchesAt(position, delimiter))) {
+            return position;
+        }
+        position++;
+    }
+    //Anything after lastStart could still be the start of a delimiter that is arriving
+    this->m_scannedLength = lastStart + 1;
+    return std::string::npos;
+}
+
+bool SerialLineBuffer::extractUntil(const std::string &delimiter, std::string *line)
+{
+    size_t delimiterPosition{this->findDelimiter(delimiter)};
+    if ((delimiterPosition == std::string::npos) || (!line)) {
+        return false;
+    }
+    this->takeLine(delimiterPosition, delimiter.length(), line);
+    return true;
+}
+
+//Drops the "\n" of a "\r\n" whose "\r" already ended a line. Returns false while
+//there are not yet enough bytes to tell whether it follows
+bool SerialLineBuffer::skipPendingTerminatorTail()
+{
+    if (this->m_pendingTerminatorTail.empty()) {
+        return true;
+    }
+    const std::string &tail{this->m_pendingTerminatorTail};
+    size_t available{std::min(tail.length(), this->m_size)};
+    if (!this->matchesPrefix(0, tail, available)) {
+        this->m_pendingTerminatorTail.clear();
+        return true;
+    }
+    if (available < tail.length()) {
+        return false;
+    }
+    this->consume(tail.length());
+    this->m_pendingTerminatorTail.clear();
+    return true;
+}
+
+size_t SerialLineBuffer::findTerminator(const SerialLineTerminators &terminators, size_t *terminatorIndex)
+{
+    if (!this->m_scannedForTerminators) {
+        this->m_scannedDelimiter.clear();
+        this->m_scannedForTerminators = true;
+        this->m_scannedLength = 0;
+    }
+    if ((terminators.empty()) || (!this->skipPendingTerminatorTail())) {
+        return std::string::npos;
+    }
+    //Only whole contiguous segments of the ring are handed to findStart(), and a
+    //candidate is only compared against the terminators sharing its first byte
+    const char *buffer{this->m_buffer.data()};
+    const size_t capacity{this->m_buffer.size()};
+    const size_t size{this->m_size};
+    const std::vector<std::string> &allTerminators{terminators.terminators()};
+    size_t position{this->m_scannedLength};
+    while (position < size) {
+        size_t physical{this->physicalIndex(position)};
+        size_t contiguous{std::min(size - position, capacity - physical)};
+        size_t start{terminators.findStart(buffer + physical, contiguous)};
+        if (start == contiguous) {
+            position += contiguous;
+            continue;
+        }
+        position += start;
+        const std::string *unfinished{nullptr};
+        for (size_t index : terminators.startingWith(buffer[physical + start])) {
+            const std::string &terminator{allTerminators[index]};
+            size_t available{std::min(terminator.length(), size - position)};
+            if (!this->matchesPrefix(position, terminator, available)) {
+                continue;
+            }
+            if (available < terminator.length()) {
+                //A longer terminator may still be arriving
+                if (!unfinished) {
+                    unfinished = &terminator;
+                }
+                continue;
+            }
+            if (unfinished) {
+                //Only the last bytes received can be the start of an unfinished terminator,
+                //so wait for the next byte to tell, but not for longer than the hold time
+                auto now = std::chrono::steady_clock::now();
+                if (this->m_terminatorHeldSince == std::chrono::steady_clock::time_point{}) {
+                    this->m_terminatorHeldSince = now;
+                }
+                if (now - this->m_terminatorHeldSince < this->m_terminatorHoldTime) {
+                    this->m_scannedLength = position;
+                    return std::string::npos;
+                }
+                this->m_pendingTerminatorTail = unfinished->substr(terminator.length());
+            }
+            this->m_terminatorHeldSince = std::chrono::steady_clock::time_point{};
+            *terminatorIndex = index;
+            return position;
+        }
+        if (unfinished) {
+            //Nothing ends here yet, so look at this byte again once more have arrived
+            this->m_scannedLength = position;
+            return std::string::npos;
+        }
+        position++;
+    }
+    this->m_scannedLength = size;
+    return std::string::npos;
+}
+
+void SerialLineBuffer::setTerminatorHoldTime(std::chrono::steady_clock::duration holdTime)
+{
+    this->m_terminatorHoldTime = holdTime;
+}
+
+std::chrono::steady_clock::duration SerialLineBuffer::terminatorHoldTime() const
+{
+    return this->m_terminatorHoldTime;
+}
+
+std::chrono::steady_clock::time_point SerialLineBuffer::heldTerminatorDeadline() const
+{
+    if (this->m_terminatorHeldSince == std::chrono::steady_clock::time_point{}) {
+        return std::chrono::steady_clock::time_point::max();
+    }
+    return this->m_terminatorHeldSince + this->m_terminatorHoldTime;
+}
+
+bool SerialLineBuffer::extractUntilAny(const SerialLineTerminators &terminators, std::string *line, size_t *terminatorIndex)
+{
+    size_t index{0};
+    size_t terminatorPosition{this->findTerminator(terminators, &index)};
+    if ((terminatorPosition == std::string::npos) || (!line)) {
+        return false;
+    }
+    if (terminatorIndex) {
+        *terminatorIndex = index;
+    }
+    this->takeLine(terminatorPosition, terminators.terminator(index).length(), line);
+    return true;
+}
+
+void SerialLineBuffer::takeLine(size_t delimiterPosition, size_t delimiterLength, std::string *line)
+{
+    size_t firstSegment{std::min(delimiterPosition, this->m_buffer.size() - this->m_head)};
+    line->assign(this->m_buffer.data() + this->m_head, firstSegment);
+    if (delimiterPosition > firstSegment) {
+        line->append(this->m_buffer.data(), delimiterPosition - firstSegment);
+    }
+    this->consume(delimiterPosition + delimiterLength);
+}
+
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+void SerialLineBuffer::markArrival(SerialTimePoint arrivalTime)
+{
+    if ((!this->m_arrivals->marks.empty()) && (this->m_arrivals->marks.back().first == this->m_arrivals->appendedTotal)) {
+        this->m_arrivals->marks.back().second = arrivalTime;
+    } else {
+        this->m_arrivals->marks.emplace_back(this->m_arrivals->appendedTotal, arrivalTime);
+    }
+}
+
+bool SerialLineBuffer::extractUntil(const std::string &delimiter, std::string *line, SerialLineTiming *timing)
+{
+    size_t delimiterPosition{this->findDelimiter(delimiter)};
+    if ((delimiterPosition == std::string::npos) || (!line)) {
+        return false;
+    }
+    timing->firstByteTime = this->arrivalTimeOf(this->m_arrivals->consumedTotal);
+    timing->lastByteTime = this->arrivalTimeOf(this->m_arrivals->consumedTotal + delimiterPosition + delimiter.length() - 1);
+    this->takeLine(delimiterPosition, delimiter.length(), line);
+    return true;
+}
+
+bool SerialLineBuffer::extractUntilAny(const SerialLineTerminators &terminators, std::string *line, size_t *terminatorIndex, SerialLineTiming *timing)
+{
+    size_t index{0};
+    size_t terminatorPosition{this->findTerminator(terminators, &index)};
+    if ((terminatorPosition == std::string::npos) || (!line)) {
+        return false;
+    }
+    size_t terminatorLength{terminators.terminator(index).length()};
+    timing->firstByteTime = this->arrivalTimeOf(this->m_arrivals->consumedTotal);
+    timing->lastByteTime = this->arrivalTimeOf(this->m_arrivals->consumedTotal + terminatorPosition + terminatorLength - 1);
+    if (terminatorIndex) {
+        *terminatorIndex = index;
+    }
+    this->takeLine(terminatorPosition, terminatorLength, line);
+    return true;
+}
+
+SerialTimePoint SerialLineBuffer::arrivalTimeOf(unsigned long long position) const
+{
+    if (this->m_arrivals->marks.empty()) {
+        return SerialTimePoint{};
+    }
+    SerialTimePoint arrivalTime{this->m_arrivals->marks.front().second};
+    for (auto &it : this->m_arrivals->marks) {
+        if (it.first > position) {
+            break;
+        }
+        arrivalTime = it.second;
+    }
+    return arrivalTime;
+}
+#endif
 
 SerialPort::SerialPort(const std::string &name) :
     SerialPort(name, DEFAULT_BAUD_RATE, DEFAULT_STOP_BITS, DEFAULT_DATA_BITS, DEFAULT_PARITY)
@@ -170,7 +689,13 @@ SerialPort::SerialPort(const std::string &name, Parity parity) :
 
 }
 
+//Only the descriptor and saved settings are taken over, the buffers are moved rather
+//than copied, and the other port is left closed
 SerialPort::SerialPort(SerialPort &&other) :
+    m_serialPort{other.releaseDescriptor()},
+#if !(defined(_WIN32) || defined(__CYGWIN__))
+    m_oldPortSettings(other.m_oldPortSettings),
+#endif
     m_portName{std::move(other.m_portName)},
     m_portNumber{std::move(other.m_portNumber)},
     m_baudRate{std::move(other.m_baudRate)},
@@ -178,11 +703,34 @@ SerialPort::SerialPort(SerialPort &&other) :
     m_dataBits{std::move(other.m_dataBits)},
     m_parity{std::move(other.m_parity)},
     m_lineEnding{std::move(other.m_lineEnding)},
+    m_lineTerminators{std::move(other.m_lineTerminators)},
     m_timeout{std::move(other.m_timeout)},
     m_retryCount{std::move(other.m_retryCount)},
-    m_isOpen{std::move(other.m_isOpen)}
-{
-
+    m_isOpen{std::move(other.m_isOpen)},
+    m_isListening{false},
+    m_shutEmDown{false},
+    m_stringBuilderQueue{std::move(other.m_stringBuilderQueue)},
+    m_receiveBuffer{std::move(other.m_receiveBuffer)},
+    m_receiveBufferHead{std::move(other.m_receiveBufferHead)},
+    m_receiveBufferCount{std::move(other.m_receiveBufferCount)},
+    m_outputBufferEnabled{std::move(other.m_outputBufferEnabled)},
+    m_outputBuffer{std::move(other.m_outputBuffer)},
+    m_writeMutex{},
+    m_bytesCallback{std::move(other.m_bytesCallback)},
+    m_lineCallback{std::move(other.m_lineCallback)},
+    m_wakeDescriptor{-1},
+    m_manager{nullptr},
+    m_frameDecoder{std::move(other.m_frameDecoder)},
+    m_frameFormat{other.m_frameFormat.load()},
+    m_frameCount{other.m_frameCount.load()},
+    m_invalidFrameCount{other.m_invalidFrameCount.load()},
+    m_frameCallback{std::move(other.m_frameCallback)},
+    m_frameQueue{std::move(other.m_frameQueue)},
+    m_encodedFrame{},
+    m_listenerThreadConfiguration{std::move(other.m_listenerThreadConfiguration)},
+    m_receiveTiming{std::move(other.m_receiveTiming)}
+{
+    other.m_isOpen = false;
 }
 
 
@@ -194,17 +742,57 @@ SerialPort::SerialPort(const std::string &name, BaudRate baudRate, StopBits stop
     m_dataBits{dataBits},
     m_parity{parity},
     m_lineEnding{DEFAULT_LINE_ENDING},
+    m_lineTerminators{nullptr},
     m_timeout{DEFAULT_TIMEOUT},
     m_retryCount{DEFAULT_RETRY_COUNT},
     m_isOpen{false},
     m_isListening{false},
-    m_shutEmDown{false}
+    m_shutEmDown{false},
+    m_stringBuilderQueue{SINGLE_MESSAGE_BUFFER_MAX},
+    m_receiveBuffer(SERIAL_PORT_BUFFER_MAX),
+    m_receiveBufferHead{0},
+    m_receiveBufferCount{0},
+    m_outputBufferEnabled{false},
+    m_outputBuffer{""},
+    m_writeMutex{},
+    m_bytesCallback{nullptr},
+    m_lineCallback{nullptr},
+    m_wakeDescriptor{-1},
+    m_manager{nullptr},
+    m_frameDecoder{nullptr},
+    m_frameFormat{SerialFraming::Format::NONE},
+    m_frameCount{0},
+    m_invalidFrameCount{0},
+    m_frameCallback{nullptr},
+    m_frameQueue{},
+    m_encodedFrame{},
+    m_listenerThreadConfiguration{nullptr},
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+    m_receiveTiming{new SerialPortReceiveTiming{{}, 0, SerialTimePoint{}, {}, {}, {}}}
+#else
+    m_receiveTiming{nullptr}
+#endif
 {
+#if (defined(_WIN32) || defined(__CYGWIN__))
+    this->m_serialPort = INVALID_HANDLE_VALUE;
+#else
+    this->m_serialPort = -1;
+#endif
     std::pair<int, std::string> truePortNameAndNumber{getPortNameAndNumber(this->m_portName)};
     this->m_portNumber = truePortNameAndNumber.first;
     this->m_portName = truePortNameAndNumber.second;
 }
 
+SerialPort::~SerialPort()
+{
+#if defined(__linux__)
+    if (this->m_manager) {
+        this->m_manager->remove(*this);
+    }
+#endif
+    this->stopAsyncListen();
+}
+
 void SerialPort::begin(long baud)
 {
     this->closePort();
@@ -247,7 +835,7 @@ void SerialPort::openPort()
     mode += "stop=" + std::to_string(parseStopBits(this->m_stopBits)) + " ";
     mode += DTR_RTS_ON_IDENTIFIER;
 
-    this->m_serialPort[this->m_portNumber] = CreateFileA(this->m_portName.c_str(),
+    this->m_serialPort = CreateFileA(this->m_portName.c_str(),
                                                       GENERIC_READ|GENERIC_WRITE,
                                                       0,                          /* no share  */
                                                       NULL,                       /* no security */
@@ -255,7 +843,7 @@ void SerialPort::openPort()
                                                       0,                          /* no threads */
                                                       NULL);                      /* no templates */
 
-    if(this->m_serialPort[this->m_portNumber] == INVALID_HANDLE_VALUE) {
+    if(this->m_serialPort == INVALID_HANDLE_VALUE) {
         throw std::runtime_error("ERROR: Unable to open serial port " + this->m_portName);
     }
 
@@ -268,7 +856,7 @@ void SerialPort::openPort()
         throw std::runtime_error("ERROR: Unable to set dcb settings for serial port " + this->m_portName);
     }
 
-    if(!SetCommState(this->m_serialPort[this->m_portNumber], &portSettings)) {
+    if(!SetCommState(this->m_serialPort, &portSettings)) {
         this->closePort();
         throw std::runtime_error("ERROR: Unable to set cfg settings for serial port " + this->m_portName);
     }
@@ -280,7 +868,7 @@ void SerialPort::openPort()
     Cptimeouts.WriteTotalTimeoutMultiplier = 0;
     Cptimeouts.WriteTotalTimeoutConstant   = 0;
 
-    if(!SetCommTimeouts(this->m_serialPort[this->m_portNumber], &Cptimeouts)) {
+    if(!SetCommTimeouts(this->m_serialPort, &Cptimeouts)) {
         this->closePort();
         throw std::runtime_error("ERROR: Unable to set timeout settings for serial port " + this->m_portName);
     }
@@ -298,50 +886,55 @@ void SerialPort::openPort()
     int cpar{parityPair.first};
     int ipar{parityPair.second};
     int bstop{parseStopBits(this->m_stopBits)};
-    this->m_serialPort[this->m_portNumber] = open(this->m_portName.c_str(), O_RDWR | O_NOCTTY | O_NDELAY);
-    if(this->m_serialPort[this->m_portNumber] == -1) {
+    this->m_serialPort = open(this->m_portName.c_str(), O_RDWR | O_NOCTTY | O_NDELAY);
+    if(this->m_serialPort == -1) {
         throw std::runtime_error("ERROR: Unable to open serial port " + this->m_portName);
     }
 
-    if(flock(this->m_serialPort[this->m_portNumber], LOCK_EX | LOCK_NB) != 0) {
+    if(flock(this->m_serialPort, LOCK_EX | LOCK_NB) != 0) {
         this->closePort();
         throw std::runtime_error("ERROR: Another process has locked serial port " + this->m_portName);
     }
 
-    error = tcgetattr(this->m_serialPort[this->m_portNumber], this->m_oldPortSettings + this->m_portNumber);
+    error = tcgetattr(this->m_serialPort, &this->m_oldPortSettings);
     if (error == -1) {
         this->closePort();
         throw std::runtime_error("ERROR: Unable to read port settings for serial port " + this->m_portName);
     }
-    memset(&this->m_newPortSettings, 0, sizeof(this->m_newPortSettings)); 
+    struct termios newPortSettings;
+    memset(&newPortSettings, 0, sizeof(newPortSettings)); 
 
-    this->m_newPortSettings.c_cflag = cbits | cpar | bstop | CLOCAL | CREAD;
-    this->m_newPortSettings.c_iflag = ipar;
-    this->m_newPortSettings.c_oflag = 0;
-    this->m_newPortSettings.c_lflag = 0;
-    this->m_newPortSettings.c_cc[VMIN] = 0;      /* block untill n bytes are received */
-    this->m_newPortSettings.c_cc[VTIME] = 0;     /* block untill a timer expires (n * 100 mSec.) */
+    newPortSettings.c_cflag = cbits | cpar | bstop | CLOCAL | CREAD;
+    newPortSettings.c_iflag = ipar;
+    newPortSettings.c_oflag = 0;
+    newPortSettings.c_lflag = 0;
+    newPortSettings.c_cc[VMIN] = 0;      /* block untill n bytes are received */
+    newPortSettings.c_cc[VTIME] = 0;     /* block untill a timer expires (n * 100 mSec.) */
 
-    cfsetispeed(&this->m_newPortSettings, baudRate);
-    cfsetospeed(&this->m_newPortSettings, baudRate);
+    cfsetispeed(&newPortSettings, baudRate);
+    cfsetospeed(&newPortSettings, baudRate);
 
-    error = tcsetattr(this->m_serialPort[this->m_portNumber], TCSANOW, &this->m_newPortSettings);
+    error = tcsetattr(this->m_serialPort, TCSANOW, &newPortSettings);
     if(error == -1) {
         this->closePort();
         throw std::runtime_error("ERROR: Unable to adjust port settings for serial port " + this->m_portName);
     }
 
-    if(ioctl(this->m_serialPort[this->m_portNumber], TIOCMGET, &status) == -1) {
-        this->closePort();
-        throw std::runtime_error("ERROR: Unable to get port status for serial port " + this->m_portName);
-    }
+    //Pseudo terminals have no modem control lines, so there is no DTR/RTS to raise
+    if (this->m_portName.find("/dev/pts/") != 0) {
+        if(ioctl(this->m_serialPort, TIOCMGET, &status) == -1) {
+            this->closePort();
+            throw std::runtime_error("ERROR: Unable to get port status for serial port " + this->m_portName);
+        }
 
-    status |= TIOCM_DTR;    /* turn on DTR */
-    status |= TIOCM_RTS;    /* turn on RTS */
-    if(ioctl(this->m_serialPort[this->m_portNumber], TIOCMSET, &status) == -1) {
-        this->closePort();
-        throw std::runtime_error("ERROR: Unable to set port status for serial port " + this->m_portName);
+        status |= TIOCM_DTR;    /* turn on DTR */
+        status |= TIOCM_RTS;    /* turn on RTS */
+        if(ioctl(this->m_serialPort, TIOCMSET, &status) == -1) {
+            this->closePort();
+            throw std::runtime_error("ERROR: Unable to set port status for serial port " + this->m_portName);
+        }
     }
+    this->clearReceiveBuffer();
     this->m_isOpen = true;
 #endif
 }
@@ -535,118 +1128,450 @@ std::pair<int, int> SerialPort::parseParity(Parity parity)
 
 unsigned char SerialPort::rawRead()
 {
-#if (defined(_WIN32) || defined(__CYGWIN__))
-    std::unique_ptr<unsigned char> buffer{new unsigned char[SERIAL_PORT_BUFFER_MAX]};
-    unsigned char charToReturn{0};
-    long int returnedBytes{0};
-    ReadFile(this->m_serialPort[this->m_portNumber], buffer.get(), 1, (LPDWORD)((void *)&returnedBytes), NULL);
-    if (returnedBytes == 1) {
-        charToReturn = buffer.get()[0];
+    std::lock_guard<std::mutex> receiveLock{this->m_receiveMutex};
+    if (this->m_receiveBufferCount == 0) {
+        this->fillReceiveBuffer();
+        if (this->m_receiveBufferCount == 0) {
+            return 0;
+        }
     }
+    unsigned char charToReturn{this->m_receiveBuffer[this->m_receiveBufferHead]};
+    this->m_receiveBufferHead = (this->m_receiveBufferHead + 1) % this->m_receiveBuffer.size();
+    this->m_receiveBufferCount--;
     return charToReturn;
+}
+
+//Reads as many bytes as are waiting (up to the free space in the receive ring) with
+//a single call, instead of one call per byte. m_receiveMutex must already be held
+ssize_t SerialPort::fillReceiveBuffer()
+{
+    if (this->m_receiveBufferCount == 0) {
+        this->m_receiveBufferHead = 0;
+    }
+    size_t tail{(this->m_receiveBufferHead + this->m_receiveBufferCount) % this->m_receiveBuffer.size()};
+    size_t freeSpace{std::min(this->m_receiveBuffer.size() - this->m_receiveBufferCount, this->m_receiveBuffer.size() - tail)};
+    if (freeSpace == 0) {
+        return 0;
+    }
+#if (defined(_WIN32) || defined(__CYGWIN__))
+    long int returnedBytes{0};
+    ReadFile(this->m_serialPort, this->m_receiveBuffer.data() + tail, freeSpace, (LPDWORD)((void *)&returnedBytes), NULL);
 #else
-    std::unique_ptr<unsigned char> buffer{new unsigned char[SERIAL_PORT_BUFFER_MAX]};
-    unsigned char charToReturn{0};
-    long int returnedBytes{::read(this->m_serialPort[this->m_portNumber], buffer.get(), 1)};
-    if(returnedBytes < 0) {
-        if(errno == EAGAIN)  {
-            return charToReturn;
+    long int returnedBytes{::read(this->m_serialPort, this->m_receiveBuffer.data() + tail, freeSpace)};
+#endif
+    if (returnedBytes <= 0) {
+        return 0;
+    }
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+    this->recordArrival(returnedBytes);
+#endif
+    this->m_receiveBufferCount += returnedBytes;
+    return returnedBytes;
+}
+
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+//Timestamps a chunk just read into the receive ring. m_receiveMutex must already be held
+void SerialPort::recordArrival(size_t length)
+{
+    SerialTimePoint now{std::chrono::steady_clock::now()};
+    if (this->m_receiveTiming->lastArrivalTime != SerialTimePoint{}) {
+        this->m_receiveTiming->interByteGap.record(now - this->m_receiveTiming->lastArrivalTime);
+    }
+    this->m_receiveTiming->lastArrivalTime = now;
+    //Marks for bytes that have already left the ring are no longer needed
+    unsigned long long consumed{this->m_receiveTiming->receiveBufferFilled - this->m_receiveBufferCount};
+    while ((this->m_receiveTiming->arrivals.size() > 1) && (this->m_receiveTiming->arrivals[1].first <= consumed)) {
+        this->m_receiveTiming->arrivals.pop_front();
+    }
+    this->m_receiveTiming->arrivals.emplace_back(this->m_receiveTiming->receiveBufferFilled, now);
+    this->m_receiveTiming->receiveBufferFilled += length;
+}
+
+SerialTimePoint SerialPort::receivedArrivalTime(unsigned long long position) const
+{
+    SerialTimePoint arrivalTime{};
+    for (auto &it : this->m_receiveTiming->arrivals) {
+        if (it.first > position) {
+            break;
         }
-    } else if (returnedBytes == 1) {
-        charToReturn = buffer.get()[0];
-    } else {
-        return charToReturn;
+        arrivalTime = it.second;
     }
+    return arrivalTime;
+}
 
-    return charToReturn;
+//Carries the arrival time of the oldest bytes in the receive ring over to the line
+//queue, and returns how many of the next length bytes share that arrival time. Both
+//m_ioMutex and m_receiveMutex must already be held
+size_t SerialPort::markTransferredArrival(size_t length)
+{
+    unsigned long long position{this->m_receiveTiming->receiveBufferFilled - this->m_receiveBufferCount};
+    this->m_stringBuilderQueue.markArrival(this->receivedArrivalTime(position));
+    for (auto &it : this->m_receiveTiming->arrivals) {
+        if (it.first > position) {
+            return static_cast<size_t>(std::min<unsigned long long>(length, it.first - position));
+        }
+    }
+    return length;
+}
 #endif
+
+void SerialPort::clearReceiveBuffer()
+{
+    std::lock_guard<std::mutex> receiveLock{this->m_receiveMutex};
+    this->m_receiveBufferHead = 0;
+    this->m_receiveBufferCount = 0;
 }
 
 unsigned char SerialPort::timedRead()
 {
-    unsigned char byteRead{0};
-    SteadyEventTimer eventTimer;
-    eventTimer.start();
+    unsigned char byteRead{this->rawRead()};
+    if (byteRead != 0) {
+        return byteRead;
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(this->m_timeout);
     do {
+        if (!this->waitForInput(deadline - std::chrono::steady_clock::now())) {
+            return 0;
+        }
         byteRead = this->rawRead();
         if (byteRead != 0) {
             return byteRead;
         }
-        eventTimer.update();
-    } while (eventTimer.totalMilliseconds() < this->m_timeout);
+    } while (std::chrono::steady_clock::now() < deadline);
     return 0;
 }
 
+//Sleeps until the port has input or the timeout expires, instead of spinning on rawRead()
+bool SerialPort::waitForInput(std::chrono::steady_clock::duration timeout)
+{
+    if (timeout <= std::chrono::steady_clock::duration::zero()) {
+        return false;
+    }
+#if (defined(_WIN32) || defined(__CYGWIN__))
+    COMSTAT comStatus;
+    DWORD errors{0};
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    do {
+        if ((ClearCommError(this->m_serialPort, &errors, &comStatus)) && (comStatus.cbInQue > 0)) {
+            return true;
+        }
+        Sleep(1);
+    } while (std::chrono::steady_clock::now() < deadline);
+    return false;
+#else
+    auto timeoutNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+    struct timespec pollTimeout{};
+    pollTimeout.tv_sec = static_cast<time_t>(timeoutNanoseconds / 1000000000L);
+    pollTimeout.tv_nsec = static_cast<long>(timeoutNanoseconds % 1000000000L);
+    struct pollfd pollDescriptor{this->m_serialPort, POLLIN, 0};
+    int pollResult{ppoll(&pollDescriptor, 1, &pollTimeout, nullptr)};
+    if ((pollResult < 0) && (errno == EINTR)) {
+        //Interrupted by a signal, let the caller check the port and wait again
+        return true;
+    }
+    return ((pollResult > 0) && ((pollDescriptor.revents & POLLIN) != 0));
+#endif
+}
+
 ssize_t SerialPort::write(char byteToSend)
 {
     return this->writeByte(byteToSend);
 }
 
-ssize_t SerialPort::write(const uint8_t *message, uint8_t messageLength)
+ssize_t SerialPort::write(const uint8_t *message, size_t messageLength)
+{
+    return this->writeBufferedBytes(message, messageLength);
+}
+
+ssize_t SerialPort::write(const void *data, size_t length)
+{
+    return this->bufferOrWrite(static_cast<const char *>(data), length, nullptr, 0);
+}
+
+ssize_t SerialPort::write(const std::string &message)
+{
+    return this->bufferOrWrite(message.data(), message.length(), nullptr, 0);
+}
+
+ssize_t SerialPort::read(uint8_t *buffer, size_t length)
+{
+    if (length == 0) {
+        return 0;
+    }
+    std::unique_lock<std::mutex> ioMutexLock{this->m_ioMutex};
+    if (this->m_isListening) {
+        this->m_receivedCondition.wait_for(ioMutexLock, std::chrono::milliseconds(this->m_timeout), [this]() {
+            return !this->m_stringBuilderQueue.empty();
+        });
+        return this->m_stringBuilderQueue.read(reinterpret_cast<char *>(buffer), length);
+    }
+    size_t readBytes{this->m_stringBuilderQueue.read(reinterpret_cast<char *>(buffer), length)};
+    ioMutexLock.unlock();
+    if (readBytes > 0) {
+        return readBytes;
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(this->m_timeout);
+    do {
+        std::lock_guard<std::mutex> receiveLock{this->m_receiveMutex};
+        if (this->m_receiveBufferCount == 0) {
+            this->fillReceiveBuffer();
+        }
+        while ((readBytes < length) && (this->m_receiveBufferCount > 0)) {
+            size_t contiguous{std::min(std::min(length - readBytes, this->m_receiveBufferCount), this->m_receiveBuffer.size() - this->m_receiveBufferHead)};
+            memcpy(buffer + readBytes, this->m_receiveBuffer.data() + this->m_receiveBufferHead, contiguous);
+            readBytes += contiguous;
+            this->m_receiveBufferHead = (this->m_receiveBufferHead + contiguous) % this->m_receiveBuffer.size();
+            this->m_receiveBufferCount -= contiguous;
+        }
+        if (readBytes > 0) {
+            return readBytes;
+        }
+    } while (this->waitForInput(deadline - std::chrono::steady_clock::now()));
+    return 0;
+}
+
+void SerialPort::setFrameFormat(SerialFraming::Format frameFormat)
+{
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    std::lock_guard<std::mutex> receiveLock{this->m_receiveMutex};
+    if (frameFormat == SerialFraming::Format::NONE) {
+        this->m_frameDecoder.reset();
+    } else {
+        this->m_frameDecoder.reset(new SerialFraming::Decoder{frameFormat});
+    }
+    this->m_frameFormat = frameFormat;
+    this->m_frameCount = 0;
+    this->m_invalidFrameCount = 0;
+    this->m_frameQueue.clear();
+}
+
+SerialFraming::Format SerialPort::frameFormat() const
+{
+    return this->m_frameFormat;
+}
+
+void SerialPort::onFrame(const SerialPortFrameCallback &callback)
+{
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    this->m_frameCallback = callback;
+}
+
+size_t SerialPort::frameCount() const
+{
+    return this->m_frameCount;
+}
+
+size_t SerialPort::invalidFrameCount() const
+{
+    return this->m_invalidFrameCount;
+}
+
+ssize_t SerialPort::writeFrame(const std::string &frame)
+{
+    return this->writeFrame(frame.data(), frame.length());
+}
+
+//Encodes into a buffer kept between calls, so sending a frame does not allocate. The
+//buffer is shared, so it is only touched with m_writeMutex held
+ssize_t SerialPort::writeFrame(const void *frame, size_t length)
+{
+    std::lock_guard<std::mutex> writeLock{this->m_writeMutex};
+    this->m_encodedFrame.clear();
+    SerialFraming::encode(this->frameFormat(), frame, length, &this->m_encodedFrame);
+    return this->appendOutput(this->m_encodedFrame.data(), this->m_encodedFrame.length(), nullptr, 0);
+}
+
+bool SerialPort::readFrame(std::string *frame)
 {
-    ssize_t bytesWritten{0};
-    for (int i = 0; i < messageLength; i++) {
-        this->writeByte(static_cast<char>(message[i]));
-        bytesWritten++;
+    if ((!frame) || (this->frameFormat() == SerialFraming::Format::NONE)) {
+        return false;
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(this->m_timeout);
+    std::unique_lock<std::mutex> ioMutexLock{this->m_ioMutex};
+    if (this->m_isListening) {
+        this->m_receivedCondition.wait_until(ioMutexLock, deadline, [this]() {
+            return !this->m_frameQueue.empty();
+        });
+    }
+    while ((this->m_frameQueue.empty()) && (!this->m_isListening)) {
+        ioMutexLock.unlock();
+        bool keepWaiting{(this->dispatchReceived() > 0) || (this->waitForInput(deadline - std::chrono::steady_clock::now()))};
+        ioMutexLock.lock();
+        if ((!keepWaiting) || (std::chrono::steady_clock::now() >= deadline)) {
+            break;
+        }
+    }
+    if (this->m_frameQueue.empty()) {
+        return false;
     }
-    return bytesWritten;
+    frame->swap(this->m_frameQueue.front());
+    this->m_frameQueue.pop_front();
+    return true;
 }
 
 
 ssize_t SerialPort::writeByte(char byteToSend)
 {
-#if (defined(_WIN32) || defined(__CYGWIN__))
-    long int writtenBytes{0};
-    WriteFile(this->m_serialPort[this->m_portNumber], &byteToSend, 1, (LPDWORD)((void *)&writtenBytes), NULL);
-    return ( (writtenBytes < 0) ? 1 : 0);
-#else
-    long int writtenBytes{::write(this->m_serialPort[this->m_portNumber], &byteToSend, 1)};
-    if(writtenBytes < 0) {
-        return (errno == EAGAIN ? 0 : 1);
+    return this->bufferOrWrite(&byteToSend, 1, nullptr, 0);
+}
+
+ssize_t SerialPort::writeBufferedBytes(const unsigned char *buffer, size_t bufferSize)
+{
+    return this->bufferOrWrite(reinterpret_cast<const char *>(buffer), bufferSize, nullptr, 0);
+}
+
+//With the output buffer enabled, small writes are collected until flushOutputBuffer() is
+//called or SERIAL_PORT_BUFFER_MAX bytes are waiting; otherwise they go straight out
+ssize_t SerialPort::bufferOrWrite(const char *first, size_t firstLength, const char *second, size_t secondLength)
+{
+    std::lock_guard<std::mutex> writeLock{this->m_writeMutex};
+    return this->appendOutput(first, firstLength, second, secondLength);
+}
+
+//m_writeMutex must already be held
+ssize_t SerialPort::appendOutput(const char *first, size_t firstLength, const char *second, size_t secondLength)
+{
+    if (!this->m_outputBufferEnabled) {
+        return this->writeSegments(first, firstLength, second, secondLength);
+    }
+    size_t totalLength{firstLength + secondLength};
+    if (this->m_outputBuffer.length() + totalLength > static_cast<size_t>(SERIAL_PORT_BUFFER_MAX)) {
+        if (this->m_outputBuffer.length() > 0) {
+            this->drainOutputBuffer();
+        }
+        if (totalLength > static_cast<size_t>(SERIAL_PORT_BUFFER_MAX)) {
+            return this->writeSegments(first, firstLength, second, secondLength);
+        }
+    }
+    this->m_outputBuffer.append(first, firstLength);
+    if (second) {
+        this->m_outputBuffer.append(second, secondLength);
+    }
+    return totalLength;
+}
+
+ssize_t SerialPort::flushOutputBuffer()
+{
+    std::lock_guard<std::mutex> writeLock{this->m_writeMutex};
+    return this->drainOutputBuffer();
+}
+
+//m_writeMutex must already be held
+ssize_t SerialPort::drainOutputBuffer()
+{
+    if (this->m_outputBuffer.length() == 0) {
+        return 0;
+    }
+    ssize_t writtenBytes{this->writeSegments(this->m_outputBuffer.data(), this->m_outputBuffer.length(), nullptr, 0)};
+    if (writtenBytes > 0) {
+        this->m_outputBuffer.erase(0, writtenBytes);
     }
     return writtenBytes;
-#endif
 }
 
-ssize_t SerialPort::writeBufferedBytes(unsigned char *buffer, long bufferSize)
+//Writes both segments with as few calls as possible, picking up after partial writes and
+//waiting (up to the timeout) for the port to drain when it would block. Returns the number
+//of bytes written, or -1 if the port failed before anything was written
+ssize_t SerialPort::writeSegments(const char *first, size_t firstLength, const char *second, size_t secondLength)
 {
 #if (defined(_WIN32) || defined(__CYGWIN__))
-    long int writtenBytes;
-    return (WriteFile(this->m_serialPort[this->m_portNumber], buffer, bufferSize, (LPDWORD)((void *)&writtenBytes), NULL) ? writtenBytes : -1);
+    ssize_t totalWritten{0};
+    for (auto segment : {std::make_pair(first, firstLength), std::make_pair(second, secondLength)}) {
+        if ((!segment.first) || (segment.second == 0)) {
+            continue;
+        }
+        DWORD writtenBytes{0};
+        if (!WriteFile(this->m_serialPort, segment.first, static_cast<DWORD>(segment.second), &writtenBytes, NULL)) {
+            return ((totalWritten > 0) ? totalWritten : -1);
+        }
+        totalWritten += writtenBytes;
+    }
+    return totalWritten;
 #else
-    long int writtenBytes{::write(this->m_serialPort[this->m_portNumber], buffer, bufferSize)};
-    if(writtenBytes < 0) {
-        return (errno == EAGAIN ? 0 : 1);
+    struct iovec segments[2];
+    int segmentCount{0};
+    if ((first) && (firstLength > 0)) {
+        segments[segmentCount].iov_base = const_cast<char *>(first);
+        segments[segmentCount++].iov_len = firstLength;
+    }
+    if ((second) && (secondLength > 0)) {
+        segments[segmentCount].iov_base = const_cast<char *>(second);
+        segments[segmentCount++].iov_len = secondLength;
+    }
+    struct iovec *nextSegment{segments};
+    ssize_t totalWritten{0};
+    while (segmentCount > 0) {
+        ssize_t writtenBytes{::writev(this->m_serialPort, nextSegment, segmentCount)};
+        if (writtenBytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                struct pollfd pollDescriptor{this->m_serialPort, POLLOUT, 0};
+                if (poll(&pollDescriptor, 1, static_cast<int>(this->m_timeout)) > 0) {
+                    continue;
+                }
+            }
+            return ((totalWritten > 0) ? totalWritten : -1);
+        }
+        totalWritten += writtenBytes;
+        while ((segmentCount > 0) && (static_cast<size_t>(writtenBytes) >= nextSegment->iov_len)) {
+            writtenBytes -= nextSegment->iov_len;
+            nextSegment++;
+            segmentCount--;
+        }
+        if (segmentCount > 0) {
+            nextSegment->iov_base = static_cast<char *>(nextSegment->iov_base) + writtenBytes;
+            nextSegment->iov_len -= writtenBytes;
+        }
     }
-    return writtenBytes;
+    return totalWritten;
 #endif
 }
 
+void SerialPort::setOutputBufferEnabled(bool outputBufferEnabled)
+{
+    std::lock_guard<std::mutex> writeLock{this->m_writeMutex};
+    if (!outputBufferEnabled) {
+        this->drainOutputBuffer();
+    }
+    this->m_outputBufferEnabled = outputBufferEnabled;
+}
+
+bool SerialPort::outputBufferEnabled() const
+{
+    return this->m_outputBufferEnabled;
+}
+
 
 void SerialPort::closePort()
 {
-    this->m_shutEmDown = true;
-    this->m_isListening = false;
+#if defined(__linux__)
+    if (this->m_manager) {
+        this->m_manager->remove(*this);
+    }
+#endif
+    this->stopAsyncListen();
     if (!this->isOpen()) {
         return;
     }
+    this->flushOutputBuffer();
     #if (defined(_WIN32) || defined(__CYGWIN__))
-        CloseHandle(this->m_serialPort[this->m_portNumber]);
+        CloseHandle(this->m_serialPort);
         this->m_isOpen = false;
     #else
         int status{0};
-        if(ioctl(this->m_serialPort[this->m_portNumber], TIOCMGET, &status) == -1) {
+        if(ioctl(this->m_serialPort, TIOCMGET, &status) == -1) {
             //std::cout << "WARNING: Unable to get port status while closing serial port " << this->m_portName << std::endl;
         }
         status &= ~TIOCM_DTR;    /* turn off DTR */
         status &= ~TIOCM_RTS;    /* turn off RTS */
-        if(ioctl(this->m_serialPort[this->m_portNumber], TIOCMSET, &status) == -1) {
+        if(ioctl(this->m_serialPort, TIOCMSET, &status) == -1) {
             //std::cout << "WARNING: Unable to get port status while closing serial port " << this->m_portName << std::endl;
         }
 
-        tcsetattr(this->m_serialPort[this->m_portNumber], TCSANOW, this->m_oldPortSettings + this->m_portNumber);
-        close(this->m_serialPort[this->m_portNumber]);
-        flock(this->m_serialPort[this->m_portNumber], LOCK_UN);
+        tcsetattr(this->m_serialPort, TCSANOW, &this->m_oldPortSettings);
+        close(this->m_serialPort);
+        flock(this->m_serialPort, LOCK_UN);
         this->m_isOpen = false;
     #endif
 }
@@ -655,11 +1580,11 @@ void SerialPort::closePort()
 void SerialPort::enableDTR()
 {
 #if (defined(_WIN32) || defined(__CYGWIN__))
-    EscapeCommFunction(this->m_serialPort[this->m_portNumber], SETDTR);
+    EscapeCommFunction(this->m_serialPort, SETDTR);
 #else
     int status{0};
     status |= TIOCM_DTR;    /* turn on DTR */
-    if(ioctl(this->m_serialPort[this->m_portNumber], TIOCMSET, &status) == -1) {
+    if(ioctl(this->m_serialPort, TIOCMSET, &status) == -1) {
         std::cout << "WARNING: Unable to set port status while enabling DTR for serial port " << this->m_portName << std::endl;
     }
 #endif
@@ -668,11 +1593,11 @@ void SerialPort::enableDTR()
 void SerialPort::disableDTR()
 {
 #if (defined(_WIN32) || defined(__CYGWIN__))
-    EscapeCommFunction(this->m_serialPort[this->m_portNumber], CLRDTR);
+    EscapeCommFunction(this->m_serialPort, CLRDTR);
 #else
     int status{0};
     status &= ~TIOCM_DTR;    /* turn off DTR */
-    if(ioctl(this->m_serialPort[this->m_portNumber], TIOCMSET, &status) == -1) {
+    if(ioctl(this->m_serialPort, TIOCMSET, &status) == -1) {
         std::cout << "WARNING: Unable to set port status while disabling DTR for serial port " << this->m_portName << std::endl;
     }
 #endif
@@ -682,14 +1607,14 @@ void SerialPort::enableRTS()
 {
 
 #if (defined(_WIN32) || defined(__CYGWIN__))
-    EscapeCommFunction(this->m_serialPort[this->m_portNumber], SETRTS);
+    EscapeCommFunction(this->m_serialPort, SETRTS);
 #else
     int status{0};
-    if(ioctl(this->m_serialPort[this->m_portNumber], TIOCMGET, &status) == -1) {
+    if(ioctl(this->m_serialPort, TIOCMGET, &status) == -1) {
           std::cout << "WARNING: Unable to get port status while enabling RTS for serial port " << this->m_portName << std::endl;
     }
     status |= TIOCM_RTS;    /* turn on RTS */
-    if(ioctl(this->m_serialPort[this->m_portNumber], TIOCMSET, &status) == -1) {
+    if(ioctl(this->m_serialPort, TIOCMSET, &status) == -1) {
         std::cout << "WARNING: Unable to set port status while enabling RTS for serial port " << this->m_portName << std::endl;
     }
 #endif
@@ -698,14 +1623,14 @@ void SerialPort::enableRTS()
 void SerialPort::disableRTS()
 {
 #if (defined(_WIN32) || defined(__CYGWIN__))
-    EscapeCommFunction(this->m_serialPort[this->m_portNumber], CLRRTS);
+    EscapeCommFunction(this->m_serialPort, CLRRTS);
 #else
     int status;
-    if(ioctl(this->m_serialPort[this->m_portNumber], TIOCMGET, &status) == -1) {
+    if(ioctl(this->m_serialPort, TIOCMGET, &status) == -1) {
         std::cout << "WARNING: Unable to get port status while disabling RTS for serial port " << this->m_portName << std::endl;
     }
     status &= ~TIOCM_RTS;    /* turn off RTS */
-    if(ioctl(this->m_serialPort[this->m_portNumber], TIOCMSET, &status) == -1) {
+    if(ioctl(this->m_serialPort, TIOCMSET, &status) == -1) {
         std::cout << "WARNING: Unable to set port status while disabling RTS for serial port " << this->m_portName << std::endl;
     }
 #endif
@@ -715,11 +1640,11 @@ bool SerialPort::isDCDEnabled() const
 {
     #if (defined(_WIN32) || defined(__CYGWIN__))
         int status{0};
-        GetCommModemStatus(this->m_serialPort[this->m_portNumber], (LPDWORD)((void *)&status));
+        GetCommModemStatus(this->m_serialPort, (LPDWORD)((void *)&status));
         return ((status&MS_RLSD_ON) != 0 ? true : false);
     #else
         int status{0};
-        ioctl(this->m_serialPort[this->m_portNumber], TIOCMGET, &status);
+        ioctl(this->m_serialPort, TIOCMGET, &status);
         return (status&TIOCM_CAR);
     #endif
 }
@@ -729,11 +1654,11 @@ bool SerialPort::isCTSEnabled() const
 {
     #if (defined(_WIN32) || defined(__CYGWIN__))
         int status{0};
-        GetCommModemStatus(this->m_serialPort[this->m_portNumber], (LPDWORD)((void *)&status));
+        GetCommModemStatus(this->m_serialPort, (LPDWORD)((void *)&status));
         return ((status&MS_CTS_ON) != 0 ? true : false);
     #else
         int status{0};
-        ioctl(this->m_serialPort[this->m_portNumber], TIOCMGET, &status);
+        ioctl(this->m_serialPort, TIOCMGET, &status);
         return (status&TIOCM_CTS);
     #endif
 }
@@ -742,11 +1667,11 @@ bool SerialPort::isDSREnabled() const
 {
     #if (defined(_WIN32) || defined(__CYGWIN__))
         int status{0};
-        GetCommModemStatus(this->m_serialPort[this->m_portNumber], (LPDWORD)((void *)&status));
+        GetCommModemStatus(this->m_serialPort, (LPDWORD)((void *)&status));
         return ((status&MS_DSR_ON) != 0 ? true : false);
     #else
         int status{0};
-        ioctl(this->m_serialPort[this->m_portNumber], TIOCMGET, &status);
+        ioctl(this->m_serialPort, TIOCMGET, &status);
         return (status&TIOCM_DSR);
     #endif
 }
@@ -758,10 +1683,11 @@ void SerialPort::flush()
 
 void SerialPort::flushRX()
 {
+    this->clearReceiveBuffer();
     #if (defined(_WIN32) || defined(__CYGWIN__))
-        PurgeComm(this->m_serialPort[this->m_portNumber], PURGE_RXCLEAR | PURGE_RXABORT);
+        PurgeComm(this->m_serialPort, PURGE_RXCLEAR | PURGE_RXABORT);
     #else
-        tcflush(this->m_serialPort[this->m_portNumber], TCIFLUSH);
+        tcflush(this->m_serialPort, TCIFLUSH);
     #endif
 }
 
@@ -769,20 +1695,21 @@ void SerialPort::flushRX()
 void SerialPort::flushTX()
 {
     #if (defined(_WIN32) || defined(__CYGWIN__))
-        PurgeComm(this->m_serialPort[this->m_portNumber], PURGE_TXCLEAR | PURGE_TXABORT);
+        PurgeComm(this->m_serialPort, PURGE_TXCLEAR | PURGE_TXABORT);
     #else
-        tcflush(this->m_serialPort[this->m_portNumber], TCOFLUSH);
+        tcflush(this->m_serialPort, TCOFLUSH);
     #endif
 }
 
 
 void SerialPort::flushRXTX()
 {
+    this->clearReceiveBuffer();
     #if (defined(_WIN32) || defined(__CYGWIN__))
-        PurgeComm(this->m_serialPort[this->m_portNumber], PURGE_RXCLEAR | PURGE_RXABORT);
-        PurgeComm(this->m_serialPort[this->m_portNumber], PURGE_TXCLEAR | PURGE_TXABORT);
+        PurgeComm(this->m_serialPort, PURGE_RXCLEAR | PURGE_RXABORT);
+        PurgeComm(this->m_serialPort, PURGE_TXCLEAR | PURGE_TXABORT);
     #else
-        tcflush(this->m_serialPort[this->m_portNumber], TCIOFLUSH);
+        tcflush(this->m_serialPort, TCIOFLUSH);
     #endif
 }
 
@@ -791,58 +1718,52 @@ void SerialPort::flushTXRX()
     return this->flushRXTX();
 }
 
+//Checks the one name directly, rather than enumerating every port to look for it
 bool SerialPort::isAvailableSerialPort(const std::string &name)
 {
+#if (defined(_WIN32) || defined(__CYGWIN__))
     for (auto &it : SerialPort::availableSerialPorts()) {
         if (name == it) {
             return true;
         }
     }
     return false;
+#else
+    return ((SerialPort::serialPortNameIndex(name) != -1) && (SerialPort::fileExists(name)));
+#endif
 }
 
 std::pair<int, std::string> SerialPort::getPortNameAndNumber(const std::string &name)
 {
 #if (defined(_WIN32) || defined(__CYGWIN__))
-    std::string str{name};
-    int i{0};
-    for (auto &it : SerialPort::SERIAL_PORT_NAMES) {
-        if (it.find(str) != std::string::npos) {
-            return std::make_pair(i, str);
-        }
-        i++;
+    int index{SerialPort::serialPortNameIndex(name)};
+    if ((index == -1) && (name.find("COM") == 0)) {
+        index = SerialPort::serialPortNameIndex(AVAILABLE_PORT_NAMES_BASE.front() + name.substr(3));
+    }
+    if (index != -1) {
+        return std::make_pair(index, name);
     }
     throw std::runtime_error("ERROR: " + name + " is an invalid serial port name");
 #else
     std::string str{name};
-    int i{0};
-    for (auto &it : SerialPort::SERIAL_PORT_NAMES) {
-        if (str == it) {
-            return std::make_pair(i, str);
-        }
-        i++;
+    int index{SerialPort::serialPortNameIndex(str)};
+    if (index != -1) {
+        return std::make_pair(index, str);
     }
-    str = name;
     if (str.find("/dev/tty") == std::string::npos) {
         str = "/dev/tty" + str;
     }
-    i = 0;
-    for (auto &it : SerialPort::SERIAL_PORT_NAMES) {
-        if (str == it) {
-            return std::make_pair(i, str);
-        }
-        i++;
+    index = SerialPort::serialPortNameIndex(str);
+    if (index != -1) {
+        return std::make_pair(index, str);
     }
     str = name;
     if (str.find("/dev/") == std::string::npos) {
         str = "/dev/" + str;
     }
-    i = 0;
-    for (auto &it : SerialPort::SERIAL_PORT_NAMES) {
-        if (str == it) {
-            return std::make_pair(i, str);
-        }
-        i++;
+    index = SerialPort::serialPortNameIndex(str);
+    if (index != -1) {
+        return std::make_pair(index, str);
     }
 
     throw std::runtime_error("ERROR: " + name + " is an invalid serial port name");
@@ -856,21 +1777,16 @@ bool SerialPort::isOpen() const
 
 ssize_t SerialPort::writeCString(const char *str)
 {
-    ssize_t writtenBytes{0};
-    while (*str != 0) {
-        writtenBytes += (this->writeByte(*(str++)));
-    }
-    return writtenBytes;
+    return this->bufferOrWrite(str, strlen(str), nullptr, 0);
 }
 
 
 ssize_t SerialPort::writeLine(const std::string &str)
 {
-    std::string copyString{str};
-    if (!SerialPort::endsWith(copyString, this->m_lineEnding)) {
-        copyString += this->m_lineEnding;
+    if (SerialPort::endsWith(str, this->m_lineEnding)) {
+        return this->bufferOrWrite(str.data(), str.length(), nullptr, 0);
     }
-    return this->writeCString(copyString.c_str());
+    return this->bufferOrWrite(str.data(), str.length(), this->m_lineEnding.data(), this->m_lineEnding.length());
 }
 
 ssize_t SerialPort::writeLine(const char *str)
@@ -885,14 +1801,78 @@ ssize_t SerialPort::writeLine(char chr)
 
 std::string SerialPort::readLine()
 {
+    return this->readLineUntil(nullptr, nullptr, nullptr);
+}
+
+std::string SerialPort::readLine(SerialLineTiming *timing)
+{
+    return this->readLineUntil(nullptr, timing, nullptr);
+}
+
+std::string SerialPort::readTerminatedLine(std::string *terminator, SerialLineTiming *timing)
+{
+    if (terminator) {
+        terminator->clear();
+    }
+    return this->readLineUntil(nullptr, timing, terminator);
+}
+
+std::string SerialPort::readUntil(char readUntil)
+{
+    return this->readUntil(std::string{1, readUntil});
+}
+
+std::string SerialPort::readUntil(const char *readUntil)
+{
+    return this->readUntil(std::string{readUntil});
+}
+
+std::string SerialPort::readUntil(const std::string &str)
+{
+    return this->readLineUntil(&str, nullptr, nullptr);
+}
+
+std::string SerialPort::readUntil(const std::string &readUntil, SerialLineTiming *timing)
+{
+    return this->readLineUntil(&readUntil, timing, nullptr);
+}
+
+//Reads up to delimiter, or to the line terminators when it is nullptr
+std::string SerialPort::readLineUntil(const std::string *delimiter, SerialLineTiming *timing, std::string *terminator)
+{
+    auto extract = [this, delimiter, timing, terminator](std::string *line) {
+        return (delimiter ? this->extractLine(*delimiter, line, timing) : this->extractTerminatedLine(line, timing, terminator));
+    };
     SteadyEventTimer eventTimer;
     std::string returnString{""};
+    if (timing) {
+        *timing = SerialLineTiming{};
+    }
     eventTimer.start();
+    std::unique_lock<std::mutex> ioMutexLock{this->m_ioMutex, std::defer_lock};
+    if (this->m_isListening) {
+        //The listener fills the queue, so just sleep until it has a whole line, or until a
+        //held back terminator is due to end one without any more bytes arriving
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(this->m_timeout);
+        ioMutexLock.lock();
+        while ((!extract(&returnString)) && (std::chrono::steady_clock::now() < deadline)) {
+            this->m_receivedCondition.wait_until(ioMutexLock, std::min(deadline, this->m_stringBuilderQueue.heldTerminatorDeadline()));
+        }
+        return returnString;
+    }
     do {
+        //Lines left over from an earlier burst are returned without touching the port
+        ioMutexLock.lock();
+        bool lineFound{extract(&returnString)};
+        ioMutexLock.unlock();
+        if (lineFound) {
+            return returnString;
+        }
         this->syncStringListener();
-        if (this->m_stringBuilderQueue.find(this->m_lineEnding) != std::string::npos) {
-            returnString = this->m_stringBuilderQueue.substr(0, this->m_stringBuilderQueue.find(this->m_lineEnding));
-            this->m_stringBuilderQueue = this->m_stringBuilderQueue.substr(this->m_stringBuilderQueue.find(this->m_lineEnding) + this->m_lineEnding.length());
+        ioMutexLock.lock();
+        lineFound = extract(&returnString);
+        ioMutexLock.unlock();
+        if (lineFound) {
             return returnString;
         }
         eventTimer.update();
@@ -900,25 +1880,98 @@ std::string SerialPort::readLine()
     return returnString;
 }
 
-std::string SerialPort::readUntil(char readUntil)
+//Takes the next whole line off the queue, recording how long it took to arrive and how
+//long it waited when timing is compiled in. m_ioMutex must already be held
+bool SerialPort::extractLine(const std::string &delimiter, std::string *line, SerialLineTiming *timing)
 {
-    return this->readUntil(std::string{1, readUntil});
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+    SerialLineTiming lineTiming{};
+    if (!this->m_stringBuilderQueue.extractUntil(delimiter, line, &lineTiming)) {
+        return false;
+    }
+    this->recordLineTiming(lineTiming, timing);
+    return true;
+#else
+    (void)timing;
+    return this->m_stringBuilderQueue.extractUntil(delimiter, line);
+#endif
 }
 
-std::string SerialPort::readUntil(const char *readUntil)
+//extractLine() for the line terminators, or lineEnding() when none are set
+bool SerialPort::extractTerminatedLine(std::string *line, SerialLineTiming *timing, std::string *terminator)
 {
-    return this->readUntil(std::string{readUntil});
+    if (!this->m_lineTerminators) {
+        bool lineFound{this->extractLine(this->m_lineEnding, line, timing)};
+        if ((lineFound) && (terminator)) {
+            *terminator = this->m_lineEnding;
+        }
+        return lineFound;
+    }
+    size_t terminatorIndex{0};
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+    SerialLineTiming lineTiming{};
+    if (!this->m_stringBuilderQueue.extractUntilAny(*this->m_lineTerminators, line, &terminatorIndex, &lineTiming)) {
+        return false;
+    }
+    this->recordLineTiming(lineTiming, timing);
+#else
+    (void)timing;
+    if (!this->m_stringBuilderQueue.extractUntilAny(*this->m_lineTerminators, line, &terminatorIndex)) {
+        return false;
+    }
+#endif
+    if (terminator) {
+        *terminator = this->m_lineTerminators->terminator(terminatorIndex);
+    }
+    return true;
 }
 
-std::string SerialPort::readUntil(const std::string &str)
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+void SerialPort::recordLineTiming(const SerialLineTiming &lineTiming, SerialLineTiming *timing)
+{
+    SerialLineTiming consumedTiming{lineTiming};
+    consumedTiming.consumedTime = std::chrono::steady_clock::now();
+    this->m_receiveTiming->lineAssembly.record(consumedTiming.assemblyTime());
+    this->m_receiveTiming->timeInBuffer.record(consumedTiming.timeInBuffer());
+    if (timing) {
+        *timing = consumedTiming;
+    }
+}
+#endif
+
+SerialPortTimingSnapshot SerialPort::timingSnapshot()
+{
+    SerialPortTimingSnapshot snapshot{};
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    std::lock_guard<std::mutex> receiveLock{this->m_receiveMutex};
+    snapshot.interByteGap = this->m_receiveTiming->interByteGap;
+    snapshot.lineAssembly = this->m_receiveTiming->lineAssembly;
+    snapshot.timeInBuffer = this->m_receiveTiming->timeInBuffer;
+#endif
+    return snapshot;
+}
+
+void SerialPort::resetTiming()
 {
-    std::string tempLineEnding{this->m_lineEnding};
-    this->m_lineEnding = str;
-    std::string readString{this->readLine()};
-    this->m_lineEnding = tempLineEnding;
-    return readString;
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    std::lock_guard<std::mutex> receiveLock{this->m_receiveMutex};
+    this->m_receiveTiming->interByteGap.clear();
+    this->m_receiveTiming->lineAssembly.clear();
+    this->m_receiveTiming->timeInBuffer.clear();
+    this->m_receiveTiming->lastArrivalTime = SerialTimePoint{};
+#endif
 }
 
+bool SerialPort::isTimingEnabled()
+{
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+    return true;
+#else
+    return false;
+#endif
+}
 
 void SerialPort::setPortName(const std::string &name)
 {
@@ -975,6 +2028,28 @@ void SerialPort::setLineEnding(const std::string &lineEnding)
     this->m_lineEnding = lineEnding;
 }
 
+void SerialPort::setTerminatorHoldTime(long holdTime)
+{
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    this->m_stringBuilderQueue.setTerminatorHoldTime(std::chrono::milliseconds(holdTime));
+}
+
+long SerialPort::terminatorHoldTime() const
+{
+    return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(this->m_stringBuilderQueue.terminatorHoldTime()).count());
+}
+
+void SerialPort::setLineTerminators(const std::vector<std::string> &terminators)
+{
+    std::unique_ptr<SerialLineTerminators> lineTerminators{};
+    if (!terminators.empty()) {
+        lineTerminators.reset(new SerialLineTerminators{terminators});
+    }
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    this->m_lineTerminators = std::move(lineTerminators);
+    this->m_stringBuilderQueue.restartScan();
+}
+
 bool SerialPort::isWhitespace(const std::string &stringToCheck)
 {
     return std::all_of(stringToCheck.begin(), stringToCheck.end(), [](char c) { return c == ' '; });
@@ -1051,6 +2126,11 @@ std::string SerialPort::lineEnding() const
     return this->m_lineEnding;
 }
 
+std::vector<std::string> SerialPort::lineTerminators() const
+{
+    return (this->m_lineTerminators ? this->m_lineTerminators->terminators() : std::vector<std::string>{});
+}
+
 long SerialPort::timeout() const
 {
     return this->m_timeout;
@@ -1227,31 +2307,146 @@ Parity SerialPort::parseParityFromRaw(const std::string &parity)
 }
 
 
+void SerialPort::startListening()
+{
+    return this->startAsyncListen();
+}
+
+//A port serviced by a SerialPortManager stops listening by leaving the manager
+void SerialPort::stopListening()
+{
+#if defined(__linux__)
+    if (this->m_manager) {
+        return this->m_manager->remove(*this);
+    }
+#endif
+    return this->stopAsyncListen();
+}
+
+void SerialPort::onBytes(const SerialPortBytesCallback &callback)
+{
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    this->m_bytesCallback = callback;
+}
+
+void SerialPort::onLine(const SerialPortLineCallback &callback)
+{
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    this->m_lineCallback = callback;
+}
+
 void SerialPort::startAsyncListen()
 {
     if (!this->m_isOpen) {
         return;
     }
     if (!this->m_isListening) {
+#if defined(__linux__)
+        this->m_wakeDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (this->m_wakeDescriptor == -1) {
+            throw std::runtime_error("In SerialPort::startAsyncListen(): Unable to create an eventfd for the listener of serial port " + this->m_portName);
+        }
+#endif
         this->m_isListening = true;
         this->m_shutEmDown = false;
+        ThreadConfiguration threadConfiguration{this->listenerThreadConfiguration()};
+        try {
 #if defined(__ANDROID__)
-        if (this->m_asyncFuture) {
-            delete this->m_asyncFuture;
-        }
-        this->m_asyncFuture = new std::thread{&SerialPort::asyncStringListener, this};
+            if (this->m_asyncFuture) {
+                delete this->m_asyncFuture;
+            }
+            this->m_asyncFuture = threadConfiguration.launchThread([this]() { this->asyncStringListener(); });
 #else
-        this->m_asyncFuture = std::async(std::launch::async,
-                                         &SerialPort::asyncStringListener,
-                                         this);
+            this->m_asyncFuture = threadConfiguration.launch([this]() { this->asyncStringListener(); });
+#endif
+        } catch (std::exception &e) {
+            this->m_isListening = false;
+#if defined(__ANDROID__)
+            this->m_asyncFuture = nullptr;
+#endif
+#if defined(__linux__)
+            close(this->m_wakeDescriptor);
+            this->m_wakeDescriptor = -1;
 #endif
+            throw std::runtime_error("In SerialPort::startAsyncListen(): Unable to start the listener of serial port " + this->m_portName + ": " + e.what());
+        }
+    }
+}
+
+void SerialPort::setListenerThreadConfiguration(const ThreadConfiguration &threadConfiguration)
+{
+    std::unique_ptr<ThreadConfiguration> listenerThreadConfiguration{};
+    if (!threadConfiguration.isDefault()) {
+        listenerThreadConfiguration.reset(new ThreadConfiguration{threadConfiguration});
     }
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    this->m_listenerThreadConfiguration = std::move(listenerThreadConfiguration);
+}
+
+ThreadConfiguration SerialPort::listenerThreadConfiguration() const
+{
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    return (this->m_listenerThreadConfiguration ? *this->m_listenerThreadConfiguration : ThreadConfiguration{});
 }
 
 void SerialPort::stopAsyncListen()
 {
     this->m_shutEmDown = true;
     this->m_isListening = false;
+    this->wakeListener();
+#if defined(__ANDROID__)
+    if (this->m_asyncFuture) {
+        this->m_asyncFuture->join();
+        delete this->m_asyncFuture;
+        this->m_asyncFuture = nullptr;
+    }
+#else
+    if (this->m_asyncFuture.valid()) {
+        this->m_asyncFuture.wait();
+        this->m_asyncFuture = std::future<void>{};
+    }
+#endif
+#if defined(__linux__)
+    if (this->m_wakeDescriptor != -1) {
+        close(this->m_wakeDescriptor);
+        this->m_wakeDescriptor = -1;
+    }
+#endif
+}
+
+void SerialPort::wakeListener()
+{
+#if defined(__linux__)
+    if (this->m_wakeDescriptor == -1) {
+        return;
+    }
+    uint64_t wakeValue{1};
+    if (::write(this->m_wakeDescriptor, &wakeValue, sizeof(wakeValue)) < 0) {
+        //Already signalled
+    }
+#endif
+}
+
+//Stops the listener (or manager) that is still working on this port, then hands the
+//descriptor over to the port being move constructed
+SerialPort::PortDescriptor SerialPort::releaseDescriptor()
+{
+#if defined(__linux__)
+    if (this->m_manager) {
+        this->m_manager->remove(*this);
+    }
+#endif
+    this->stopAsyncListen();
+    if (this->m_isOpen) {
+        this->flushOutputBuffer();
+    }
+    PortDescriptor descriptor{this->m_serialPort};
+#if (defined(_WIN32) || defined(__CYGWIN__))
+    this->m_serialPort = INVALID_HANDLE_VALUE;
+#else
+    this->m_serialPort = -1;
+#endif
+    return descriptor;
 }
 
 bool SerialPort::isListening() const
@@ -1259,23 +2454,165 @@ bool SerialPort::isListening() const
     return this->m_isListening;
 }
 
+//Sleeps in poll() until the port has input or the eventfd is signalled by stopAsyncListen(),
+//so arriving bytes are handled immediately and an idle port costs nothing. Without an
+//eventfd (non Linux) the poll wakes up every timeout to check for shutdown instead
 void SerialPort::asyncStringListener()
 {
-    std::unique_lock<std::mutex> ioMutexLock{this->m_ioMutex, std::defer_lock};
+#if (defined(_WIN32) || defined(__CYGWIN__))
     do {
-        unsigned char byteRead = this->timedRead();
-        if (byteRead != 0) {
-            ioMutexLock.lock();
-            addToStringBuilderQueue(byteRead);
-            ioMutexLock.unlock();
+        if (this->waitForInput(std::chrono::milliseconds(this->m_timeout))) {
+            this->dispatchReceived();
         } else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+            this->dispatchLines(std::string{});
+        }
+    } while (!this->m_shutEmDown);
+#else
+    struct pollfd pollDescriptors[2];
+    pollDescriptors[0] = pollfd{this->m_serialPort, POLLIN, 0};
+    pollDescriptors[1] = pollfd{this->m_wakeDescriptor, POLLIN, 0};
+    do {
+        int pollTimeout{(this->m_wakeDescriptor == -1) ? static_cast<int>(this->m_timeout) : -1};
+        auto heldLineDeadline = this->heldLineDeadline();
+        if (heldLineDeadline != std::chrono::steady_clock::time_point::max()) {
+            //Round up, so the poll does not end just before the held back terminator is due
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(heldLineDeadline - std::chrono::steady_clock::now()).count() + 1;
+            int heldLineTimeout{static_cast<int>(std::max<long long>(0, remaining))};
+            pollTimeout = ((pollTimeout == -1) ? heldLineTimeout : std::min(pollTimeout, heldLineTimeout));
+        }
+        int pollResult{poll(pollDescriptors, 2, pollTimeout)};
+        if (pollResult == 0) {
+            this->dispatchLines(std::string{});
+            continue;
+        } else if ((pollResult < 0) && (errno == EINTR)) {
+            continue;
+        } else if (pollResult < 0) {
+            break;
+        }
+        if ((pollDescriptors[1].revents != 0) || (this->m_shutEmDown)) {
+            break;
+        }
+        if ((pollDescriptors[0].revents & POLLIN) == 0) {
+            //POLLHUP/POLLERR/POLLNVAL with nothing left to read, the port has gone away
+            break;
         }
+        this->dispatchReceived();
     } while (!this->m_shutEmDown);
+#endif
+}
+
+size_t SerialPort::dispatchReceived()
+{
+    if (this->frameFormat() != SerialFraming::Format::NONE) {
+        return this->decodeReceiveBuffer();
+    }
+    std::unique_lock<std::mutex> receiveLock{this->m_receiveMutex};
+    //A second read picks up whatever did not fit before the end of the ring
+    if ((this->fillReceiveBuffer() > 0) && (this->m_receiveBufferCount < this->m_receiveBuffer.size())) {
+        this->fillReceiveBuffer();
+    }
+    receiveLock.unlock();
+    std::string received{};
+    //Nobody may be reading the queue, so make room rather than leave the port readable forever
+    this->transferReceiveBuffer(&received, true);
+    if (received.empty()) {
+        return 0;
+    }
+    this->dispatchLines(received);
+    return received.length();
+}
+
+//When the listener has to hand a line ended by a held back terminator to onLine. Without
+//an onLine callback, readers take the line themselves and nothing needs to wake for it
+std::chrono::steady_clock::time_point SerialPort::heldLineDeadline()
+{
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    if (!this->m_lineCallback) {
+        return std::chrono::steady_clock::time_point::max();
+    }
+    return this->m_stringBuilderQueue.heldTerminatorDeadline();
+}
+
+//Passes what was just received to onBytes and the lines it completed to onLine. Called
+//with nothing received when a held back terminator may be due to end a line by now
+void SerialPort::dispatchLines(const std::string &received)
+{
+    std::unique_lock<std::mutex> ioMutexLock{this->m_ioMutex};
+    if ((received.empty()) && (std::chrono::steady_clock::now() < this->m_stringBuilderQueue.heldTerminatorDeadline())) {
+        return;
+    }
+    SerialPortBytesCallback bytesCallback{this->m_bytesCallback};
+    SerialPortLineCallback lineCallback{this->m_lineCallback};
+    std::vector<std::string> lines{};
+    if (lineCallback) {
+        std::string line{};
+        while (this->extractTerminatedLine(&line, nullptr, nullptr)) {
+            lines.push_back(std::move(line));
+        }
+    }
+    ioMutexLock.unlock();
+    this->m_receivedCondition.notify_all();
+    if ((bytesCallback) && (!received.empty())) {
+        bytesCallback(received.data(), received.length());
+    }
+    for (auto &it : lines) {
+        lineCallback(it);
+    }
+}
+
+//Decodes frames straight out of the receive ring, without copying the received bytes
+//anywhere else first. onBytes and onFrame are called with the receive ring locked, so
+//they may write to the port but must not read from it
+size_t SerialPort::decodeReceiveBuffer()
+{
+    std::unique_lock<std::mutex> ioMutexLock{this->m_ioMutex};
+    SerialPortBytesCallback bytesCallback{this->m_bytesCallback};
+    SerialPortFrameCallback frameCallback{this->m_frameCallback};
+    ioMutexLock.unlock();
+    std::vector<std::string> queuedFrames{};
+    SerialPortFrameCallback queueFrame{[&queuedFrames](const char *frame, size_t length) {
+        queuedFrames.emplace_back(frame, length);
+    }};
+    size_t receivedBytes{0};
+    std::unique_lock<std::mutex> receiveLock{this->m_receiveMutex};
+    do {
+        //The frame format may have been turned off since dispatchReceived() checked it
+        if ((!this->m_frameDecoder) || ((this->m_receiveBufferCount == 0) && (this->fillReceiveBuffer() == 0))) {
+            break;
+        }
+        size_t contiguous{std::min(this->m_receiveBufferCount, this->m_receiveBuffer.size() - this->m_receiveBufferHead)};
+        const char *received{reinterpret_cast<const char *>(this->m_receiveBuffer.data() + this->m_receiveBufferHead)};
+        if (bytesCallback) {
+            bytesCallback(received, contiguous);
+        }
+        this->m_frameDecoder->feed(received, contiguous, (frameCallback ? frameCallback : queueFrame));
+        this->m_frameCount = this->m_frameDecoder->frameCount();
+        this->m_invalidFrameCount = this->m_frameDecoder->invalidFrameCount();
+        this->m_receiveBufferHead = (this->m_receiveBufferHead + contiguous) % this->m_receiveBuffer.size();
+        this->m_receiveBufferCount -= contiguous;
+        receivedBytes += contiguous;
+    } while (receivedBytes < this->m_receiveBuffer.size());
+    receiveLock.unlock();
+    if (queuedFrames.size() > 0) {
+        ioMutexLock.lock();
+        for (auto &it : queuedFrames) {
+            this->m_frameQueue.push_back(std::move(it));
+        }
+        //Nobody may be reading frames, so keep only the newest
+        while (this->m_frameQueue.size() > static_cast<size_t>(FRAME_QUEUE_MAX)) {
+            this->m_frameQueue.pop_front();
+        }
+        ioMutexLock.unlock();
+        this->m_receivedCondition.notify_all();
+    }
+    return receivedBytes;
 }
 
 void SerialPort::syncStringListener()
 {
+    if (this->m_isListening) {
+        return;
+    }
     std::unique_lock<std::mutex> ioMutexLock{this->m_ioMutex, std::defer_lock};
     long tempTimeout{this->m_timeout};
     long splitTimeout{this->m_timeout};
@@ -1292,8 +2629,15 @@ void SerialPort::syncStringListener()
         splitTimeout = (tempTimeout - eventTimer.totalMilliseconds());
         if (byteRead != 0) {
             ioMutexLock.lock();
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+            {
+                std::lock_guard<std::mutex> receiveLock{this->m_receiveMutex};
+                this->m_stringBuilderQueue.markArrival(this->receivedArrivalTime(this->m_receiveTiming->receiveBufferFilled - this->m_receiveBufferCount - 1));
+            }
+#endif
             addToStringBuilderQueue(byteRead);
             ioMutexLock.unlock();
+            this->transferReceiveBuffer();
             return;
         } else {
             break;
@@ -1304,16 +2648,41 @@ void SerialPort::syncStringListener()
 
 void SerialPort::addToStringBuilderQueue(unsigned char byte)
 {
-    if (this->m_stringBuilderQueue.size() >= SINGLE_MESSAGE_BUFFER_MAX) {
-        this->m_stringBuilderQueue = this->m_stringBuilderQueue.substr(1);
+    this->m_stringBuilderQueue.push_back(static_cast<char>(byte));
+}
+
+//Moves everything already sitting in the receive ring to the string builder queue,
+//so a whole burst is handled at once rather than one byte per listener pass
+void SerialPort::transferReceiveBuffer(std::string *transferred, bool discardOldest)
+{
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    std::lock_guard<std::mutex> receiveLock{this->m_receiveMutex};
+    if ((discardOldest) && (this->m_receiveBufferCount > this->m_stringBuilderQueue.freeSpace())) {
+        this->m_stringBuilderQueue.discard(this->m_receiveBufferCount - this->m_stringBuilderQueue.freeSpace());
+    }
+    //Otherwise bytes that do not fit stay in the ring until the queue is drained
+    while ((this->m_receiveBufferCount > 0) && (this->m_stringBuilderQueue.freeSpace() > 0)) {
+        size_t contiguous{std::min(this->m_receiveBufferCount, this->m_receiveBuffer.size() - this->m_receiveBufferHead)};
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+        contiguous = this->markTransferredArrival(contiguous);
+#endif
+        contiguous = this->m_stringBuilderQueue.append(reinterpret_cast<const char *>(this->m_receiveBuffer.data() + this->m_receiveBufferHead), contiguous);
+        if (transferred) {
+            transferred->append(reinterpret_cast<const char *>(this->m_receiveBuffer.data() + this->m_receiveBufferHead), contiguous);
+        }
+        this->m_receiveBufferHead = (this->m_receiveBufferHead + contiguous) % this->m_receiveBuffer.size();
+        this->m_receiveBufferCount -= contiguous;
     }
-    this->m_stringBuilderQueue += static_cast<char>(byte);
 }
 
 ssize_t SerialPort::available()
 {
-    this->syncStringListener();
-    return this->m_stringBuilderQueue.size();
+    std::unique_lock<std::mutex> receiveLock{this->m_receiveMutex};
+    this->fillReceiveBuffer();
+    size_t receiveBufferCount{this->m_receiveBufferCount};
+    receiveLock.unlock();
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    return this->m_stringBuilderQueue.size() + receiveBufferCount;
 }
 
 std::string SerialPort::peek()
@@ -1330,11 +2699,13 @@ char SerialPort::peekByte()
 
 unsigned char SerialPort::readByte()
 {
+    std::unique_lock<std::mutex> ioMutexLock{this->m_ioMutex};
     if (this->m_stringBuilderQueue.empty()) {
+        ioMutexLock.unlock();
         return this->rawRead();
     } else {
         unsigned char returnChar{static_cast<unsigned char>(this->m_stringBuilderQueue.front())};
-        this->m_stringBuilderQueue = this->m_stringBuilderQueue.substr(1);
+        this->m_stringBuilderQueue.pop_front();
         return returnChar;
     }
 }
@@ -1352,7 +2723,8 @@ void SerialPort::putBack(const char *str)
 
 void SerialPort::putBack(const std::string &str)
 {
-    this->m_stringBuilderQueue = str + this->m_stringBuilderQueue;
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    this->m_stringBuilderQueue.push_front(str);
 }
 
 BaudRate SerialPort::parseBaudRateFromRaw(const char *baudRate) { return parseBaudRateFromRaw(std::string{baudRate}); }
@@ -1581,11 +2953,21 @@ std::vector<std::string> SerialPort::availableSerialPorts()
         (void)e;
         return returnVector;
     }
-#else
-    for (auto &it : SerialPort::SERIAL_PORT_NAMES) {
-        if (SerialPort::fileExists(it)) {
-            returnVector.emplace_back(it);
+#elif defined(__linux__)
+    //The kernel lists every tty it has registered, so read that instead of probing each
+    //candidate name. Pseudo terminals are not registered there, so /dev/pts is read too
+    for (auto &directory : {std::make_pair("/sys/class/tty", "/dev/"), std::make_pair("/dev/pts", "/dev/pts/")}) {
+        DIR *directoryHandle{opendir(directory.first)};
+        if (!directoryHandle) {
+            continue;
         }
+        while (dirent *entry = readdir(directoryHandle)) {
+            std::string portName{directory.second + std::string{entry->d_name}};
+            if ((SerialPort::serialPortNameIndex(portName) != -1) && (SerialPort::fileExists(portName))) {
+                returnVector.emplace_back(portName);
+            }
+        }
+        closedir(directoryHandle);
     }
     std::set<std::string> uniques;
     for (auto &it : returnVector) {
@@ -1596,9 +2978,75 @@ std::vector<std::string> SerialPort::availableSerialPorts()
         realReturn.emplace_back(it);
     }
     return realReturn;
+#else
+    for (auto &it : SerialPort::serialPortNames()) {
+        if (SerialPort::fileExists(it)) {
+            returnVector.emplace_back(it);
+        }
+    }
+    return returnVector;
 #endif
 }
 
+const std::vector<std::string> &SerialPort::serialPortNames()
+{
+    static const std::vector<std::string> serialPortNames{SerialPort::generateSerialPortNames()};
+    return serialPortNames;
+}
+
+const SerialPortNameList SerialPort::SERIAL_PORT_NAMES{};
+
+SerialPortNameList::operator const std::vector<std::string> &() const
+{
+    return SerialPort::serialPortNames();
+}
+
+std::vector<std::string>::const_iterator SerialPortNameList::begin() const
+{
+    return SerialPort::serialPortNames().begin();
+}
+
+std::vector<std::string>::const_iterator SerialPortNameList::end() const
+{
+    return SerialPort::serialPortNames().end();
+}
+
+size_t SerialPortNameList::size() const
+{
+    return SerialPort::serialPortNames().size();
+}
+
+bool SerialPortNameList::empty() const
+{
+    return SerialPort::serialPortNames().empty();
+}
+
+const std::string &SerialPortNameList::operator[](size_t index) const
+{
+    return SerialPort::serialPortNames()[index];
+}
+
+const std::string &SerialPortNameList::at(size_t index) const
+{
+    return SerialPort::serialPortNames().at(index);
+}
+
+//Slot of name in serialPortNames(), or -1 if it is not a serial port name
+int SerialPort::serialPortNameIndex(const std::string &name)
+{
+    static const std::unordered_map<std::string, int> serialPortNameIndex{[]() {
+        std::unordered_map<std::string, int> nameIndex{};
+        const std::vector<std::string> &serialPortNames{SerialPort::serialPortNames()};
+        nameIndex.reserve(serialPortNames.size());
+        for (size_t i = 0; i < serialPortNames.size(); i++) {
+            nameIndex.emplace(serialPortNames[i], static_cast<int>(i));
+        }
+        return nameIndex;
+    }()};
+    auto found = serialPortNameIndex.find(name);
+    return ((found == serialPortNameIndex.end()) ? -1 : found->second);
+}
+
 std::vector<std::string> SerialPort::generateSerialPortNames()
 {
     std::vector<std::string> returnVector;
@@ -1613,21 +3061,9 @@ std::vector<std::string> SerialPort::generateSerialPortNames()
 bool SerialPort::isValidSerialPortName(const std::string &serialPortName)
 {
     #if defined(_WIN32) || defined(__CYGWIN__)
-        for (int i = 0; i < 256; i++) {
-            if (serialPortName == ("COM" + std::to_string(i))) {
-                return true;
-            }
-        }
-        return false; 
+        return ((serialPortName.find("COM") == 0) && (SerialPort::serialPortNameIndex(AVAILABLE_PORT_NAMES_BASE.front() + serialPortName.substr(3)) != -1));
     #else
-        for (auto &it : SerialPort::AVAILABLE_PORT_NAMES_BASE) {
-            for (int i = 0; i < 256; i++) {
-                if (serialPortName == (it + std::to_string(i))) {
-                    return true;
-                }
-            }
-        }
-        return false;
+        return (SerialPort::serialPortNameIndex(serialPortName) != -1);
     #endif
 }
 
@@ -31,13 +31,25 @@
 
 
 #include <string>
+#include <array>
 #include <set>
+#include <deque>
+#include <memory>
 #include <vector>
-
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#if !(defined(_WIN32) || defined(__CYGWIN__))
+    #include <termios.h>
+#endif
 
 
 #include "eventtimer.h"
 #include "ibytestream.h"
+#include "serialframing.h"
+#include "serialtiming.h"
+#include "threadconfiguration.h"
 
 
 enum class StopBits { ONE, TWO };
@@ -59,8 +71,138 @@ enum class BaudRate { BAUD50, BAUD75, BAUD110, BAUD134, BAUD150,
                       BAUD3000000, BAUD3500000, BAUD4000000 };
 #endif
 
+//A set of line terminators, searched for together in one pass. Where one terminator
+//starts another ("\r" and "\r\n") the longer one wins, so "\r\n" ends a line once
+class SerialLineTerminators
+{
+public:
+    SerialLineTerminators();
+    explicit SerialLineTerminators(const std::vector<std::string> &terminators);
+
+    bool empty() const;
+    size_t size() const;
+    const std::string &terminator(size_t index) const;
+    const std::vector<std::string> &terminators() const;
+    //Offset of the first byte in data that can start a terminator, or length if none can
+    size_t findStart(const char *data, size_t length) const;
+    //Indices of the terminators starting with firstByte, longest first
+    const std::vector<size_t> &startingWith(char firstByte) const;
+
+    //Up to this many distinct first bytes are each looked for with memchr
+    static const constexpr size_t MAXIMUM_SEPARATE_SEARCHES{4};
+
+private:
+    std::vector<std::string> m_terminators;
+    std::string m_firstBytes;
+    std::array<unsigned char, 256> m_firstByteSlot;
+    std::vector<std::vector<size_t>> m_startingWith;
+};
+
+//Fixed capacity byte ring that SerialPort assembles lines in. It remembers how far it
+//has already searched for a delimiter, so each received byte is only scanned once, and
+//searches for the first delimiter byte, or the first bytes of a set of terminators,
+//with memchr (vectorized by the C library) over the contiguous parts of the ring
+class SerialLineBuffer
+{
+public:
+    explicit SerialLineBuffer(size_t capacity);
+
+    size_t size() const;
+    size_t capacity() const;
+    size_t freeSpace() const;
+    bool empty() const;
+    void clear();
+    //Searches everything again, for when the terminators searched for have changed
+    void restartScan();
+
+    //Drops the oldest byte if the buffer is full
+    void push_back(char byte);
+    //Makes room for length more bytes by dropping the oldest ones
+    void discard(size_t length);
+    //Appends as much as fits, and returns how many bytes that was
+    size_t append(const char *data, size_t length);
+    //Moves up to length of the oldest bytes into destination, and returns how many that was
+    size_t read(char *destination, size_t length);
+    //Put back bytes are read next, the newest bytes are dropped if they no longer fit
+    void push_front(const std::string &str);
+    char front() const;
+    void pop_front();
+
+    //Moves everything before the next delimiter into line and drops the delimiter
+    bool extractUntil(const std::string &delimiter, std::string *line);
+    //Same for whichever of the terminators comes first, reporting which one it was. A
+    //"\r" with nothing after it yet is held back, since it may be the start of a "\r\n":
+    //it ends a line once the next byte shows it does not, or once nothing else has come
+    //for the hold time. A "\n" that arrives after that is dropped rather than read as an
+    //empty line
+    bool extractUntilAny(const SerialLineTerminators &terminators, std::string *line, size_t *terminatorIndex);
+    void setTerminatorHoldTime(std::chrono::steady_clock::duration holdTime);
+    std::chrono::steady_clock::duration terminatorHoldTime() const;
+    //When a held back terminator is due to end its line, or time_point::max() if none is held
+    std::chrono::steady_clock::time_point heldTerminatorDeadline() const;
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+    //Bytes appended from now on arrived at arrivalTime
+    void markArrival(SerialTimePoint arrivalTime);
+    //Also fills in when the first and last bytes of the line arrived
+    bool extractUntil(const std::string &delimiter, std::string *line, SerialLineTiming *timing);
+    bool extractUntilAny(const SerialLineTerminators &terminators, std::string *line, size_t *terminatorIndex, SerialLineTiming *timing);
+#endif
+
+    static const long DEFAULT_TERMINATOR_HOLD_MILLISECONDS;
+
+private:
+    std::vector<char> m_buffer;
+    size_t m_head;
+    size_t m_size;
+    size_t m_scannedLength;
+    std::string m_scannedDelimiter;
+    bool m_scannedForTerminators;
+    //Rest of a longer terminator that may still follow the last line's shorter one
+    std::string m_pendingTerminatorTail;
+    std::chrono::steady_clock::duration m_terminatorHoldTime;
+    std::chrono::steady_clock::time_point m_terminatorHeldSince;
+    //Always declared, but only allocated with TJLUTILS_SERIALPORT_TIMING, so the layout
+    //does not depend on the define
+    std::unique_ptr<SerialLineArrivals> m_arrivals;
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+    SerialTimePoint arrivalTimeOf(unsigned long long position) const;
+#endif
+
+    size_t physicalIndex(size_t offset) const;
+    size_t findDelimiter(const std::string &delimiter);
+    size_t findTerminator(const SerialLineTerminators &terminators, size_t *terminatorIndex);
+    bool skipPendingTerminatorTail();
+    bool matchesAt(size_t offset, const std::string &delimiter) const;
+    bool matchesPrefix(size_t offset, const std::string &str, size_t length) const;
+    void takeLine(size_t delimiterPosition, size_t delimiterLength, std::string *line);
+    void consume(size_t length);
+};
+
+//Called from the listener thread as data arrives, without any SerialPort lock held
+using SerialPortBytesCallback = std::function<void(const char *, size_t)>;
+using SerialPortLineCallback = std::function<void(const std::string &)>;
+//The frame is a view into the decoder, only valid until the callback returns
+using SerialPortFrameCallback = SerialFraming::FrameCallback;
+
+class SerialPortManager;
+
+//Stands in for the vector SerialPort::SERIAL_PORT_NAMES used to be, so existing callers
+//keep compiling. Nothing is built until it is first used (see SerialPort::serialPortNames())
+class SerialPortNameList
+{
+public:
+    operator const std::vector<std::string> &() const;
+    std::vector<std::string>::const_iterator begin() const;
+    std::vector<std::string>::const_iterator end() const;
+    size_t size() const;
+    bool empty() const;
+    const std::string &operator[](size_t index) const;
+    const std::string &at(size_t index) const;
+};
+
 class SerialPort : public IByteStream
 {
+    friend class SerialPortManager;
 public:
     SerialPort(const std::string &name);
     SerialPort(const std::string &name, BaudRate baudRate);
@@ -87,6 +229,7 @@ public:
     void putBack(char back);
 
     SerialPort(SerialPort &&other);
+    ~SerialPort();
     friend bool operator==(const SerialPort &lhs, const SerialPort &rhs);
 
     SerialPort &operator=(const SerialPort &rhs) = delete;
@@ -105,8 +248,45 @@ public:
     ssize_t writeLine(const char *str);
     ssize_t writeLine(char chr);
     ssize_t write(char byteToSend);
-    ssize_t write(const uint8_t *message, uint8_t messageLength);
+    ssize_t write(const uint8_t *message, size_t messageLength);
+    ssize_t write(const void *data, size_t length);
+    ssize_t write(const std::string &message);
+    //Binary safe read: returns the number of bytes copied into buffer (0 on timeout),
+    //where read() and readByte() cannot tell a NUL byte from no data
+    ssize_t read(uint8_t *buffer, size_t length);
     ssize_t available();
+
+    //Also report when the line arrived and was taken. Built without
+    //TJLUTILS_SERIALPORT_TIMING, timing is left zeroed and the snapshot is empty
+    std::string readLine(SerialLineTiming *timing);
+    std::string readUntil(const std::string &readUntil, SerialLineTiming *timing);
+    //readLine() that also reports the terminator that ended the line (empty on timeout)
+    std::string readTerminatedLine(std::string *terminator, SerialLineTiming *timing = nullptr);
+    SerialPortTimingSnapshot timingSnapshot();
+    void resetTiming();
+    static bool isTimingEnabled();
+
+    //With a frame format set, received bytes are decoded into frames instead of being
+    //queued for readLine(). Frames go to the onFrame callback, or are queued for readFrame()
+    void setFrameFormat(SerialFraming::Format frameFormat);
+    SerialFraming::Format frameFormat() const;
+    void onFrame(const SerialPortFrameCallback &callback);
+    bool readFrame(std::string *frame);
+    ssize_t writeFrame(const void *frame, size_t length);
+    ssize_t writeFrame(const std::string &frame);
+    size_t frameCount() const;
+    size_t invalidFrameCount() const;
+
+    void startListening();
+    void stopListening();
+    //Every received chunk is passed to onBytes. Once an onLine callback is set, complete
+    //lines go to it instead of being queued for readLine(). Pass nullptr to remove one
+    void onBytes(const SerialPortBytesCallback &callback);
+    void onLine(const SerialPortLineCallback &callback);
+    //Where and how the listener thread runs, applied by the next startListening(). Ports
+    //serviced by a SerialPortManager run on its reactor threads instead
+    void setListenerThreadConfiguration(const ThreadConfiguration &threadConfiguration);
+    ThreadConfiguration listenerThreadConfiguration() const;
 public:
     bool isDCDEnabled() const;
     bool isCTSEnabled() const;
@@ -120,6 +300,7 @@ public:
     void flushTX();
     void flushRXTX();
     void flushTXRX();
+    ssize_t flushOutputBuffer();
 
     void setPortName(const std::string &name);
     void setBaudRate(BaudRate baudRate);
@@ -127,8 +308,15 @@ public:
     void setParity(Parity parity);
     void setDataBits(DataBits dataBits);
     void setLineEnding(const std::string &lineEnding);
+    //Lines read end at any of these instead of lineEnding(), found in a single scan of
+    //the received bytes. writeLine() still appends lineEnding(). Empty to go back to it
+    void setLineTerminators(const std::vector<std::string> &terminators);
+    //How long (in milliseconds) a "\r" with nothing after it waits for the "\n" of a "\r\n"
+    //when both are line terminators, before it ends the line on its own
+    void setTerminatorHoldTime(long holdTime);
     void setTimeout(long timeout);
     void setRetryCount(long retryCount);
+    void setOutputBufferEnabled(bool outputBufferEnabled);
 
     std::string portName() const;
     int portNumber() const;
@@ -138,9 +326,12 @@ public:
     Parity parity() const;
     long timeout() const;
     std::string lineEnding() const;
+    std::vector<std::string> lineTerminators() const;
+    long terminatorHoldTime() const;
     long retryCount() const;
     bool isOpen() const;
     bool isListening() const;
+    bool outputBufferEnabled() const;
 
     std::string baudRateToString() const;
     std::string stopBitsToString() const;
@@ -150,7 +341,10 @@ public:
     static std::string stopBitsToString(StopBits stopBits);
     static std::string dataBitsToString(DataBits dataBits);
     static std::string parityToString(Parity parity);
-    static const std::vector<std::string> SERIAL_PORT_NAMES;
+    //Every name a SerialPort will accept, built the first time it is needed
+    static const std::vector<std::string> &serialPortNames();
+    //Deprecated, use serialPortNames()
+    static const SerialPortNameList SERIAL_PORT_NAMES;
 
     static BaudRate parseBaudRateFromRaw(const std::string &baudRate);
     static DataBits parseDataBitsFromRaw(const std::string &dataBits);
@@ -192,14 +386,13 @@ public:
 private:
     #if (defined(_WIN32) || defined(__CYGWIN__))
         static const char *DTR_RTS_ON_IDENTIFIER;
-        static const int constexpr NUMBER_OF_POSSIBLE_SERIAL_PORTS{256};
         static const char *SERIAL_PORT_REGISTRY_PATH;
-        HANDLE m_serialPort[NUMBER_OF_POSSIBLE_SERIAL_PORTS];
+        using PortDescriptor = HANDLE;
+        PortDescriptor m_serialPort;
     #else
-        static const int constexpr NUMBER_OF_POSSIBLE_SERIAL_PORTS{256*9};
-        int m_serialPort[NUMBER_OF_POSSIBLE_SERIAL_PORTS];
-        struct termios m_oldPortSettings[NUMBER_OF_POSSIBLE_SERIAL_PORTS];
-        struct termios m_newPortSettings;
+        using PortDescriptor = int;
+        PortDescriptor m_serialPort;
+        struct termios m_oldPortSettings;
     #endif
     std::string m_portName;
     int m_portNumber;
@@ -208,14 +401,40 @@ private:
     DataBits m_dataBits;
     Parity m_parity;
     std::string m_lineEnding;
+    std::unique_ptr<SerialLineTerminators> m_lineTerminators;
     long m_timeout;
     int m_retryCount;
     bool m_isOpen;
     int m_maximumReadSize;
     bool m_isListening;
     bool m_shutEmDown;
-    std::mutex m_ioMutex;
-    std::string m_stringBuilderQueue;
+    mutable std::mutex m_ioMutex;
+    SerialLineBuffer m_stringBuilderQueue;
+    std::mutex m_receiveMutex;
+    std::vector<unsigned char> m_receiveBuffer;
+    size_t m_receiveBufferHead;
+    size_t m_receiveBufferCount;
+    bool m_outputBufferEnabled;
+    std::string m_outputBuffer;
+    //Serializes writes and guards the output buffer
+    std::mutex m_writeMutex;
+    std::condition_variable m_receivedCondition;
+    SerialPortBytesCallback m_bytesCallback;
+    SerialPortLineCallback m_lineCallback;
+    int m_wakeDescriptor;
+    SerialPortManager *m_manager;
+    std::unique_ptr<SerialFraming::Decoder> m_frameDecoder;
+    //Copies of the decoder's format and counts, so they can be read (and frames written
+    //from onFrame) without taking the receive ring lock
+    std::atomic<SerialFraming::Format> m_frameFormat;
+    std::atomic<size_t> m_frameCount;
+    std::atomic<size_t> m_invalidFrameCount;
+    SerialPortFrameCallback m_frameCallback;
+    std::deque<std::string> m_frameQueue;
+    std::string m_encodedFrame;
+    std::unique_ptr<ThreadConfiguration> m_listenerThreadConfiguration;
+    //Null unless built with TJLUTILS_SERIALPORT_TIMING, like SerialLineBuffer::m_arrivals
+    std::unique_ptr<SerialPortReceiveTiming> m_receiveTiming;
 
     #if defined(__ANDROID__)
         std::thread *m_asyncFuture;
@@ -226,9 +445,25 @@ private:
     void asyncStringListener();
     void syncStringListener();
     void addToStringBuilderQueue(unsigned char byte);
+    void transferReceiveBuffer(std::string *transferred = nullptr, bool discardOldest = false);
+    size_t dispatchReceived();
+    size_t decodeReceiveBuffer();
+    bool extractLine(const std::string &delimiter, std::string *line, SerialLineTiming *timing);
+    bool extractTerminatedLine(std::string *line, SerialLineTiming *timing, std::string *terminator);
+    std::chrono::steady_clock::time_point heldLineDeadline();
+    void dispatchLines(const std::string &received);
+    std::string readLineUntil(const std::string *delimiter, SerialLineTiming *timing, std::string *terminator);
+#if defined(TJLUTILS_SERIALPORT_TIMING)
+    void recordLineTiming(const SerialLineTiming &lineTiming, SerialLineTiming *timing);
+    void recordArrival(size_t length);
+    size_t markTransferredArrival(size_t length);
+    SerialTimePoint receivedArrivalTime(unsigned long long position) const;
+#endif
+    void wakeListener();
 
     void startAsyncListen();
     void stopAsyncListen();
+    PortDescriptor releaseDescriptor();
 
 
     static bool isWhitespace(const std::string &stringToCheck);
@@ -241,16 +476,25 @@ private:
 
     static const long constexpr SERIAL_PORT_BUFFER_MAX{4096};
     static const long constexpr SINGLE_MESSAGE_BUFFER_MAX{4096};
+    static const long constexpr FRAME_QUEUE_MAX{256};
     static bool isAvailableSerialPort(const std::string &name);
     static std::pair<int, std::string> getPortNameAndNumber(const std::string &name);
     static std::vector<std::string> generateSerialPortNames();
+    static int serialPortNameIndex(const std::string &name);
 
     ssize_t writeCString(const char *str);
     ssize_t writeByte(char byteToSend);
-    ssize_t writeBufferedBytes(unsigned char *buffer, long bufferSize);
+    ssize_t writeBufferedBytes(const unsigned char *buffer, size_t bufferSize);
+    ssize_t writeSegments(const char *first, size_t firstLength, const char *second, size_t secondLength);
+    ssize_t bufferOrWrite(const char *first, size_t firstLength, const char *second, size_t secondLength);
+    ssize_t appendOutput(const char *first, size_t firstLength, const char *second, size_t secondLength);
+    ssize_t drainOutputBuffer();
     unsigned char timedRead();
+    bool waitForInput(std::chrono::steady_clock::duration timeout);
     unsigned char rawRead();
     unsigned char readByte();
+    ssize_t fillReceiveBuffer();
+    void clearReceiveBuffer();
 
     static int parseDataBits(DataBits dataBits);
     static int parseStopBits(StopBits stopBits);
@@ -0,0 +1,440 @@
+/***********************************************************************
+*    serialportmanager.cpp:                                            *
+*    SerialPortManager class, for servicing many serial ports at once  *
+*    Copyright (c) 2016 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the implementation of a SerialPortManager class   *
+*    It is used to service the reads, writes, and timeouts of many     *
+*    SerialPorts from a small fixed pool of epoll reactor threads,     *
+*    instead of starting a listener thread for every port              *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#if defined(__linux__)
+
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <unistd.h>
+#include <errno.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "serialportmanager.h"
+
+const constexpr unsigned int SerialPortManager::DEFAULT_REACTOR_COUNT;
+const constexpr size_t SerialPortManager::MAXIMUM_PENDING_WRITE_BYTES;
+const constexpr int SerialPortManager::MAXIMUM_EVENTS_PER_WAIT;
+
+SerialPortManager::SerialPortManager(unsigned int reactorCount) :
+    SerialPortManager{reactorCount, ThreadConfiguration{}}
+{
+
+}
+
+SerialPortManager::SerialPortManager(unsigned int reactorCount, const ThreadConfiguration &reactorThreadConfiguration) :
+    m_reactors{},
+    m_assignmentMutex{},
+    m_assignments{}
+{
+    if (reactorCount == 0) {
+        throw std::runtime_error("In SerialPortManager::SerialPortManager(unsigned int, const ThreadConfiguration &): At least one reactor is needed");
+    }
+    for (unsigned int i = 0; i < reactorCount; i++) {
+        std::unique_ptr<Reactor> reactor{new Reactor{}};
+        reactor->shutEmDown = false;
+        reactor->dispatching = nullptr;
+        reactor->pollDescriptor = epoll_create1(EPOLL_CLOEXEC);
+        reactor->wakeDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        //The eventfd is registered with a null pointer, which no managed port can have
+        epoll_event wakeEvent{};
+        wakeEvent.events = EPOLLIN;
+        wakeEvent.data.ptr = nullptr;
+        if ((reactor->pollDescriptor == -1) || (reactor->wakeDescriptor == -1) ||
+            (epoll_ctl(reactor->pollDescriptor, EPOLL_CTL_ADD, reactor->wakeDescriptor, &wakeEvent) == -1)) {
+            std::string errorString{strerror(errno)};
+            if (reactor->pollDescriptor != -1) {
+                close(reactor->pollDescriptor);
+            }
+            if (reactor->wakeDescriptor != -1) {
+                close(reactor->wakeDescriptor);
+            }
+            this->releaseReactors();
+            throw std::runtime_error("In SerialPortManager::SerialPortManager(unsigned int, const ThreadConfiguration &): Unable to set up reactor " + std::to_string(i) + ": " + errorString);
+        }
+        Reactor *startingReactor{reactor.get()};
+        try {
+#if defined(__ANDROID__)
+            reactor->asyncFuture = reactorThreadConfiguration.launchThread([this, startingReactor]() { this->reactorLoop(startingReactor); });
+#else
+            reactor->asyncFuture = reactorThreadConfiguration.launch([this, startingReactor]() { this->reactorLoop(startingReactor); });
+#endif
+        } catch (std::exception &e) {
+            close(reactor->pollDescriptor);
+            close(reactor->wakeDescriptor);
+            this->releaseReactors();
+            throw std::runtime_error("In SerialPortManager::SerialPortManager(unsigned int, const ThreadConfiguration &): Unable to start reactor " + std::to_string(i) + ": " + e.what());
+        }
+        this->m_reactors.push_back(std::move(reactor));
+    }
+}
+
+SerialPortManager::~SerialPortManager()
+{
+    for (auto &it : this->m_reactors) {
+        this->stopReactor(it.get());
+    }
+    std::vector<SerialPort *> remainingPorts{};
+    std::unique_lock<std::mutex> assignmentLock{this->m_assignmentMutex};
+    for (auto &it : this->m_assignments) {
+        remainingPorts.push_back(const_cast<SerialPort *>(it.first));
+    }
+    assignmentLock.unlock();
+    for (auto &it : remainingPorts) {
+        this->remove(*it);
+    }
+    for (auto &it : this->m_reactors) {
+        close(it->pollDescriptor);
+        close(it->wakeDescriptor);
+    }
+}
+
+//Only for a constructor that has failed, before any port can have been added
+void SerialPortManager::releaseReactors()
+{
+    for (auto &it : this->m_reactors) {
+        this->stopReactor(it.get());
+        close(it->pollDescriptor);
+        close(it->wakeDescriptor);
+    }
+}
+
+void SerialPortManager::stopReactor(Reactor *reactor)
+{
+    std::unique_lock<std::mutex> reactorLock{reactor->mutex};
+    reactor->shutEmDown = true;
+    reactorLock.unlock();
+    uint64_t wakeValue{1};
+    if (::write(reactor->wakeDescriptor, &wakeValue, sizeof(wakeValue)) < 0) {
+        //Already signalled
+    }
+#if defined(__ANDROID__)
+    if (reactor->asyncFuture) {
+        reactor->asyncFuture->join();
+        delete reactor->asyncFuture;
+        reactor->asyncFuture = nullptr;
+    }
+#else
+    if (reactor->asyncFuture.valid()) {
+        reactor->asyncFuture.wait();
+        reactor->asyncFuture = std::future<void>{};
+    }
+#endif
+}
+
+void SerialPortManager::add(SerialPort &serialPort)
+{
+    if (!serialPort.isOpen()) {
+        throw std::runtime_error("In SerialPortManager::add(SerialPort &): Serial port " + serialPort.portName() + " must be opened before it can be managed");
+    } else if (serialPort.m_manager) {
+        throw std::runtime_error("In SerialPortManager::add(SerialPort &): Serial port " + serialPort.portName() + " is already managed");
+    } else if (serialPort.isListening()) {
+        throw std::runtime_error("In SerialPortManager::add(SerialPort &): Serial port " + serialPort.portName() + " has its own listener, call stopListening() first");
+    }
+    std::lock_guard<std::mutex> assignmentLock{this->m_assignmentMutex};
+    //New ports go to whichever reactor currently has the fewest
+    Reactor *reactor{nullptr};
+    size_t fewestPorts{0};
+    for (auto &it : this->m_reactors) {
+        std::lock_guard<std::mutex> reactorLock{it->mutex};
+        if ((!reactor) || (it->ports.size() < fewestPorts)) {
+            reactor = it.get();
+            fewestPorts = it->ports.size();
+        }
+    }
+    std::lock_guard<std::mutex> reactorLock{reactor->mutex};
+    std::unique_ptr<ManagedPort> managedPort{new ManagedPort{}};
+    managedPort->serialPort = &serialPort;
+    managedPort->descriptor = serialPort.m_serialPort;
+    managedPort->writeInterest = false;
+    managedPort->timeout = 0;
+    managedPort->deadline = std::chrono::steady_clock::time_point::max();
+    managedPort->heldLineDeadline = std::chrono::steady_clock::time_point::max();
+    epoll_event portEvent{};
+    portEvent.events = EPOLLIN;
+    portEvent.data.ptr = &serialPort;
+    if (epoll_ctl(reactor->pollDescriptor, EPOLL_CTL_ADD, managedPort->descriptor, &portEvent) == -1) {
+        throw std::runtime_error("In SerialPortManager::add(SerialPort &): Unable to watch serial port " + serialPort.portName() + ": " + strerror(errno));
+    }
+    serialPort.m_manager = this;
+    serialPort.m_isListening = true;
+    reactor->ports.emplace(&serialPort, std::move(managedPort));
+    this->m_assignments.emplace(&serialPort, reactor);
+}
+
+//Anything still waiting to be written is handed to the port's own (blocking) write
+void SerialPortManager::remove(SerialPort &serialPort)
+{
+    Reactor *reactor{this->reactorFor(serialPort)};
+    if (!reactor) {
+        return;
+    }
+    std::unique_lock<std::mutex> reactorLock{reactor->mutex};
+    if (std::this_thread::get_id() != reactor->threadId) {
+        reactor->dispatchFinished.wait(reactorLock, [reactor, &serialPort]() {
+            return reactor->dispatching != &serialPort;
+        });
+    }
+    auto found = reactor->ports.find(&serialPort);
+    if (found == reactor->ports.end()) {
+        return;
+    }
+    std::string pendingWrite{std::move(found->second->pendingWrite)};
+    epoll_ctl(reactor->pollDescriptor, EPOLL_CTL_DEL, found->second->descriptor, nullptr);
+    reactor->ports.erase(found);
+    serialPort.m_manager = nullptr;
+    serialPort.m_isListening = false;
+    reactorLock.unlock();
+
+    std::unique_lock<std::mutex> assignmentLock{this->m_assignmentMutex};
+    this->m_assignments.erase(&serialPort);
+    assignmentLock.unlock();
+    if ((pendingWrite.length() > 0) && (serialPort.isOpen())) {
+        serialPort.writeSegments(pendingWrite.data(), pendingWrite.length(), nullptr, 0);
+    }
+}
+
+bool SerialPortManager::contains(const SerialPort &serialPort) const
+{
+    return (this->reactorFor(serialPort) != nullptr);
+}
+
+size_t SerialPortManager::size() const
+{
+    std::lock_guard<std::mutex> assignmentLock{this->m_assignmentMutex};
+    return this->m_assignments.size();
+}
+
+unsigned int SerialPortManager::reactorCount() const
+{
+    return static_cast<unsigned int>(this->m_reactors.size());
+}
+
+SerialPortManager::Reactor *SerialPortManager::reactorFor(const SerialPort &serialPort) const
+{
+    std::lock_guard<std::mutex> assignmentLock{this->m_assignmentMutex};
+    auto found = this->m_assignments.find(&serialPort);
+    return ((found == this->m_assignments.end()) ? nullptr : found->second);
+}
+
+ssize_t SerialPortManager::write(SerialPort &serialPort, const std::string &message)
+{
+    Reactor *reactor{this->reactorFor(serialPort)};
+    if (!reactor) {
+        throw std::runtime_error("In SerialPortManager::write(SerialPort &, const std::string &): Serial port " + serialPort.portName() + " is not managed by this SerialPortManager");
+    }
+    std::lock_guard<std::mutex> reactorLock{reactor->mutex};
+    ManagedPort *managedPort{reactor->ports.at(&serialPort).get()};
+    size_t acceptedBytes{std::min(message.length(), MAXIMUM_PENDING_WRITE_BYTES - managedPort->pendingWrite.length())};
+    managedPort->pendingWrite.append(message, 0, acceptedBytes);
+    this->flushPendingWrite(reactor, managedPort);
+    return acceptedBytes;
+}
+
+ssize_t SerialPortManager::writeLine(SerialPort &serialPort, const std::string &str)
+{
+    return this->write(serialPort, str + serialPort.lineEnding());
+}
+
+size_t SerialPortManager::pendingWriteBytes(const SerialPort &serialPort) const
+{
+    Reactor *reactor{this->reactorFor(serialPort)};
+    if (!reactor) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> reactorLock{reactor->mutex};
+    return reactor->ports.at(const_cast<SerialPort *>(&serialPort))->pendingWrite.length();
+}
+
+void SerialPortManager::setTimeout(SerialPort &serialPort, long timeout, const SerialPortTimeoutCallback &callback)
+{
+    Reactor *reactor{this->reactorFor(serialPort)};
+    if (!reactor) {
+        throw std::runtime_error("In SerialPortManager::setTimeout(SerialPort &, long, const SerialPortTimeoutCallback &): Serial port " + serialPort.portName() + " is not managed by this SerialPortManager");
+    }
+    std::unique_lock<std::mutex> reactorLock{reactor->mutex};
+    ManagedPort *managedPort{reactor->ports.at(&serialPort).get()};
+    managedPort->timeout = timeout;
+    managedPort->timeoutCallback = callback;
+    managedPort->deadline = (((timeout > 0) && (callback)) ? std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout) : std::chrono::steady_clock::time_point::max());
+    reactorLock.unlock();
+    //The reactor may be sleeping with a longer (or no) timeout
+    uint64_t wakeValue{1};
+    if (::write(reactor->wakeDescriptor, &wakeValue, sizeof(wakeValue)) < 0) {
+        //Already signalled
+    }
+}
+
+//Writes as much of the queue as the port takes without blocking, and only asks epoll
+//about writability while something is left over. The reactor mutex must be held
+void SerialPortManager::flushPendingWrite(Reactor *reactor, ManagedPort *managedPort)
+{
+    size_t writtenBytes{0};
+    while (writtenBytes < managedPort->pendingWrite.length()) {
+        ssize_t result{::write(managedPort->descriptor, managedPort->pendingWrite.data() + writtenBytes, managedPort->pendingWrite.length() - writtenBytes)};
+        if (result > 0) {
+            writtenBytes += result;
+        } else if ((result < 0) && (errno == EINTR)) {
+            continue;
+        } else if ((result < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            break;
+        } else {
+            //The port has failed, keeping the bytes would only spin the reactor on EPOLLOUT
+            writtenBytes = managedPort->pendingWrite.length();
+        }
+    }
+    managedPort->pendingWrite.erase(0, writtenBytes);
+    bool needsWriteInterest{managedPort->pendingWrite.length() > 0};
+    if (needsWriteInterest != managedPort->writeInterest) {
+        epoll_event portEvent{};
+        portEvent.events = (needsWriteInterest ? (EPOLLIN | EPOLLOUT) : EPOLLIN);
+        portEvent.data.ptr = managedPort->serialPort;
+        epoll_ctl(reactor->pollDescriptor, EPOLL_CTL_MOD, managedPort->descriptor, &portEvent);
+        managedPort->writeInterest = needsWriteInterest;
+    }
+}
+
+//Milliseconds until the earliest port timeout, or -1 to sleep until something happens.
+//The reactor mutex must be held
+int SerialPortManager::nextWaitTimeout(Reactor *reactor) const
+{
+    auto earliestDeadline = std::chrono::steady_clock::time_point::max();
+    for (auto &it : reactor->ports) {
+        earliestDeadline = std::min(earliestDeadline, std::min(it.second->deadline, it.second->heldLineDeadline));
+    }
+    if (earliestDeadline == std::chrono::steady_clock::time_point::max()) {
+        return -1;
+    }
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(earliestDeadline - std::chrono::steady_clock::now()).count();
+    //Round up, so the reactor does not wake just before the deadline and go straight back to sleep
+    return static_cast<int>(std::max<long long>(0, remaining + 1));
+}
+
+//Runs the port's receive path (or timeout callback) with the reactor mutex released, so
+//callbacks can write to or remove ports. remove() waits on dispatchFinished meanwhile
+size_t SerialPortManager::dispatch(Reactor *reactor, std::unique_lock<std::mutex> &reactorLock, SerialPort *serialPort, DispatchReason dispatchReason)
+{
+    auto found = reactor->ports.find(serialPort);
+    if (found == reactor->ports.end()) {
+        return 0;
+    }
+    ManagedPort *managedPort{found->second.get()};
+    SerialPortTimeoutCallback timeoutCallback{};
+    if (dispatchReason == DispatchReason::HeldLine) {
+        //Not input, so the receive timeout keeps running
+        managedPort->heldLineDeadline = std::chrono::steady_clock::time_point::max();
+    } else if ((managedPort->timeout > 0) && (managedPort->timeoutCallback)) {
+        managedPort->deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(managedPort->timeout);
+        timeoutCallback = managedPort->timeoutCallback;
+    } else if (dispatchReason == DispatchReason::TimedOut) {
+        //Turned off since the deadline was collected
+        return 0;
+    }
+    reactor->dispatching = serialPort;
+    reactorLock.unlock();
+    size_t receivedBytes{0};
+    if (dispatchReason == DispatchReason::TimedOut) {
+        timeoutCallback(*serialPort);
+    } else if (dispatchReason == DispatchReason::HeldLine) {
+        serialPort->dispatchLines(std::string{});
+    } else {
+        receivedBytes = serialPort->dispatchReceived();
+    }
+    //The port cannot be removed until dispatching is cleared, so it is still safe to ask
+    auto heldLineDeadline = serialPort->heldLineDeadline();
+    reactorLock.lock();
+    found = reactor->ports.find(serialPort);
+    if (found != reactor->ports.end()) {
+        found->second->heldLineDeadline = heldLineDeadline;
+    }
+    reactor->dispatching = nullptr;
+    reactor->dispatchFinished.notify_all();
+    return receivedBytes;
+}
+
+void SerialPortManager::reactorLoop(Reactor *reactor)
+{
+    epoll_event events[MAXIMUM_EVENTS_PER_WAIT];
+    std::unique_lock<std::mutex> reactorLock{reactor->mutex};
+    reactor->threadId = std::this_thread::get_id();
+    std::vector<SerialPort *> timedOutPorts{};
+    std::vector<SerialPort *> heldLinePorts{};
+    while (!reactor->shutEmDown) {
+        int waitTimeout{this->nextWaitTimeout(reactor)};
+        reactorLock.unlock();
+        int eventCount{epoll_wait(reactor->pollDescriptor, events, MAXIMUM_EVENTS_PER_WAIT, waitTimeout)};
+        reactorLock.lock();
+        if ((eventCount < 0) && (errno != EINTR)) {
+            break;
+        }
+        for (int i = 0; (i < eventCount) && (!reactor->shutEmDown); i++) {
+            SerialPort *serialPort{static_cast<SerialPort *>(events[i].data.ptr)};
+            if (!serialPort) {
+                uint64_t wakeValue{0};
+                if (::read(reactor->wakeDescriptor, &wakeValue, sizeof(wakeValue)) < 0) {
+                    //Nothing to drain
+                }
+                continue;
+            }
+            //A port removed while the mutex was released may still have an event in the batch
+            auto found = reactor->ports.find(serialPort);
+            if (found == reactor->ports.end()) {
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                this->flushPendingWrite(reactor, found->second.get());
+            }
+            int descriptor{found->second->descriptor};
+            if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) &&
+                (this->dispatch(reactor, reactorLock, serialPort, DispatchReason::Received) == 0) &&
+                (events[i].events & (EPOLLHUP | EPOLLERR)) &&
+                (reactor->ports.count(serialPort) > 0)) {
+                //The other end hung up and nothing is left to read, stop watching the port
+                //rather than have level triggered epoll report it forever
+                epoll_ctl(reactor->pollDescriptor, EPOLL_CTL_DEL, descriptor, nullptr);
+            }
+        }
+        auto now = std::chrono::steady_clock::now();
+        timedOutPorts.clear();
+        heldLinePorts.clear();
+        for (auto &it : reactor->ports) {
+            if (it.second->deadline <= now) {
+                timedOutPorts.push_back(it.first);
+            }
+            if (it.second->heldLineDeadline <= now) {
+                heldLinePorts.push_back(it.first);
+            }
+        }
+        for (auto &it : timedOutPorts) {
+            if (!reactor->shutEmDown) {
+                this->dispatch(reactor, reactorLock, it, DispatchReason::TimedOut);
+            }
+        }
+        for (auto &it : heldLinePorts) {
+            if (!reactor->shutEmDown) {
+                this->dispatch(reactor, reactorLock, it, DispatchReason::HeldLine);
+            }
+        }
+    }
+}
+
+#endif //defined(__linux__)
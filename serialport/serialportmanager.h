@@ -0,0 +1,125 @@
+/***********************************************************************
+*    serialportmanager.h:                                              *
+*    SerialPortManager class, for servicing many serial ports at once  *
+*    Copyright (c) 2016 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the declarations of a SerialPortManager class     *
+*    It is used to service the reads, writes, and timeouts of many     *
+*    SerialPorts from a small fixed pool of epoll reactor threads,     *
+*    instead of starting a listener thread for every port              *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#ifndef TJLUTILS_SERIALPORTMANAGER_H
+#define TJLUTILS_SERIALPORTMANAGER_H
+
+#if defined(__linux__)
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include <unordered_map>
+
+#include "serialport.h"
+
+using SerialPortTimeoutCallback = std::function<void(SerialPort &)>;
+
+//Managed ports deliver input through their onBytes()/onLine() callbacks (or readLine(),
+//which waits for the reactor like it does for startListening()), always on the thread
+//of the reactor the port was assigned to. Ports must stay open while they are managed;
+//closePort() removes a port from its manager
+class SerialPortManager
+{
+public:
+    explicit SerialPortManager(unsigned int reactorCount = DEFAULT_REACTOR_COUNT);
+    //Every reactor thread is started with reactorThreadConfiguration (see threadconfiguration.h)
+    SerialPortManager(unsigned int reactorCount, const ThreadConfiguration &reactorThreadConfiguration);
+    ~SerialPortManager();
+    SerialPortManager(const SerialPortManager &other) = delete;
+    SerialPortManager &operator=(const SerialPortManager &rhs) = delete;
+
+    void add(SerialPort &serialPort);
+    void remove(SerialPort &serialPort);
+    bool contains(const SerialPort &serialPort) const;
+    size_t size() const;
+    unsigned int reactorCount() const;
+
+    //Writes what the port accepts right away and queues the rest for the reactor to send
+    //when the port drains. Returns the number of bytes accepted, which is short only when
+    //more than MAXIMUM_PENDING_WRITE_BYTES are already waiting
+    ssize_t write(SerialPort &serialPort, const std::string &message);
+    ssize_t writeLine(SerialPort &serialPort, const std::string &str);
+    size_t pendingWriteBytes(const SerialPort &serialPort) const;
+
+    //Calls back on the reactor thread whenever the port has gone timeout milliseconds
+    //without receiving anything. A timeout of 0 (the default) turns it off
+    void setTimeout(SerialPort &serialPort, long timeout, const SerialPortTimeoutCallback &callback);
+
+    static const constexpr unsigned int DEFAULT_REACTOR_COUNT{1};
+    static const constexpr size_t MAXIMUM_PENDING_WRITE_BYTES{65536};
+
+private:
+    struct ManagedPort
+    {
+        SerialPort *serialPort;
+        int descriptor;
+        std::string pendingWrite;
+        bool writeInterest;
+        long timeout;
+        SerialPortTimeoutCallback timeoutCallback;
+        std::chrono::steady_clock::time_point deadline;
+        //When a "\r" held back in case it starts a "\r\n" is due to end its line
+        std::chrono::steady_clock::time_point heldLineDeadline;
+    };
+
+    enum class DispatchReason { Received, TimedOut, HeldLine };
+
+    struct Reactor
+    {
+        int pollDescriptor;
+        int wakeDescriptor;
+        bool shutEmDown;
+        std::mutex mutex;
+        std::condition_variable dispatchFinished;
+        SerialPort *dispatching;
+        std::thread::id threadId;
+        std::unordered_map<SerialPort *, std::unique_ptr<ManagedPort>> ports;
+    #if defined(__ANDROID__)
+        std::thread *asyncFuture;
+    #else
+        std::future<void> asyncFuture;
+    #endif
+    };
+
+    std::vector<std::unique_ptr<Reactor>> m_reactors;
+    mutable std::mutex m_assignmentMutex;
+    std::unordered_map<const SerialPort *, Reactor *> m_assignments;
+
+    static const constexpr int MAXIMUM_EVENTS_PER_WAIT{64};
+
+    Reactor *reactorFor(const SerialPort &serialPort) const;
+    void reactorLoop(Reactor *reactor);
+    int nextWaitTimeout(Reactor *reactor) const;
+    size_t dispatch(Reactor *reactor, std::unique_lock<std::mutex> &reactorLock, SerialPort *serialPort, DispatchReason dispatchReason);
+    void flushPendingWrite(Reactor *reactor, ManagedPort *managedPort);
+    void stopReactor(Reactor *reactor);
+    void releaseReactors();
+};
+
+#endif //defined(__linux__)
+
+#endif //TJLUTILS_SERIALPORTMANAGER_H
@@ -0,0 +1,202 @@
+/***********************************************************************
+*    serialportwatcher.cpp:                                            *
+*    SerialPortWatcher class, for tracking serial port hotplug events  *
+*    Copyright (c) 2016 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the implementation of a SerialPortWatcher class   *
+*    It is used to keep a cached list of the available serial ports,   *
+*    updated by inotify as devices are plugged in and removed, so it   *
+*    can be read from many threads without scanning the filesystem     *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#if defined(__linux__)
+
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+
+#include "serialport.h"
+#include "serialportwatcher.h"
+
+//Each watched directory, and the prefix that turns an entry in it into a port name
+const std::vector<std::pair<const char *, const char *>> SerialPortWatcher::WATCHED_DIRECTORIES{
+    {"/dev", "/dev/"},
+    {"/dev/pts", "/dev/pts/"},
+    {"/sys/class/tty", "/dev/"}
+};
+const constexpr size_t SerialPortWatcher::EVENT_BUFFER_SIZE;
+
+SerialPortWatcher::SerialPortWatcher() :
+    m_inotifyDescriptor{inotify_init1(IN_NONBLOCK | IN_CLOEXEC)},
+    m_wakeDescriptor{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)},
+    m_shutEmDown{false},
+    m_rescanCount{0},
+    m_snapshot{std::make_shared<const std::vector<std::string>>()},
+    m_watchedPrefixes{},
+    m_callbackMutex{},
+    m_addedCallback{nullptr},
+    m_removedCallback{nullptr}
+{
+    if ((this->m_inotifyDescriptor == -1) || (this->m_wakeDescriptor == -1)) {
+        std::string errorString{strerror(errno)};
+        if (this->m_inotifyDescriptor != -1) {
+            close(this->m_inotifyDescriptor);
+        }
+        if (this->m_wakeDescriptor != -1) {
+            close(this->m_wakeDescriptor);
+        }
+        throw std::runtime_error("In SerialPortWatcher::SerialPortWatcher(): Unable to set up inotify: " + errorString);
+    }
+    for (auto &it : WATCHED_DIRECTORIES) {
+        int watchDescriptor{inotify_add_watch(this->m_inotifyDescriptor, it.first, IN_CREATE | IN_DELETE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO)};
+        if (watchDescriptor != -1) {
+            this->m_watchedPrefixes.emplace(watchDescriptor, it.second);
+        }
+    }
+    //The first snapshot is taken before the watcher thread starts, so it is never empty
+    //just because the thread has not been scheduled yet
+    this->rescan();
+#if defined(__ANDROID__)
+    this->m_asyncFuture = new std::thread{&SerialPortWatcher::watchLoop, this};
+#else
+    this->m_asyncFuture = std::async(std::launch::async, &SerialPortWatcher::watchLoop, this);
+#endif
+}
+
+SerialPortWatcher::~SerialPortWatcher()
+{
+    this->m_shutEmDown = true;
+    uint64_t wakeValue{1};
+    if (::write(this->m_wakeDescriptor, &wakeValue, sizeof(wakeValue)) < 0) {
+        //Already signalled
+    }
+#if defined(__ANDROID__)
+    if (this->m_asyncFuture) {
+        this->m_asyncFuture->join();
+        delete this->m_asyncFuture;
+        this->m_asyncFuture = nullptr;
+    }
+#else
+    if (this->m_asyncFuture.valid()) {
+        this->m_asyncFuture.wait();
+    }
+#endif
+    close(this->m_inotifyDescriptor);
+    close(this->m_wakeDescriptor);
+}
+
+std::shared_ptr<const std::vector<std::string>> SerialPortWatcher::snapshot() const
+{
+    return std::atomic_load(&this->m_snapshot);
+}
+
+bool SerialPortWatcher::isAvailable(const std::string &name) const
+{
+    std::shared_ptr<const std::vector<std::string>> availablePorts{this->snapshot()};
+    return std::binary_search(availablePorts->begin(), availablePorts->end(), name);
+}
+
+void SerialPortWatcher::onAdded(const SerialPortWatcherCallback &callback)
+{
+    std::lock_guard<std::mutex> callbackLock{this->m_callbackMutex};
+    this->m_addedCallback = callback;
+}
+
+void SerialPortWatcher::onRemoved(const SerialPortWatcherCallback &callback)
+{
+    std::lock_guard<std::mutex> callbackLock{this->m_callbackMutex};
+    this->m_removedCallback = callback;
+}
+
+unsigned long SerialPortWatcher::rescanCount() const
+{
+    return this->m_rescanCount.load();
+}
+
+//Publishes a fresh snapshot, then reports the difference from the last one
+void SerialPortWatcher::rescan()
+{
+    std::vector<std::string> availablePorts{SerialPort::availableSerialPorts()};
+    std::sort(availablePorts.begin(), availablePorts.end());
+    std::shared_ptr<const std::vector<std::string>> newSnapshot{std::make_shared<const std::vector<std::string>>(std::move(availablePorts))};
+    std::shared_ptr<const std::vector<std::string>> oldSnapshot{std::atomic_exchange(&this->m_snapshot, newSnapshot)};
+    this->m_rescanCount++;
+
+    std::vector<std::string> addedPorts{};
+    std::vector<std::string> removedPorts{};
+    std::set_difference(newSnapshot->begin(), newSnapshot->end(), oldSnapshot->begin(), oldSnapshot->end(), std::back_inserter(addedPorts));
+    std::set_difference(oldSnapshot->begin(), oldSnapshot->end(), newSnapshot->begin(), newSnapshot->end(), std::back_inserter(removedPorts));
+    if ((addedPorts.empty()) && (removedPorts.empty())) {
+        return;
+    }
+    std::unique_lock<std::mutex> callbackLock{this->m_callbackMutex};
+    SerialPortWatcherCallback addedCallback{this->m_addedCallback};
+    SerialPortWatcherCallback removedCallback{this->m_removedCallback};
+    callbackLock.unlock();
+    for (auto &it : removedPorts) {
+        if (removedCallback) {
+            removedCallback(it);
+        }
+    }
+    for (auto &it : addedPorts) {
+        if (addedCallback) {
+            addedCallback(it);
+        }
+    }
+}
+
+//Sleeps until inotify reports a change, and only rescans when a changed entry could be a
+//serial port, so the rest of the churn in /dev is ignored. A burst of events (one device
+//usually produces several) is read in one go and costs a single rescan
+void SerialPortWatcher::watchLoop()
+{
+    alignas(inotify_event) char eventBuffer[EVENT_BUFFER_SIZE];
+    struct pollfd pollDescriptors[2];
+    pollDescriptors[0] = pollfd{this->m_inotifyDescriptor, POLLIN, 0};
+    pollDescriptors[1] = pollfd{this->m_wakeDescriptor, POLLIN, 0};
+    while (!this->m_shutEmDown) {
+        int pollResult{poll(pollDescriptors, 2, -1)};
+        if ((pollResult < 0) && (errno == EINTR)) {
+            continue;
+        } else if ((pollResult < 0) || (pollDescriptors[1].revents != 0) || (this->m_shutEmDown)) {
+            break;
+        }
+        bool needsRescan{false};
+        ssize_t readBytes{0};
+        while ((readBytes = ::read(this->m_inotifyDescriptor, eventBuffer, sizeof(eventBuffer))) > 0) {
+            for (char *position = eventBuffer; position < eventBuffer + readBytes; ) {
+                inotify_event *event{reinterpret_cast<inotify_event *>(position)};
+                position += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    needsRescan = true;
+                    continue;
+                }
+                auto found = this->m_watchedPrefixes.find(event->wd);
+                if ((found != this->m_watchedPrefixes.end()) && (event->len > 0) &&
+                    (SerialPort::isValidSerialPortName(found->second + std::string{event->name}))) {
+                    needsRescan = true;
+                }
+            }
+        }
+        if (needsRescan) {
+            this->rescan();
+        }
+    }
+}
+
+#endif //defined(__linux__)
@@ -0,0 +1,82 @@
+/***********************************************************************
+*    serialportwatcher.h:                                              *
+*    SerialPortWatcher class, for tracking serial port hotplug events  *
+*    Copyright (c) 2016 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the declarations of a SerialPortWatcher class     *
+*    It is used to keep a cached list of the available serial ports,   *
+*    updated by inotify as devices are plugged in and removed, so it   *
+*    can be read from many threads without scanning the filesystem     *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#ifndef TJLUTILS_SERIALPORTWATCHER_H
+#define TJLUTILS_SERIALPORTWATCHER_H
+
+#if defined(__linux__)
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <future>
+#include <functional>
+#include <unordered_map>
+
+using SerialPortWatcherCallback = std::function<void(const std::string &)>;
+
+//The snapshot is an immutable, sorted copy of SerialPort::availableSerialPorts(), swapped
+//out whole whenever a watched directory changes, so readers only pay for a pointer load.
+//Callbacks run on the watcher thread after the new snapshot has been published
+class SerialPortWatcher
+{
+public:
+    SerialPortWatcher();
+    ~SerialPortWatcher();
+    SerialPortWatcher(const SerialPortWatcher &other) = delete;
+    SerialPortWatcher &operator=(const SerialPortWatcher &rhs) = delete;
+
+    std::shared_ptr<const std::vector<std::string>> snapshot() const;
+    bool isAvailable(const std::string &name) const;
+    void onAdded(const SerialPortWatcherCallback &callback);
+    void onRemoved(const SerialPortWatcherCallback &callback);
+    unsigned long rescanCount() const;
+
+    static const std::vector<std::pair<const char *, const char *>> WATCHED_DIRECTORIES;
+
+private:
+    int m_inotifyDescriptor;
+    int m_wakeDescriptor;
+    std::atomic<bool> m_shutEmDown;
+    std::atomic<unsigned long> m_rescanCount;
+    std::shared_ptr<const std::vector<std::string>> m_snapshot;
+    std::unordered_map<int, std::string> m_watchedPrefixes;
+    std::mutex m_callbackMutex;
+    SerialPortWatcherCallback m_addedCallback;
+    SerialPortWatcherCallback m_removedCallback;
+
+    #if defined(__ANDROID__)
+        std::thread *m_asyncFuture;
+    #else
+        std::future<void> m_asyncFuture;
+    #endif
+
+    void watchLoop();
+    void rescan();
+
+    static const constexpr size_t EVENT_BUFFER_SIZE{4096};
+};
+
+#endif //defined(__linux__)
+
+#endif //TJLUTILS_SERIALPORTWATCHER_H
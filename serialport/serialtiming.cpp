@@ -0,0 +1,100 @@
+/***********************************************************************
+*    serialtiming.cpp:                                                 *
+*    Receive timestamps and latency histograms for SerialPort          *
+*    Copyright (c) 2017 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the implementation of the SerialLatencyHistogram  *
+*    class                                                             *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#include <algorithm>
+#include <limits>
+
+#include "serialtiming.h"
+
+const constexpr size_t SerialLatencyHistogram::BUCKET_COUNT;
+
+SerialLatencyHistogram::SerialLatencyHistogram() :
+    m_buckets{},
+    m_count{0},
+    m_totalNanoseconds{0},
+    m_minimumNanoseconds{std::numeric_limits<unsigned long long>::max()},
+    m_maximumNanoseconds{0}
+{
+
+}
+
+void SerialLatencyHistogram::record(std::chrono::nanoseconds duration)
+{
+    unsigned long long nanoseconds{(duration.count() > 0) ? static_cast<unsigned long long>(duration.count()) : 0};
+    size_t bucket{0};
+#if defined(__GNUC__)
+    bucket = static_cast<size_t>(63 - __builtin_clzll(nanoseconds | 1));
+#else
+    for (unsigned long long remaining = nanoseconds >> 1; remaining != 0; remaining >>= 1) {
+        bucket++;
+    }
+#endif
+    this->m_buckets[std::min(bucket, BUCKET_COUNT - 1)]++;
+    this->m_count++;
+    this->m_totalNanoseconds += nanoseconds;
+    this->m_minimumNanoseconds = std::min(this->m_minimumNanoseconds, nanoseconds);
+    this->m_maximumNanoseconds = std::max(this->m_maximumNanoseconds, nanoseconds);
+}
+
+void SerialLatencyHistogram::clear()
+{
+    *this = SerialLatencyHistogram{};
+}
+
+unsigned long long SerialLatencyHistogram::count() const
+{
+    return this->m_count;
+}
+
+std::chrono::nanoseconds SerialLatencyHistogram::minimum() const
+{
+    return std::chrono::nanoseconds{(this->m_count == 0) ? 0 : this->m_minimumNanoseconds};
+}
+
+std::chrono::nanoseconds SerialLatencyHistogram::maximum() const
+{
+    return std::chrono::nanoseconds{this->m_maximumNanoseconds};
+}
+
+std::chrono::nanoseconds SerialLatencyHistogram::mean() const
+{
+    return std::chrono::nanoseconds{(this->m_count == 0) ? 0 : (this->m_totalNanoseconds / this->m_count)};
+}
+
+std::chrono::nanoseconds SerialLatencyHistogram::percentile(double fraction) const
+{
+    if (this->m_count == 0) {
+        return std::chrono::nanoseconds{0};
+    }
+    fraction = std::min(std::max(fraction, 0.0), 1.0);
+    unsigned long long target{std::max(1ULL, static_cast<unsigned long long>(fraction * this->m_count + 0.5))};
+    unsigned long long seen{0};
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+        seen += this->m_buckets[bucket];
+        if (seen >= target) {
+            //The true value is never above the largest sample
+            return std::chrono::nanoseconds{std::min((2ULL << bucket) - 1, this->m_maximumNanoseconds)};
+        }
+    }
+    return this->maximum();
+}
+
+unsigned long long SerialLatencyHistogram::bucketCount(size_t bucket) const
+{
+    return ((bucket < BUCKET_COUNT) ? this->m_buckets[bucket] : 0);
+}
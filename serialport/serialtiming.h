@@ -0,0 +1,105 @@
+/***********************************************************************
+*    serialtiming.h:                                                   *
+*    Receive timestamps and latency histograms for SerialPort          *
+*    Copyright (c) 2017 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the declarations of the SerialLineTiming and      *
+*    SerialLatencyHistogram classes. SerialPort only records timing    *
+*    when it is built with TJLUTILS_SERIALPORT_TIMING defined (cmake   *
+*    -DSERIALPORT_TIMING=ON), otherwise none of it is compiled in. The *
+*    timing state lives behind a pointer, so the layout of SerialPort  *
+*    is the same whether the library was built with the define or not *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#ifndef TJLUTILS_SERIALTIMING_H
+#define TJLUTILS_SERIALTIMING_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <utility>
+
+using SerialTimePoint = std::chrono::steady_clock::time_point;
+
+//When the first and last bytes of a line were read from the port, and when the
+//consumer took the line. Bytes read by the same read() call share one timestamp
+struct SerialLineTiming
+{
+    SerialTimePoint firstByteTime;
+    SerialTimePoint lastByteTime;
+    SerialTimePoint consumedTime;
+
+    std::chrono::nanoseconds assemblyTime() const { return this->lastByteTime - this->firstByteTime; }
+    std::chrono::nanoseconds timeInBuffer() const { return this->consumedTime - this->lastByteTime; }
+};
+
+//Counts durations in power of two buckets of nanoseconds (bucket n holds [2^n, 2^(n+1))),
+//so recording is a handful of instructions and a copy is a fixed size snapshot
+class SerialLatencyHistogram
+{
+public:
+    SerialLatencyHistogram();
+
+    void record(std::chrono::nanoseconds duration);
+    void clear();
+
+    unsigned long long count() const;
+    std::chrono::nanoseconds minimum() const;
+    std::chrono::nanoseconds maximum() const;
+    std::chrono::nanoseconds mean() const;
+    //Upper edge of the bucket holding the given fraction (0.0 to 1.0) of the samples
+    std::chrono::nanoseconds percentile(double fraction) const;
+    unsigned long long bucketCount(size_t bucket) const;
+
+    static const constexpr size_t BUCKET_COUNT{40};
+
+private:
+    std::array<unsigned long long, BUCKET_COUNT> m_buckets;
+    unsigned long long m_count;
+    unsigned long long m_totalNanoseconds;
+    unsigned long long m_minimumNanoseconds;
+    unsigned long long m_maximumNanoseconds;
+};
+
+//interByteGap is the idle time before each burst, measured between successive reads
+//that returned data. lineAssembly runs from the first to the last byte of a line, and
+//timeInBuffer from the last byte of a line to the consumer taking it
+struct SerialPortTimingSnapshot
+{
+    SerialLatencyHistogram interByteGap;
+    SerialLatencyHistogram lineAssembly;
+    SerialLatencyHistogram timeInBuffer;
+};
+
+//Arrival marks a SerialLineBuffer keeps when timing is compiled in: (stream position of
+//the first byte, arrival time), oldest first, and how many bytes went in and came out
+struct SerialLineArrivals
+{
+    std::deque<std::pair<unsigned long long, SerialTimePoint>> marks;
+    unsigned long long appendedTotal;
+    unsigned long long consumedTotal;
+};
+
+//Timing state a SerialPort keeps when timing is compiled in. Arrival marks for the
+//receive ring are by position in the stream of bytes read so far
+struct SerialPortReceiveTiming
+{
+    std::deque<std::pair<unsigned long long, SerialTimePoint>> arrivals;
+    unsigned long long receiveBufferFilled;
+    SerialTimePoint lastArrivalTime;
+    SerialLatencyHistogram interByteGap;
+    SerialLatencyHistogram lineAssembly;
+    SerialLatencyHistogram timeInBuffer;
+};
+
+#endif //TJLUTILS_SERIALTIMING_H
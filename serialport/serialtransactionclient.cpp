@@ -0,0 +1,436 @@
+/***********************************************************************
+*    serialtransactionclient.cpp:                                      *
+*    SerialTransactionClient, for pipelined commands over a SerialPort *
+*    Copyright (c) 2017 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the implementation of a SerialTransactionClient   *
+*    class                                                             *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "serialtransactionclient.h"
+
+const constexpr size_t SerialTransactionClient::DEFAULT_MAXIMUM_IN_FLIGHT;
+const constexpr long SerialTransactionClient::DEFAULT_TIMEOUT;
+const constexpr size_t SerialTransactionClient::LATENCY_SAMPLE_COUNT;
+
+SerialTransactionClient::SerialTransactionClient(std::shared_ptr<SerialPort> serialPort) :
+    SerialTransactionClient{serialPort, SerialTransactionClient::DEFAULT_MAXIMUM_IN_FLIGHT, nullptr}
+{
+
+}
+
+SerialTransactionClient::SerialTransactionClient(std::shared_ptr<SerialPort> serialPort, size_t maximumInFlight) :
+    SerialTransactionClient{serialPort, maximumInFlight, nullptr}
+{
+
+}
+
+SerialTransactionClient::SerialTransactionClient(std::shared_ptr<SerialPort> serialPort, size_t maximumInFlight, const TagExtractor &tagExtractor) :
+    SerialTransactionClient{serialPort, maximumInFlight, tagExtractor, ThreadConfiguration{}}
+{
+
+}
+
+SerialTransactionClient::SerialTransactionClient(std::shared_ptr<SerialPort> serialPort, size_t maximumInFlight, const TagExtractor &tagExtractor, const ThreadConfiguration &deadlineThreadConfiguration) :
+    m_serialPort{serialPort},
+    m_tagExtractor{tagExtractor},
+    m_inFlightTransactions{},
+    m_waitingTransactions{},
+    m_nextDeadline{steady_time_point::max()},
+    m_nextTransactionId{1},
+    m_maximumInFlight{(maximumInFlight == 0) ? 1 : maximumInFlight},
+    m_defaultTimeout{SerialTransactionClient::DEFAULT_TIMEOUT},
+    m_completedCount{0},
+    m_timedOutCount{0},
+    m_unmatchedReplyCount{0},
+    m_latencySamples{},
+    m_nextLatencySample{0},
+    m_shutEmDown{false}
+{
+    if (!this->m_serialPort) {
+        throw std::runtime_error("In SerialTransactionClient::SerialTransactionClient(std::shared_ptr<SerialPort>, size_t, const TagExtractor &, const ThreadConfiguration &): SerialPort is a nullptr");
+    }
+    if (!this->m_serialPort->isOpen()) {
+        throw std::runtime_error("In SerialTransactionClient::SerialTransactionClient(std::shared_ptr<SerialPort>, size_t, const TagExtractor &, const ThreadConfiguration &): Serial port " + this->m_serialPort->portName() + " is not open");
+    }
+    this->m_latencySamples.reserve(SerialTransactionClient::LATENCY_SAMPLE_COUNT);
+    try {
+#if defined(__ANDROID__)
+        this->m_asyncFuture = deadlineThreadConfiguration.launchThread([this]() { this->asyncDeadlineListener(); });
+#else
+        this->m_asyncFuture = deadlineThreadConfiguration.launch([this]() { this->asyncDeadlineListener(); });
+#endif
+    } catch (std::exception &e) {
+        throw std::runtime_error("In SerialTransactionClient::SerialTransactionClient(std::shared_ptr<SerialPort>, size_t, const TagExtractor &, const ThreadConfiguration &): Unable to start the deadline thread: " + std::string{e.what()});
+    }
+    this->m_serialPort->onLine([this](const std::string &reply) { this->handleReply(reply); });
+    if (!this->m_serialPort->isListening()) {
+        this->m_serialPort->startListening();
+    }
+}
+
+SerialTransactionClient::~SerialTransactionClient()
+{
+    //Stopping the port listening waits out a reply that is still being handled
+    this->m_serialPort->onLine(nullptr);
+    this->m_serialPort->stopListening();
+    {
+        std::lock_guard<std::mutex> transactionLock{this->m_transactionMutex};
+        this->m_shutEmDown = true;
+    }
+    this->m_deadlineCondition.notify_all();
+#if defined(__ANDROID__)
+    if (this->m_asyncFuture) {
+        this->m_asyncFuture->join();
+        delete this->m_asyncFuture;
+    }
+#else
+    if (this->m_asyncFuture.valid()) {
+        this->m_asyncFuture.wait();
+    }
+#endif
+    this->cancelAll();
+}
+
+std::future<SerialTransactionResult> SerialTransactionClient::transact(const std::string &command)
+{
+    return this->transact(command, this->defaultTimeout());
+}
+
+std::future<SerialTransactionResult> SerialTransactionClient::transact(const std::string &command, std::chrono::milliseconds timeout)
+{
+    std::shared_ptr<std::promise<SerialTransactionResult>> promise{std::make_shared<std::promise<SerialTransactionResult>>()};
+    std::future<SerialTransactionResult> returnFuture{promise->get_future()};
+    this->transact(command, timeout, [promise](const SerialTransactionResult &result) { promise->set_value(result); });
+    return returnFuture;
+}
+
+void SerialTransactionClient::transact(const std::string &command, const CompletionCallback &callback)
+{
+    return this->transact(command, this->defaultTimeout(), callback);
+}
+
+void SerialTransactionClient::transact(const std::string &command, std::chrono::milliseconds timeout, const CompletionCallback &callback)
+{
+    PendingTransaction pendingTransaction{};
+    if ((this->m_tagExtractor) && (!this->m_tagExtractor(command, &pendingTransaction.tag))) {
+        throw std::runtime_error("In SerialTransactionClient::transact(const std::string &, std::chrono::milliseconds, const CompletionCallback &): No tag could be extracted from command \"" + command + "\"");
+    }
+    pendingTransaction.command = command;
+    pendingTransaction.sentTime = std::chrono::steady_clock::now();
+    pendingTransaction.deadline = pendingTransaction.sentTime + timeout;
+    pendingTransaction.callback = callback;
+
+    std::vector<Completion> completions{};
+    bool deadlineMovedUp{false};
+    {
+        std::lock_guard<std::mutex> transactionLock{this->m_transactionMutex};
+        pendingTransaction.transactionId = this->m_nextTransactionId++;
+        if (pendingTransaction.deadline < this->m_nextDeadline) {
+            this->m_nextDeadline = pendingTransaction.deadline;
+            deadlineMovedUp = true;
+        }
+        this->m_waitingTransactions.push_back(std::move(pendingTransaction));
+    }
+    if (deadlineMovedUp) {
+        this->m_deadlineCondition.notify_one();
+    }
+    this->sendWaitingTransactions(&completions);
+    runCompletions(&completions);
+}
+
+void SerialTransactionClient::cancelAll()
+{
+    std::vector<Completion> completions{};
+    {
+        std::lock_guard<std::mutex> transactionLock{this->m_transactionMutex};
+        for (auto &it : this->m_inFlightTransactions) {
+            completions.emplace_back(it.callback, SerialTransactionResult{it.transactionId, SerialTransactionStatus::Cancelled, it.command, "", elapsedSince(it.sentTime)});
+        }
+        for (auto &it : this->m_waitingTransactions) {
+            completions.emplace_back(it.callback, SerialTransactionResult{it.transactionId, SerialTransactionStatus::Cancelled, it.command, "", elapsedSince(it.sentTime)});
+        }
+        this->m_inFlightTransactions.clear();
+        this->m_waitingTransactions.clear();
+    }
+    runCompletions(&completions);
+}
+
+//Runs on the port's listener thread, for every line the device sends. Commands waiting
+//for the window to open are left to the deadline thread, so the listener never writes
+void SerialTransactionClient::handleReply(const std::string &reply)
+{
+    std::vector<Completion> completions{};
+    bool windowOpened{false};
+    {
+        std::lock_guard<std::mutex> transactionLock{this->m_transactionMutex};
+        auto found = this->m_inFlightTransactions.end();
+        if (!this->m_tagExtractor) {
+            found = this->m_inFlightTransactions.begin();
+        } else {
+            std::string tag{};
+            if (this->m_tagExtractor(reply, &tag)) {
+                found = std::find_if(this->m_inFlightTransactions.begin(), this->m_inFlightTransactions.end(), [&tag](const PendingTransaction &pendingTransaction) {
+                    return pendingTransaction.tag == tag;
+                });
+            }
+        }
+        if (found == this->m_inFlightTransactions.end()) {
+            this->m_unmatchedReplyCount++;
+            return;
+        }
+        std::chrono::microseconds latency{elapsedSince(found->sentTime)};
+        this->m_completedCount++;
+        this->recordLatency(latency);
+        completions.emplace_back(found->callback, SerialTransactionResult{found->transactionId, SerialTransactionStatus::Success, found->command, reply, latency});
+        this->m_inFlightTransactions.erase(found);
+        windowOpened = this->canSendWaitingTransaction();
+    }
+    if (windowOpened) {
+        this->m_deadlineCondition.notify_one();
+    }
+    runCompletions(&completions);
+}
+
+//Moves every command that fits in the window in flight with m_transactionMutex held, then
+//writes them with it released, so a slow port holds up neither replies nor new transactions.
+//Must be called without m_transactionMutex held. With the port's output buffer enabled,
+//the commands go out in a single write
+void SerialTransactionClient::sendWaitingTransactions(std::vector<Completion> *completions)
+{
+    std::lock_guard<std::mutex> sendLock{this->m_sendMutex};
+    std::vector<std::pair<unsigned long long, std::string>> commands{};
+    bool writeFailed{false};
+    do {
+        commands.clear();
+        writeFailed = false;
+        {
+            std::lock_guard<std::mutex> transactionLock{this->m_transactionMutex};
+            while (this->canSendWaitingTransaction()) {
+                PendingTransaction pendingTransaction{std::move(this->m_waitingTransactions.front())};
+                this->m_waitingTransactions.pop_front();
+                steady_time_point now{std::chrono::steady_clock::now()};
+                if (now >= pendingTransaction.deadline) {
+                    this->m_timedOutCount++;
+                    completions->emplace_back(pendingTransaction.callback, SerialTransactionResult{pendingTransaction.transactionId, SerialTransactionStatus::TimedOut, pendingTransaction.command, "", elapsedSince(pendingTransaction.sentTime)});
+                    continue;
+                }
+                pendingTransaction.sentTime = now;
+                //The command goes in flight before it is written, so a fast reply always finds it
+                commands.emplace_back(pendingTransaction.transactionId, pendingTransaction.command);
+                this->m_inFlightTransactions.push_back(std::move(pendingTransaction));
+            }
+        }
+        for (auto &it : commands) {
+            if (this->m_serialPort->writeLine(it.second) > 0) {
+                continue;
+            }
+            writeFailed = true;
+            std::lock_guard<std::mutex> transactionLock{this->m_transactionMutex};
+            auto found = std::find_if(this->m_inFlightTransactions.begin(), this->m_inFlightTransactions.end(), [&it](const PendingTransaction &pendingTransaction) {
+                return pendingTransaction.transactionId == it.first;
+            });
+            if (found != this->m_inFlightTransactions.end()) {
+                completions->emplace_back(found->callback, SerialTransactionResult{found->transactionId, SerialTransactionStatus::WriteFailed, found->command, "", elapsedSince(found->sentTime)});
+                this->m_inFlightTransactions.erase(found);
+            }
+        }
+        //A failed write frees its place in the window for the next waiting command
+    } while (writeFailed);
+    if ((!commands.empty()) && (this->m_serialPort->outputBufferEnabled())) {
+        this->m_serialPort->flushOutputBuffer();
+    }
+}
+
+bool SerialTransactionClient::canSendWaitingTransaction() const
+{
+    //Caller must hold m_transactionMutex
+    return ((!this->m_waitingTransactions.empty()) && (this->m_inFlightTransactions.size() < this->m_maximumInFlight));
+}
+
+void SerialTransactionClient::expireTransactions(steady_time_point now, std::vector<Completion> *completions)
+{
+    //Caller must hold m_transactionMutex
+    for (auto *transactions : {&this->m_inFlightTransactions, &this->m_waitingTransactions}) {
+        for (auto iter = transactions->begin(); iter != transactions->end(); ) {
+            if (now >= iter->deadline) {
+                this->m_timedOutCount++;
+                completions->emplace_back(iter->callback, SerialTransactionResult{iter->transactionId, SerialTransactionStatus::TimedOut, iter->command, "", elapsedSince(iter->sentTime)});
+                iter = transactions->erase(iter);
+            } else {
+                iter++;
+            }
+        }
+    }
+}
+
+SerialTransactionClient::steady_time_point SerialTransactionClient::earliestDeadline() const
+{
+    //Caller must hold m_transactionMutex
+    steady_time_point earliest{steady_time_point::max()};
+    for (auto *transactions : {&this->m_inFlightTransactions, &this->m_waitingTransactions}) {
+        for (auto &it : *transactions) {
+            earliest = std::min(earliest, it.deadline);
+        }
+    }
+    return earliest;
+}
+
+//Sleeps until the earliest transaction deadline, until a new transaction brings that
+//deadline forward, or until a reply opens the window for a waiting command, so timeouts
+//fire on time without polling and commands are sent from here, not the listener thread.
+//A new transaction lowers m_nextDeadline under m_transactionMutex, so the wakeup is seen
+//even when transact() has already sent the command by the time this thread runs
+void SerialTransactionClient::asyncDeadlineListener()
+{
+    std::vector<Completion> completions{};
+    std::unique_lock<std::mutex> transactionLock{this->m_transactionMutex};
+    steady_time_point waitedDeadline{};
+    auto wakeUp = [this, &waitedDeadline]() {
+        return ((this->m_shutEmDown) || (this->canSendWaitingTransaction()) || (this->m_nextDeadline < waitedDeadline));
+    };
+    while (!this->m_shutEmDown) {
+        this->m_nextDeadline = this->earliestDeadline();
+        waitedDeadline = this->m_nextDeadline;
+        if (waitedDeadline == steady_time_point::max()) {
+            this->m_deadlineCondition.wait(transactionLock, wakeUp);
+        } else {
+            this->m_deadlineCondition.wait_until(transactionLock, waitedDeadline, wakeUp);
+        }
+        this->expireTransactions(std::chrono::steady_clock::now(), &completions);
+        transactionLock.unlock();
+        this->sendWaitingTransactions(&completions);
+        runCompletions(&completions);
+        transactionLock.lock();
+    }
+}
+
+void SerialTransactionClient::recordLatency(std::chrono::microseconds latency)
+{
+    //Caller must hold m_transactionMutex
+    if (this->m_latencySamples.size() < SerialTransactionClient::LATENCY_SAMPLE_COUNT) {
+        this->m_latencySamples.push_back(latency);
+    } else {
+        this->m_latencySamples[this->m_nextLatencySample] = latency;
+    }
+    this->m_nextLatencySample = (this->m_nextLatencySample + 1) % SerialTransactionClient::LATENCY_SAMPLE_COUNT;
+}
+
+SerialTransactionLatency SerialTransactionClient::latencyStatistics() const
+{
+    std::vector<std::chrono::microseconds> samples{};
+    {
+        std::lock_guard<std::mutex> transactionLock{this->m_transactionMutex};
+        samples = this->m_latencySamples;
+    }
+    SerialTransactionLatency returnLatency{0, std::chrono::microseconds{0}, std::chrono::microseconds{0}, std::chrono::microseconds{0}, std::chrono::microseconds{0}, std::chrono::microseconds{0}};
+    if (samples.empty()) {
+        return returnLatency;
+    }
+    std::sort(samples.begin(), samples.end());
+    std::chrono::microseconds total{0};
+    for (auto &it : samples) {
+        total += it;
+    }
+    returnLatency.sampleCount = samples.size();
+    returnLatency.minimum = samples.front();
+    returnLatency.mean = total / static_cast<long long>(samples.size());
+    returnLatency.p50 = samples[(samples.size() - 1) / 2];
+    returnLatency.p99 = samples[((samples.size() - 1) * 99) / 100];
+    returnLatency.maximum = samples.back();
+    return returnLatency;
+}
+
+void SerialTransactionClient::resetLatencyStatistics()
+{
+    std::lock_guard<std::mutex> transactionLock{this->m_transactionMutex};
+    this->m_latencySamples.clear();
+    this->m_nextLatencySample = 0;
+}
+
+void SerialTransactionClient::runCompletions(std::vector<Completion> *completions)
+{
+    for (auto &it : *completions) {
+        if (it.first) {
+            it.first(it.second);
+        }
+    }
+    completions->clear();
+}
+
+std::chrono::microseconds SerialTransactionClient::elapsedSince(steady_time_point timePoint)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - timePoint);
+}
+
+size_t SerialTransactionClient::maximumInFlight() const
+{
+    std::lock_guard<std::mutex> transactionLock{this->m_transactionMutex};
+    return this->m_maximumInFlight;
+}
+
+void SerialTransactionClient::setMaximumInFlight(size_t maximumInFlight)
+{
+    std::vector<Completion> completions{};
+    {
+        std::lock_guard<std::mutex> transactionLock{this->m_transactionMutex};
+        this->m_maximumInFlight = ((maximumInFlight == 0) ? 1 : maximumInFlight);
+    }
+    this->sendWaitingTransactions(&completions);
+    runCompletions(&completions);
+}
+
+std::chrono::milliseconds SerialTransactionClient::defaultTimeout() const
+{
+    std::lock_guard<std::mutex> transactionLock{this->m_transactionMutex};
+    return this->m_defaultTimeout;
+}
+
+void SerialTransactionClient::setDefaultTimeout(std::chrono::milliseconds timeout)
+{
+    std::lock_guard<std::mutex> transactionLock{this->m_transactionMutex};
+    this->m_defaultTimeout = timeout;
+}
+
+size_t SerialTransactionClient::inFlight() const
+{
+    std::lock_guard<std::mutex> transactionLock{this->m_transactionMutex};
+    return this->m_inFlightTransactions.size();
+}
+
+size_t SerialTransactionClient::queued() const
+{
+    std::lock_guard<std::mutex> transactionLock{this->m_transactionMutex};
+    return this->m_waitingTransactions.size();
+}
+
+unsigned long long SerialTransactionClient::completedCount() const
+{
+    std::lock_guard<std::mutex> transactionLock{this->m_transactionMutex};
+    return this->m_completedCount;
+}
+
+unsigned long long SerialTransactionClient::timedOutCount() const
+{
+    std::lock_guard<std::mutex> transactionLock{this->m_transactionMutex};
+    return this->m_timedOutCount;
+}
+
+unsigned long long SerialTransactionClient::unmatchedReplyCount() const
+{
+    std::lock_guard<std::mutex> transactionLock{this->m_transactionMutex};
+    return this->m_unmatchedReplyCount;
+}
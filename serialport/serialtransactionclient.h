@@ -0,0 +1,177 @@
+/***********************************************************************
+*    serialtransactionclient.h:                                        *
+*    SerialTransactionClient, for pipelined commands over a SerialPort *
+*    Copyright (c) 2017 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the declarations of a SerialTransactionClient     *
+*    class. It queues command lines for a line-in, line-out device,    *
+*    keeps up to a configurable number of commands outstanding at      *
+*    once, and matches each reply line to its command, either in the  *
+*    order the commands were sent or by a tag that a user supplied     *
+*    extractor pulls out of both the command and the reply.            *
+*    Transactions complete through a callback or a std::future, or    *
+*    time out when their own deadline passes                           *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#ifndef TJLUTILS_SERIALTRANSACTIONCLIENT_H
+#define TJLUTILS_SERIALTRANSACTIONCLIENT_H
+
+#include <memory>
+#include <string>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <chrono>
+
+#include "serialport.h"
+
+enum class SerialTransactionStatus { Success, TimedOut, Cancelled, WriteFailed };
+
+class SerialTransactionResult
+{
+public:
+    SerialTransactionResult(unsigned long long transactionId, SerialTransactionStatus status, const std::string &command, const std::string &reply, std::chrono::microseconds latency) :
+        m_transactionId{transactionId},
+        m_status{status},
+        m_command{command},
+        m_reply{reply},
+        m_latency{latency}
+    {
+
+    }
+
+    unsigned long long transactionId() const { return this->m_transactionId; }
+    SerialTransactionStatus status() const { return this->m_status; }
+    std::string command() const { return this->m_command; }
+    std::string reply() const { return this->m_reply; }
+    std::chrono::microseconds latency() const { return this->m_latency; }
+
+private:
+    unsigned long long m_transactionId;
+    SerialTransactionStatus m_status;
+    std::string m_command;
+    std::string m_reply;
+    std::chrono::microseconds m_latency;
+};
+
+//Latency (command written to reply received) of the most recent successful transactions
+struct SerialTransactionLatency
+{
+    size_t sampleCount;
+    std::chrono::microseconds minimum;
+    std::chrono::microseconds mean;
+    std::chrono::microseconds p50;
+    std::chrono::microseconds p99;
+    std::chrono::microseconds maximum;
+};
+
+//The client takes over the onLine() callback of the port and listens on it for as long as
+//the client exists; destroying the client stops the port listening. In order matching
+//assumes the device answers every command, so a command that times out is taken to have
+//no reply coming. Devices that can drop or delay replies should be matched by tag instead.
+//The thread that times transactions out and writes waiting commands is started with
+//deadlineThreadConfiguration, if given
+class SerialTransactionClient
+{
+public:
+    using CompletionCallback = std::function<void(const SerialTransactionResult &)>;
+    //Returns false if the line carries no tag. Called on commands and on reply lines
+    using TagExtractor = std::function<bool(const std::string &line, std::string *tag)>;
+
+    SerialTransactionClient(std::shared_ptr<SerialPort> serialPort);
+    SerialTransactionClient(std::shared_ptr<SerialPort> serialPort, size_t maximumInFlight);
+    SerialTransactionClient(std::shared_ptr<SerialPort> serialPort, size_t maximumInFlight, const TagExtractor &tagExtractor);
+    SerialTransactionClient(std::shared_ptr<SerialPort> serialPort, size_t maximumInFlight, const TagExtractor &tagExtractor, const ThreadConfiguration &deadlineThreadConfiguration);
+    ~SerialTransactionClient();
+
+    SerialTransactionClient(const SerialTransactionClient &other) = delete;
+    SerialTransactionClient &operator=(const SerialTransactionClient &rhs) = delete;
+
+    std::future<SerialTransactionResult> transact(const std::string &command);
+    std::future<SerialTransactionResult> transact(const std::string &command, std::chrono::milliseconds timeout);
+    void transact(const std::string &command, const CompletionCallback &callback);
+    void transact(const std::string &command, std::chrono::milliseconds timeout, const CompletionCallback &callback);
+
+    void cancelAll();
+
+    size_t maximumInFlight() const;
+    void setMaximumInFlight(size_t maximumInFlight);
+    std::chrono::milliseconds defaultTimeout() const;
+    void setDefaultTimeout(std::chrono::milliseconds timeout);
+
+    size_t inFlight() const;
+    size_t queued() const;
+    unsigned long long completedCount() const;
+    unsigned long long timedOutCount() const;
+    unsigned long long unmatchedReplyCount() const;
+    SerialTransactionLatency latencyStatistics() const;
+    void resetLatencyStatistics();
+
+    static const constexpr size_t DEFAULT_MAXIMUM_IN_FLIGHT{4};
+    static const constexpr long DEFAULT_TIMEOUT{1000};
+    static const constexpr size_t LATENCY_SAMPLE_COUNT{1024};
+
+private:
+    using steady_time_point = std::chrono::steady_clock::time_point;
+    using Completion = std::pair<CompletionCallback, SerialTransactionResult>;
+
+    struct PendingTransaction
+    {
+        unsigned long long transactionId;
+        std::string command;
+        std::string tag;
+        steady_time_point sentTime;
+        steady_time_point deadline;
+        CompletionCallback callback;
+    };
+
+    std::shared_ptr<SerialPort> m_serialPort;
+    TagExtractor m_tagExtractor;
+    std::deque<PendingTransaction> m_inFlightTransactions;
+    std::deque<PendingTransaction> m_waitingTransactions;
+    mutable std::mutex m_transactionMutex;
+    //Held while commands go in flight and are written, so they reach the port in that order
+    std::mutex m_sendMutex;
+    std::condition_variable m_deadlineCondition;
+    steady_time_point m_nextDeadline;
+    unsigned long long m_nextTransactionId;
+    size_t m_maximumInFlight;
+    std::chrono::milliseconds m_defaultTimeout;
+    unsigned long long m_completedCount;
+    unsigned long long m_timedOutCount;
+    unsigned long long m_unmatchedReplyCount;
+    std::vector<std::chrono::microseconds> m_latencySamples;
+    size_t m_nextLatencySample;
+    bool m_shutEmDown;
+
+#if defined(__ANDROID__)
+    std::thread *m_asyncFuture;
+#else
+    std::future<void> m_asyncFuture;
+#endif
+
+    void asyncDeadlineListener();
+    void handleReply(const std::string &reply);
+    void sendWaitingTransactions(std::vector<Completion> *completions);
+    bool canSendWaitingTransaction() const;
+    void expireTransactions(steady_time_point now, std::vector<Completion> *completions);
+    void recordLatency(std::chrono::microseconds latency);
+    steady_time_point earliestDeadline() const;
+
+    static void runCompletions(std::vector<Completion> *completions);
+    static std::chrono::microseconds elapsedSince(steady_time_point timePoint);
+};
+
+#endif //TJLUTILS_SERIALTRANSACTIONCLIENT_H
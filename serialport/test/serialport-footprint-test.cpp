@@ -0,0 +1,54 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <pty.h>
+#include <unistd.h>
+#include <serialport.h>
+
+//Checks that a SerialPort holds only the state for the one port it opens, and that
+//moving an open port hands over the descriptor and leaves the original closed. Timing
+//state is kept behind a pointer, so the budget is the same with and without
+//TJLUTILS_SERIALPORT_TIMING, as is the size, whichever way the library was built
+static const size_t SERIAL_PORT_SIZE_BUDGET{1024};
+
+int main()
+{
+    bool passed{sizeof(SerialPort) <= SERIAL_PORT_SIZE_BUDGET};
+
+    int masterDescriptor{-1};
+    int slaveDescriptor{-1};
+    char slaveName[256];
+    if (openpty(&masterDescriptor, &slaveDescriptor, slaveName, nullptr, nullptr) != 0) {
+        std::cout << "FAILED: unable to open a pseudo terminal" << std::endl;
+        return 1;
+    }
+    std::vector<SerialPort> serialPorts{};
+    serialPorts.reserve(1);
+    SerialPort original{slaveName, BaudRate::BAUD115200};
+    original.openPort();
+    original.startListening();
+    serialPorts.push_back(std::move(original));
+    passed &= (!original.isOpen()) && (serialPorts[0].isOpen()) && (!serialPorts[0].isListening());
+
+    std::string request{"MOVED\r\n"};
+    if (::write(masterDescriptor, request.data(), request.length()) != static_cast<ssize_t>(request.length())) {
+        passed = false;
+    }
+    passed &= (serialPorts[0].readLine() == "MOVED");
+    serialPorts[0].writeLine("REPLY");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    char replyBuffer[64];
+    ssize_t replyLength{::read(masterDescriptor, replyBuffer, sizeof(replyBuffer))};
+    passed &= (replyLength > 0) && (std::string(replyBuffer, replyLength) == "REPLY\r\n");
+    serialPorts[0].closePort();
+    close(slaveDescriptor);
+    close(masterDescriptor);
+
+    std::cout << "sizeof_serial_port=" << sizeof(SerialPort)
+              << " budget=" << SERIAL_PORT_SIZE_BUDGET
+              << " bytes_for_256_ports=" << (sizeof(SerialPort) * 256)
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return (passed ? 0 : 1);
+}
@@ -0,0 +1,212 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <cstring>
+#include <pty.h>
+#include <unistd.h>
+#include <serialport.h>
+#include <serialframing.h>
+
+//Round trips COBS and SLIP frames through the decoder in random sized chunks (including
+//corrupted frames, which must be counted and skipped), then measures decode throughput
+//in memory and frames per second through a SerialPort on a pseudo terminal
+static const int NUMBER_OF_FRAMES{100000};
+static const size_t FRAME_LENGTH{64};
+
+std::string randomFrame(std::mt19937 &randomEngine, size_t length)
+{
+    std::string frame(length, '\0');
+    for (auto &it : frame) {
+        //Plenty of the bytes each format has to stuff
+        static const char SPECIAL_BYTES[]{'\x00', '\xC0', '\xDB', '\xDC', '\xDD'};
+        it = ((randomEngine() % 4) == 0) ? SPECIAL_BYTES[randomEngine() % 5] : static_cast<char>(randomEngine());
+    }
+    return frame;
+}
+
+bool checkRoundTrips(SerialFraming::Format format, const std::string &name)
+{
+    std::mt19937 randomEngine{99};
+    std::vector<std::string> frames{"", std::string(1, '\0'), std::string(253, 'a'), std::string(254, 'a'), std::string(255, 'a'), std::string(600, '\0')};
+    for (int i = 0; i < 200; i++) {
+        frames.push_back(randomFrame(randomEngine, randomEngine() % 700));
+    }
+    std::string stream{};
+    std::vector<std::string> expectedFrames{};
+    size_t expectedInvalid{0};
+    for (size_t i = 0; i < frames.size(); i++) {
+        if ((format == SerialFraming::Format::SLIP) && (frames[i].empty())) {
+            continue;
+        }
+        std::string encoded{SerialFraming::encode(format, frames[i])};
+        if ((i % 10) == 5) {
+            //Send a broken frame first: a COBS block cut short by a delimiter, a bad SLIP escape
+            if (format == SerialFraming::Format::COBS) {
+                stream += std::string{"\x05\x41\x42\x00", 4};
+            } else {
+                stream += std::string{"\xC0\xDB\x01"};
+            }
+            expectedInvalid++;
+        }
+        stream += encoded;
+        expectedFrames.push_back(frames[i]);
+    }
+    //A frame longer than the decoder allows is dropped too
+    stream += SerialFraming::encode(format, std::string(SerialFraming::DEFAULT_MAXIMUM_FRAME_LENGTH + 1, 'x'));
+    expectedInvalid++;
+    stream += SerialFraming::encode(format, "after");
+    expectedFrames.push_back("after");
+
+    SerialFraming::Decoder decoder{format};
+    std::vector<std::string> decodedFrames{};
+    for (size_t position = 0; position < stream.length(); ) {
+        size_t chunk{std::min<size_t>(1 + randomEngine() % 97, stream.length() - position)};
+        decoder.feed(stream.data() + position, chunk, [&decodedFrames](const char *frame, size_t length) {
+            decodedFrames.emplace_back(frame, length);
+        });
+        position += chunk;
+    }
+    bool passed{(decodedFrames == expectedFrames) && (decoder.invalidFrameCount() == expectedInvalid) && (decoder.frameCount() == expectedFrames.size())};
+    if (!passed) {
+        std::cout << "FAILED: " << name << " decoded " << decodedFrames.size() << "/" << expectedFrames.size()
+                  << " frames with " << decoder.invalidFrameCount() << "/" << expectedInvalid << " invalid" << std::endl;
+    }
+    return passed;
+}
+
+void measureDecode(SerialFraming::Format format, const std::string &name)
+{
+    std::mt19937 randomEngine{5};
+    std::string stream{};
+    for (int i = 0; i < 1000; i++) {
+        SerialFraming::encode(format, randomFrame(randomEngine, FRAME_LENGTH).data(), FRAME_LENGTH, &stream);
+    }
+    SerialFraming::Decoder decoder{format};
+    size_t decodedBytes{0};
+    SerialFraming::FrameCallback countFrame{[&decodedBytes](const char *, size_t length) {
+        decodedBytes += length;
+    }};
+    auto startTime = std::chrono::steady_clock::now();
+    for (int round = 0; round < 200; round++) {
+        for (size_t position = 0; position < stream.length(); position += 4096) {
+            decoder.feed(stream.data() + position, std::min<size_t>(4096, stream.length() - position), countFrame);
+        }
+    }
+    double elapsedSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()};
+    std::cout << "decode=" << name
+              << " mb_per_s=" << (decodedBytes / elapsedSeconds / 1e6)
+              << " frames_per_s=" << (decoder.frameCount() / elapsedSeconds) << std::endl;
+}
+
+bool measurePseudoTerminal(SerialFraming::Format format, const std::string &name, bool listening)
+{
+    int masterDescriptor{-1};
+    int slaveDescriptor{-1};
+    char slaveName[256];
+    if (openpty(&masterDescriptor, &slaveDescriptor, slaveName, nullptr, nullptr) != 0) {
+        std::cout << "FAILED: unable to open a pseudo terminal" << std::endl;
+        return false;
+    }
+    SerialPort serialPort{slaveName, BaudRate::BAUD4000000};
+    serialPort.openPort();
+    serialPort.setFrameFormat(format);
+    std::atomic<long> framesReceived{0};
+    std::atomic<bool> framesIntact{true};
+    std::mt19937 randomEngine{11};
+    std::string expectedFrame{randomFrame(randomEngine, FRAME_LENGTH)};
+    if (listening) {
+        serialPort.onFrame([&](const char *frame, size_t length) {
+            if ((length != expectedFrame.length()) || (memcmp(frame, expectedFrame.data(), length) != 0)) {
+                framesIntact = false;
+            }
+            framesReceived++;
+        });
+        serialPort.startListening();
+    }
+    std::string encoded{};
+    for (int i = 0; i < 64; i++) {
+        SerialFraming::encode(format, expectedFrame.data(), expectedFrame.length(), &encoded);
+    }
+    auto startTime = std::chrono::steady_clock::now();
+    std::thread writer{[&]() {
+        for (int i = 0; i < NUMBER_OF_FRAMES / 64; i++) {
+            for (size_t written = 0; written < encoded.length(); ) {
+                ssize_t result{::write(masterDescriptor, encoded.data() + written, encoded.length() - written)};
+                if (result > 0) {
+                    written += result;
+                }
+            }
+        }
+    }};
+    long expectedFrames{(NUMBER_OF_FRAMES / 64) * 64};
+    if (listening) {
+        while ((framesReceived < expectedFrames) && (std::chrono::steady_clock::now() - startTime < std::chrono::seconds(20))) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    } else {
+        std::string frame{};
+        while ((framesReceived < expectedFrames) && (serialPort.readFrame(&frame))) {
+            if (frame != expectedFrame) {
+                framesIntact = false;
+            }
+            framesReceived++;
+        }
+    }
+    double elapsedSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()};
+    writer.join();
+    bool passed{(framesReceived == expectedFrames) && (framesIntact) && (serialPort.invalidFrameCount() == 0)};
+    std::cout << "pty=" << name << (listening ? "_on_frame" : "_read_frame")
+              << " frames=" << framesReceived.load()
+              << " frames_per_s=" << (framesReceived / elapsedSeconds)
+              << " mb_per_s=" << (framesReceived * FRAME_LENGTH / elapsedSeconds / 1e6)
+              << " intact=" << (passed ? "true" : "false") << std::endl;
+    serialPort.closePort();
+    close(slaveDescriptor);
+    close(masterDescriptor);
+    return passed;
+}
+
+bool checkBinaryRead()
+{
+    int masterDescriptor{-1};
+    int slaveDescriptor{-1};
+    char slaveName[256];
+    if (openpty(&masterDescriptor, &slaveDescriptor, slaveName, nullptr, nullptr) != 0) {
+        return false;
+    }
+    SerialPort serialPort{slaveName, BaudRate::BAUD115200};
+    serialPort.openPort();
+    std::string binary{"\x00\x01\x00\xFF\x00", 5};
+    bool passed{::write(masterDescriptor, binary.data(), binary.length()) == static_cast<ssize_t>(binary.length())};
+    uint8_t readBuffer[16];
+    ssize_t readBytes{0};
+    std::string received{};
+    while ((received.length() < binary.length()) && ((readBytes = serialPort.read(readBuffer, sizeof(readBuffer))) > 0)) {
+        received.append(reinterpret_cast<char *>(readBuffer), readBytes);
+    }
+    passed &= (received == binary) && (serialPort.read(readBuffer, sizeof(readBuffer)) == 0);
+    serialPort.closePort();
+    close(slaveDescriptor);
+    close(masterDescriptor);
+    std::cout << "binary_read=" << (passed ? "pass" : "fail") << std::endl;
+    return passed;
+}
+
+int main()
+{
+    bool passed{checkRoundTrips(SerialFraming::Format::COBS, "cobs")};
+    passed &= checkRoundTrips(SerialFraming::Format::SLIP, "slip");
+    std::cout << "round_trips=" << (passed ? "pass" : "fail") << std::endl;
+    passed &= checkBinaryRead();
+    measureDecode(SerialFraming::Format::COBS, "cobs");
+    measureDecode(SerialFraming::Format::SLIP, "slip");
+    for (bool listening : {true, false}) {
+        passed &= measurePseudoTerminal(SerialFraming::Format::COBS, "cobs", listening);
+        passed &= measurePseudoTerminal(SerialFraming::Format::SLIP, "slip", listening);
+    }
+    return (passed ? 0 : 1);
+}
@@ -0,0 +1,119 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <termios.h>
+#include <serialport.h>
+
+//Feeds received bursts into the previous std::string queue (append, find, substr)
+//and into SerialLineBuffer, checks both produce the same lines and reports the
+//line assembly throughput for a few line lengths and line endings
+static const size_t BYTES_PER_RUN{32UL * 1024UL * 1024UL};
+static const size_t BURST_SIZE{256};
+static const size_t QUEUE_CAPACITY{4096};
+
+class LegacyLineQueue
+{
+public:
+    void append(const char *data, size_t length)
+    {
+        for (size_t i = 0; i < length; i++) {
+            if (this->m_queue.size() >= QUEUE_CAPACITY) {
+                this->m_queue = this->m_queue.substr(1);
+            }
+            this->m_queue += data[i];
+        }
+    }
+
+    bool extractUntil(const std::string &delimiter, std::string *line)
+    {
+        if (this->m_queue.find(delimiter) == std::string::npos) {
+            return false;
+        }
+        *line = this->m_queue.substr(0, this->m_queue.find(delimiter));
+        this->m_queue = this->m_queue.substr(this->m_queue.find(delimiter) + delimiter.length());
+        return true;
+    }
+
+private:
+    std::string m_queue;
+};
+
+std::string makeStream(size_t lineLength, const std::string &lineEnding)
+{
+    std::mt19937 randomEngine{static_cast<unsigned int>(lineLength)};
+    std::string stream{};
+    stream.reserve(BYTES_PER_RUN + lineLength + lineEnding.length());
+    while (stream.length() < BYTES_PER_RUN) {
+        for (size_t i = 0; i < lineLength; i++) {
+            stream += static_cast<char>('A' + (randomEngine() % 26));
+        }
+        stream += lineEnding;
+    }
+    return stream;
+}
+
+template <typename LineQueue>
+double measure(LineQueue *lineQueue, const std::string &stream, const std::string &lineEnding, std::vector<std::string> *lines)
+{
+    std::string line{};
+    auto startTime = std::chrono::steady_clock::now();
+    for (size_t offset = 0; offset < stream.length(); offset += BURST_SIZE) {
+        lineQueue->append(stream.data() + offset, std::min(BURST_SIZE, stream.length() - offset));
+        while (lineQueue->extractUntil(lineEnding, &line)) {
+            lines->push_back(std::move(line));
+        }
+    }
+    double elapsedSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()};
+    return static_cast<double>(stream.length()) / elapsedSeconds / 1e6;
+}
+
+bool checkEdgeCases()
+{
+    SerialLineBuffer lineBuffer{8};
+    std::string line{};
+    lineBuffer.append("ab\r", 3);
+    bool passed{!lineBuffer.extractUntil("\r\n", &line)};
+    //Only five bytes fit, the rest is left to the caller
+    passed &= (lineBuffer.append("\ncdefgh", 7) == 5);
+    passed &= (lineBuffer.extractUntil("\r\n", &line) && (line == "ab"));
+    lineBuffer.append("ghij", 4);
+    //Full, so the oldest byte ('c') is dropped
+    lineBuffer.push_back('k');
+    lineBuffer.push_front("xy");
+    passed &= (lineBuffer.size() == 8) && (lineBuffer.front() == 'x');
+    lineBuffer.pop_front();
+    passed &= (lineBuffer.extractUntil("f", &line) && (line == "yde"));
+    passed &= (lineBuffer.extractUntil("hi", &line) && (line == "g"));
+    passed &= (!lineBuffer.extractUntil("k", &line)) && (lineBuffer.empty());
+    return passed;
+}
+
+int main()
+{
+    bool allPassed{checkEdgeCases()};
+    std::cout << "edge_cases=" << (allPassed ? "pass" : "fail") << std::endl;
+    for (const std::string lineEnding : {"\n", "\r\n"}) {
+        for (size_t lineLength : {16, 80, 1000}) {
+            std::string stream{makeStream(lineLength, lineEnding)};
+            std::vector<std::string> legacyLines{};
+            std::vector<std::string> lines{};
+            legacyLines.reserve(stream.length() / lineLength);
+            lines.reserve(stream.length() / lineLength);
+            LegacyLineQueue legacyQueue{};
+            SerialLineBuffer lineBuffer{QUEUE_CAPACITY};
+            double legacyMegabytesPerSecond{measure(&legacyQueue, stream, lineEnding, &legacyLines)};
+            double megabytesPerSecond{measure(&lineBuffer, stream, lineEnding, &lines)};
+            bool linesMatch{lines == legacyLines};
+            allPassed &= linesMatch;
+            std::cout << "line_ending=" << (lineEnding == "\n" ? "lf" : "crlf")
+                      << " line_bytes=" << lineLength
+                      << " lines=" << lines.size()
+                      << " legacy_mb_per_s=" << legacyMegabytesPerSecond
+                      << " ring_mb_per_s=" << megabytesPerSecond
+                      << " lines_match=" << (linesMatch ? "true" : "false") << std::endl;
+        }
+    }
+    return (allPassed ? 0 : 1);
+}
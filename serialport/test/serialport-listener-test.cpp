@@ -0,0 +1,119 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <ctime>
+#include <pty.h>
+#include <unistd.h>
+#include <serialport.h>
+
+//Starts the SerialPort listener on a pseudo terminal with onBytes/onLine callbacks,
+//then reports callback latency for lines sent at random intervals, process CPU
+//while the port sits idle, readLine() through the listener, and how long
+//stopListening() takes
+static const int NUMBER_OF_LINES{500};
+
+static std::atomic<long long> lastSendTime{0};
+
+long long steadyNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double processCpuSeconds()
+{
+    timespec cpuTime{};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuTime);
+    return static_cast<double>(cpuTime.tv_sec) + static_cast<double>(cpuTime.tv_nsec) / 1e9;
+}
+
+void writeToMaster(int masterDescriptor, const std::string &str)
+{
+    lastSendTime.store(steadyNanoseconds());
+    if (::write(masterDescriptor, str.data(), str.length()) != static_cast<ssize_t>(str.length())) {
+        std::cout << "WARNING: short write to the pseudo terminal" << std::endl;
+    }
+}
+
+int main()
+{
+    int masterDescriptor{-1};
+    int slaveDescriptor{-1};
+    char slaveName[256];
+    if (openpty(&masterDescriptor, &slaveDescriptor, slaveName, nullptr, nullptr) != 0) {
+        std::cout << "FAILED: unable to open a pseudo terminal" << std::endl;
+        return 1;
+    }
+    SerialPort serialPort{slaveName, BaudRate::BAUD115200};
+    serialPort.openPort();
+
+    std::mutex resultMutex{};
+    std::vector<double> latencyMicroseconds{};
+    std::vector<std::string> lines{};
+    std::atomic<size_t> bytesSeen{0};
+    serialPort.onBytes([&bytesSeen](const char *, size_t length) {
+        bytesSeen += length;
+    });
+    serialPort.onLine([&](const std::string &line) {
+        double latency{static_cast<double>(steadyNanoseconds() - lastSendTime.load()) / 1e3};
+        std::lock_guard<std::mutex> resultLock{resultMutex};
+        latencyMicroseconds.push_back(latency);
+        lines.push_back(line);
+    });
+    serialPort.startListening();
+
+    size_t bytesSent{0};
+    for (int i = 0; i < NUMBER_OF_LINES; i++) {
+        std::this_thread::sleep_for(std::chrono::microseconds(500 + (i * 7919) % 1500));
+        std::string line{"LINE:" + std::to_string(i) + "\r\n"};
+        writeToMaster(masterDescriptor, line);
+        bytesSent += line.length();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    double startCpu{processCpuSeconds()};
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    double idleCpuPercent{(processCpuSeconds() - startCpu) * 100.0};
+
+    bool passed{true};
+    {
+        std::lock_guard<std::mutex> resultLock{resultMutex};
+        passed &= (lines.size() == NUMBER_OF_LINES) && (bytesSeen.load() == bytesSent);
+        for (size_t i = 0; (passed) && (i < lines.size()); i++) {
+            passed &= (lines[i] == "LINE:" + std::to_string(i));
+        }
+        std::sort(latencyMicroseconds.begin(), latencyMicroseconds.end());
+    }
+
+    //Without an onLine callback, lines are queued for readLine() again
+    serialPort.onLine(nullptr);
+    std::thread delayedWriter{[masterDescriptor]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        writeToMaster(masterDescriptor, "READ_LINE\r\n");
+    }};
+    std::string readLineResult{serialPort.readLine()};
+    double readLineLatency{static_cast<double>(steadyNanoseconds() - lastSendTime.load()) / 1e3};
+    delayedWriter.join();
+    passed &= (readLineResult == "READ_LINE");
+
+    auto stopStart = std::chrono::steady_clock::now();
+    serialPort.stopListening();
+    double stopMicroseconds{std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - stopStart).count()};
+    serialPort.closePort();
+    close(slaveDescriptor);
+    close(masterDescriptor);
+
+    std::cout << "lines=" << lines.size()
+              << " bytes=" << bytesSeen.load()
+              << " latency_p50_us=" << (latencyMicroseconds.empty() ? 0.0 : latencyMicroseconds[latencyMicroseconds.size() / 2])
+              << " latency_p99_us=" << (latencyMicroseconds.empty() ? 0.0 : latencyMicroseconds[latencyMicroseconds.size() * 99 / 100])
+              << " idle_cpu_percent=" << idleCpuPercent
+              << " read_line_latency_us=" << readLineLatency
+              << " stop_us=" << stopMicroseconds
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return (passed ? 0 : 1);
+}
@@ -0,0 +1,247 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <serialport.h>
+#include "serialport-loopback.h"
+
+//Drives SerialPort through a pseudo terminal loopback and reports, for each message
+//size, receive and transmit throughput, CPU per megabyte and line round trip latency
+//through an echo on the far end. Every result is one line of space separated
+//key=value pairs that always starts with "benchmark=serialport_loopback format=1
+//test=<name> message_bytes=<size>", so runs can be compared by a script
+//Usage: serialport-loopback-benchmark [megabytes per run, default 8]
+static const std::vector<size_t> MESSAGE_SIZES{16, 64, 256, 1024, 4096};
+static const int FORMAT_VERSION{1};
+static const int LINES_PER_LATENCY_RUN{500};
+static const long PORT_TIMEOUT{1000};
+
+double cpuSeconds(clockid_t clockId)
+{
+    timespec cpuTime{};
+    clock_gettime(clockId, &cpuTime);
+    return static_cast<double>(cpuTime.tv_sec) + static_cast<double>(cpuTime.tv_nsec) / 1e9;
+}
+
+//Printable bytes ending in "\r\n", so the same message works for raw and line reads
+std::string makeMessage(size_t messageBytes)
+{
+    std::string message(messageBytes - 2, '\0');
+    for (size_t i = 0; i < message.length(); i++) {
+        message[i] = static_cast<char>('!' + (i * 7) % 90);
+    }
+    return message + "\r\n";
+}
+
+struct ThroughputResult
+{
+    size_t bytes;
+    double seconds;
+    double portCpuSeconds;
+    double processCpuSeconds;
+    bool passed;
+};
+
+class ResultLine
+{
+public:
+    ResultLine(const std::string &testName, size_t messageBytes)
+    {
+        std::cout << std::fixed << std::setprecision(3)
+                  << "benchmark=serialport_loopback format=" << FORMAT_VERSION
+                  << " test=" << testName
+                  << " message_bytes=" << messageBytes;
+    }
+
+    ~ResultLine()
+    {
+        std::cout << std::endl;
+    }
+
+    template <typename T>
+    ResultLine &add(const std::string &key, const T &value)
+    {
+        std::cout << " " << key << "=" << value;
+        return *this;
+    }
+};
+
+void reportThroughput(const std::string &testName, size_t messageBytes, const ThroughputResult &result)
+{
+    double megabytes{static_cast<double>(result.bytes) / 1e6};
+    ResultLine{testName, messageBytes}
+        .add("bytes", result.bytes)
+        .add("seconds", result.seconds)
+        .add("mb_per_s", megabytes / result.seconds)
+        .add("port_cpu_ms_per_mb", result.portCpuSeconds * 1e3 / megabytes)
+        .add("process_cpu_ms_per_mb", result.processCpuSeconds * 1e3 / megabytes)
+        .add("result", (result.passed ? "pass" : "fail"));
+}
+
+//The far end writes a stream of messages, SerialPort::read() drains it on this thread
+ThroughputResult measureReceive(SerialPortLoopback &loopback, SerialPort &serialPort, const std::string &message, size_t totalBytes)
+{
+    std::thread writerThread{[&loopback, &message, totalBytes]() {
+        std::string chunk{};
+        while (chunk.length() < 65536) {
+            chunk += message;
+        }
+        for (size_t written = 0; written < totalBytes; written += chunk.length()) {
+            loopback.writeMaster(chunk.data(), std::min(chunk.length(), totalBytes - written));
+        }
+    }};
+
+    std::vector<uint8_t> buffer(65536);
+    size_t received{0};
+    bool passed{true};
+    double startPortCpu{cpuSeconds(CLOCK_THREAD_CPUTIME_ID)};
+    double startProcessCpu{cpuSeconds(CLOCK_PROCESS_CPUTIME_ID)};
+    auto startTime = std::chrono::steady_clock::now();
+    while (received < totalBytes) {
+        ssize_t readBytes{serialPort.read(buffer.data(), buffer.size())};
+        if (readBytes <= 0) {
+            passed = false;
+            break;
+        }
+        for (ssize_t i = 0; i < readBytes; i++) {
+            if (static_cast<char>(buffer[i]) != message[(received + i) % message.length()]) {
+                passed = false;
+            }
+        }
+        received += readBytes;
+    }
+    double seconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()};
+    double portCpu{cpuSeconds(CLOCK_THREAD_CPUTIME_ID) - startPortCpu};
+    double processCpu{cpuSeconds(CLOCK_PROCESS_CPUTIME_ID) - startProcessCpu};
+    writerThread.join();
+    return ThroughputResult{received, seconds, portCpu, processCpu, (passed && (received == totalBytes))};
+}
+
+//SerialPort::write() sends a stream of messages on this thread, the far end drains it
+ThroughputResult measureTransmit(SerialPortLoopback &loopback, SerialPort &serialPort, const std::string &message, size_t totalBytes)
+{
+    size_t messageCount{totalBytes / message.length()};
+    size_t expectedBytes{messageCount * message.length()};
+    std::atomic<size_t> received{0};
+    std::atomic<bool> passed{true};
+    std::thread readerThread{[&loopback, &message, &received, &passed, expectedBytes]() {
+        std::vector<char> buffer(65536);
+        while (received < expectedBytes) {
+            ssize_t readBytes{loopback.readMaster(buffer.data(), buffer.size(), std::chrono::milliseconds{PORT_TIMEOUT})};
+            if (readBytes <= 0) {
+                passed = false;
+                return;
+            }
+            size_t position{received};
+            for (ssize_t i = 0; i < readBytes; i++) {
+                if (buffer[i] != message[(position + i) % message.length()]) {
+                    passed = false;
+                }
+            }
+            received += readBytes;
+        }
+    }};
+
+    double startPortCpu{cpuSeconds(CLOCK_THREAD_CPUTIME_ID)};
+    double startProcessCpu{cpuSeconds(CLOCK_PROCESS_CPUTIME_ID)};
+    auto startTime = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < messageCount; i++) {
+        if (serialPort.write(message) != static_cast<ssize_t>(message.length())) {
+            passed = false;
+            break;
+        }
+    }
+    double portCpu{cpuSeconds(CLOCK_THREAD_CPUTIME_ID) - startPortCpu};
+    readerThread.join();
+    double seconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()};
+    double processCpu{cpuSeconds(CLOCK_PROCESS_CPUTIME_ID) - startProcessCpu};
+    return ThroughputResult{received.load(), seconds, portCpu, processCpu, (passed && (received == expectedBytes))};
+}
+
+//The far end echoes every line back, each sample is writeLine() to readLine() returning
+bool measureLineRoundTrip(SerialPortLoopback &loopback, SerialPort &serialPort, const std::string &message)
+{
+    std::atomic<bool> stopEcho{false};
+    std::thread echoThread{[&loopback, &stopEcho]() {
+        std::vector<char> buffer(65536);
+        std::string pending{};
+        while (!stopEcho) {
+            ssize_t readBytes{loopback.readMaster(buffer.data(), buffer.size(), std::chrono::milliseconds{10})};
+            if (readBytes <= 0) {
+                continue;
+            }
+            pending.append(buffer.data(), readBytes);
+            size_t lineEnd{pending.rfind("\r\n")};
+            if (lineEnd != std::string::npos) {
+                loopback.writeMaster(pending.data(), lineEnd + 2);
+                pending.erase(0, lineEnd + 2);
+            }
+        }
+    }};
+
+    std::string line{message.substr(0, message.length() - 2)};
+    std::vector<double> roundTripMicroseconds{};
+    bool passed{true};
+    for (int i = 0; i < LINES_PER_LATENCY_RUN; i++) {
+        auto startTime = std::chrono::steady_clock::now();
+        serialPort.writeLine(line);
+        std::string echoed{serialPort.readLine()};
+        roundTripMicroseconds.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count());
+        if (echoed != line) {
+            passed = false;
+            break;
+        }
+    }
+    stopEcho = true;
+    echoThread.join();
+
+    std::sort(roundTripMicroseconds.begin(), roundTripMicroseconds.end());
+    auto percentile = [&roundTripMicroseconds](double fraction) {
+        return roundTripMicroseconds[static_cast<size_t>(fraction * (roundTripMicroseconds.size() - 1))];
+    };
+    ResultLine{"line_round_trip", message.length()}
+        .add("lines", roundTripMicroseconds.size())
+        .add("p50_us", percentile(0.50))
+        .add("p99_us", percentile(0.99))
+        .add("max_us", roundTripMicroseconds.back())
+        .add("result", (passed ? "pass" : "fail"));
+    return passed;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t megabytesPerRun{8};
+    if (argc > 1) {
+        megabytesPerRun = std::max(1L, std::strtol(argv[1], nullptr, 10));
+    }
+    size_t bytesPerRun{megabytesPerRun * 1000UL * 1000UL};
+
+    bool allPassed{true};
+    SerialPortLoopback loopback{};
+    for (size_t messageBytes : MESSAGE_SIZES) {
+        std::string message{makeMessage(messageBytes)};
+        size_t totalBytes{(bytesPerRun / messageBytes) * messageBytes};
+
+        SerialPort serialPort{loopback.slaveName(), BaudRate::BAUD115200};
+        serialPort.setTimeout(PORT_TIMEOUT);
+        serialPort.setLineEnding("\r\n");
+        serialPort.openPort();
+
+        ThroughputResult receiveResult{measureReceive(loopback, serialPort, message, totalBytes)};
+        reportThroughput("receive", messageBytes, receiveResult);
+        ThroughputResult transmitResult{measureTransmit(loopback, serialPort, message, totalBytes)};
+        reportThroughput("transmit", messageBytes, transmitResult);
+        bool roundTripPassed{measureLineRoundTrip(loopback, serialPort, message)};
+        allPassed = allPassed && receiveResult.passed && transmitResult.passed && roundTripPassed;
+
+        serialPort.closePort();
+        loopback.drainMaster();
+    }
+    return (allPassed ? 0 : 1);
+}
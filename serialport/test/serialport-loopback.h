@@ -0,0 +1,92 @@
+#ifndef TJLUTILS_SERIALPORT_LOOPBACK_H
+#define TJLUTILS_SERIALPORT_LOOPBACK_H
+
+#include <string>
+#include <stdexcept>
+#include <chrono>
+#include <pty.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+
+//Pseudo terminal pair for exercising SerialPort without hardware: SerialPort opens
+//slaveName() like any other device and the test drives the master descriptor as the
+//far end of the cable. The slave descriptor stays open for the lifetime of the
+//loopback, so the master never sees a hang up between SerialPort runs
+class SerialPortLoopback
+{
+public:
+    SerialPortLoopback() :
+        m_masterDescriptor{-1},
+        m_slaveDescriptor{-1},
+        m_slaveName{}
+    {
+        char slaveName[256];
+        if (openpty(&this->m_masterDescriptor, &this->m_slaveDescriptor, slaveName, nullptr, nullptr) != 0) {
+            throw std::runtime_error("In SerialPortLoopback::SerialPortLoopback(): Unable to open a pseudo terminal");
+        }
+        this->m_slaveName = slaveName;
+        struct termios rawSettings{};
+        tcgetattr(this->m_slaveDescriptor, &rawSettings);
+        cfmakeraw(&rawSettings);
+        tcsetattr(this->m_slaveDescriptor, TCSANOW, &rawSettings);
+    }
+
+    ~SerialPortLoopback()
+    {
+        close(this->m_masterDescriptor);
+        close(this->m_slaveDescriptor);
+    }
+
+    SerialPortLoopback(const SerialPortLoopback &other) = delete;
+    SerialPortLoopback &operator=(const SerialPortLoopback &rhs) = delete;
+
+    int masterDescriptor() const { return this->m_masterDescriptor; }
+    std::string slaveName() const { return this->m_slaveName; }
+
+    //Blocks until every byte has been written to the master
+    bool writeMaster(const void *data, size_t length)
+    {
+        const char *position{static_cast<const char *>(data)};
+        while (length > 0) {
+            ssize_t writtenBytes{::write(this->m_masterDescriptor, position, length)};
+            if (writtenBytes <= 0) {
+                return false;
+            }
+            position += writtenBytes;
+            length -= writtenBytes;
+        }
+        return true;
+    }
+
+    bool writeMaster(const std::string &str)
+    {
+        return this->writeMaster(str.data(), str.length());
+    }
+
+    //Reads whatever is waiting on the master, returning 0 if nothing arrives within timeout
+    ssize_t readMaster(void *buffer, size_t length, std::chrono::milliseconds timeout)
+    {
+        struct pollfd pollDescriptor{this->m_masterDescriptor, POLLIN, 0};
+        if (poll(&pollDescriptor, 1, static_cast<int>(timeout.count())) <= 0) {
+            return 0;
+        }
+        ssize_t readBytes{::read(this->m_masterDescriptor, buffer, length)};
+        return ((readBytes > 0) ? readBytes : 0);
+    }
+
+    //Discards anything still waiting on the master, so one run does not leak into the next
+    void drainMaster()
+    {
+        char discarded[4096];
+        while (this->readMaster(discarded, sizeof(discarded), std::chrono::milliseconds{10}) > 0) { }
+    }
+
+private:
+    int m_masterDescriptor;
+    int m_slaveDescriptor;
+    std::string m_slaveName;
+};
+
+#endif //TJLUTILS_SERIALPORT_LOOPBACK_H
@@ -0,0 +1,182 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <pty.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <serialport.h>
+#include <serialportmanager.h>
+
+//Drives 128 pseudo terminals, first with a listener thread per SerialPort and then
+//through one SerialPortManager reactor, and reports thread count, context switches,
+//CPU time and delivery for the same burst of lines. Also checks queued writes and
+//per port timeouts through the manager
+static const int NUMBER_OF_PORTS{128};
+static const int LINES_PER_PORT{200};
+
+struct PseudoTerminal
+{
+    int masterDescriptor;
+    int slaveDescriptor;
+    std::unique_ptr<SerialPort> serialPort;
+};
+
+int threadCount()
+{
+    std::ifstream status{"/proc/self/status"};
+    std::string line{};
+    while (std::getline(status, line)) {
+        if (line.find("Threads:") == 0) {
+            return std::stoi(line.substr(8));
+        }
+    }
+    return -1;
+}
+
+long contextSwitches(double *cpuSeconds)
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    *cpuSeconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+std::vector<PseudoTerminal> openPseudoTerminals(std::atomic<long> *linesReceived)
+{
+    std::vector<PseudoTerminal> pseudoTerminals(NUMBER_OF_PORTS);
+    for (auto &it : pseudoTerminals) {
+        char slaveName[256];
+        if (openpty(&it.masterDescriptor, &it.slaveDescriptor, slaveName, nullptr, nullptr) != 0) {
+            throw std::runtime_error("Unable to open a pseudo terminal");
+        }
+        termios rawSettings{};
+        tcgetattr(it.masterDescriptor, &rawSettings);
+        cfmakeraw(&rawSettings);
+        tcsetattr(it.masterDescriptor, TCSANOW, &rawSettings);
+        it.serialPort.reset(new SerialPort{slaveName, BaudRate::BAUD115200});
+        it.serialPort->openPort();
+        it.serialPort->onLine([linesReceived](const std::string &) {
+            (*linesReceived)++;
+        });
+    }
+    return pseudoTerminals;
+}
+
+void closePseudoTerminals(std::vector<PseudoTerminal> &pseudoTerminals)
+{
+    for (auto &it : pseudoTerminals) {
+        it.serialPort->closePort();
+        close(it.slaveDescriptor);
+        close(it.masterDescriptor);
+    }
+}
+
+void runBurst(const std::string &name, std::vector<PseudoTerminal> &pseudoTerminals, std::atomic<long> *linesReceived)
+{
+    double startCpu{0.0};
+    long startSwitches{contextSwitches(&startCpu)};
+    auto startTime = std::chrono::steady_clock::now();
+    for (int line = 0; line < LINES_PER_PORT; line++) {
+        std::string message{"PORT_LINE:" + std::to_string(line) + "\r\n"};
+        for (auto &it : pseudoTerminals) {
+            if (::write(it.masterDescriptor, message.data(), message.length()) < 0) {
+                std::cout << "WARNING: write to pseudo terminal failed" << std::endl;
+            }
+        }
+        if ((line % 10) == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    long expectedLines{static_cast<long>(NUMBER_OF_PORTS) * LINES_PER_PORT};
+    while ((linesReceived->load() < expectedLines) && (std::chrono::steady_clock::now() - startTime < std::chrono::seconds(10))) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double elapsedSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()};
+    int threads{threadCount()};
+    double endCpu{0.0};
+    long endSwitches{contextSwitches(&endCpu)};
+    std::cout << "mode=" << name
+              << " ports=" << NUMBER_OF_PORTS
+              << " threads=" << threads
+              << " lines=" << linesReceived->load() << "/" << expectedLines
+              << " seconds=" << elapsedSeconds
+              << " context_switches=" << (endSwitches - startSwitches)
+              << " cpu_seconds=" << (endCpu - startCpu) << std::endl;
+}
+
+bool checkManagedWritesAndTimeouts()
+{
+    std::atomic<long> linesReceived{0};
+    std::vector<PseudoTerminal> pseudoTerminals{openPseudoTerminals(&linesReceived)};
+    SerialPortManager serialPortManager{};
+    for (auto &it : pseudoTerminals) {
+        serialPortManager.add(*it.serialPort);
+    }
+    //More than a pseudo terminal buffers, so most of it waits in the manager's queue
+    std::string bigMessage(32768, 'W');
+    bool passed{serialPortManager.write(*pseudoTerminals[0].serialPort, bigMessage) == static_cast<ssize_t>(bigMessage.length())};
+    std::string drained{};
+    char readBuffer[4096];
+    auto startTime = std::chrono::steady_clock::now();
+    while ((drained.length() < bigMessage.length()) && (std::chrono::steady_clock::now() - startTime < std::chrono::seconds(5))) {
+        pollfd pollDescriptor{pseudoTerminals[0].masterDescriptor, POLLIN, 0};
+        if (poll(&pollDescriptor, 1, 100) > 0) {
+            ssize_t readBytes{::read(pseudoTerminals[0].masterDescriptor, readBuffer, sizeof(readBuffer))};
+            if (readBytes > 0) {
+                drained.append(readBuffer, readBytes);
+            }
+        }
+    }
+    passed &= (drained == bigMessage) && (serialPortManager.pendingWriteBytes(*pseudoTerminals[0].serialPort) == 0);
+
+    std::atomic<int> timeoutCount{0};
+    serialPortManager.setTimeout(*pseudoTerminals[1].serialPort, 50, [&timeoutCount](SerialPort &) {
+        timeoutCount++;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(275));
+    int idleTimeouts{timeoutCount.load()};
+    passed &= (idleTimeouts >= 4) && (idleTimeouts <= 6);
+
+    serialPortManager.remove(*pseudoTerminals[2].serialPort);
+    passed &= (!serialPortManager.contains(*pseudoTerminals[2].serialPort)) && (serialPortManager.size() == NUMBER_OF_PORTS - 1);
+    closePseudoTerminals(pseudoTerminals);
+    passed &= (serialPortManager.size() == 0);
+    std::cout << "queued_write_bytes=" << drained.length()
+              << " idle_timeouts=" << idleTimeouts
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return passed;
+}
+
+int main()
+{
+    std::atomic<long> linesReceived{0};
+    std::vector<PseudoTerminal> pseudoTerminals{openPseudoTerminals(&linesReceived)};
+    for (auto &it : pseudoTerminals) {
+        it.serialPort->startListening();
+    }
+    runBurst("thread_per_port", pseudoTerminals, &linesReceived);
+    bool passed{linesReceived.load() == static_cast<long>(NUMBER_OF_PORTS) * LINES_PER_PORT};
+    closePseudoTerminals(pseudoTerminals);
+
+    for (unsigned int reactorCount : {1, 4}) {
+        linesReceived = 0;
+        pseudoTerminals = openPseudoTerminals(&linesReceived);
+        {
+            SerialPortManager serialPortManager{reactorCount};
+            for (auto &it : pseudoTerminals) {
+                serialPortManager.add(*it.serialPort);
+            }
+            runBurst("manager_" + std::to_string(reactorCount) + "_reactor", pseudoTerminals, &linesReceived);
+            passed &= (linesReceived.load() == static_cast<long>(NUMBER_OF_PORTS) * LINES_PER_PORT);
+        }
+        closePseudoTerminals(pseudoTerminals);
+    }
+    passed &= checkManagedWritesAndTimeouts();
+    return (passed ? 0 : 1);
+}
@@ -0,0 +1,240 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <serialport.h>
+#include <serialframing.h>
+#include <serialchannelmux.h>
+#include "serialport-loopback.h"
+
+//A simulated device on the far end of a pseudo terminal echoes every frame back on the
+//channel it came in on. Bulk channels of different priorities keep their queues full
+//while a control channel sends one short line at a time, and each channel checks that
+//its own byte pattern comes back intact. Reports per channel throughput and queueing
+//latency, and checks the bulk channels share the link in line with their priorities.
+//Last, a far end that stops reading fills the pseudo terminal, and the frames the port
+//cannot take must show up as failed instead of sent
+static const std::chrono::milliseconds RUN_TIME{2000};
+static const size_t BULK_WRITE_LENGTH{1024};
+static const std::chrono::milliseconds STALLED_RUN_TIME{500};
+
+class EchoDevice
+{
+public:
+    EchoDevice(SerialPortLoopback &loopback) :
+        m_loopback(loopback),
+        m_stop{false},
+        m_thread{&EchoDevice::run, this}
+    {
+
+    }
+
+    ~EchoDevice()
+    {
+        this->m_stop = true;
+        this->m_thread.join();
+    }
+
+private:
+    SerialPortLoopback &m_loopback;
+    std::atomic<bool> m_stop;
+    std::thread m_thread;
+
+    void run()
+    {
+        SerialFraming::Decoder decoder{SerialFraming::Format::COBS};
+        std::vector<char> buffer(4096);
+        std::string echoed{};
+        while (!this->m_stop) {
+            ssize_t readBytes{this->m_loopback.readMaster(buffer.data(), buffer.size(), std::chrono::milliseconds{10})};
+            if (readBytes <= 0) {
+                continue;
+            }
+            echoed.clear();
+            decoder.feed(buffer.data(), static_cast<size_t>(readBytes), [&echoed](const char *frame, size_t length) {
+                SerialFraming::encode(SerialFraming::Format::COBS, frame, length, &echoed);
+            });
+            this->m_loopback.writeMaster(echoed);
+        }
+    }
+};
+
+uint8_t patternByte(uint8_t channelId, unsigned long long position)
+{
+    return static_cast<uint8_t>(channelId * 31 + position * 7);
+}
+
+struct BulkResult
+{
+    unsigned long long bytesReceived;
+    bool intact;
+};
+
+void runBulkWriter(std::shared_ptr<SerialChannel> channel, const std::atomic<bool> &stop)
+{
+    std::vector<uint8_t> chunk(BULK_WRITE_LENGTH);
+    unsigned long long position{0};
+    while (!stop) {
+        for (auto &it : chunk) {
+            it = patternByte(channel->channelId(), position++);
+        }
+        size_t written{0};
+        while ((written < chunk.size()) && (!stop)) {
+            written += static_cast<size_t>(channel->write(chunk.data() + written, chunk.size() - written));
+        }
+    }
+}
+
+void runBulkReader(std::shared_ptr<SerialChannel> channel, const std::atomic<bool> &stop, BulkResult *result)
+{
+    std::vector<uint8_t> buffer(4096);
+    result->bytesReceived = 0;
+    result->intact = true;
+    while (!stop) {
+        ssize_t readBytes{channel->read(buffer.data(), buffer.size())};
+        for (ssize_t i = 0; i < readBytes; i++) {
+            if (buffer[i] != patternByte(channel->channelId(), result->bytesReceived + i)) {
+                result->intact = false;
+            }
+        }
+        result->bytesReceived += static_cast<unsigned long long>(std::max<ssize_t>(readBytes, 0));
+    }
+}
+
+double toMicroseconds(std::chrono::nanoseconds duration)
+{
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+bool runStalledDevice()
+{
+    SerialPortLoopback loopback{};
+    std::shared_ptr<SerialPort> serialPort{new SerialPort{loopback.slaveName(), BaudRate::BAUD115200}, [](SerialPort *toDelete) {
+        toDelete->closePort();
+        delete toDelete;
+    }};
+    serialPort->setTimeout(20);
+    serialPort->openPort();
+    SerialChannelStatistics statistics{};
+    unsigned long long bytesQueued{0};
+    {
+        SerialChannelMux channelMux{serialPort};
+        std::shared_ptr<SerialChannel> channel{channelMux.openChannel(1)};
+        channel->setTimeout(20);
+        std::vector<uint8_t> chunk(BULK_WRITE_LENGTH, 0x55);
+        auto startTime = std::chrono::steady_clock::now();
+        while (std::chrono::steady_clock::now() - startTime < STALLED_RUN_TIME) {
+            bytesQueued += static_cast<unsigned long long>(std::max<ssize_t>(channel->write(chunk.data(), chunk.size()), 0));
+        }
+        //Gives the transmitter time to time out on what is still queued
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        statistics = channel->statistics();
+    }
+    bool passed{(statistics.framesFailed > 0) && (statistics.bytesSent < bytesQueued)};
+    std::cout << "test=stalled_device queued_kb=" << (bytesQueued / 1024)
+              << " sent_kb=" << (statistics.bytesSent / 1024)
+              << " frames_sent=" << statistics.framesSent
+              << " frames_failed=" << statistics.framesFailed
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return passed;
+}
+
+int main()
+{
+    SerialPortLoopback loopback{};
+    std::shared_ptr<SerialPort> serialPort{new SerialPort{loopback.slaveName(), BaudRate::BAUD115200}, [](SerialPort *toDelete) {
+        toDelete->closePort();
+        delete toDelete;
+    }};
+    serialPort->setTimeout(100);
+    serialPort->openPort();
+    EchoDevice echoDevice{loopback};
+    bool allPassed{true};
+    {
+        SerialChannelMux channelMux{serialPort};
+        const std::vector<unsigned int> bulkPriorities{1, 1, 4};
+        std::vector<std::shared_ptr<SerialChannel>> bulkChannels{};
+        for (size_t i = 0; i < bulkPriorities.size(); i++) {
+            bulkChannels.push_back(channelMux.openChannel(static_cast<uint8_t>(i + 1), bulkPriorities[i]));
+            bulkChannels.back()->setTimeout(100);
+        }
+        std::shared_ptr<SerialChannel> controlChannel{channelMux.openChannel(10, 8)};
+        controlChannel->setTimeout(1000);
+
+        std::atomic<bool> stopWriting{false};
+        std::atomic<bool> stopReading{false};
+        std::vector<BulkResult> bulkResults(bulkChannels.size());
+        std::vector<std::thread> threads{};
+        for (size_t i = 0; i < bulkChannels.size(); i++) {
+            threads.emplace_back(runBulkWriter, bulkChannels[i], std::cref(stopWriting));
+            threads.emplace_back(runBulkReader, bulkChannels[i], std::cref(stopReading), &bulkResults[i]);
+        }
+        //Let the bulk queues fill before timing the control channel round trips
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        for (auto &it : bulkChannels) {
+            it->resetStatistics();
+        }
+        auto startTime = std::chrono::steady_clock::now();
+        int controlRoundTrips{0};
+        bool controlIntact{true};
+        SerialLatencyHistogram controlRoundTrip{};
+        while (std::chrono::steady_clock::now() - startTime < RUN_TIME) {
+            std::string command{"STATUS:" + std::to_string(controlRoundTrips)};
+            auto sentTime = std::chrono::steady_clock::now();
+            controlChannel->writeLine(command);
+            controlIntact = controlIntact && (controlChannel->readLine() == command);
+            controlRoundTrip.record(std::chrono::steady_clock::now() - sentTime);
+            controlRoundTrips++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        double elapsedSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()};
+        std::vector<SerialChannelStatistics> bulkStatistics{};
+        for (auto &it : bulkChannels) {
+            bulkStatistics.push_back(it->statistics());
+        }
+        stopWriting = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        stopReading = true;
+        for (auto &it : threads) {
+            it.join();
+        }
+
+        for (size_t i = 0; i < bulkChannels.size(); i++) {
+            const SerialChannelStatistics &statistics = bulkStatistics[i];
+            bool passed{(bulkResults[i].intact) && (statistics.bytesSent > 0) && (statistics.bytesDropped == 0)};
+            std::cout << "channel=" << static_cast<int>(bulkChannels[i]->channelId())
+                      << " kind=bulk priority=" << bulkPriorities[i]
+                      << " sent_kb_per_s=" << (statistics.bytesSent / elapsedSeconds / 1024.0)
+                      << " queue_p50_us=" << toMicroseconds(statistics.queueLatency.percentile(0.5))
+                      << " queue_p99_us=" << toMicroseconds(statistics.queueLatency.percentile(0.99))
+                      << " intact=" << (bulkResults[i].intact ? "true" : "false")
+                      << " result=" << (passed ? "pass" : "fail") << std::endl;
+            allPassed = allPassed && passed;
+        }
+        SerialChannelStatistics controlStatistics{controlChannel->statistics()};
+        std::cout << "channel=" << static_cast<int>(controlChannel->channelId())
+                  << " kind=control priority=" << controlChannel->priority()
+                  << " round_trips=" << controlRoundTrips
+                  << " queue_p50_us=" << toMicroseconds(controlStatistics.queueLatency.percentile(0.5))
+                  << " queue_p99_us=" << toMicroseconds(controlStatistics.queueLatency.percentile(0.99))
+                  << " round_trip_p50_us=" << toMicroseconds(controlRoundTrip.percentile(0.5))
+                  << " round_trip_p99_us=" << toMicroseconds(controlRoundTrip.percentile(0.99))
+                  << " result=" << (controlIntact ? "pass" : "fail") << std::endl;
+        allPassed = allPassed && controlIntact;
+
+        //Equal priorities get about the same share, and priority 4 about four times that
+        double equalShare{static_cast<double>(bulkStatistics[0].bytesSent) / std::max<unsigned long long>(bulkStatistics[1].bytesSent, 1)};
+        double weightedShare{static_cast<double>(bulkStatistics[2].bytesSent) / std::max<unsigned long long>(bulkStatistics[0].bytesSent, 1)};
+        bool sharesPassed{(equalShare > 0.8) && (equalShare < 1.25) && (weightedShare > 3.0) && (weightedShare < 5.0)};
+        std::cout << "shares equal_priority_ratio=" << equalShare
+                  << " priority_4_to_1_ratio=" << weightedShare
+                  << " unrouted_frames=" << channelMux.unroutedFrameCount()
+                  << " result=" << (sharesPassed ? "pass" : "fail") << std::endl;
+        allPassed = allPassed && sharesPassed && (channelMux.unroutedFrameCount() == 0);
+    }
+    allPassed = runStalledDevice() && allPassed;
+    return (allPassed ? 0 : 1);
+}
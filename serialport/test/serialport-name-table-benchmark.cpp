@@ -0,0 +1,112 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <pty.h>
+#include <unistd.h>
+#include <serialport.h>
+
+//Every lookup and enumeration result is added into this, so none of them can be
+//dropped as dead code
+static volatile long benchmarkSink{0};
+
+//Checks port name resolution against the lazily built name table, and that the old
+//SERIAL_PORT_NAMES still reads the same names, then compares resolving and enumerating
+//ports with the old linear scans and per name probing
+static const int LOOKUPS_PER_RUN{20000};
+
+double elapsedMicroseconds(std::chrono::steady_clock::time_point startTime)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+int legacyNameIndex(const std::string &name)
+{
+    int i{0};
+    for (auto &it : SerialPort::serialPortNames()) {
+        if (it == name) {
+            return i;
+        }
+        i++;
+    }
+    return -1;
+}
+
+std::vector<std::string> legacyAvailableSerialPorts()
+{
+    std::vector<std::string> returnVector{};
+    for (auto &it : SerialPort::serialPortNames()) {
+        if (access(it.c_str(), F_OK) != -1) {
+            returnVector.push_back(it);
+        }
+    }
+    std::sort(returnVector.begin(), returnVector.end());
+    return returnVector;
+}
+
+int main()
+{
+    auto startTime = std::chrono::steady_clock::now();
+    bool passed{SerialPort::isValidSerialPortName("/dev/ttyUSB3")};
+    double firstLookupMicroseconds{elapsedMicroseconds(startTime)};
+    passed &= (!SerialPort::isValidSerialPortName("/dev/ttyXYZ0")) && (!SerialPort::isValidSerialPortName("/dev/ttyUSB256"));
+    passed &= (SerialPort{"ttyS0"}.portName() == "/dev/ttyS0") && (SerialPort{"USB3"}.portName() == "/dev/ttyUSB3") && (SerialPort{"rfcomm2"}.portName() == "/dev/rfcomm2");
+    passed &= (SerialPort{"/dev/ttyACM1"}.portNumber() == legacyNameIndex("/dev/ttyACM1"));
+    const std::vector<std::string> &legacyNames = SerialPort::SERIAL_PORT_NAMES;
+    passed &= (&legacyNames == &SerialPort::serialPortNames()) && (SerialPort::SERIAL_PORT_NAMES.size() == legacyNames.size());
+    passed &= (std::count(SerialPort::SERIAL_PORT_NAMES.begin(), SerialPort::SERIAL_PORT_NAMES.end(), "/dev/ttyUSB3") == 1);
+    try {
+        SerialPort invalidPort{"/dev/notaport"};
+        passed = false;
+    } catch (std::exception &e) {
+        (void)e;
+    }
+
+    int masterDescriptor{-1};
+    int slaveDescriptor{-1};
+    char slaveName[256];
+    if (openpty(&masterDescriptor, &slaveDescriptor, slaveName, nullptr, nullptr) != 0) {
+        std::cout << "FAILED: unable to open a pseudo terminal" << std::endl;
+        return 1;
+    }
+    std::vector<std::string> availablePorts{SerialPort::availableSerialPorts()};
+    passed &= (std::find(availablePorts.begin(), availablePorts.end(), std::string{slaveName}) != availablePorts.end());
+    passed &= (availablePorts == legacyAvailableSerialPorts());
+    SerialPort pseudoTerminal{slaveName};
+    pseudoTerminal.openPort();
+    passed &= pseudoTerminal.isOpen();
+    pseudoTerminal.closePort();
+
+    std::vector<std::string> lookupNames{"/dev/ttyS0", "/dev/ttyUSB17", "/dev/rfcomm200", "/dev/pts/255", "/dev/ttyXYZ0"};
+    long sink{0};
+    startTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < LOOKUPS_PER_RUN; i++) {
+        sink += legacyNameIndex(lookupNames[i % lookupNames.size()]);
+    }
+    double legacyLookupMicroseconds{elapsedMicroseconds(startTime) / LOOKUPS_PER_RUN};
+    startTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < LOOKUPS_PER_RUN; i++) {
+        sink += SerialPort::isValidSerialPortName(lookupNames[i % lookupNames.size()]);
+    }
+    double indexedLookupMicroseconds{elapsedMicroseconds(startTime) / LOOKUPS_PER_RUN};
+
+    startTime = std::chrono::steady_clock::now();
+    sink += legacyAvailableSerialPorts().size();
+    double legacyEnumerateMicroseconds{elapsedMicroseconds(startTime)};
+    startTime = std::chrono::steady_clock::now();
+    sink += SerialPort::availableSerialPorts().size();
+    double sysfsEnumerateMicroseconds{elapsedMicroseconds(startTime)};
+    close(slaveDescriptor);
+    close(masterDescriptor);
+
+    benchmarkSink = sink;
+    std::cout << "first_lookup_us=" << firstLookupMicroseconds
+              << " legacy_lookup_us=" << legacyLookupMicroseconds
+              << " indexed_lookup_us=" << indexedLookupMicroseconds
+              << " legacy_enumerate_us=" << legacyEnumerateMicroseconds
+              << " sysfs_enumerate_us=" << sysfsEnumerateMicroseconds
+              << " available_ports=" << availablePorts.size()
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return (passed ? 0 : 1);
+}
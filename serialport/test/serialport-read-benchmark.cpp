@@ -0,0 +1,139 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <pty.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <serialport.h>
+
+//Pushes a stream of lines through a pseudo terminal and measures receive throughput
+//of SerialPort against the previous receive path (one heap allocation and one read()
+//per byte, reproduced here on a raw descriptor)
+static const size_t BYTES_PER_RUN{4UL * 1024UL * 1024UL};
+static const std::string LINE_PAYLOAD{"$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47"};
+
+struct PseudoTerminal
+{
+    int masterDescriptor;
+    std::string slaveName;
+};
+
+PseudoTerminal openPseudoTerminal()
+{
+    int masterDescriptor{-1};
+    int slaveDescriptor{-1};
+    char slaveName[256];
+    if (openpty(&masterDescriptor, &slaveDescriptor, slaveName, nullptr, nullptr) != 0) {
+        throw std::runtime_error("Unable to open a pseudo terminal");
+    }
+    //SerialPort opens the slave by name, keeping this descriptor open means the
+    //slave side never hangs up between runs
+    return PseudoTerminal{masterDescriptor, slaveName};
+}
+
+std::string lineChunk()
+{
+    std::string chunk{};
+    while (chunk.length() < 4096) {
+        chunk += LINE_PAYLOAD + "\r\n";
+    }
+    return chunk;
+}
+
+//Writes whole chunks, so every run ends on a line boundary
+void writeLines(int masterDescriptor, size_t totalBytes)
+{
+    std::string chunk{lineChunk()};
+    size_t written{0};
+    while (written < totalBytes) {
+        ssize_t result{::write(masterDescriptor, chunk.data() + (written % chunk.length()), chunk.length() - (written % chunk.length()))};
+        if (result > 0) {
+            written += result;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+unsigned char legacyRawRead(int descriptor)
+{
+    std::unique_ptr<unsigned char[]> buffer{new unsigned char[4096]};
+    unsigned char charToReturn{0};
+    if (::read(descriptor, buffer.get(), 1) == 1) {
+        charToReturn = buffer.get()[0];
+    }
+    return charToReturn;
+}
+
+void report(const std::string &name, size_t bytesRead, std::chrono::steady_clock::time_point startTime)
+{
+    double elapsedSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()};
+    std::cout << "path=" << name
+              << " bytes=" << bytesRead
+              << " seconds=" << elapsedSeconds
+              << " mb_per_s=" << (static_cast<double>(bytesRead) / elapsedSeconds / 1e6) << std::endl;
+}
+
+int main()
+{
+    PseudoTerminal pseudoTerminal{openPseudoTerminal()};
+    const size_t chunkLength{lineChunk().length()};
+    const size_t bytesPerRun{((BYTES_PER_RUN + chunkLength - 1) / chunkLength) * chunkLength};
+    {
+        int descriptor{open(pseudoTerminal.slaveName.c_str(), O_RDWR | O_NOCTTY | O_NDELAY)};
+        termios settings{};
+        tcgetattr(descriptor, &settings);
+        cfmakeraw(&settings);
+        tcsetattr(descriptor, TCSANOW, &settings);
+        std::thread writer{writeLines, pseudoTerminal.masterDescriptor, bytesPerRun};
+        size_t bytesRead{0};
+        auto startTime = std::chrono::steady_clock::now();
+        while (bytesRead < bytesPerRun) {
+            if (legacyRawRead(descriptor) != 0) {
+                bytesRead++;
+            }
+        }
+        report("legacy_read_byte", bytesRead, startTime);
+        writer.join();
+        close(descriptor);
+    }
+
+    SerialPort serialPort{pseudoTerminal.slaveName, BaudRate::BAUD4000000};
+    serialPort.openPort();
+    {
+        std::thread writer{writeLines, pseudoTerminal.masterDescriptor, bytesPerRun};
+        size_t bytesRead{0};
+        auto startTime = std::chrono::steady_clock::now();
+        while (bytesRead < bytesPerRun) {
+            if (serialPort.read() != 0) {
+                bytesRead++;
+            }
+        }
+        report("read_byte", bytesRead, startTime);
+        writer.join();
+    }
+    bool linesIntact{true};
+    {
+        std::thread writer{writeLines, pseudoTerminal.masterDescriptor, bytesPerRun};
+        size_t bytesRead{0};
+        auto startTime = std::chrono::steady_clock::now();
+        while (bytesRead < bytesPerRun) {
+            std::string line{serialPort.readLine()};
+            if (line.length() == 0) {
+                continue;
+            }
+            if (line != LINE_PAYLOAD) {
+                linesIntact = false;
+            }
+            bytesRead += line.length() + serialPort.lineEnding().length();
+        }
+        report("read_line", bytesRead, startTime);
+        writer.join();
+    }
+    serialPort.closePort();
+    close(pseudoTerminal.masterDescriptor);
+    std::cout << "lines_intact=" << (linesIntact ? "true" : "false") << std::endl;
+    return (linesIntact ? 0 : 1);
+}
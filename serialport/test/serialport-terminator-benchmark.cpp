@@ -0,0 +1,244 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <serialport.h>
+#include "serialport-loopback.h"
+
+//Checks that one scan for a set of terminators splits a stream with mixed line endings
+//correctly wherever the reads happen to break it, including between the "\r" and "\n"
+//of a "\r\n", and that a "\r" with nothing after it ends its line once the hold time
+//is up, then checks its throughput is at least that of looking for each terminator in
+//turn with std::string::find from the start of the pending bytes. Finishes with
+//readTerminatedLine() and onLine() over a pseudo terminal. The throughput check is only
+//meaningful against a library built with optimization and without sanitizers, since
+//std::string::find runs in the already optimized standard library either way
+static const std::vector<std::string> TERMINATORS{"\r\n", "\n", "\r"};
+static const int THROUGHPUT_REPEATS{2000};
+//Each way is timed this many times, alternating, and the fastest run counts
+static const int THROUGHPUT_ROUNDS{5};
+
+struct TerminatedLine
+{
+    std::string line;
+    std::string terminator;
+};
+
+std::vector<TerminatedLine> splitAll(SerialLineBuffer *lineBuffer, const SerialLineTerminators &terminators)
+{
+    std::vector<TerminatedLine> lines{};
+    std::string line{};
+    size_t terminatorIndex{0};
+    while (lineBuffer->extractUntilAny(terminators, &line, &terminatorIndex)) {
+        lines.push_back(TerminatedLine{line, terminators.terminator(terminatorIndex)});
+    }
+    return lines;
+}
+
+bool runSplitPoints()
+{
+    const std::string stream{"first\r\nsecond\nthird\rfourth\r\n\r\nsixth\n"};
+    const std::vector<TerminatedLine> expected{{"first", "\r\n"}, {"second", "\n"}, {"third", "\r"},
+                                               {"fourth", "\r\n"}, {"", "\r\n"}, {"sixth", "\n"}};
+    SerialLineTerminators terminators{TERMINATORS};
+    bool passed{true};
+    for (size_t split = 0; split <= stream.length(); split++) {
+        SerialLineBuffer lineBuffer{256};
+        lineBuffer.append(stream.data(), split);
+        std::vector<TerminatedLine> lines{splitAll(&lineBuffer, terminators)};
+        lineBuffer.append(stream.data() + split, stream.length() - split);
+        for (auto &it : splitAll(&lineBuffer, terminators)) {
+            lines.push_back(it);
+        }
+        if ((lines.size() != expected.size()) || (!lineBuffer.empty())) {
+            passed = false;
+            continue;
+        }
+        for (size_t i = 0; i < lines.size(); i++) {
+            passed = passed && (lines[i].line == expected[i].line) && (lines[i].terminator == expected[i].terminator);
+        }
+    }
+    std::cout << "test=split_points splits=" << (stream.length() + 1)
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return passed;
+}
+
+//A trailing "\r" is held back until the hold time is up, then ends its line on its own,
+//and a "\n" arriving after that is not read as an empty line
+bool runHeldTerminator()
+{
+    SerialLineTerminators terminators{TERMINATORS};
+    SerialLineBuffer lineBuffer{256};
+    lineBuffer.setTerminatorHoldTime(std::chrono::milliseconds(5));
+    lineBuffer.append("held\r", 5);
+    bool heldBack{splitAll(&lineBuffer, terminators).empty()};
+    bool deadlineSet{lineBuffer.heldTerminatorDeadline() != std::chrono::steady_clock::time_point::max()};
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::vector<TerminatedLine> lines{splitAll(&lineBuffer, terminators)};
+    bool released{(lines.size() == 1) && (lines[0].line == "held") && (lines[0].terminator == "\r")};
+    lineBuffer.append("\nnext\n", 6);
+    lines = splitAll(&lineBuffer, terminators);
+    bool lateTailDropped{(lines.size() == 1) && (lines[0].line == "next")};
+    bool passed{heldBack && deadlineSet && released && lateTailDropped};
+    std::cout << "test=held_terminator held_back=" << (heldBack ? "true" : "false")
+              << " released=" << (released ? "true" : "false")
+              << " late_tail_dropped=" << (lateTailDropped ? "true" : "false")
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return passed;
+}
+
+//Every terminator searched for separately from the start of what is pending, the way a
+//caller of readUntil() has to when it does not know which ending comes next
+size_t findEarliestSeparately(const std::string &pending, size_t *terminatorLength)
+{
+    size_t earliest{std::string::npos};
+    for (auto &it : TERMINATORS) {
+        size_t position{pending.find(it)};
+        if ((position < earliest) || ((position == earliest) && (position != std::string::npos) && (it.length() > *terminatorLength))) {
+            earliest = position;
+            *terminatorLength = it.length();
+        }
+    }
+    return earliest;
+}
+
+//Appends the chunk THROUGHPUT_REPEATS times in pieces that do not line up with the
+//lines, the way a port delivers them, and returns how many lines were split off
+size_t splitSinglePass(const std::string &chunk)
+{
+    SerialLineTerminators terminators{TERMINATORS};
+    SerialLineBuffer lineBuffer{chunk.length() * 2};
+    std::string line{};
+    size_t terminatorIndex{0};
+    size_t lines{0};
+    for (int repeat = 0; repeat < THROUGHPUT_REPEATS; repeat++) {
+        for (size_t offset = 0; offset < chunk.length(); offset += 100) {
+            lineBuffer.append(chunk.data() + offset, std::min<size_t>(100, chunk.length() - offset));
+            while (lineBuffer.extractUntilAny(terminators, &line, &terminatorIndex)) {
+                lines++;
+            }
+        }
+    }
+    return lines;
+}
+
+size_t splitSeparately(const std::string &chunk)
+{
+    std::string pending{};
+    std::string line{};
+    size_t lines{0};
+    for (int repeat = 0; repeat < THROUGHPUT_REPEATS; repeat++) {
+        for (size_t offset = 0; offset < chunk.length(); offset += 100) {
+            pending.append(chunk.data() + offset, std::min<size_t>(100, chunk.length() - offset));
+            size_t terminatorLength{0};
+            size_t position{0};
+            while ((position = findEarliestSeparately(pending, &terminatorLength)) != std::string::npos) {
+                //Not sure yet whether a trailing "\r" is a whole terminator
+                if ((pending[position] == '\r') && (terminatorLength == 1) && (position + 1 == pending.length())) {
+                    break;
+                }
+                line.assign(pending, 0, position);
+                pending.erase(0, position + terminatorLength);
+                terminatorLength = 0;
+                lines++;
+            }
+        }
+    }
+    return lines;
+}
+
+bool runThroughput()
+{
+    std::string chunk{};
+    const std::vector<std::string> endings{"\r\n", "\n", "\r\n", "\r"};
+    //An odd number of lines, so the chunk ends in "\r\n" and nothing is left undecided
+    for (int i = 0; i < 63; i++) {
+        chunk += "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*" + std::to_string(i) + endings[i % endings.size()];
+    }
+    size_t singlePassLines{0};
+    size_t separateLines{0};
+    double singlePassSeconds{0.0};
+    double separateSeconds{0.0};
+    for (int round = 0; round < THROUGHPUT_ROUNDS; round++) {
+        auto startTime = std::chrono::steady_clock::now();
+        singlePassLines = splitSinglePass(chunk);
+        double elapsedSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()};
+        singlePassSeconds = ((round == 0) ? elapsedSeconds : std::min(singlePassSeconds, elapsedSeconds));
+
+        startTime = std::chrono::steady_clock::now();
+        separateLines = splitSeparately(chunk);
+        elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        separateSeconds = ((round == 0) ? elapsedSeconds : std::min(separateSeconds, elapsedSeconds));
+    }
+    double megabytes{static_cast<double>(chunk.length()) * THROUGHPUT_REPEATS / 1e6};
+    bool passed{(singlePassLines == separateLines) && (singlePassSeconds <= separateSeconds)};
+    std::cout << "test=throughput lines=" << singlePassLines
+              << " single_pass_mb_per_s=" << (megabytes / singlePassSeconds)
+              << " separate_scans_mb_per_s=" << (megabytes / separateSeconds)
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return passed;
+}
+
+bool runSerialPort(SerialPortLoopback &loopback, bool listening)
+{
+    SerialPort serialPort{loopback.slaveName(), BaudRate::BAUD115200};
+    serialPort.setTimeout(1000);
+    serialPort.setLineTerminators(TERMINATORS);
+    serialPort.openPort();
+    bool passed{serialPort.lineTerminators() == TERMINATORS};
+    const std::vector<TerminatedLine> expected{{"ALPHA", "\r\n"}, {"BRAVO", "\n"}, {"CHARLIE", "\r"}, {"DELTA", "\r\n"}};
+    std::vector<std::string> callbackLines{};
+    std::mutex callbackMutex{};
+    if (listening) {
+        serialPort.onLine([&callbackLines, &callbackMutex](const std::string &line) {
+            std::lock_guard<std::mutex> callbackLock{callbackMutex};
+            callbackLines.push_back(line);
+        });
+        serialPort.startListening();
+    }
+    for (auto &it : expected) {
+        loopback.writeMaster(it.line + it.terminator);
+    }
+    if (listening) {
+        auto giveUpTime = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (std::chrono::steady_clock::now() < giveUpTime) {
+            std::lock_guard<std::mutex> callbackLock{callbackMutex};
+            if (callbackLines.size() >= expected.size()) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::lock_guard<std::mutex> callbackLock{callbackMutex};
+        passed = passed && (callbackLines.size() == expected.size());
+        for (size_t i = 0; (passed) && (i < expected.size()); i++) {
+            passed = (callbackLines[i] == expected[i].line);
+        }
+        serialPort.onLine(nullptr);
+        serialPort.stopListening();
+    } else {
+        for (auto &it : expected) {
+            std::string terminator{};
+            std::string line{serialPort.readTerminatedLine(&terminator)};
+            passed = passed && (line == it.line) && (terminator == it.terminator);
+        }
+    }
+    std::cout << "test=serial_port mode=" << (listening ? "listening" : "synchronous")
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    serialPort.closePort();
+    loopback.drainMaster();
+    return passed;
+}
+
+int main()
+{
+    bool allPassed{runSplitPoints()};
+    allPassed = runHeldTerminator() && allPassed;
+    allPassed = runThroughput() && allPassed;
+    SerialPortLoopback loopback{};
+    allPassed = runSerialPort(loopback, false) && allPassed;
+    allPassed = runSerialPort(loopback, true) && allPassed;
+    return (allPassed ? 0 : 1);
+}
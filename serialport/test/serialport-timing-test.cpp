@@ -0,0 +1,112 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <serialport.h>
+#include "serialport-loopback.h"
+
+//Sends lines through a pseudo terminal in two halves with a known pause between them,
+//leaves each one unread for a known time, and checks the line timing readLine() reports
+//in both synchronous and listening mode. Then measures readLine() throughput, to compare
+//a build with TJLUTILS_SERIALPORT_TIMING against one without
+static const int NUMBER_OF_TIMED_LINES{20};
+static const std::chrono::milliseconds ASSEMBLY_PAUSE{4};
+static const std::chrono::milliseconds BUFFER_PAUSE{6};
+static const int THROUGHPUT_LINES{200000};
+
+double toMilliseconds(std::chrono::nanoseconds duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+bool runTimedLines(SerialPortLoopback &loopback, bool listening)
+{
+    SerialPort serialPort{loopback.slaveName(), BaudRate::BAUD115200};
+    serialPort.setTimeout(1000);
+    serialPort.setLineEnding("\r\n");
+    serialPort.openPort();
+    if (listening) {
+        serialPort.startListening();
+    }
+    bool passed{true};
+    for (int i = 0; i < NUMBER_OF_TIMED_LINES; i++) {
+        std::string line{"MEASUREMENT:" + std::to_string(i)};
+        loopback.writeMaster(line.substr(0, 6));
+        std::this_thread::sleep_for(ASSEMBLY_PAUSE);
+        loopback.writeMaster(line.substr(6) + "\r\n");
+        std::this_thread::sleep_for(BUFFER_PAUSE);
+        SerialLineTiming timing{};
+        std::string received{serialPort.readLine(&timing)};
+        if (received != line) {
+            passed = false;
+        }
+        if (!SerialPort::isTimingEnabled()) {
+            passed = passed && (timing.firstByteTime == SerialTimePoint{}) && (timing.consumedTime == SerialTimePoint{});
+            continue;
+        }
+        //Without the listener the bytes are only read by readLine() itself, so the
+        //whole wait shows up as time before the line was read instead
+        if (listening) {
+            passed = passed && (timing.assemblyTime() >= ASSEMBLY_PAUSE) && (timing.assemblyTime() < ASSEMBLY_PAUSE * 3);
+            passed = passed && (timing.timeInBuffer() >= BUFFER_PAUSE / 2) && (timing.timeInBuffer() < BUFFER_PAUSE * 3);
+        } else {
+            passed = passed && (timing.lastByteTime >= timing.firstByteTime) && (timing.consumedTime >= timing.lastByteTime);
+        }
+    }
+    SerialPortTimingSnapshot snapshot{serialPort.timingSnapshot()};
+    if (SerialPort::isTimingEnabled()) {
+        passed = passed && (snapshot.lineAssembly.count() == NUMBER_OF_TIMED_LINES) && (snapshot.interByteGap.count() > 0);
+    } else {
+        passed = passed && (snapshot.lineAssembly.count() == 0) && (snapshot.interByteGap.count() == 0);
+    }
+    std::cout << "mode=" << (listening ? "listening" : "synchronous")
+              << " timing_enabled=" << (SerialPort::isTimingEnabled() ? "true" : "false")
+              << " lines=" << snapshot.lineAssembly.count()
+              << " gap_p50_ms=" << toMilliseconds(snapshot.interByteGap.percentile(0.5))
+              << " gap_max_ms=" << toMilliseconds(snapshot.interByteGap.maximum())
+              << " assembly_mean_ms=" << toMilliseconds(snapshot.lineAssembly.mean())
+              << " in_buffer_mean_ms=" << toMilliseconds(snapshot.timeInBuffer.mean())
+              << " in_buffer_p99_ms=" << toMilliseconds(snapshot.timeInBuffer.percentile(0.99))
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    serialPort.closePort();
+    loopback.drainMaster();
+    return passed;
+}
+
+void runThroughput(SerialPortLoopback &loopback)
+{
+    SerialPort serialPort{loopback.slaveName(), BaudRate::BAUD115200};
+    serialPort.setTimeout(1000);
+    serialPort.setLineEnding("\r\n");
+    serialPort.openPort();
+    std::thread writerThread{[&loopback]() {
+        std::string chunk{};
+        for (int i = 0; i < 100; i++) {
+            chunk += "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n";
+        }
+        for (int i = 0; i < THROUGHPUT_LINES / 100; i++) {
+            loopback.writeMaster(chunk);
+        }
+    }};
+    int linesRead{0};
+    auto startTime = std::chrono::steady_clock::now();
+    while ((linesRead < THROUGHPUT_LINES) && (!serialPort.readLine().empty())) {
+        linesRead++;
+    }
+    double elapsedSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()};
+    writerThread.join();
+    std::cout << "mode=throughput timing_enabled=" << (SerialPort::isTimingEnabled() ? "true" : "false")
+              << " lines=" << linesRead
+              << " lines_per_s=" << (linesRead / elapsedSeconds) << std::endl;
+    serialPort.closePort();
+    loopback.drainMaster();
+}
+
+int main()
+{
+    SerialPortLoopback loopback{};
+    bool allPassed{runTimedLines(loopback, false)};
+    allPassed = runTimedLines(loopback, true) && allPassed;
+    runThroughput(loopback);
+    return (allPassed ? 0 : 1);
+}
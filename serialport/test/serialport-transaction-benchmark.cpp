@@ -0,0 +1,265 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <serialport.h>
+#include <serialtransactionclient.h>
+#include "serialport-loopback.h"
+
+//A simulated device on the far end of a pseudo terminal answers every "#<n> <command>"
+//line with "#<n> OK <command>" a fixed turnaround time after it arrives. Reports
+//transactions per second for writeLine()/readLine() one at a time against the
+//SerialTransactionClient at several in flight limits, then checks tag matching with
+//replies out of order and with dropped replies timing out, including a lone command
+//sent to an idle client
+static const int TRANSACTIONS_PER_RUN{2000};
+static const std::chrono::microseconds DEVICE_TURNAROUND{200};
+//Generous time a queued command may take to get through a window of one, so a slow
+//machine does not turn queue time into timeouts
+static const std::chrono::microseconds QUEUED_TRANSACTION_ALLOWANCE{2000};
+
+using steady_time_point = std::chrono::steady_clock::time_point;
+
+class SimulatedDevice
+{
+public:
+    //Every reorderEvery'th reply is held back an extra turnaround, every dropEvery'th command is ignored
+    SimulatedDevice(SerialPortLoopback &loopback, int reorderEvery, int dropEvery) :
+        m_loopback(loopback),
+        m_reorderEvery{reorderEvery},
+        m_dropEvery{dropEvery},
+        m_stop{false},
+        m_thread{&SimulatedDevice::run, this}
+    {
+
+    }
+
+    ~SimulatedDevice()
+    {
+        this->m_stop = true;
+        this->m_thread.join();
+    }
+
+private:
+    SerialPortLoopback &m_loopback;
+    int m_reorderEvery;
+    int m_dropEvery;
+    std::atomic<bool> m_stop;
+    std::thread m_thread;
+
+    void run()
+    {
+        std::vector<char> buffer(4096);
+        std::string pending{};
+        std::deque<std::pair<steady_time_point, std::string>> replies{};
+        while (!this->m_stop) {
+            auto now = std::chrono::steady_clock::now();
+            std::string due{};
+            while ((!replies.empty()) && (replies.front().first <= now)) {
+                due += replies.front().second;
+                replies.pop_front();
+            }
+            if (!due.empty()) {
+                this->m_loopback.writeMaster(due);
+            }
+            ssize_t readBytes{0};
+            if (replies.empty()) {
+                readBytes = this->m_loopback.readMaster(buffer.data(), buffer.size(), std::chrono::milliseconds{10});
+            } else {
+                struct pollfd pollDescriptor{this->m_loopback.masterDescriptor(), POLLIN, 0};
+                if (poll(&pollDescriptor, 1, 0) > 0) {
+                    readBytes = this->m_loopback.readMaster(buffer.data(), buffer.size(), std::chrono::milliseconds{0});
+                }
+            }
+            if (readBytes <= 0) {
+                continue;
+            }
+            pending.append(buffer.data(), readBytes);
+            size_t lineEnd{0};
+            while ((lineEnd = pending.find("\r\n")) != std::string::npos) {
+                std::string command{pending.substr(0, lineEnd)};
+                pending.erase(0, lineEnd + 2);
+                size_t separator{command.find(' ')};
+                long sequence{std::strtol(command.c_str() + 1, nullptr, 10)};
+                if ((this->m_dropEvery > 0) && ((sequence % this->m_dropEvery) == 0)) {
+                    continue;
+                }
+                auto replyTime = std::chrono::steady_clock::now() + DEVICE_TURNAROUND;
+                if ((this->m_reorderEvery > 0) && ((sequence % this->m_reorderEvery) == 0)) {
+                    replyTime += DEVICE_TURNAROUND;
+                }
+                std::string reply{command.substr(0, separator) + " OK" + command.substr(separator) + "\r\n"};
+                auto position = std::upper_bound(replies.begin(), replies.end(), replyTime, [](const steady_time_point &timePoint, const std::pair<steady_time_point, std::string> &entry) {
+                    return timePoint < entry.first;
+                });
+                replies.emplace(position, replyTime, reply);
+            }
+        }
+    }
+};
+
+std::string makeCommand(int sequence)
+{
+    return "#" + std::to_string(sequence) + " READ:" + std::to_string(sequence % 16);
+}
+
+//Closed when the last owner lets go, so the next run can lock the same pseudo terminal
+std::shared_ptr<SerialPort> openSerialPort(SerialPortLoopback &loopback)
+{
+    std::shared_ptr<SerialPort> serialPort{new SerialPort{loopback.slaveName(), BaudRate::BAUD115200}, [](SerialPort *toDelete) {
+        toDelete->closePort();
+        delete toDelete;
+    }};
+    serialPort->setTimeout(1000);
+    serialPort->setLineEnding("\r\n");
+    serialPort->openPort();
+    return serialPort;
+}
+
+bool tagOf(const std::string &line, std::string *tag)
+{
+    size_t separator{line.find(' ')};
+    if ((line.empty()) || (line[0] != '#') || (separator == std::string::npos)) {
+        return false;
+    }
+    tag->assign(line, 0, separator);
+    return true;
+}
+
+bool runSequential(SerialPortLoopback &loopback)
+{
+    std::shared_ptr<SerialPort> serialPort{openSerialPort(loopback)};
+    SimulatedDevice simulatedDevice{loopback, 0, 0};
+    bool passed{true};
+    auto startTime = std::chrono::steady_clock::now();
+    for (int i = 1; i <= TRANSACTIONS_PER_RUN; i++) {
+        std::string command{makeCommand(i)};
+        serialPort->writeLine(command);
+        std::string reply{serialPort->readLine()};
+        if (reply != ("#" + std::to_string(i) + " OK" + command.substr(command.find(' ')))) {
+            passed = false;
+        }
+    }
+    double elapsedSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()};
+    std::cout << "mode=sequential in_flight=1"
+              << " transactions_per_s=" << (TRANSACTIONS_PER_RUN / elapsedSeconds)
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return passed;
+}
+
+bool runPipelined(SerialPortLoopback &loopback, size_t maximumInFlight, bool matchByTag)
+{
+    std::shared_ptr<SerialPort> serialPort{openSerialPort(loopback)};
+    SimulatedDevice simulatedDevice{loopback, (matchByTag ? 3 : 0), 0};
+    SerialTransactionClient transactionClient{serialPort, maximumInFlight, (matchByTag ? SerialTransactionClient::TagExtractor{tagOf} : nullptr)};
+    //Every command is queued up front and its timeout counts from then, so it has to cover the whole queue
+    std::chrono::milliseconds timeout{std::chrono::seconds(1) + std::chrono::duration_cast<std::chrono::milliseconds>(QUEUED_TRANSACTION_ALLOWANCE * TRANSACTIONS_PER_RUN / maximumInFlight)};
+    std::vector<std::future<SerialTransactionResult>> results{};
+    auto startTime = std::chrono::steady_clock::now();
+    for (int i = 1; i <= TRANSACTIONS_PER_RUN; i++) {
+        results.push_back(transactionClient.transact(makeCommand(i), timeout));
+    }
+    bool passed{true};
+    for (auto &it : results) {
+        SerialTransactionResult result{it.get()};
+        std::string command{result.command()};
+        if ((result.status() != SerialTransactionStatus::Success) || (result.reply() != command.substr(0, command.find(' ')) + " OK" + command.substr(command.find(' ')))) {
+            passed = false;
+        }
+    }
+    double elapsedSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()};
+    SerialTransactionLatency latency{transactionClient.latencyStatistics()};
+    std::cout << "mode=" << (matchByTag ? "pipelined_by_tag_reordered" : "pipelined_in_order")
+              << " in_flight=" << maximumInFlight
+              << " transactions_per_s=" << (TRANSACTIONS_PER_RUN / elapsedSeconds)
+              << " latency_p50_us=" << latency.p50.count()
+              << " latency_p99_us=" << latency.p99.count()
+              << " unmatched=" << transactionClient.unmatchedReplyCount()
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return passed;
+}
+
+//Every tenth command is never answered, those must time out without holding up the rest.
+//Commands are paced, as the timeout also covers the time a command spends queued
+bool runDroppedReplies(SerialPortLoopback &loopback)
+{
+    std::shared_ptr<SerialPort> serialPort{openSerialPort(loopback)};
+    SimulatedDevice simulatedDevice{loopback, 0, 10};
+    SerialTransactionClient transactionClient{serialPort, 8, tagOf};
+    std::atomic<int> succeeded{0};
+    std::atomic<int> timedOut{0};
+    std::atomic<int> completed{0};
+    const int transactionCount{200};
+    for (int i = 1; i <= transactionCount; i++) {
+        transactionClient.transact(makeCommand(i), std::chrono::milliseconds{20}, [&](const SerialTransactionResult &result) {
+            if (result.status() == SerialTransactionStatus::Success) {
+                succeeded++;
+            } else if (result.status() == SerialTransactionStatus::TimedOut) {
+                timedOut++;
+            }
+            completed++;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto giveUpTime = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while ((completed < transactionCount) && (std::chrono::steady_clock::now() < giveUpTime)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    bool passed{(succeeded == (transactionCount - transactionCount / 10)) && (timedOut == (transactionCount / 10))};
+    std::cout << "mode=dropped_replies succeeded=" << succeeded
+              << " timed_out=" << timedOut
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return passed;
+}
+
+//A client with nothing in flight sends one command that is never answered. The command
+//is usually written by transact() itself, before the deadline thread gets to run, and
+//must still time out
+bool runIdleUnanswered(SerialPortLoopback &loopback)
+{
+    std::shared_ptr<SerialPort> serialPort{openSerialPort(loopback)};
+    SimulatedDevice simulatedDevice{loopback, 0, 1};
+    SerialTransactionClient transactionClient{serialPort, 8, tagOf};
+    const int transactionCount{10};
+    const std::chrono::milliseconds timeout{20};
+    int timedOut{0};
+    std::chrono::microseconds worstLatency{0};
+    for (int i = 1; i <= transactionCount; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        std::future<SerialTransactionResult> result{transactionClient.transact(makeCommand(i), timeout)};
+        if (result.wait_for(std::chrono::seconds(2)) != std::future_status::ready) {
+            transactionClient.cancelAll();
+        }
+        SerialTransactionResult completedResult{result.get()};
+        if (completedResult.status() == SerialTransactionStatus::TimedOut) {
+            timedOut++;
+            worstLatency = std::max(worstLatency, completedResult.latency());
+        }
+    }
+    bool passed{timedOut == transactionCount};
+    std::cout << "mode=idle_unanswered timed_out=" << timedOut
+              << " worst_timeout_us=" << worstLatency.count()
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return passed;
+}
+
+int main()
+{
+    SerialPortLoopback loopback{};
+    bool allPassed{runSequential(loopback)};
+    for (size_t maximumInFlight : {1, 4, 16}) {
+        allPassed = runPipelined(loopback, maximumInFlight, false) && allPassed;
+        loopback.drainMaster();
+    }
+    allPassed = runPipelined(loopback, 16, true) && allPassed;
+    loopback.drainMaster();
+    allPassed = runDroppedReplies(loopback) && allPassed;
+    loopback.drainMaster();
+    allPassed = runIdleUnanswered(loopback) && allPassed;
+    return (allPassed ? 0 : 1);
+}
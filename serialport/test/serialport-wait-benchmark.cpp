@@ -0,0 +1,134 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <ctime>
+#include <pty.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <serialport.h>
+#include <eventtimer.h>
+
+//A responder answers every 2ms on the master side of a pseudo terminal while the
+//reader waits for each line, comparing the previous busy loop in timedRead
+//(reproduced on a raw descriptor) with the poll based wait. Reports reader CPU
+//time per received byte and the latency from the response being sent to the
+//line being returned
+static const int NUMBER_OF_RESPONSES{1000};
+static const auto RESPONSE_INTERVAL = std::chrono::milliseconds(2);
+static const long READ_TIMEOUT{100};
+
+static std::atomic<long long> lastSendTime{0};
+
+long long steadyNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double threadCpuSeconds()
+{
+    timespec cpuTime{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuTime);
+    return static_cast<double>(cpuTime.tv_sec) + static_cast<double>(cpuTime.tv_nsec) / 1e9;
+}
+
+void respond(int masterDescriptor)
+{
+    for (int i = 0; i < NUMBER_OF_RESPONSES; i++) {
+        std::this_thread::sleep_for(RESPONSE_INTERVAL);
+        std::string response{"RESPONSE:" + std::to_string(i) + "\r\n"};
+        lastSendTime.store(steadyNanoseconds());
+        ::write(masterDescriptor, response.data(), response.length());
+    }
+}
+
+unsigned char legacyTimedRead(int descriptor)
+{
+    SteadyEventTimer eventTimer;
+    eventTimer.start();
+    do {
+        std::unique_ptr<unsigned char[]> buffer{new unsigned char[4096]};
+        if (::read(descriptor, buffer.get(), 1) == 1) {
+            return buffer.get()[0];
+        }
+        eventTimer.update();
+    } while (eventTimer.totalMilliseconds() < READ_TIMEOUT);
+    return 0;
+}
+
+std::string legacyReadLine(int descriptor)
+{
+    std::string line{};
+    while (true) {
+        unsigned char byteRead{legacyTimedRead(descriptor)};
+        if (byteRead == 0) {
+            return "";
+        }
+        line += static_cast<char>(byteRead);
+        if ((line.length() >= 2) && (line.compare(line.length() - 2, 2, "\r\n") == 0)) {
+            return line.substr(0, line.length() - 2);
+        }
+    }
+}
+
+template <typename ReadLine>
+bool runBenchmark(const std::string &name, int masterDescriptor, const ReadLine &readLine)
+{
+    std::vector<double> latencyMicroseconds{};
+    size_t bytesRead{0};
+    double startCpu{threadCpuSeconds()};
+    auto startTime = std::chrono::steady_clock::now();
+    std::thread responder{respond, masterDescriptor};
+    for (int i = 0; i < NUMBER_OF_RESPONSES; i++) {
+        std::string line{readLine()};
+        if (line != "RESPONSE:" + std::to_string(i)) {
+            std::cout << "path=" << name << " FAILED: expected response " << i << ", got " << line << std::endl;
+            responder.join();
+            return false;
+        }
+        latencyMicroseconds.push_back(static_cast<double>(steadyNanoseconds() - lastSendTime.load()) / 1e3);
+        bytesRead += line.length() + 2;
+    }
+    responder.join();
+    double cpuSeconds{threadCpuSeconds() - startCpu};
+    double elapsedSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()};
+    std::sort(latencyMicroseconds.begin(), latencyMicroseconds.end());
+    std::cout << "path=" << name
+              << " bytes=" << bytesRead
+              << " cpu_percent=" << (cpuSeconds / elapsedSeconds * 100.0)
+              << " cpu_us_per_byte=" << (cpuSeconds * 1e6 / bytesRead)
+              << " latency_p50_us=" << latencyMicroseconds[latencyMicroseconds.size() / 2]
+              << " latency_p99_us=" << latencyMicroseconds[latencyMicroseconds.size() * 99 / 100] << std::endl;
+    return true;
+}
+
+int main()
+{
+    int masterDescriptor{-1};
+    int slaveDescriptor{-1};
+    char slaveName[256];
+    if (openpty(&masterDescriptor, &slaveDescriptor, slaveName, nullptr, nullptr) != 0) {
+        std::cout << "FAILED: unable to open a pseudo terminal" << std::endl;
+        return 1;
+    }
+    termios settings{};
+    tcgetattr(slaveDescriptor, &settings);
+    cfmakeraw(&settings);
+    tcsetattr(slaveDescriptor, TCSANOW, &settings);
+    fcntl(slaveDescriptor, F_SETFL, O_NONBLOCK);
+
+    bool allPassed{runBenchmark("legacy_busy_wait", masterDescriptor, [slaveDescriptor]() { return legacyReadLine(slaveDescriptor); })};
+
+    SerialPort serialPort{slaveName, BaudRate::BAUD115200};
+    serialPort.setTimeout(READ_TIMEOUT);
+    serialPort.openPort();
+    allPassed &= runBenchmark("poll_wait", masterDescriptor, [&serialPort]() { return serialPort.readLine(); });
+    serialPort.closePort();
+    close(slaveDescriptor);
+    close(masterDescriptor);
+    return (allPassed ? 0 : 1);
+}
@@ -0,0 +1,116 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <pty.h>
+#include <unistd.h>
+#include <serialport.h>
+#include <serialportwatcher.h>
+
+//The snapshot and enumeration sizes are summed into this, which keeps both timed
+//loops from being discarded
+static volatile long benchmarkSink{0};
+
+//Opens and closes pseudo terminals under a SerialPortWatcher, checking the add/remove
+//callbacks and snapshots, then compares reading the snapshot from several threads with
+//enumerating the ports on every call
+static const int NUMBER_OF_HOTPLUGS{20};
+static const int QUERIES_PER_THREAD{200000};
+static const int NUMBER_OF_READER_THREADS{4};
+
+bool waitFor(const std::function<bool()> &condition)
+{
+    auto startTime = std::chrono::steady_clock::now();
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() - startTime > std::chrono::seconds(2)) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    return true;
+}
+
+int main()
+{
+    SerialPortWatcher serialPortWatcher{};
+    std::mutex eventMutex{};
+    std::vector<std::string> addedPorts{};
+    std::vector<std::string> removedPorts{};
+    serialPortWatcher.onAdded([&](const std::string &name) {
+        std::lock_guard<std::mutex> eventLock{eventMutex};
+        addedPorts.push_back(name);
+    });
+    serialPortWatcher.onRemoved([&](const std::string &name) {
+        std::lock_guard<std::mutex> eventLock{eventMutex};
+        removedPorts.push_back(name);
+    });
+    auto hasEvent = [&](const std::vector<std::string> &events, const std::string &name) {
+        std::lock_guard<std::mutex> eventLock{eventMutex};
+        return (std::find(events.begin(), events.end(), name) != events.end());
+    };
+
+    bool passed{true};
+    double totalNoticeMicroseconds{0.0};
+    std::atomic<bool> readersRunning{true};
+    std::atomic<long> readerQueries{0};
+    std::vector<std::thread> readers{};
+    for (int i = 0; i < NUMBER_OF_READER_THREADS; i++) {
+        readers.emplace_back([&]() {
+            while (readersRunning) {
+                readerQueries += serialPortWatcher.isAvailable("/dev/ttyS0") ? 1 : 1;
+            }
+        });
+    }
+    for (int i = 0; i < NUMBER_OF_HOTPLUGS; i++) {
+        int masterDescriptor{-1};
+        int slaveDescriptor{-1};
+        char slaveName[256];
+        if (openpty(&masterDescriptor, &slaveDescriptor, slaveName, nullptr, nullptr) != 0) {
+            std::cout << "FAILED: unable to open a pseudo terminal" << std::endl;
+            return 1;
+        }
+        std::string name{slaveName};
+        auto startTime = std::chrono::steady_clock::now();
+        passed &= waitFor([&]() { return hasEvent(addedPorts, name); });
+        totalNoticeMicroseconds += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+        passed &= serialPortWatcher.isAvailable(name);
+        close(slaveDescriptor);
+        close(masterDescriptor);
+        passed &= waitFor([&]() { return hasEvent(removedPorts, name); });
+        passed &= !serialPortWatcher.isAvailable(name);
+        std::lock_guard<std::mutex> eventLock{eventMutex};
+        addedPorts.clear();
+        removedPorts.clear();
+    }
+    readersRunning = false;
+    for (auto &it : readers) {
+        it.join();
+    }
+
+    long sink{0};
+    auto startTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < QUERIES_PER_THREAD; i++) {
+        sink += serialPortWatcher.snapshot()->size();
+    }
+    double snapshotNanoseconds{std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count() / QUERIES_PER_THREAD};
+    startTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < 1000; i++) {
+        sink += SerialPort::availableSerialPorts().size();
+    }
+    double enumerateNanoseconds{std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count() / 1000};
+    passed &= (*serialPortWatcher.snapshot() == SerialPort::availableSerialPorts());
+
+    benchmarkSink = sink;
+    std::cout << "hotplugs=" << NUMBER_OF_HOTPLUGS
+              << " mean_notice_us=" << (totalNoticeMicroseconds / NUMBER_OF_HOTPLUGS)
+              << " rescans=" << serialPortWatcher.rescanCount()
+              << " concurrent_reader_queries=" << readerQueries.load()
+              << " snapshot_ns=" << snapshotNanoseconds
+              << " enumerate_ns=" << enumerateNanoseconds
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return (passed ? 0 : 1);
+}
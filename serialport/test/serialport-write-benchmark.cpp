@@ -0,0 +1,143 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <pty.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <serialport.h>
+
+//Sends bursts of short commands to a pseudo terminal and reports time and write
+//syscalls per burst for the previous byte at a time path (reproduced on a raw
+//descriptor), unbuffered writeLine(), buffered writeLine() and a single write()
+static const int NUMBER_OF_BURSTS{50};
+static const int COMMANDS_PER_BURST{1000};
+
+long long writeSyscallCount()
+{
+    std::ifstream processIo{"/proc/self/io"};
+    std::string key{};
+    long long value{0};
+    while (processIo >> key >> value) {
+        if (key == "syscw:") {
+            return value;
+        }
+    }
+    return -1;
+}
+
+std::string commandFor(int commandNumber)
+{
+    return "SET:CH" + std::to_string(commandNumber % 16) + ":VALUE=" + std::to_string(commandNumber);
+}
+
+void drainMaster(int masterDescriptor, std::atomic<long long> *bytesReceived, std::atomic<bool> *stopDraining)
+{
+    char buffer[65536];
+    while (!stopDraining->load()) {
+        ssize_t received{::read(masterDescriptor, buffer, sizeof(buffer))};
+        if (received > 0) {
+            *bytesReceived += received;
+        }
+    }
+}
+
+ssize_t legacyWriteLine(int descriptor, const std::string &str)
+{
+    std::string copyString{str + "\r\n"};
+    ssize_t writtenBytes{0};
+    for (const char *it = copyString.c_str(); *it != 0; it++) {
+        while (::write(descriptor, it, 1) != 1) {
+            std::this_thread::yield();
+        }
+        writtenBytes++;
+    }
+    return writtenBytes;
+}
+
+template <typename SendBurst>
+void runBenchmark(const std::string &name, const SendBurst &sendBurst, const std::atomic<long long> &bytesReceived)
+{
+    long long expectedBytes{0};
+    for (int i = 0; i < COMMANDS_PER_BURST; i++) {
+        expectedBytes += commandFor(i).length() + 2;
+    }
+    expectedBytes *= NUMBER_OF_BURSTS;
+    long long startBytes{bytesReceived.load()};
+    long long startSyscalls{writeSyscallCount()};
+    auto startTime = std::chrono::steady_clock::now();
+    for (int burst = 0; burst < NUMBER_OF_BURSTS; burst++) {
+        sendBurst();
+    }
+    while (bytesReceived.load() - startBytes < expectedBytes) {
+        std::this_thread::yield();
+    }
+    double elapsedSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()};
+    std::cout << "path=" << name
+              << " bytes=" << (bytesReceived.load() - startBytes)
+              << " writes_per_burst=" << (writeSyscallCount() - startSyscalls) / NUMBER_OF_BURSTS
+              << " us_per_burst=" << (elapsedSeconds * 1e6 / NUMBER_OF_BURSTS) << std::endl;
+}
+
+int main()
+{
+    int masterDescriptor{-1};
+    int slaveDescriptor{-1};
+    char slaveName[256];
+    if (openpty(&masterDescriptor, &slaveDescriptor, slaveName, nullptr, nullptr) != 0) {
+        std::cout << "FAILED: unable to open a pseudo terminal" << std::endl;
+        return 1;
+    }
+    termios settings{};
+    tcgetattr(slaveDescriptor, &settings);
+    cfmakeraw(&settings);
+    tcsetattr(slaveDescriptor, TCSANOW, &settings);
+    fcntl(slaveDescriptor, F_SETFL, O_NONBLOCK);
+
+    std::atomic<long long> bytesReceived{0};
+    std::atomic<bool> stopDraining{false};
+    std::thread drainThread{drainMaster, masterDescriptor, &bytesReceived, &stopDraining};
+
+    std::vector<std::string> commands{};
+    std::string wholeBurst{};
+    for (int i = 0; i < COMMANDS_PER_BURST; i++) {
+        commands.push_back(commandFor(i));
+        wholeBurst += commands.back() + "\r\n";
+    }
+
+    runBenchmark("legacy_byte_writes", [&]() {
+        for (auto &it : commands) {
+            legacyWriteLine(slaveDescriptor, it);
+        }
+    }, bytesReceived);
+
+    SerialPort serialPort{slaveName, BaudRate::BAUD4000000};
+    serialPort.openPort();
+    runBenchmark("write_line", [&]() {
+        for (auto &it : commands) {
+            serialPort.writeLine(it);
+        }
+    }, bytesReceived);
+    serialPort.setOutputBufferEnabled(true);
+    runBenchmark("buffered_write_line", [&]() {
+        for (auto &it : commands) {
+            serialPort.writeLine(it);
+        }
+        serialPort.flushOutputBuffer();
+    }, bytesReceived);
+    serialPort.setOutputBufferEnabled(false);
+    runBenchmark("single_write", [&]() {
+        serialPort.write(wholeBurst);
+    }, bytesReceived);
+
+    serialPort.closePort();
+    stopDraining.store(true);
+    ::write(slaveDescriptor, "\n", 1);
+    drainThread.join();
+    close(slaveDescriptor);
+    close(masterDescriptor);
+    return 0;
+}
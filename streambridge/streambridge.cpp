@@ -0,0 +1,781 @@
+/***********************************************************************
+*    streambridge.cpp:                                                 *
+*    StreamBridge, forwards data between two byte stream endpoints     *
+*    Copyright (c) 2017 Tyler Lewis                                    *
+************************************************************************
+*    This is a source file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the implementation of the StreamBridge and        *
+*    StreamBridgeEndpoint classes                                      *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#include "streambridge.h"
+#include "serialport.h"
+#include "udpduplex.h"
+
+const constexpr size_t StreamBridge::DEFAULT_SLOT_COUNT;
+const constexpr size_t StreamBridge::DEFAULT_SLOT_LENGTH;
+
+//How long a reader waits after its source threw, before trying again
+static const std::chrono::milliseconds READ_FAILURE_BACKOFF{10};
+//How long to wait before reading again from a source that cannot wait for data itself
+static const std::chrono::milliseconds IDLE_READ_WAIT{1};
+
+class SerialPortBridgeEndpoint : public StreamBridgeEndpoint
+{
+public:
+    SerialPortBridgeEndpoint(std::shared_ptr<SerialPort> serialPort) :
+        m_serialPort{serialPort}
+    {
+
+    }
+
+    ssize_t read(char *buffer, size_t length)
+    {
+        return this->m_serialPort->read(reinterpret_cast<uint8_t *>(buffer), length);
+    }
+
+    ssize_t write(const char *data, size_t length)
+    {
+        return this->m_serialPort->write(reinterpret_cast<const uint8_t *>(data), length);
+    }
+
+    void flush()
+    {
+        if (this->m_serialPort->outputBufferEnabled()) {
+            this->m_serialPort->flushOutputBuffer();
+        }
+    }
+
+    std::string name() const
+    {
+        return this->m_serialPort->portName();
+    }
+
+private:
+    std::shared_ptr<SerialPort> m_serialPort;
+};
+
+class UDPDuplexBridgeEndpoint : public StreamBridgeEndpoint
+{
+public:
+    UDPDuplexBridgeEndpoint(std::shared_ptr<UDPDuplex> udpDuplex) :
+        m_udpDuplex{udpDuplex}
+    {
+
+    }
+
+    ssize_t read(char *buffer, size_t length)
+    {
+        ssize_t readBytes{this->m_udpDuplex->readDatagram(buffer, length)};
+        //A listening duplex or a client only ever hands back what is already queued, and
+        //does not wait for more, so give the reader something to wait on
+        if ((readBytes <= 0) && ((this->m_udpDuplex->udpObjectType() == UDPObjectType::Client) || (this->m_udpDuplex->isListening()))) {
+            std::this_thread::sleep_for(IDLE_READ_WAIT);
+        }
+        return readBytes;
+    }
+
+    ssize_t write(const char *data, size_t length)
+    {
+        return ((this->m_udpDuplex->write(data, length) > 0) ? static_cast<ssize_t>(length) : 0);
+    }
+
+    bool isMessageOriented() const
+    {
+        return true;
+    }
+
+    unsigned long long oversizeMessageCount() const
+    {
+        return this->m_udpDuplex->oversizeDatagramCount();
+    }
+
+    std::string name() const
+    {
+        return this->m_udpDuplex->portName();
+    }
+
+private:
+    std::shared_ptr<UDPDuplex> m_udpDuplex;
+};
+
+class ByteStreamBridgeEndpoint : public StreamBridgeEndpoint
+{
+public:
+    ByteStreamBridgeEndpoint(std::shared_ptr<IByteStream> byteStream) :
+        m_byteStream{byteStream},
+        m_pending{""}
+    {
+
+    }
+
+    ssize_t read(char *buffer, size_t length)
+    {
+        if (this->m_pending.empty()) {
+            std::string line{this->m_byteStream->readLine()};
+            if (line.empty()) {
+                return 0;
+            }
+            this->m_pending = line + this->m_byteStream->lineEnding();
+        }
+        size_t copyLength{std::min(length, this->m_pending.length())};
+        memcpy(buffer, this->m_pending.data(), copyLength);
+        this->m_pending.erase(0, copyLength);
+        return copyLength;
+    }
+
+    ssize_t write(const char *data, size_t length)
+    {
+        return ((this->m_byteStream->writeLine(std::string(data, length)) > 0) ? static_cast<ssize_t>(length) : 0);
+    }
+
+    std::string name() const
+    {
+        return this->m_byteStream->portName();
+    }
+
+private:
+    std::shared_ptr<IByteStream> m_byteStream;
+    std::string m_pending;
+};
+
+std::shared_ptr<StreamBridgeEndpoint> StreamBridgeEndpoint::fromSerialPort(std::shared_ptr<SerialPort> serialPort)
+{
+    if (!serialPort) {
+        throw std::runtime_error("In StreamBridgeEndpoint::fromSerialPort(std::shared_ptr<SerialPort>): SerialPort is a nullptr");
+    }
+    return std::make_shared<SerialPortBridgeEndpoint>(serialPort);
+}
+
+std::shared_ptr<StreamBridgeEndpoint> StreamBridgeEndpoint::fromUDPDuplex(std::shared_ptr<UDPDuplex> udpDuplex)
+{
+    if (!udpDuplex) {
+        throw std::runtime_error("In StreamBridgeEndpoint::fromUDPDuplex(std::shared_ptr<UDPDuplex>): UDPDuplex is a nullptr");
+    }
+    return std::make_shared<UDPDuplexBridgeEndpoint>(udpDuplex);
+}
+
+std::shared_ptr<StreamBridgeEndpoint> StreamBridgeEndpoint::fromByteStream(std::shared_ptr<IByteStream> byteStream)
+{
+    if (!byteStream) {
+        throw std::runtime_error("In StreamBridgeEndpoint::fromByteStream(std::shared_ptr<IByteStream>): IByteStream is a nullptr");
+    }
+    return std::make_shared<ByteStreamBridgeEndpoint>(byteStream);
+}
+
+//One direction of a bridge. The slots are allocated once, up front: slotCount of them
+//for messages waiting to be written, plus the one the reader is currently filling.
+//Slot numbers move between the free and ready queues, and the bytes stay where they are
+class StreamBridge::Pump
+{
+public:
+    Pump(std::shared_ptr<StreamBridgeEndpoint> source,
+         std::shared_ptr<StreamBridgeEndpoint> destination,
+         const std::string &delimiter,
+         bool batchingEnabled,
+         StreamBridgeOverflowPolicy overflowPolicy,
+         size_t slotCount,
+         size_t slotLength,
+         const ThreadConfiguration &threadConfiguration);
+    ~Pump();
+
+    void stop();
+    StreamBridgeStatistics statistics() const;
+    void resetStatistics();
+
+private:
+    //Fixed capacity ring of slot numbers, so moving a slot never allocates
+    class SlotQueue
+    {
+    public:
+        SlotQueue(size_t capacity) :
+            m_slots(capacity),
+            m_head{0},
+            m_count{0}
+        {
+
+        }
+
+        bool empty() const { return (this->m_count == 0); }
+        size_t front() const { return this->m_slots[this->m_head]; }
+        void push(size_t slot)
+        {
+            this->m_slots[(this->m_head + this->m_count) % this->m_slots.size()] = slot;
+            this->m_count++;
+        }
+        size_t pop()
+        {
+            size_t slot{this->m_slots[this->m_head]};
+            this->m_head = (this->m_head + 1) % this->m_slots.size();
+            this->m_count--;
+            return slot;
+        }
+
+    private:
+        std::vector<size_t> m_slots;
+        size_t m_head;
+        size_t m_count;
+    };
+
+    std::shared_ptr<StreamBridgeEndpoint> m_source;
+    std::shared_ptr<StreamBridgeEndpoint> m_destination;
+    const std::string m_delimiter;
+    const bool m_batchingEnabled;
+    const StreamBridgeOverflowPolicy m_overflowPolicy;
+    const size_t m_slotLength;
+    std::vector<char> m_slots;
+    std::vector<size_t> m_slotLengths;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_readyCondition;
+    std::condition_variable m_spaceCondition;
+    SlotQueue m_readySlots;
+    SlotQueue m_freeSlots;
+    StreamBridgeStatistics m_statistics;
+    bool m_shutEmDown;
+
+#if defined(__ANDROID__)
+    std::thread *m_readerFuture;
+    std::thread *m_writerFuture;
+#else
+    std::future<void> m_readerFuture;
+    std::future<void> m_writerFuture;
+#endif
+
+    void asyncReader();
+    void asyncWriter();
+    char *slot(size_t slotNumber);
+    size_t nextRecordEnd(const char *data, size_t position, size_t length) const;
+    size_t findRecordsEnd(const char *data, size_t scanFrom, size_t length, unsigned long long *records) const;
+    void writeMessage(const char *message, size_t length, StreamBridgeStatistics *written);
+};
+
+StreamBridge::Pump::Pump(std::shared_ptr<StreamBridgeEndpoint> source,
+                         std::shared_ptr<StreamBridgeEndpoint> destination,
+                         const std::string &delimiter,
+                         bool batchingEnabled,
+                         StreamBridgeOverflowPolicy overflowPolicy,
+                         size_t slotCount,
+                         size_t slotLength,
+                         const ThreadConfiguration &threadConfiguration) :
+    m_source{source},
+    m_destination{destination},
+    m_delimiter{delimiter},
+    m_batchingEnabled{batchingEnabled},
+    m_overflowPolicy{overflowPolicy},
+    m_slotLength{slotLength},
+    m_slots((slotCount + 1) * slotLength),
+    m_slotLengths(slotCount + 1),
+    m_readySlots{slotCount + 1},
+    m_freeSlots{slotCount + 1},
+    m_statistics{},
+    m_shutEmDown{false}
+{
+    //The last slot starts out with the reader
+    for (size_t i = 0; i < slotCount; i++) {
+        this->m_freeSlots.push(i);
+    }
+#if defined(__ANDROID__)
+    this->m_readerFuture = nullptr;
+    this->m_writerFuture = nullptr;
+#endif
+    try {
+#if defined(__ANDROID__)
+        this->m_readerFuture = threadConfiguration.launchThread([this]() { this->asyncReader(); });
+        this->m_writerFuture = threadConfiguration.launchThread([this]() { this->asyncWriter(); });
+#else
+        this->m_readerFuture = threadConfiguration.launch([this]() { this->asyncReader(); });
+        this->m_writerFuture = threadConfiguration.launch([this]() { this->asyncWriter(); });
+#endif
+    } catch (std::exception &) {
+        //The reader may have started already
+        this->stop();
+        throw;
+    }
+}
+
+StreamBridge::Pump::~Pump()
+{
+    this->stop();
+}
+
+void StreamBridge::Pump::stop()
+{
+    {
+        std::lock_guard<std::mutex> pumpLock{this->m_mutex};
+        this->m_shutEmDown = true;
+    }
+    this->m_readyCondition.notify_all();
+    this->m_spaceCondition.notify_all();
+#if defined(__ANDROID__)
+    if (this->m_readerFuture) {
+        this->m_readerFuture->join();
+        delete this->m_readerFuture;
+        this->m_readerFuture = nullptr;
+    }
+    if (this->m_writerFuture) {
+        this->m_writerFuture->join();
+        delete this->m_writerFuture;
+        this->m_writerFuture = nullptr;
+    }
+#else
+    if (this->m_readerFuture.valid()) {
+        this->m_readerFuture.wait();
+    }
+    if (this->m_writerFuture.valid()) {
+        this->m_writerFuture.wait();
+    }
+#endif
+}
+
+StreamBridgeStatistics StreamBridge::Pump::statistics() const
+{
+    std::lock_guard<std::mutex> pumpLock{this->m_mutex};
+    return this->m_statistics;
+}
+
+void StreamBridge::Pump::resetStatistics()
+{
+    std::lock_guard<std::mutex> pumpLock{this->m_mutex};
+    this->m_statistics = StreamBridgeStatistics{};
+}
+
+char *StreamBridge::Pump::slot(size_t slotNumber)
+{
+    return this->m_slots.data() + (slotNumber * this->m_slotLength);
+}
+
+//Returns the end of the first delimiter that starts at or after position, or 0 if there is none
+size_t StreamBridge::Pump::nextRecordEnd(const char *data, size_t position, size_t length) const
+{
+    const size_t delimiterLength{this->m_delimiter.length()};
+    const char lastDelimiterByte{this->m_delimiter.back()};
+    while (position + delimiterLength <= length) {
+        size_t searchFrom{position + delimiterLength - 1};
+        const char *lastByte{static_cast<const char *>(memchr(data + searchFrom, lastDelimiterByte, length - searchFrom))};
+        if (!lastByte) {
+            return 0;
+        }
+        size_t end{static_cast<size_t>(lastByte - data) + 1};
+        if (memcmp(data + end - delimiterLength, this->m_delimiter.data(), delimiterLength) == 0) {
+            return end;
+        }
+        position = end - delimiterLength + 1;
+    }
+    return 0;
+}
+
+//Returns the end of the last whole record in data, or 0 if there is none yet. Everything
+//before scanFrom was already scanned, and held no whole record
+size_t StreamBridge::Pump::findRecordsEnd(const char *data, size_t scanFrom, size_t length, unsigned long long *records) const
+{
+    //A delimiter may have started in the bytes that were already scanned
+    size_t position{(scanFrom >= this->m_delimiter.length()) ? (scanFrom - this->m_delimiter.length() + 1) : 0};
+    size_t recordsEnd{0};
+    size_t end{0};
+    while ((end = this->nextRecordEnd(data, position, length)) != 0) {
+        recordsEnd = end;
+        position = end;
+        (*records)++;
+    }
+    return recordsEnd;
+}
+
+void StreamBridge::Pump::asyncReader()
+{
+    const bool isMessageOriented{this->m_source->isMessageOriented()};
+    const bool splitsRecords{(!isMessageOriented) && (!this->m_delimiter.empty())};
+    size_t current{this->m_slotLengths.size() - 1};
+    size_t filled{0};
+    size_t scanned{0};
+    unsigned long long oversizeMessages{this->m_source->oversizeMessageCount()};
+    while (true) {
+        {
+            std::lock_guard<std::mutex> pumpLock{this->m_mutex};
+            if (this->m_shutEmDown) {
+                return;
+            }
+        }
+        char *currentSlot{this->slot(current)};
+        ssize_t readBytes{0};
+        try {
+            readBytes = this->m_source->read(currentSlot + filled, this->m_slotLength - filled);
+        } catch (std::exception &e) {
+            (void)e;
+            {
+                std::lock_guard<std::mutex> pumpLock{this->m_mutex};
+                this->m_statistics.readFailures++;
+            }
+            std::this_thread::sleep_for(READ_FAILURE_BACKOFF);
+            continue;
+        }
+        if (readBytes <= 0) {
+            //A message that did not fit in the slot is not handed back at all
+            if (isMessageOriented) {
+                unsigned long long droppedMessages{this->m_source->oversizeMessageCount() - oversizeMessages};
+                if (droppedMessages > 0) {
+                    oversizeMessages += droppedMessages;
+                    std::lock_guard<std::mutex> pumpLock{this->m_mutex};
+                    this->m_statistics.messagesIn += droppedMessages;
+                    this->m_statistics.messagesDropped += droppedMessages;
+                }
+            }
+            continue;
+        }
+        filled += static_cast<size_t>(readBytes);
+        size_t messageEnd{filled};
+        unsigned long long records{1};
+        if (splitsRecords) {
+            records = 0;
+            messageEnd = this->findRecordsEnd(currentSlot, scanned, filled, &records);
+            if (records == 0) {
+                if (filled < this->m_slotLength) {
+                    std::lock_guard<std::mutex> pumpLock{this->m_mutex};
+                    this->m_statistics.bytesIn += static_cast<size_t>(readBytes);
+                    scanned = filled;
+                    continue;
+                }
+                //A record that does not fit in a slot goes out in pieces
+                messageEnd = filled;
+                records = 1;
+            }
+        }
+
+        std::unique_lock<std::mutex> pumpLock{this->m_mutex};
+        this->m_statistics.bytesIn += static_cast<size_t>(readBytes);
+        this->m_statistics.messagesIn += records;
+        if (this->m_overflowPolicy == StreamBridgeOverflowPolicy::Block) {
+            this->m_spaceCondition.wait(pumpLock, [this]() {
+                return (this->m_shutEmDown) || (!this->m_freeSlots.empty());
+            });
+            if (this->m_shutEmDown) {
+                return;
+            }
+        }
+        size_t remaining{filled - messageEnd};
+        if (this->m_freeSlots.empty()) {
+            //Drop the whole records just read, and keep any partial one that follows
+            this->m_statistics.bytesDropped += messageEnd;
+            this->m_statistics.messagesDropped += records;
+            pumpLock.unlock();
+            memmove(currentSlot, currentSlot + messageEnd, remaining);
+        } else {
+            size_t next{this->m_freeSlots.pop()};
+            this->m_slotLengths[current] = messageEnd;
+            this->m_readySlots.push(current);
+            pumpLock.unlock();
+            this->m_readyCondition.notify_one();
+            memcpy(this->slot(next), currentSlot + messageEnd, remaining);
+            current = next;
+        }
+        filled = remaining;
+        scanned = remaining;
+    }
+}
+
+void StreamBridge::Pump::asyncWriter()
+{
+    std::unique_lock<std::mutex> pumpLock{this->m_mutex};
+    while (true) {
+        this->m_readyCondition.wait(pumpLock, [this]() {
+            return (this->m_shutEmDown) || (!this->m_readySlots.empty());
+        });
+        if (this->m_shutEmDown) {
+            return;
+        }
+        size_t ready{this->m_readySlots.front()};
+        size_t length{this->m_slotLengths[ready]};
+        pumpLock.unlock();
+
+        StreamBridgeStatistics written{};
+        const char *message{this->slot(ready)};
+        if ((this->m_batchingEnabled) || (this->m_delimiter.empty()) || (this->m_source->isMessageOriented())) {
+            this->writeMessage(message, length, &written);
+        } else {
+            size_t start{0};
+            while (start < length) {
+                size_t end{this->nextRecordEnd(message, start, length)};
+                if (end == 0) {
+                    end = length;
+                }
+                this->writeMessage(message + start, end - start, &written);
+                start = end;
+            }
+        }
+
+        pumpLock.lock();
+        this->m_readySlots.pop();
+        this->m_freeSlots.push(ready);
+        this->m_statistics.bytesOut += written.bytesOut;
+        this->m_statistics.messagesOut += written.messagesOut;
+        this->m_statistics.bytesDropped += written.bytesDropped;
+        this->m_statistics.writeFailures += written.writeFailures;
+        bool caughtUp{this->m_readySlots.empty()};
+        pumpLock.unlock();
+        this->m_spaceCondition.notify_one();
+        if (caughtUp) {
+            try {
+                this->m_destination->flush();
+            } catch (std::exception &e) {
+                (void)e;
+            }
+        }
+        pumpLock.lock();
+    }
+}
+
+//The destination waits up to its own timeout in each write(), so the rest of a message is
+//written again for as long as every attempt takes some of it. Whatever is left once one
+//takes nothing is counted as dropped, so bytesOut and bytesDropped still add up to bytesIn
+void StreamBridge::Pump::writeMessage(const char *message, size_t length, StreamBridgeStatistics *written)
+{
+    size_t totalWritten{0};
+    while (totalWritten < length) {
+        ssize_t writtenBytes{0};
+        try {
+            writtenBytes = this->m_destination->write(message + totalWritten, length - totalWritten);
+        } catch (std::exception &e) {
+            (void)e;
+            writtenBytes = 0;
+        }
+        if (writtenBytes <= 0) {
+            break;
+        }
+        totalWritten += std::min(static_cast<size_t>(writtenBytes), length - totalWritten);
+    }
+    written->bytesOut += totalWritten;
+    if (totalWritten == length) {
+        written->messagesOut++;
+    } else {
+        written->bytesDropped += length - totalWritten;
+        written->writeFailures++;
+    }
+}
+
+StreamBridge::StreamBridge(std::shared_ptr<StreamBridgeEndpoint> first, std::shared_ptr<StreamBridgeEndpoint> second) :
+    m_first{first},
+    m_second{second},
+    m_firstToSecond{nullptr},
+    m_secondToFirst{nullptr},
+    m_isRunning{false},
+    m_delimiter{""},
+    m_batchingEnabled{true},
+    m_overflowPolicy{StreamBridgeOverflowPolicy::DropNewest},
+    m_slotCount{StreamBridge::DEFAULT_SLOT_COUNT},
+    m_slotLength{StreamBridge::DEFAULT_SLOT_LENGTH},
+    m_threadConfiguration{}
+{
+    if ((!this->m_first) || (!this->m_second)) {
+        throw std::runtime_error("In StreamBridge::StreamBridge(std::shared_ptr<StreamBridgeEndpoint>, std::shared_ptr<StreamBridgeEndpoint>): StreamBridgeEndpoint is a nullptr");
+    }
+}
+
+StreamBridge::StreamBridge(std::shared_ptr<SerialPort> serialPort, std::shared_ptr<UDPDuplex> udpDuplex) :
+    StreamBridge{StreamBridgeEndpoint::fromSerialPort(serialPort), StreamBridgeEndpoint::fromUDPDuplex(udpDuplex)}
+{
+    this->m_delimiter = serialPort->lineEnding();
+}
+
+StreamBridge::~StreamBridge()
+{
+    this->stop();
+}
+
+void StreamBridge::start()
+{
+    this->start(StreamBridgeDirection::Both);
+}
+
+void StreamBridge::start(StreamBridgeDirection direction)
+{
+    this->checkStopped("start(StreamBridgeDirection)");
+    this->m_firstToSecond.reset();
+    this->m_secondToFirst.reset();
+    try {
+        this->startPumps(direction);
+    } catch (std::exception &e) {
+        this->m_firstToSecond.reset();
+        this->m_secondToFirst.reset();
+        throw std::runtime_error("In StreamBridge::start(StreamBridgeDirection): Unable to start the bridge: " + std::string{e.what()});
+    }
+    this->m_isRunning = true;
+}
+
+void StreamBridge::startPumps(StreamBridgeDirection direction)
+{
+    if ((direction == StreamBridgeDirection::FirstToSecond) || (direction == StreamBridgeDirection::Both)) {
+        this->m_firstToSecond = std::unique_ptr<Pump>{new Pump{this->m_first,
+                                                               this->m_second,
+                                                               this->m_delimiter,
+                                                               this->m_batchingEnabled,
+                                                               this->m_overflowPolicy,
+                                                               this->m_slotCount,
+                                                               this->m_slotLength,
+                                                               this->m_threadConfiguration}};
+    }
+    if ((direction == StreamBridgeDirection::SecondToFirst) || (direction == StreamBridgeDirection::Both)) {
+        this->m_secondToFirst = std::unique_ptr<Pump>{new Pump{this->m_second,
+                                                               this->m_first,
+                                                               this->m_delimiter,
+                                                               this->m_batchingEnabled,
+                                                               this->m_overflowPolicy,
+                                                               this->m_slotCount,
+                                                               this->m_slotLength,
+                                                               this->m_threadConfiguration}};
+    }
+}
+
+void StreamBridge::stop()
+{
+    if (this->m_firstToSecond) {
+        this->m_firstToSecond->stop();
+    }
+    if (this->m_secondToFirst) {
+        this->m_secondToFirst->stop();
+    }
+    this->m_isRunning = false;
+}
+
+bool StreamBridge::isRunning() const
+{
+    return this->m_isRunning;
+}
+
+std::shared_ptr<StreamBridgeEndpoint> StreamBridge::first() const
+{
+    return this->m_first;
+}
+
+std::shared_ptr<StreamBridgeEndpoint> StreamBridge::second() const
+{
+    return this->m_second;
+}
+
+std::string StreamBridge::delimiter() const
+{
+    return this->m_delimiter;
+}
+
+void StreamBridge::setDelimiter(const std::string &delimiter)
+{
+    this->checkStopped("setDelimiter(const std::string &)");
+    this->m_delimiter = delimiter;
+}
+
+bool StreamBridge::batchingEnabled() const
+{
+    return this->m_batchingEnabled;
+}
+
+void StreamBridge::setBatchingEnabled(bool batchingEnabled)
+{
+    this->checkStopped("setBatchingEnabled(bool)");
+    this->m_batchingEnabled = batchingEnabled;
+}
+
+StreamBridgeOverflowPolicy StreamBridge::overflowPolicy() const
+{
+    return this->m_overflowPolicy;
+}
+
+void StreamBridge::setOverflowPolicy(StreamBridgeOverflowPolicy overflowPolicy)
+{
+    this->checkStopped("setOverflowPolicy(StreamBridgeOverflowPolicy)");
+    this->m_overflowPolicy = overflowPolicy;
+}
+
+size_t StreamBridge::slotCount() const
+{
+    return this->m_slotCount;
+}
+
+void StreamBridge::setSlotCount(size_t slotCount)
+{
+    this->checkStopped("setSlotCount(size_t)");
+    if (slotCount == 0) {
+        throw std::runtime_error("In StreamBridge::setSlotCount(size_t): At least one slot is needed");
+    }
+    this->m_slotCount = slotCount;
+}
+
+size_t StreamBridge::slotLength() const
+{
+    return this->m_slotLength;
+}
+
+void StreamBridge::setSlotLength(size_t slotLength)
+{
+    this->checkStopped("setSlotLength(size_t)");
+    if (slotLength == 0) {
+        throw std::runtime_error("In StreamBridge::setSlotLength(size_t): Slots cannot be empty");
+    }
+    this->m_slotLength = slotLength;
+}
+
+ThreadConfiguration StreamBridge::threadConfiguration() const
+{
+    return this->m_threadConfiguration;
+}
+
+void StreamBridge::setThreadConfiguration(const ThreadConfiguration &threadConfiguration)
+{
+    this->checkStopped("setThreadConfiguration(const ThreadConfiguration &)");
+    this->m_threadConfiguration = threadConfiguration;
+}
+
+StreamBridgeStatistics StreamBridge::statistics(StreamBridgeDirection direction) const
+{
+    StreamBridgeStatistics firstToSecond{};
+    StreamBridgeStatistics secondToFirst{};
+    if (this->m_firstToSecond) {
+        firstToSecond = this->m_firstToSecond->statistics();
+    }
+    if (this->m_secondToFirst) {
+        secondToFirst = this->m_secondToFirst->statistics();
+    }
+    if (direction == StreamBridgeDirection::FirstToSecond) {
+        return firstToSecond;
+    } else if (direction == StreamBridgeDirection::SecondToFirst) {
+        return secondToFirst;
+    }
+    firstToSecond.bytesIn += secondToFirst.bytesIn;
+    firstToSecond.messagesIn += secondToFirst.messagesIn;
+    firstToSecond.bytesOut += secondToFirst.bytesOut;
+    firstToSecond.messagesOut += secondToFirst.messagesOut;
+    firstToSecond.bytesDropped += secondToFirst.bytesDropped;
+    firstToSecond.messagesDropped += secondToFirst.messagesDropped;
+    firstToSecond.readFailures += secondToFirst.readFailures;
+    firstToSecond.writeFailures += secondToFirst.writeFailures;
+    return firstToSecond;
+}
+
+void StreamBridge::resetStatistics()
+{
+    if (this->m_firstToSecond) {
+        this->m_firstToSecond->resetStatistics();
+    }
+    if (this->m_secondToFirst) {
+        this->m_secondToFirst->resetStatistics();
+    }
+}
+
+void StreamBridge::checkStopped(const std::string &functionName) const
+{
+    if (this->m_isRunning) {
+        throw std::runtime_error("In StreamBridge::" + functionName + ": The bridge is running, stop() it first");
+    }
+}
+
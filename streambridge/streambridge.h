@@ -0,0 +1,172 @@
+/***********************************************************************
+*    streambridge.h:                                                   *
+*    StreamBridge, forwards data between two byte stream endpoints     *
+*    Copyright (c) 2017 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the declarations of the StreamBridge and          *
+*    StreamBridgeEndpoint classes. A bridge moves data between two     *
+*    endpoints (a SerialPort and a UDPDuplex, for instance) in one or  *
+*    both directions. Each direction reads straight into one of a      *
+*    fixed number of preallocated slots on one thread and writes the   *
+*    filled slots out on another, so nothing is allocated per message  *
+*    and a slow destination only ever holds up a bounded amount of     *
+*    data                                                              *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#ifndef TJLUTILS_STREAMBRIDGE_H
+#define TJLUTILS_STREAMBRIDGE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <thread>
+#include <cstdint>
+
+#include "ibytestream.h"
+#include "threadconfiguration.h"
+
+class SerialPort;
+class UDPDuplex;
+
+enum class StreamBridgeDirection {
+    FirstToSecond,
+    SecondToFirst,
+    Both
+};
+
+//What a direction does with newly read data while every slot is still waiting to be written
+//DropNewest: the new data is discarded and counted, so the source keeps being drained
+//Block: reading stops until the destination has caught up
+enum class StreamBridgeOverflowPolicy {
+    DropNewest,
+    Block
+};
+
+struct StreamBridgeStatistics
+{
+    unsigned long long bytesIn;
+    unsigned long long messagesIn;
+    unsigned long long bytesOut;
+    unsigned long long messagesOut;
+    unsigned long long bytesDropped;
+    unsigned long long messagesDropped;
+    unsigned long long readFailures;
+    unsigned long long writeFailures;
+};
+
+//One side of a StreamBridge. read() waits up to the endpoint's own timeout and returns 0
+//if nothing arrived, and write() returns length once all of it has been taken. A message
+//oriented endpoint returns one whole message (a datagram, for instance) from each read(),
+//any other is treated as a stream of bytes
+class StreamBridgeEndpoint
+{
+public:
+    virtual ~StreamBridgeEndpoint() { }
+
+    virtual ssize_t read(char *buffer, size_t length) = 0;
+    virtual ssize_t write(const char *data, size_t length) = 0;
+    //Called whenever the writes queued for this endpoint have run out
+    virtual void flush() { }
+    virtual bool isMessageOriented() const { return false; }
+    //How many messages read() has thrown away so far because they were longer than the
+    //buffer it was given. The bridge counts them as dropped
+    virtual unsigned long long oversizeMessageCount() const { return 0; }
+    virtual std::string name() const = 0;
+
+    //Binary reads and writes, nothing added to or removed from the bytes
+    static std::shared_ptr<StreamBridgeEndpoint> fromSerialPort(std::shared_ptr<SerialPort> serialPort);
+    //One datagram per message, sent without a line ending. The duplex should not be
+    //listening, so that datagrams are received straight into the bridge's slots
+    static std::shared_ptr<StreamBridgeEndpoint> fromUDPDuplex(std::shared_ptr<UDPDuplex> udpDuplex);
+    //Any other IByteStream, through readLine() and writeLine(). Every line is copied into
+    //a std::string on the way, so use one of the above where they apply
+    static std::shared_ptr<StreamBridgeEndpoint> fromByteStream(std::shared_ptr<IByteStream> byteStream);
+};
+
+//When a delimiter is set, data from a stream endpoint is cut into records on it, and every
+//message written holds whole records only, each still ending in its own delimiter. With
+//batching enabled (the default), the records that arrived together go out as one message
+//of up to slotLength() bytes, otherwise every record is written on its own. Without a
+//delimiter each read is passed on as it is. A record longer than a slot is passed on in
+//slot sized pieces. Messages from a message oriented endpoint are always passed on whole,
+//and one longer than a slot is dropped (counted in messagesIn and messagesDropped only,
+//since its length is not known). A message the destination stops taking part way through
+//counts as a write failure, and its unwritten bytes as dropped
+//
+//The settings can only be changed while the bridge is stopped. Statistics are kept after
+//stop() and cleared by the next start()
+class StreamBridge
+{
+public:
+    StreamBridge(std::shared_ptr<StreamBridgeEndpoint> first, std::shared_ptr<StreamBridgeEndpoint> second);
+    //The serial port is the first endpoint, and its line ending becomes the delimiter
+    StreamBridge(std::shared_ptr<SerialPort> serialPort, std::shared_ptr<UDPDuplex> udpDuplex);
+    ~StreamBridge();
+
+    StreamBridge(const StreamBridge &other) = delete;
+    StreamBridge &operator=(const StreamBridge &rhs) = delete;
+
+    void start();
+    void start(StreamBridgeDirection direction);
+    void stop();
+    bool isRunning() const;
+
+    std::shared_ptr<StreamBridgeEndpoint> first() const;
+    std::shared_ptr<StreamBridgeEndpoint> second() const;
+
+    std::string delimiter() const;
+    void setDelimiter(const std::string &delimiter);
+    bool batchingEnabled() const;
+    void setBatchingEnabled(bool batchingEnabled);
+    StreamBridgeOverflowPolicy overflowPolicy() const;
+    void setOverflowPolicy(StreamBridgeOverflowPolicy overflowPolicy);
+    size_t slotCount() const;
+    void setSlotCount(size_t slotCount);
+    size_t slotLength() const;
+    void setSlotLength(size_t slotLength);
+    //The reader and writer threads of every direction are started with this (see
+    //threadconfiguration.h). A launcher gives up two of its threads per direction for as
+    //long as the bridge runs
+    ThreadConfiguration threadConfiguration() const;
+    void setThreadConfiguration(const ThreadConfiguration &threadConfiguration);
+
+    //StreamBridgeDirection::Both adds the two directions together
+    StreamBridgeStatistics statistics(StreamBridgeDirection direction) const;
+    void resetStatistics();
+
+    static const constexpr size_t DEFAULT_SLOT_COUNT{64};
+    //The largest UDP payload that fits in one Ethernet frame without fragmenting
+    static const constexpr size_t DEFAULT_SLOT_LENGTH{1472};
+
+private:
+    class Pump;
+
+    std::shared_ptr<StreamBridgeEndpoint> m_first;
+    std::shared_ptr<StreamBridgeEndpoint> m_second;
+    std::unique_ptr<Pump> m_firstToSecond;
+    std::unique_ptr<Pump> m_secondToFirst;
+    bool m_isRunning;
+    std::string m_delimiter;
+    bool m_batchingEnabled;
+    StreamBridgeOverflowPolicy m_overflowPolicy;
+    size_t m_slotCount;
+    size_t m_slotLength;
+    ThreadConfiguration m_threadConfiguration;
+
+    void checkStopped(const std::string &functionName) const;
+    void startPumps(StreamBridgeDirection direction);
+};
+
+#endif //TJLUTILS_STREAMBRIDGE_H
@@ -0,0 +1,473 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <serialport.h>
+#include <udpduplex.h>
+#include <streambridge.h>
+#include "../../serialport/test/serialport-loopback.h"
+
+//Forwards NMEA style lines from a pseudo terminal to a UDP socket and datagrams from a UDP
+//socket back out of the pseudo terminal, checking that every datagram holds whole lines
+//with a single line ending and that nothing is lost or reordered, and compares the
+//throughput against a readLine()/writeLine() loop. Then runs a bridge between a fast
+//source and a slow destination to check the drop counters and the blocking policy, then
+//one into a destination that only takes part of each write, and last sends datagrams
+//around the slot length, where the one that does not fit is dropped
+//UDPServer keeps its port bound until the process exits, so every run gets its own
+static const uint16_t LOOP_TO_UDP_PORT_NUMBER{9894};
+static const uint16_t BRIDGE_TO_UDP_PORT_NUMBER{9895};
+static const uint16_t UDP_TO_SERIAL_PORT_NUMBER{9896};
+static const uint16_t OVERSIZE_PORT_NUMBER{9898};
+static const size_t OVERSIZE_SLOT_LENGTH{256};
+static const int NUMBER_OF_LINES{50000};
+static const int NUMBER_OF_DATAGRAMS{2000};
+static const std::chrono::milliseconds QUIET_TIME{300};
+
+std::string makeLine(int lineNumber)
+{
+    return "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*" + std::to_string(lineNumber) + "\r\n";
+}
+
+void writeLines(SerialPortLoopback &loopback, const std::string &lines)
+{
+    //Pieces that do not line up with the lines, the way a device delivers them
+    for (size_t offset = 0; offset < lines.length(); offset += 700) {
+        loopback.writeMaster(lines.data() + offset, std::min<size_t>(700, lines.length() - offset));
+    }
+}
+
+struct ReceivedDatagrams
+{
+    std::string bytes;
+    unsigned long long datagrams;
+    bool wholeLines;
+};
+
+void receiveDatagrams(UDPServer *udpServer, const std::atomic<bool> &stop, ReceivedDatagrams *received)
+{
+    std::vector<char> buffer(65535);
+    received->datagrams = 0;
+    received->wholeLines = true;
+    received->bytes.reserve(8 * 1024 * 1024);
+    while (!stop) {
+        ssize_t readBytes{udpServer->readDatagram(buffer.data(), buffer.size())};
+        if (readBytes <= 0) {
+            continue;
+        }
+        size_t start{received->bytes.length()};
+        received->bytes.append(buffer.data(), static_cast<size_t>(readBytes));
+        bool endsInLineEnding{(readBytes >= 2) && (received->bytes.compare(received->bytes.length() - 2, 2, "\r\n") == 0)};
+        bool doubledLineEnding{received->bytes.find("\r\n\r\n", start) != std::string::npos};
+        received->wholeLines = received->wholeLines && endsInLineEnding && (!doubledLineEnding) && (received->bytes[start] == '$');
+        received->datagrams++;
+    }
+}
+
+void waitForQuiet(const std::function<unsigned long long()> &progress)
+{
+    unsigned long long lastProgress{progress()};
+    auto lastChangeTime = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - lastChangeTime < QUIET_TIME) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if (progress() != lastProgress) {
+            lastProgress = progress();
+            lastChangeTime = std::chrono::steady_clock::now();
+        }
+    }
+}
+
+bool runSerialToUDP(SerialPortLoopback &loopback, std::shared_ptr<SerialPort> serialPort, bool useBridge)
+{
+    std::string lines{};
+    for (int i = 0; i < NUMBER_OF_LINES; i++) {
+        lines += makeLine(i);
+    }
+    const uint16_t portNumber{useBridge ? BRIDGE_TO_UDP_PORT_NUMBER : LOOP_TO_UDP_PORT_NUMBER};
+    UDPServer udpServer{portNumber};
+    udpServer.setTimeout(UDPServer::DEFAULT_TIMEOUT);
+    std::shared_ptr<UDPDuplex> udpDuplex{std::make_shared<UDPDuplex>("127.0.0.1", portNumber, UDPObjectType::Client)};
+    std::atomic<bool> stopReceiving{false};
+    ReceivedDatagrams received{};
+    std::thread receiverThread{receiveDatagrams, &udpServer, std::cref(stopReceiving), &received};
+
+    StreamBridge streamBridge{serialPort, udpDuplex};
+    std::atomic<bool> stopForwarding{false};
+    std::atomic<unsigned long long> forwardedLines{0};
+    std::thread forwardingThread{};
+    if (useBridge) {
+        //The pseudo terminal holds on to whatever the bridge is not ready for yet
+        streamBridge.setOverflowPolicy(StreamBridgeOverflowPolicy::Block);
+        streamBridge.start(StreamBridgeDirection::FirstToSecond);
+    } else {
+        forwardingThread = std::thread{[&]() {
+            while (!stopForwarding) {
+                std::string line{serialPort->readLine()};
+                if (!line.empty()) {
+                    udpDuplex->writeLine(line);
+                    forwardedLines++;
+                }
+            }
+        }};
+    }
+    auto startTime = std::chrono::steady_clock::now();
+    writeLines(loopback, lines);
+    auto progress = [&]() -> unsigned long long {
+        return (useBridge ? streamBridge.statistics(StreamBridgeDirection::FirstToSecond).bytesOut : forwardedLines.load());
+    };
+    waitForQuiet(progress);
+    double elapsedSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime - QUIET_TIME).count()};
+    StreamBridgeStatistics statistics{streamBridge.statistics(StreamBridgeDirection::FirstToSecond)};
+    streamBridge.stop();
+    stopForwarding = true;
+    if (forwardingThread.joinable()) {
+        forwardingThread.join();
+    }
+    stopReceiving = true;
+    receiverThread.join();
+
+    //The loop is only there to compare against, and one datagram per line can outrun the receiver
+    bool passed{(!useBridge) || ((received.bytes == lines) && (received.wholeLines) &&
+                                 (statistics.bytesIn == lines.length()) && (statistics.bytesOut == lines.length()) &&
+                                 (statistics.messagesIn == NUMBER_OF_LINES) && (statistics.bytesDropped == 0) && (statistics.writeFailures == 0))};
+    size_t linesReceived{static_cast<size_t>(std::count(received.bytes.begin(), received.bytes.end(), '\n'))};
+    std::cout << "test=serial_to_udp forwarding=" << (useBridge ? "bridge" : "readline_writeline")
+              << " lines=" << NUMBER_OF_LINES
+              << " lines_received=" << linesReceived
+              << " datagrams=" << received.datagrams
+              << " lines_per_datagram=" << (static_cast<double>(NUMBER_OF_LINES) / std::max<unsigned long long>(received.datagrams, 1))
+              << " lines_per_s=" << (NUMBER_OF_LINES / elapsedSeconds)
+              << " mb_per_s=" << (lines.length() / elapsedSeconds / 1e6)
+              << " dropped_bytes=" << statistics.bytesDropped
+              << " write_failures=" << statistics.writeFailures
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return passed;
+}
+
+bool runUDPToSerial(SerialPortLoopback &loopback, std::shared_ptr<SerialPort> serialPort)
+{
+    std::shared_ptr<UDPDuplex> udpDuplex{std::make_shared<UDPDuplex>("127.0.0.1", UDPDuplex::DEFAULT_CLIENT_PORT_NUMBER, UDP_TO_SERIAL_PORT_NUMBER, UDPObjectType::Server)};
+    StreamBridge streamBridge{serialPort, udpDuplex};
+    //Datagrams left in the socket wait there while the pseudo terminal drains, rather than
+    //being dropped when it falls behind for a moment
+    streamBridge.setOverflowPolicy(StreamBridgeOverflowPolicy::Block);
+    streamBridge.start(StreamBridgeDirection::SecondToFirst);
+
+    std::string expected{};
+    std::string serialBytes{};
+    std::atomic<bool> stopReading{false};
+    std::thread masterReader{[&]() {
+        std::vector<char> buffer(4096);
+        while (!stopReading) {
+            ssize_t readBytes{loopback.readMaster(buffer.data(), buffer.size(), std::chrono::milliseconds{10})};
+            if (readBytes > 0) {
+                serialBytes.append(buffer.data(), static_cast<size_t>(readBytes));
+            }
+        }
+    }};
+    UDPClient udpClient{"127.0.0.1", UDP_TO_SERIAL_PORT_NUMBER};
+    auto startTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < NUMBER_OF_DATAGRAMS; i++) {
+        std::string command{"SET:" + std::to_string(i) + ":" + std::string(static_cast<size_t>(i % 64), 'x') + "\n"};
+        expected += command;
+        udpClient.write(command.data(), command.length());
+        //Keep within what the socket buffers on the way can hold
+        if ((i % 64) == 63) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    waitForQuiet([&]() { return streamBridge.statistics(StreamBridgeDirection::SecondToFirst).bytesOut; });
+    double elapsedSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime - QUIET_TIME).count()};
+    StreamBridgeStatistics statistics{streamBridge.statistics(StreamBridgeDirection::SecondToFirst)};
+    streamBridge.stop();
+    stopReading = true;
+    masterReader.join();
+
+    bool passed{(serialBytes == expected) && (statistics.messagesIn == NUMBER_OF_DATAGRAMS) &&
+                (statistics.messagesOut == NUMBER_OF_DATAGRAMS) && (statistics.bytesOut == statistics.bytesIn) &&
+                (statistics.bytesDropped == 0) && (statistics.messagesDropped == 0) && (statistics.writeFailures == 0)};
+    std::cout << "test=udp_to_serial datagrams=" << statistics.messagesIn
+              << " datagrams_per_s=" << (statistics.messagesIn / elapsedSeconds)
+              << " bytes_in=" << statistics.bytesIn
+              << " bytes_out=" << statistics.bytesOut
+              << " dropped_bytes=" << statistics.bytesDropped
+              << " datagrams_dropped=" << statistics.messagesDropped
+              << " write_failures=" << statistics.writeFailures
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return passed;
+}
+
+bool runOversizeDatagram(SerialPortLoopback &loopback, std::shared_ptr<SerialPort> serialPort)
+{
+    std::shared_ptr<UDPDuplex> udpDuplex{std::make_shared<UDPDuplex>("127.0.0.1", UDPDuplex::DEFAULT_CLIENT_PORT_NUMBER, OVERSIZE_PORT_NUMBER, UDPObjectType::Server)};
+    StreamBridge streamBridge{serialPort, udpDuplex};
+    streamBridge.setSlotLength(OVERSIZE_SLOT_LENGTH);
+    streamBridge.start(StreamBridgeDirection::SecondToFirst);
+
+    std::string fits{std::string(OVERSIZE_SLOT_LENGTH - 1, 'f') + "\n"};
+    std::string oversize{std::string(OVERSIZE_SLOT_LENGTH, 'o') + "\n"};
+    std::vector<std::string> datagrams{"before\n", oversize, fits, "after\n"};
+    UDPClient udpClient{"127.0.0.1", OVERSIZE_PORT_NUMBER};
+    for (auto &it : datagrams) {
+        udpClient.write(it.data(), it.length());
+    }
+    std::string expected{"before\n" + fits + "after\n"};
+    std::string serialBytes{};
+    std::vector<char> buffer(4096);
+    auto startTime = std::chrono::steady_clock::now();
+    while ((serialBytes.length() < expected.length()) && (std::chrono::steady_clock::now() - startTime < std::chrono::seconds(2))) {
+        ssize_t readBytes{loopback.readMaster(buffer.data(), buffer.size(), std::chrono::milliseconds{10})};
+        if (readBytes > 0) {
+            serialBytes.append(buffer.data(), static_cast<size_t>(readBytes));
+        }
+    }
+    waitForQuiet([&]() { return streamBridge.statistics(StreamBridgeDirection::SecondToFirst).messagesIn; });
+    StreamBridgeStatistics statistics{streamBridge.statistics(StreamBridgeDirection::SecondToFirst)};
+    streamBridge.stop();
+
+    bool passed{(serialBytes == expected) && (statistics.messagesIn == datagrams.size()) &&
+                (statistics.messagesOut == datagrams.size() - 1) && (statistics.messagesDropped == 1) &&
+                (udpDuplex->oversizeDatagramCount() == 1)};
+    std::cout << "test=oversize_datagram slot_length=" << OVERSIZE_SLOT_LENGTH
+              << " messages_in=" << statistics.messagesIn
+              << " messages_out=" << statistics.messagesOut
+              << " messages_dropped=" << statistics.messagesDropped
+              << " oversize_datagrams=" << udpDuplex->oversizeDatagramCount()
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return passed;
+}
+
+//Hands out a fixed run of lines as fast as it is read, then nothing
+class MemorySource : public StreamBridgeEndpoint
+{
+public:
+    MemorySource(const std::string &data) :
+        m_data{data},
+        m_position{0}
+    {
+
+    }
+
+    ssize_t read(char *buffer, size_t length)
+    {
+        size_t readLength{std::min<size_t>(std::min<size_t>(length, 333), this->m_data.length() - this->m_position)};
+        if (readLength == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            return 0;
+        }
+        memcpy(buffer, this->m_data.data() + this->m_position, readLength);
+        this->m_position += readLength;
+        return readLength;
+    }
+
+    ssize_t write(const char *data, size_t length) { (void)data; return length; }
+    std::string name() const { return "memory"; }
+
+private:
+    std::string m_data;
+    size_t m_position;
+};
+
+//Takes a while over every message, and keeps them
+class SlowSink : public StreamBridgeEndpoint
+{
+public:
+    ssize_t read(char *buffer, size_t length)
+    {
+        (void)buffer;
+        (void)length;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return 0;
+    }
+
+    ssize_t write(const char *data, size_t length)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        std::lock_guard<std::mutex> messagesLock{this->m_mutex};
+        this->m_messages.emplace_back(data, length);
+        return length;
+    }
+
+    std::string name() const { return "slow"; }
+
+    std::vector<std::string> messages() const
+    {
+        std::lock_guard<std::mutex> messagesLock{this->m_mutex};
+        return this->m_messages;
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::vector<std::string> m_messages;
+};
+
+//Takes at most PARTIAL_WRITE_LENGTH bytes of each write, the way a port that can only
+//drain part of a message before its timeout does, and with refuseEvery set takes nothing
+//at all from every refuseEvery'th write
+static const size_t PARTIAL_WRITE_LENGTH{100};
+
+class PartialSink : public StreamBridgeEndpoint
+{
+public:
+    PartialSink(unsigned refuseEvery) :
+        m_refuseEvery{refuseEvery},
+        m_writes{0}
+    {
+
+    }
+
+    ssize_t read(char *buffer, size_t length)
+    {
+        (void)buffer;
+        (void)length;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return 0;
+    }
+
+    ssize_t write(const char *data, size_t length)
+    {
+        std::lock_guard<std::mutex> bytesLock{this->m_mutex};
+        this->m_writes++;
+        if ((this->m_refuseEvery != 0) && ((this->m_writes % this->m_refuseEvery) == 0)) {
+            return 0;
+        }
+        size_t writeLength{std::min(length, PARTIAL_WRITE_LENGTH)};
+        this->m_bytes.append(data, writeLength);
+        return writeLength;
+    }
+
+    std::string name() const { return "partial"; }
+
+    std::string bytes() const
+    {
+        std::lock_guard<std::mutex> bytesLock{this->m_mutex};
+        return this->m_bytes;
+    }
+
+private:
+    const unsigned m_refuseEvery;
+    mutable std::mutex m_mutex;
+    unsigned m_writes;
+    std::string m_bytes;
+};
+
+bool runPartialWrites(unsigned refuseEvery)
+{
+    std::string lines{};
+    for (int i = 0; i < 20000; i++) {
+        lines += "LINE:" + std::to_string(i) + "\n";
+    }
+    std::shared_ptr<PartialSink> partialSink{std::make_shared<PartialSink>(refuseEvery)};
+    StreamBridge streamBridge{std::make_shared<MemorySource>(lines), partialSink};
+    streamBridge.setDelimiter("\n");
+    streamBridge.setOverflowPolicy(StreamBridgeOverflowPolicy::Block);
+    streamBridge.setSlotCount(4);
+    streamBridge.setSlotLength(256);
+    streamBridge.start(StreamBridgeDirection::FirstToSecond);
+    waitForQuiet([&]() { return streamBridge.statistics(StreamBridgeDirection::FirstToSecond).bytesOut; });
+    streamBridge.stop();
+    StreamBridgeStatistics statistics{streamBridge.statistics(StreamBridgeDirection::FirstToSecond)};
+
+    //Every byte read is either written or counted as dropped, and the rest of a message
+    //that was only partly taken is written before the next one starts
+    std::string delivered{partialSink->bytes()};
+    bool passed{(statistics.bytesIn == lines.length()) && (statistics.bytesOut == delivered.length()) &&
+                (statistics.bytesOut + statistics.bytesDropped == statistics.bytesIn)};
+    if (refuseEvery == 0) {
+        passed = passed && (delivered == lines) && (statistics.writeFailures == 0) && (statistics.bytesDropped == 0);
+    } else {
+        passed = passed && (statistics.writeFailures > 0) && (statistics.bytesDropped > 0) && (statistics.messagesOut > 0);
+    }
+    std::cout << "test=partial_writes refuse_every=" << refuseEvery
+              << " write_length=" << PARTIAL_WRITE_LENGTH
+              << " messages_out=" << statistics.messagesOut
+              << " bytes_out=" << statistics.bytesOut
+              << " bytes_dropped=" << statistics.bytesDropped
+              << " write_failures=" << statistics.writeFailures
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return passed;
+}
+
+bool runOverflow(StreamBridgeOverflowPolicy overflowPolicy, bool batchingEnabled)
+{
+    std::string lines{};
+    for (int i = 0; i < 20000; i++) {
+        lines += "LINE:" + std::to_string(i) + "\n";
+    }
+    std::shared_ptr<SlowSink> slowSink{std::make_shared<SlowSink>()};
+    StreamBridge streamBridge{std::make_shared<MemorySource>(lines), slowSink};
+    streamBridge.setDelimiter("\n");
+    streamBridge.setOverflowPolicy(overflowPolicy);
+    streamBridge.setBatchingEnabled(batchingEnabled);
+    streamBridge.setSlotCount(4);
+    streamBridge.setSlotLength(256);
+    streamBridge.start(StreamBridgeDirection::FirstToSecond);
+    bool settingsLocked{false};
+    try {
+        streamBridge.setSlotCount(8);
+    } catch (std::exception &e) {
+        (void)e;
+        settingsLocked = true;
+    }
+    waitForQuiet([&]() { return streamBridge.statistics(StreamBridgeDirection::FirstToSecond).bytesOut; });
+    streamBridge.stop();
+    StreamBridgeStatistics statistics{streamBridge.statistics(StreamBridgeDirection::FirstToSecond)};
+
+    //Every message holds whole lines, in order, and one line each without batching
+    bool wholeLines{true};
+    int lastLine{-1};
+    std::string delivered{};
+    for (auto &it : slowSink->messages()) {
+        wholeLines = wholeLines && (it.back() == '\n') && (it.compare(0, 5, "LINE:") == 0);
+        wholeLines = wholeLines && ((batchingEnabled) || (it.find('\n') == it.length() - 1));
+        int firstLine{std::stoi(it.substr(5))};
+        wholeLines = wholeLines && (firstLine > lastLine);
+        lastLine = firstLine;
+        delivered += it;
+    }
+    bool passed{settingsLocked && wholeLines && (statistics.bytesIn == lines.length()) &&
+                (statistics.bytesOut + statistics.bytesDropped == statistics.bytesIn) &&
+                (statistics.messagesIn == 20000) && (statistics.bytesOut == delivered.length())};
+    if (overflowPolicy == StreamBridgeOverflowPolicy::Block) {
+        passed = passed && (statistics.bytesDropped == 0) && (delivered == lines);
+    } else {
+        passed = passed && (statistics.bytesDropped > 0) && (statistics.messagesDropped > 0);
+    }
+    std::cout << "test=overflow policy=" << ((overflowPolicy == StreamBridgeOverflowPolicy::Block) ? "block" : "drop_newest")
+              << " batching=" << (batchingEnabled ? "true" : "false")
+              << " messages_out=" << statistics.messagesOut
+              << " bytes_out=" << statistics.bytesOut
+              << " bytes_dropped=" << statistics.bytesDropped
+              << " lines_dropped=" << statistics.messagesDropped
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return passed;
+}
+
+int main()
+{
+    SerialPortLoopback loopback{};
+    std::shared_ptr<SerialPort> serialPort{new SerialPort{loopback.slaveName(), BaudRate::BAUD115200}, [](SerialPort *toDelete) {
+        toDelete->closePort();
+        delete toDelete;
+    }};
+    serialPort->setTimeout(100);
+    serialPort->setLineEnding("\r\n");
+    serialPort->openPort();
+    bool allPassed{runSerialToUDP(loopback, serialPort, false)};
+    allPassed = runSerialToUDP(loopback, serialPort, true) && allPassed;
+    allPassed = runUDPToSerial(loopback, serialPort) && allPassed;
+    allPassed = runOverflow(StreamBridgeOverflowPolicy::DropNewest, true) && allPassed;
+    allPassed = runOverflow(StreamBridgeOverflowPolicy::Block, true) && allPassed;
+    allPassed = runOverflow(StreamBridgeOverflowPolicy::Block, false) && allPassed;
+    allPassed = runPartialWrites(0) && allPassed;
+    allPassed = runPartialWrites(40) && allPassed;
+    allPassed = runOversizeDatagram(loopback, serialPort) && allPassed;
+    return (allPassed ? 0 : 1);
+}
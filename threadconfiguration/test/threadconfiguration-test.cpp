@@ -0,0 +1,379 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <future>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <condition_variable>
+#include <dirent.h>
+#include <pty.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <serialport.h>
+#include <serialportmanager.h>
+#include <serialchannelmux.h>
+#include <serialtransactionclient.h>
+#include <udpduplex.h>
+#include <udprpcclient.h>
+#include <streambridge.h>
+#include <threadconfiguration.h>
+
+//Starts the listeners of a SerialPort and a UDPServer, and the reactors of a
+//SerialPortManager, with thread names, CPU affinity, a caller supplied launcher and a
+//real time policy, and checks from inside and outside the threads that they took effect.
+//Also checks that a launcher's thread gets its own name and affinity back afterwards, and
+//that the mux, transaction client, RPC client and bridge threads take their names
+static const uint16_t UDP_PORT_NUMBER{9897};
+static const uint16_t RPC_SERVER_PORT_NUMBER{9899};
+static const uint16_t RPC_CLIENT_PORT_NUMBER{9900};
+
+std::string currentThreadName()
+{
+    char threadName[16]{};
+    prctl(PR_GET_NAME, threadName, 0, 0, 0);
+    return threadName;
+}
+
+std::vector<unsigned int> currentThreadAffinity()
+{
+    std::vector<unsigned int> cpus{};
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    if (sched_getaffinity(0, sizeof(cpuSet), &cpuSet) == 0) {
+        for (unsigned int i = 0; i < CPU_SETSIZE; i++) {
+            if (CPU_ISSET(i, &cpuSet)) {
+                cpus.push_back(i);
+            }
+        }
+    }
+    return cpus;
+}
+
+//The names of every thread in the process, from /proc/self/task/*/comm
+std::vector<std::string> processThreadNames()
+{
+    std::vector<std::string> threadNames{};
+    DIR *taskDirectory{opendir("/proc/self/task")};
+    if (!taskDirectory) {
+        return threadNames;
+    }
+    while (dirent *entry = readdir(taskDirectory)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        std::ifstream commFile{std::string{"/proc/self/task/"} + entry->d_name + "/comm"};
+        std::string threadName{""};
+        std::getline(commFile, threadName);
+        threadNames.push_back(threadName);
+    }
+    closedir(taskDirectory);
+    return threadNames;
+}
+
+size_t countThreadsNamed(const std::string &threadName)
+{
+    size_t count{0};
+    for (auto &it : processThreadNames()) {
+        count += (it == threadName) ? 1 : 0;
+    }
+    return count;
+}
+
+//Runs every task it is given, one after the other, on the same long lived thread
+class SingleThreadExecutor
+{
+public:
+    SingleThreadExecutor() :
+        m_mutex{},
+        m_taskCondition{},
+        m_tasks{},
+        m_shutEmDown{false},
+        m_thread{&SingleThreadExecutor::run, this}
+    {
+
+    }
+
+    ~SingleThreadExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> taskLock{this->m_mutex};
+            this->m_shutEmDown = true;
+        }
+        this->m_taskCondition.notify_all();
+        this->m_thread.join();
+    }
+
+    std::future<void> submit(const std::function<void()> &task)
+    {
+        std::shared_ptr<std::packaged_task<void()>> packagedTask{std::make_shared<std::packaged_task<void()>>(task)};
+        {
+            std::lock_guard<std::mutex> taskLock{this->m_mutex};
+            this->m_tasks.push_back([packagedTask]() { (*packagedTask)(); });
+        }
+        this->m_taskCondition.notify_all();
+        return packagedTask->get_future();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_taskCondition;
+    std::deque<std::function<void()>> m_tasks;
+    bool m_shutEmDown;
+    std::thread m_thread;
+
+    void run()
+    {
+        prctl(PR_SET_NAME, "executor", 0, 0, 0);
+        std::unique_lock<std::mutex> taskLock{this->m_mutex};
+        while (true) {
+            this->m_taskCondition.wait(taskLock, [this]() { return (this->m_shutEmDown) || (!this->m_tasks.empty()); });
+            if (this->m_tasks.empty()) {
+                return;
+            }
+            std::function<void()> task{std::move(this->m_tasks.front())};
+            this->m_tasks.pop_front();
+            taskLock.unlock();
+            task();
+            taskLock.lock();
+        }
+    }
+};
+
+int main()
+{
+    bool passed{true};
+
+    int masterDescriptor{-1};
+    int slaveDescriptor{-1};
+    char slaveName[256];
+    if (openpty(&masterDescriptor, &slaveDescriptor, slaveName, nullptr, nullptr) != 0) {
+        std::cout << "FAILED: unable to open a pseudo terminal" << std::endl;
+        return 1;
+    }
+
+    //SerialPort listener: name and affinity, seen from the onBytes() callback
+    {
+        SerialPort serialPort{slaveName, BaudRate::BAUD115200};
+        serialPort.openPort();
+        ThreadConfiguration threadConfiguration{};
+        threadConfiguration.setThreadName("serial-listener");
+        threadConfiguration.setCpuAffinity(std::vector<unsigned int>{0});
+        serialPort.setListenerThreadConfiguration(threadConfiguration);
+
+        std::mutex resultMutex{};
+        std::string listenerName{""};
+        std::vector<unsigned int> listenerAffinity{};
+        std::atomic<bool> called{false};
+        serialPort.onBytes([&](const char *, size_t) {
+            std::lock_guard<std::mutex> resultLock{resultMutex};
+            listenerName = currentThreadName();
+            listenerAffinity = currentThreadAffinity();
+            called = true;
+        });
+        serialPort.startListening();
+        if (::write(masterDescriptor, "ping\r\n", 6) != 6) {
+            std::cout << "WARNING: short write to the pseudo terminal" << std::endl;
+        }
+        for (int i = 0; (i < 200) && (!called); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        serialPort.stopListening();
+        serialPort.closePort();
+
+        std::lock_guard<std::mutex> resultLock{resultMutex};
+        bool affinityMatches{(listenerAffinity.size() == 1) && (listenerAffinity[0] == 0)};
+        std::cout << "serial_listener_name=" << listenerName << std::endl;
+        std::cout << "serial_listener_cpus=" << listenerAffinity.size() << std::endl;
+        if ((listenerName != "serial-listener") || (!affinityMatches)) {
+            std::cout << "FAILED: the serial listener did not run with its configuration" << std::endl;
+            passed = false;
+        }
+        if (currentThreadName() == "serial-listener") {
+            std::cout << "FAILED: the configuration leaked onto the calling thread" << std::endl;
+            passed = false;
+        }
+    }
+
+    //UDPServer listener: started through a caller supplied launcher
+    {
+        UDPServer udpServer{UDP_PORT_NUMBER};
+        udpServer.setTimeout(UDPServer::DEFAULT_TIMEOUT);
+        std::atomic<int> launches{0};
+        ThreadConfiguration threadConfiguration{};
+        threadConfiguration.setThreadName("udp-listener-with-a-long-name");
+        threadConfiguration.setLauncher([&launches](const std::function<void()> &task) {
+            launches++;
+            return std::async(std::launch::async, task);
+        });
+        udpServer.setListenerThreadConfiguration(threadConfiguration);
+        udpServer.startListening();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        //Linux keeps the first 15 characters of the name
+        size_t namedThreads{countThreadsNamed("udp-listener-wi")};
+        udpServer.stopListening();
+        std::cout << "udp_launcher_calls=" << launches << std::endl;
+        std::cout << "udp_named_threads=" << namedThreads << std::endl;
+        if ((launches != 1) || (namedThreads != 1)) {
+            std::cout << "FAILED: the UDP listener was not started through the launcher" << std::endl;
+            passed = false;
+        }
+    }
+
+    //A launcher backed by a long lived thread: the settings hold while the task runs, and
+    //the thread has its own back once it returns
+    {
+        SingleThreadExecutor executor{};
+        std::vector<unsigned int> executorAffinity{};
+        executor.submit([&executorAffinity]() { executorAffinity = currentThreadAffinity(); }).wait();
+        ThreadConfiguration threadConfiguration{};
+        threadConfiguration.setThreadName("borrowed");
+        threadConfiguration.setCpuAffinity(std::vector<unsigned int>{0});
+        threadConfiguration.setLauncher([&executor](const std::function<void()> &task) {
+            return executor.submit(task);
+        });
+        std::string taskName{""};
+        threadConfiguration.launch([&taskName]() { taskName = currentThreadName(); }).wait();
+        std::string nameAfter{""};
+        std::vector<unsigned int> affinityAfter{};
+        executor.submit([&nameAfter, &affinityAfter]() {
+            nameAfter = currentThreadName();
+            affinityAfter = currentThreadAffinity();
+        }).wait();
+        std::cout << "launcher_task_name=" << taskName << std::endl;
+        std::cout << "launcher_name_after=" << nameAfter << std::endl;
+        std::cout << "launcher_cpus_after=" << affinityAfter.size() << std::endl;
+        if ((taskName != "borrowed") || (nameAfter != "executor") || (affinityAfter != executorAffinity)) {
+            std::cout << "FAILED: the launcher's thread was not handed back as it was" << std::endl;
+            passed = false;
+        }
+    }
+
+    //SerialPortManager reactors
+    {
+        ThreadConfiguration threadConfiguration{};
+        threadConfiguration.setThreadName("port-reactor");
+        SerialPortManager serialPortManager{2, threadConfiguration};
+        size_t namedThreads{countThreadsNamed("port-reactor")};
+        std::cout << "reactor_named_threads=" << namedThreads << std::endl;
+        if (namedThreads != 2) {
+            std::cout << "FAILED: the reactors did not run with their configuration" << std::endl;
+            passed = false;
+        }
+    }
+
+    //The threads the other classes start for themselves
+    {
+        auto namedConfiguration = [](const std::string &threadName) {
+            ThreadConfiguration threadConfiguration{};
+            threadConfiguration.setThreadName(threadName);
+            return threadConfiguration;
+        };
+        auto closeAndDelete = [](SerialPort *toDelete) {
+            toDelete->closePort();
+            delete toDelete;
+        };
+        std::shared_ptr<SerialPort> muxPort{new SerialPort{slaveName, BaudRate::BAUD115200}, closeAndDelete};
+        muxPort->openPort();
+        //A port is locked while open, so the transaction client gets a terminal of its own
+        int transactionMaster{-1};
+        int transactionSlave{-1};
+        char transactionSlaveName[256];
+        if (openpty(&transactionMaster, &transactionSlave, transactionSlaveName, nullptr, nullptr) != 0) {
+            std::cout << "FAILED: unable to open a pseudo terminal" << std::endl;
+            return 1;
+        }
+        std::shared_ptr<SerialPort> transactionPort{new SerialPort{transactionSlaveName, BaudRate::BAUD115200}, closeAndDelete};
+        transactionPort->openPort();
+        std::shared_ptr<UDPDuplex> udpDuplex{std::make_shared<UDPDuplex>("127.0.0.1", RPC_CLIENT_PORT_NUMBER, RPC_SERVER_PORT_NUMBER)};
+        {
+            SerialChannelMux channelMux{muxPort, SerialFraming::Format::COBS, namedConfiguration("mux-transmit")};
+            SerialTransactionClient transactionClient{transactionPort, SerialTransactionClient::DEFAULT_MAXIMUM_IN_FLIGHT, nullptr, namedConfiguration("txn-deadline")};
+            UDPRpcClient rpcClient{udpDuplex, UDPRpcClient::DEFAULT_MAXIMUM_IN_FLIGHT, namedConfiguration("rpc-listener")};
+            StreamBridge streamBridge{StreamBridgeEndpoint::fromSerialPort(muxPort), StreamBridgeEndpoint::fromUDPDuplex(udpDuplex)};
+            streamBridge.setThreadConfiguration(namedConfiguration("bridge-pump"));
+            streamBridge.start(StreamBridgeDirection::FirstToSecond);
+            size_t muxThreads{countThreadsNamed("mux-transmit")};
+            size_t transactionThreads{countThreadsNamed("txn-deadline")};
+            size_t rpcThreads{countThreadsNamed("rpc-listener")};
+            size_t bridgeThreads{countThreadsNamed("bridge-pump")};
+            streamBridge.stop();
+            std::cout << "mux_named_threads=" << muxThreads << std::endl;
+            std::cout << "transaction_named_threads=" << transactionThreads << std::endl;
+            std::cout << "rpc_named_threads=" << rpcThreads << std::endl;
+            std::cout << "bridge_named_threads=" << bridgeThreads << std::endl;
+            //One direction of a bridge is a reader and a writer
+            if ((muxThreads != 1) || (transactionThreads != 1) || (rpcThreads != 1) || (bridgeThreads != 2)) {
+                std::cout << "FAILED: a background thread did not run with its configuration" << std::endl;
+                passed = false;
+            }
+        }
+        transactionPort.reset();
+        close(transactionMaster);
+        close(transactionSlave);
+    }
+
+    //A real time policy needs CAP_SYS_NICE: it either takes effect, or startListening()
+    //throws and leaves the port as it was
+    {
+        SerialPort serialPort{slaveName, BaudRate::BAUD115200};
+        serialPort.openPort();
+        ThreadConfiguration threadConfiguration{};
+        threadConfiguration.setSchedulingPolicy(ThreadSchedulingPolicy::Fifo, 10);
+        serialPort.setListenerThreadConfiguration(threadConfiguration);
+        std::atomic<int> listenerPolicy{-1};
+        serialPort.onBytes([&listenerPolicy](const char *, size_t) {
+            int policy{0};
+            sched_param schedulingParameters{};
+            pthread_getschedparam(pthread_self(), &policy, &schedulingParameters);
+            listenerPolicy = policy;
+        });
+        bool started{true};
+        try {
+            serialPort.startListening();
+        } catch (std::exception &e) {
+            started = false;
+            std::cout << "fifo_error=" << e.what() << std::endl;
+        }
+        if (started) {
+            if (::write(masterDescriptor, "ping\r\n", 6) != 6) {
+                std::cout << "WARNING: short write to the pseudo terminal" << std::endl;
+            }
+            for (int i = 0; (i < 200) && (listenerPolicy == -1); i++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            serialPort.stopListening();
+        }
+        std::cout << "fifo_started=" << (started ? "true" : "false") << std::endl;
+        if ((started) && (listenerPolicy != SCHED_FIFO)) {
+            std::cout << "FAILED: the listener started without its real time policy" << std::endl;
+            passed = false;
+        }
+        if ((!started) && (serialPort.isListening())) {
+            std::cout << "FAILED: the port was left listening after a failed start" << std::endl;
+            passed = false;
+        }
+        serialPort.closePort();
+    }
+
+    try {
+        ThreadConfiguration threadConfiguration{};
+        threadConfiguration.setSchedulingPolicy(ThreadSchedulingPolicy::RoundRobin, 0);
+        std::cout << "FAILED: a real time priority of 0 was accepted" << std::endl;
+        passed = false;
+    } catch (std::exception &e) {
+        std::cout << "invalid_priority_rejected=true" << std::endl;
+    }
+
+    close(masterDescriptor);
+    close(slaveDescriptor);
+    std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+    return (passed ? 0 : 1);
+}
@@ -0,0 +1,266 @@
+/***********************************************************************
+*    threadconfiguration.cpp:                                          *
+*    ThreadConfiguration, placement and priority of worker threads     *
+*    Copyright (c) 2017 Tyler Lewis                                    *
+************************************************************************
+*    This is a source file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the implementation of a ThreadConfiguration class *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#include <memory>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#if defined(__linux__)
+    #include <sched.h>
+    #include <pthread.h>
+    #include <sys/prctl.h>
+#endif
+
+#include "threadconfiguration.h"
+
+const constexpr size_t ThreadConfiguration::MAXIMUM_THREAD_NAME_LENGTH;
+
+//Saves the settings applyToCurrentThread() changes when constructed, and puts them back
+//when destroyed. Used on threads borrowed from a launcher, which outlive the task
+class SavedThreadSettings
+{
+public:
+    SavedThreadSettings(bool isEnabled) :
+        m_isEnabled{isEnabled}
+    {
+#if defined(__linux__)
+        if (!this->m_isEnabled) {
+            return;
+        }
+        CPU_ZERO(&this->m_cpuSet);
+        this->m_hasCpuSet = (sched_getaffinity(0, sizeof(this->m_cpuSet), &this->m_cpuSet) == 0);
+        this->m_hasScheduling = (pthread_getschedparam(pthread_self(), &this->m_schedulingPolicy, &this->m_schedulingParameters) == 0);
+        memset(this->m_threadName, 0, sizeof(this->m_threadName));
+        this->m_hasThreadName = (prctl(PR_GET_NAME, this->m_threadName, 0, 0, 0) == 0);
+#endif
+    }
+
+    //Best effort: there is no one left to report a failure to
+    ~SavedThreadSettings()
+    {
+#if defined(__linux__)
+        if (!this->m_isEnabled) {
+            return;
+        }
+        if (this->m_hasThreadName) {
+            prctl(PR_SET_NAME, this->m_threadName, 0, 0, 0);
+        }
+        if (this->m_hasScheduling) {
+            pthread_setschedparam(pthread_self(), this->m_schedulingPolicy, &this->m_schedulingParameters);
+        }
+        if (this->m_hasCpuSet) {
+            sched_setaffinity(0, sizeof(this->m_cpuSet), &this->m_cpuSet);
+        }
+#endif
+    }
+
+    SavedThreadSettings(const SavedThreadSettings &other) = delete;
+    SavedThreadSettings &operator=(const SavedThreadSettings &rhs) = delete;
+
+private:
+    bool m_isEnabled;
+#if defined(__linux__)
+    bool m_hasCpuSet;
+    cpu_set_t m_cpuSet;
+    bool m_hasScheduling;
+    int m_schedulingPolicy;
+    struct sched_param m_schedulingParameters;
+    bool m_hasThreadName;
+    //PR_GET_NAME fills in up to 16 bytes, terminator included
+    char m_threadName[ThreadConfiguration::MAXIMUM_THREAD_NAME_LENGTH + 1];
+#endif
+};
+
+ThreadConfiguration::ThreadConfiguration() :
+    m_cpuAffinity{},
+    m_schedulingPolicy{ThreadSchedulingPolicy::Inherit},
+    m_schedulingPriority{0},
+    m_threadName{""},
+    m_launcher{nullptr}
+{
+
+}
+
+std::vector<unsigned int> ThreadConfiguration::cpuAffinity() const
+{
+    return this->m_cpuAffinity;
+}
+
+void ThreadConfiguration::setCpuAffinity(const std::vector<unsigned int> &cpuAffinity)
+{
+#if defined(__linux__)
+    for (auto &it : cpuAffinity) {
+        if (it >= CPU_SETSIZE) {
+            throw std::runtime_error("In ThreadConfiguration::setCpuAffinity(const std::vector<unsigned int> &): CPU " + std::to_string(it) + " is out of range");
+        }
+    }
+#endif
+    this->m_cpuAffinity = cpuAffinity;
+}
+
+ThreadSchedulingPolicy ThreadConfiguration::schedulingPolicy() const
+{
+    return this->m_schedulingPolicy;
+}
+
+int ThreadConfiguration::schedulingPriority() const
+{
+    return this->m_schedulingPriority;
+}
+
+void ThreadConfiguration::setSchedulingPolicy(ThreadSchedulingPolicy schedulingPolicy, int schedulingPriority)
+{
+    bool isRealTime{(schedulingPolicy == ThreadSchedulingPolicy::Fifo) || (schedulingPolicy == ThreadSchedulingPolicy::RoundRobin)};
+    if ((isRealTime) && ((schedulingPriority < 1) || (schedulingPriority > 99))) {
+        throw std::runtime_error("In ThreadConfiguration::setSchedulingPolicy(ThreadSchedulingPolicy, int): Real time priorities run from 1 to 99, " + std::to_string(schedulingPriority) + " was given");
+    } else if ((!isRealTime) && (schedulingPriority != 0)) {
+        throw std::runtime_error("In ThreadConfiguration::setSchedulingPolicy(ThreadSchedulingPolicy, int): Only the real time policies take a priority other than 0");
+    }
+    this->m_schedulingPolicy = schedulingPolicy;
+    this->m_schedulingPriority = schedulingPriority;
+}
+
+std::string ThreadConfiguration::threadName() const
+{
+    return this->m_threadName;
+}
+
+void ThreadConfiguration::setThreadName(const std::string &threadName)
+{
+    this->m_threadName = threadName;
+}
+
+ThreadLauncher ThreadConfiguration::launcher() const
+{
+    return this->m_launcher;
+}
+
+void ThreadConfiguration::setLauncher(const ThreadLauncher &launcher)
+{
+    this->m_launcher = launcher;
+}
+
+bool ThreadConfiguration::isDefault() const
+{
+    return (this->m_cpuAffinity.empty()) &&
+           (this->m_schedulingPolicy == ThreadSchedulingPolicy::Inherit) &&
+           (this->m_threadName.empty()) &&
+           (!this->m_launcher);
+}
+
+std::string ThreadConfiguration::applyToCurrentThread() const
+{
+#if defined(__linux__)
+    if (!this->m_cpuAffinity.empty()) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        for (auto &it : this->m_cpuAffinity) {
+            CPU_SET(it, &cpuSet);
+        }
+        if (sched_setaffinity(0, sizeof(cpuSet), &cpuSet) != 0) {
+            return "Unable to set the CPU affinity: " + std::string{strerror(errno)};
+        }
+    }
+    if (this->m_schedulingPolicy != ThreadSchedulingPolicy::Inherit) {
+        int nativePolicy{SCHED_OTHER};
+        if (this->m_schedulingPolicy == ThreadSchedulingPolicy::Batch) {
+            nativePolicy = SCHED_BATCH;
+        } else if (this->m_schedulingPolicy == ThreadSchedulingPolicy::Idle) {
+            nativePolicy = SCHED_IDLE;
+        } else if (this->m_schedulingPolicy == ThreadSchedulingPolicy::Fifo) {
+            nativePolicy = SCHED_FIFO;
+        } else if (this->m_schedulingPolicy == ThreadSchedulingPolicy::RoundRobin) {
+            nativePolicy = SCHED_RR;
+        }
+        struct sched_param schedulingParameters{};
+        schedulingParameters.sched_priority = this->m_schedulingPriority;
+        int result{pthread_setschedparam(pthread_self(), nativePolicy, &schedulingParameters)};
+        if (result != 0) {
+            return "Unable to set the scheduling policy: " + std::string{strerror(result)};
+        }
+    }
+    if (!this->m_threadName.empty()) {
+        std::string threadName{this->m_threadName.substr(0, ThreadConfiguration::MAXIMUM_THREAD_NAME_LENGTH)};
+        if (prctl(PR_SET_NAME, threadName.c_str(), 0, 0, 0) != 0) {
+            return "Unable to set the thread name: " + std::string{strerror(errno)};
+        }
+    }
+    return "";
+#else
+    if ((!this->m_cpuAffinity.empty()) || (this->m_schedulingPolicy != ThreadSchedulingPolicy::Inherit) || (!this->m_threadName.empty())) {
+        return "Thread placement, priority and names are only supported on Linux";
+    }
+    return "";
+#endif
+}
+
+std::function<void()> ThreadConfiguration::configuredTask(const std::function<void()> &task, std::future<std::string> *applied) const
+{
+    std::shared_ptr<std::promise<std::string>> appliedPromise{std::make_shared<std::promise<std::string>>()};
+    *applied = appliedPromise->get_future();
+    ThreadConfiguration configuration{*this};
+    return [configuration, task, appliedPromise]() {
+        //A thread of our own ends with the task, so only a launcher's needs putting back
+        SavedThreadSettings savedSettings{static_cast<bool>(configuration.m_launcher)};
+        std::string errorString{configuration.applyToCurrentThread()};
+        appliedPromise->set_value(errorString);
+        if (errorString.empty()) {
+            task();
+        }
+    };
+}
+
+std::future<void> ThreadConfiguration::launch(const std::function<void()> &task) const
+{
+    if (this->isDefault()) {
+        return std::async(std::launch::async, task);
+    }
+    std::future<std::string> applied{};
+    std::function<void()> configured{this->configuredTask(task, &applied)};
+    std::future<void> taskFuture{};
+    if (this->m_launcher) {
+        taskFuture = this->m_launcher(configured);
+    } else {
+        taskFuture = std::async(std::launch::async, configured);
+    }
+    std::string errorString{applied.get()};
+    if (!errorString.empty()) {
+        taskFuture.wait();
+        throw std::runtime_error("In ThreadConfiguration::launch(const std::function<void()> &): " + errorString);
+    }
+    return taskFuture;
+}
+
+std::thread *ThreadConfiguration::launchThread(const std::function<void()> &task) const
+{
+    if (this->m_launcher) {
+        throw std::runtime_error("In ThreadConfiguration::launchThread(const std::function<void()> &): A launcher can only be used where a std::future is kept");
+    }
+    if (this->isDefault()) {
+        return new std::thread{task};
+    }
+    std::future<std::string> applied{};
+    std::thread *taskThread{new std::thread{this->configuredTask(task, &applied)}};
+    std::string errorString{applied.get()};
+    if (!errorString.empty()) {
+        taskThread->join();
+        delete taskThread;
+        throw std::runtime_error("In ThreadConfiguration::launchThread(const std::function<void()> &): " + errorString);
+    }
+    return taskThread;
+}
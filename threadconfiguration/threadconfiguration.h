@@ -0,0 +1,97 @@
+/***********************************************************************
+*    threadconfiguration.h:                                            *
+*    ThreadConfiguration, placement and priority of worker threads     *
+*    Copyright (c) 2017 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the declarations of a ThreadConfiguration class   *
+*    It describes how a background thread, such as the listener of a  *
+*    SerialPort or UDPServer, should be started: the CPUs it may run   *
+*    on, its scheduling policy and priority, its name, and optionally *
+*    a caller supplied launcher (an executor or thread factory) that   *
+*    runs it instead of a new std::async thread                        *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#ifndef TJLUTILS_THREADCONFIGURATION_H
+#define TJLUTILS_THREADCONFIGURATION_H
+
+#include <string>
+#include <vector>
+#include <future>
+#include <thread>
+#include <functional>
+
+//Inherit leaves the thread with the policy and priority of the thread that started it
+//Fifo and RoundRobin are the real time policies, and usually need CAP_SYS_NICE
+enum class ThreadSchedulingPolicy {
+    Inherit,
+    Other,
+    Batch,
+    Idle,
+    Fifo,
+    RoundRobin
+};
+
+//Runs task to completion on a thread of the caller's choosing, and returns a future that
+//becomes ready once task has returned. task has to be started promptly, since the thread
+//that launches it waits for it to apply its settings. The affinity, scheduling and name
+//the thread had before are put back once task returns, so a pooled thread goes back to
+//its pool as it was
+using ThreadLauncher = std::function<std::future<void>(const std::function<void()> &task)>;
+
+class ThreadConfiguration
+{
+public:
+    ThreadConfiguration();
+
+    //An empty list (the default) lets the thread run on any CPU
+    std::vector<unsigned int> cpuAffinity() const;
+    void setCpuAffinity(const std::vector<unsigned int> &cpuAffinity);
+
+    //Priorities run from 1 to 99 for Fifo and RoundRobin, and must be 0 for the others
+    ThreadSchedulingPolicy schedulingPolicy() const;
+    int schedulingPriority() const;
+    void setSchedulingPolicy(ThreadSchedulingPolicy schedulingPolicy, int schedulingPriority = 0);
+
+    //Linux keeps the first 15 characters
+    std::string threadName() const;
+    void setThreadName(const std::string &threadName);
+
+    ThreadLauncher launcher() const;
+    void setLauncher(const ThreadLauncher &launcher);
+
+    //True if nothing has been set, so threads start exactly as they would without one
+    bool isDefault() const;
+
+    //Applies the affinity, scheduling and name to the calling thread. Returns an empty
+    //string on success, otherwise a description of the first setting that failed
+    std::string applyToCurrentThread() const;
+
+    //Starts task on a new thread, or through the launcher if one is set, with the settings
+    //above applied. Throws std::runtime_error (and does not run task) if they cannot be
+    std::future<void> launch(const std::function<void()> &task) const;
+    //The same, for the places that keep a std::thread instead of a std::future. Throws if
+    //a launcher is set, since a launcher only hands back a std::future
+    std::thread *launchThread(const std::function<void()> &task) const;
+
+    static const constexpr size_t MAXIMUM_THREAD_NAME_LENGTH{15};
+
+private:
+    std::vector<unsigned int> m_cpuAffinity;
+    ThreadSchedulingPolicy m_schedulingPolicy;
+    int m_schedulingPriority;
+    std::string m_threadName;
+    ThreadLauncher m_launcher;
+
+    std::function<void()> configuredTask(const std::function<void()> &task, std::future<std::string> *applied) const;
+};
+
+#endif //TJLUTILS_THREADCONFIGURATION_H
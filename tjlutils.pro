@@ -10,6 +10,8 @@ TARGET = tjlutils
 TEMPLATE = lib
 
 DEFINES += TJLUTILS_LIBRARY
+#Record receive timestamps and latency histograms in SerialPort
+#DEFINES += TJLUTILS_SERIALPORT_TIMING
 
 CONFIG += static_and_shared build_all c++14
 
@@ -24,7 +26,11 @@ INCLUDEPATH += systemcommand/ \
                datetime/ \
                prettyprinter/ \
                udpduplex/ \
-               ibytestream/
+               ibytestream/ \
+               crc32c/ \
+               lzcodec/ \
+               streambridge/ \
+               threadconfiguration/
 
 SOURCES += systemcommand/systemcommand.cpp \
            generalutilities/generalutilities.cpp \
@@ -32,9 +38,20 @@ SOURCES += systemcommand/systemcommand.cpp \
            mathutilities/mathutilities.cpp \
            datetime/datetime.cpp \
            serialport/serialport.cpp \
+           serialport/serialframing.cpp \
+           serialport/serialportmanager.cpp \
+           serialport/serialportwatcher.cpp \
+           serialport/serialtiming.cpp \
+           serialport/serialtransactionclient.cpp \
+           serialport/serialchannelmux.cpp \
            udpduplex/udpduplex.cpp \
+           udpduplex/udprpcclient.cpp \
            prettyprinter/prettyprinter.cpp \
            ibytestream/ibytestream.cpp \
+           crc32c/crc32c.cpp \
+           lzcodec/lzcodec.cpp \
+           streambridge/streambridge.cpp \
+           threadconfiguration/threadconfiguration.cpp \
 
 HEADERS += systemcommand/systemcommand.h \
            mathutilities/mathutilities.h \
@@ -42,13 +59,24 @@ HEADERS += systemcommand/systemcommand.h \
            generalutilities/generalutilities.h \
            datetime/datetime.h \
            serialport/serialport.h \
+           serialport/serialframing.h \
+           serialport/serialportmanager.h \
+           serialport/serialportwatcher.h \
+           serialport/serialtiming.h \
+           serialport/serialtransactionclient.h \
+           serialport/serialchannelmux.h \
            eventtimer/eventtimer.h \
            prettyprinter/prettyprinter \
            udpduplex/udpduplex.h \
+           udpduplex/udprpcclient.h \
            templateobjects/templateobjects.h \
            bitset/bitset.h \
            stringformat/stringformat.h \
-           ibytestream/ibytestream.h
+           ibytestream/ibytestream.h \
+           crc32c/crc32c.h \
+           lzcodec/lzcodec.h \
+           streambridge/streambridge.h \
+           threadconfiguration/threadconfiguration.h
 
 unix {
     target.path = /usr/lib
@@ -0,0 +1,193 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <udpduplex.h>
+#include <lzcodec.h>
+#include <crc32c.h>
+
+//Sends compressible, incompressible and flag-leading payloads through a compressing
+//UDPClient, checking both what goes out on the wire (the 0x01/0x02 flag byte) and that the
+//UDPServer hands back exactly what was sent. Then sends raw datagrams that claim to be
+//compressed but are not valid blocks, and repeats everything with a CRC32C trailer on top,
+//where a corrupted trailer must count as an integrity failure and a corrupted block that
+//still carries a good trailer as a decompression failure
+static const uint16_t SERVER_PORT_NUMBER{9891};
+static const uint16_t CHECKED_SERVER_PORT_NUMBER{9892};
+static const uint16_t WIRE_PORT_NUMBER{9893};
+static const int NUMBER_OF_CORRUPTED_DATAGRAMS{20};
+static const size_t MAXIMUM_DATAGRAM_SIZE{65535};
+static const char UNCOMPRESSED_FLAG{'\x01'};
+static const char COMPRESSED_FLAG{'\x02'};
+
+std::vector<std::string> samplePayloads()
+{
+    std::vector<std::string> payloads{};
+    std::string telemetry{""};
+    for (int i = 0; i < 20; i++) {
+        telemetry += "sensor=" + std::to_string(i % 4) + " temperature=21.5 humidity=40 state=ok;";
+    }
+    payloads.push_back(telemetry);
+
+    std::mt19937 randomEngine{1234};
+    std::uniform_int_distribution<int> printable{33, 126};
+    std::string noise{""};
+    for (int i = 0; i < 600; i++) {
+        noise += static_cast<char>(printable(randomEngine));
+    }
+    payloads.push_back(noise);
+
+    payloads.push_back("short");
+    payloads.push_back(std::string{UNCOMPRESSED_FLAG} + "starts with the uncompressed flag");
+    payloads.push_back(std::string{COMPRESSED_FLAG} + "starts with the compressed flag");
+    return payloads;
+}
+
+int openSocket(uint16_t portNumber)
+{
+    int rawSocket{socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)};
+    if (portNumber != 0) {
+        sockaddr_in bindAddress{};
+        bindAddress.sin_family = AF_INET;
+        bindAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bindAddress.sin_port = htons(portNumber);
+        bind(rawSocket, reinterpret_cast<sockaddr *>(&bindAddress), sizeof(bindAddress));
+        timeval receiveTimeout{1, 0};
+        setsockopt(rawSocket, SOL_SOCKET, SO_RCVTIMEO, &receiveTimeout, sizeof(receiveTimeout));
+    }
+    return rawSocket;
+}
+
+void sendRaw(int rawSocket, uint16_t portNumber, const std::string &datagram)
+{
+    sockaddr_in serverAddress{};
+    serverAddress.sin_family = AF_INET;
+    serverAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    serverAddress.sin_port = htons(portNumber);
+    sendto(rawSocket, datagram.data(), datagram.length(), 0, reinterpret_cast<sockaddr *>(&serverAddress), sizeof(serverAddress));
+}
+
+std::vector<std::string> drain(UDPServer &udpServer)
+{
+    std::vector<std::string> received{};
+    auto lastReceiveTime = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - lastReceiveTime < std::chrono::milliseconds(250)) {
+        std::string message{udpServer.readLine()};
+        if (message.length() == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        lastReceiveTime = std::chrono::steady_clock::now();
+        received.push_back(message);
+    }
+    return received;
+}
+
+//Sends every payload to a plain socket and checks the flag byte each one went out with
+bool checkWireFormat(bool integrityCheckEnabled)
+{
+    int wireSocket{openSocket(WIRE_PORT_NUMBER)};
+    UDPClient udpClient{"127.0.0.1", WIRE_PORT_NUMBER};
+    udpClient.setCompressionEnabled(true);
+    udpClient.setIntegrityCheckEnabled(integrityCheckEnabled);
+    std::vector<std::string> payloads{samplePayloads()};
+    std::vector<char> expectedFlags{COMPRESSED_FLAG, '\0', '\0', UNCOMPRESSED_FLAG, UNCOMPRESSED_FLAG};
+    bool passed{true};
+    for (size_t i = 0; i < payloads.size(); i++) {
+        udpClient.write(payloads[i].data(), payloads[i].length());
+        char buffer[MAXIMUM_DATAGRAM_SIZE];
+        ssize_t received{recv(wireSocket, buffer, sizeof(buffer), 0)};
+        if (received <= 0) {
+            passed = false;
+            continue;
+        }
+        std::string datagram{buffer, static_cast<size_t>(received)};
+        if ((integrityCheckEnabled) && (!CRC32C::verifyAndStripTrailer(&datagram))) {
+            passed = false;
+            continue;
+        }
+        if (expectedFlags[i] == '\0') {
+            passed = passed && (datagram == payloads[i]);
+        } else if (expectedFlags[i] == UNCOMPRESSED_FLAG) {
+            passed = passed && (datagram == UNCOMPRESSED_FLAG + payloads[i]);
+        } else {
+            std::string expanded{""};
+            passed = passed && (datagram[0] == COMPRESSED_FLAG) && (datagram.length() < payloads[i].length())
+                     && (LZCodec::decompress(datagram.data() + 1, datagram.length() - 1, &expanded)) && (expanded == payloads[i]);
+        }
+    }
+    close(wireSocket);
+    std::cout << "test=wire_format crc=" << (integrityCheckEnabled ? "true" : "false")
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return passed;
+}
+
+//Round trips the sample payloads through a compressing client and server, interleaved with
+//raw datagrams flagged as compressed that hold a malformed block, some of which also have a
+//bad trailer when the integrity check is on
+bool checkRoundTrip(uint16_t portNumber, bool integrityCheckEnabled)
+{
+    UDPServer udpServer{portNumber};
+    udpServer.setTimeout(UDPServer::DEFAULT_TIMEOUT);
+    udpServer.setCompressionEnabled(true);
+    udpServer.setIntegrityCheckEnabled(integrityCheckEnabled);
+    udpServer.startListening();
+
+    UDPClient udpClient{"127.0.0.1", portNumber};
+    udpClient.setCompressionEnabled(true);
+    udpClient.setIntegrityCheckEnabled(integrityCheckEnabled);
+    int rawSocket{openSocket(0)};
+
+    std::vector<std::string> payloads{samplePayloads()};
+    std::string compressedBlock{LZCodec::compress(payloads[0])};
+    int expectedIntegrityFailures{0};
+    for (int i = 0; i < NUMBER_OF_CORRUPTED_DATAGRAMS; i++) {
+        const std::string &payload{payloads[static_cast<size_t>(i) % payloads.size()]};
+        udpClient.write(payload.data(), payload.length());
+
+        //A truncated block, which cannot expand to the length it claims
+        std::string corrupted{COMPRESSED_FLAG + compressedBlock.substr(0, compressedBlock.length() / 2)};
+        if (integrityCheckEnabled) {
+            corrupted = CRC32C::appendTrailer(corrupted);
+            if ((i % 2) == 1) {
+                corrupted[corrupted.length() / 2] ^= 0x20;
+                expectedIntegrityFailures++;
+            }
+        }
+        sendRaw(rawSocket, portNumber, corrupted);
+    }
+    close(rawSocket);
+
+    std::vector<std::string> received{drain(udpServer)};
+    udpServer.stopListening();
+
+    size_t intact{0};
+    for (size_t i = 0; i < received.size(); i++) {
+        intact += (received[i] == payloads[i % payloads.size()]) ? 1 : 0;
+    }
+    unsigned long long expectedDecompressionFailures{static_cast<unsigned long long>(NUMBER_OF_CORRUPTED_DATAGRAMS - expectedIntegrityFailures)};
+    bool passed{(received.size() == static_cast<size_t>(NUMBER_OF_CORRUPTED_DATAGRAMS))
+                && (intact == received.size())
+                && (udpServer.decompressionFailureCount() == expectedDecompressionFailures)
+                && (udpServer.integrityFailureCount() == static_cast<unsigned long long>(expectedIntegrityFailures))};
+    std::cout << "test=round_trip crc=" << (integrityCheckEnabled ? "true" : "false")
+              << " received=" << received.size()
+              << " intact=" << intact
+              << " decompression_failures=" << udpServer.decompressionFailureCount()
+              << " integrity_failures=" << udpServer.integrityFailureCount()
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return passed;
+}
+
+int main()
+{
+    bool passed{true};
+    passed &= checkWireFormat(false);
+    passed &= checkWireFormat(true);
+    passed &= checkRoundTrip(SERVER_PORT_NUMBER, false);
+    passed &= checkRoundTrip(CHECKED_SERVER_PORT_NUMBER, true);
+    std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+    return (passed ? 0 : 1);
+}
@@ -0,0 +1,133 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <dirent.h>
+#include <udpduplex.h>
+
+//Ping-pong round trip latency against a loopback echo peer that replies to the
+//source address of each datagram, for the two socket and single socket layouts
+static const uint16_t ECHO_PORT_NUMBER{9900};
+static const uint16_t SHARED_SERVER_PORT_NUMBER{9901};
+static const uint16_t SEPARATE_SERVER_PORT_NUMBER{9902};
+static const int NUMBER_OF_ROUND_TRIPS{20000};
+
+int openFileDescriptorCount()
+{
+    int count{0};
+    DIR *directory{opendir("/proc/self/fd")};
+    if (!directory) {
+        return -1;
+    }
+    while (readdir(directory) != nullptr) {
+        count++;
+    }
+    closedir(directory);
+    //Skip ".", ".." and the descriptor for the directory itself
+    return count - 3;
+}
+
+void runEchoPeer(int echoSocket, std::atomic<bool> *stopEcho, std::atomic<int> *lastSourcePort)
+{
+    char buffer[2048];
+    while (!stopEcho->load()) {
+        sockaddr_in sourceAddress{};
+        socklen_t sourceAddressLength{sizeof(sourceAddress)};
+        ssize_t received{recvfrom(echoSocket, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr *>(&sourceAddress), &sourceAddressLength)};
+        if (received <= 0) {
+            continue;
+        }
+        lastSourcePort->store(ntohs(sourceAddress.sin_port));
+        sendto(echoSocket, buffer, static_cast<size_t>(received), 0, reinterpret_cast<sockaddr *>(&sourceAddress), sourceAddressLength);
+    }
+}
+
+bool runBenchmark(const std::string &name, UDPDuplex *udpDuplex, int fileDescriptorsUsed, const std::atomic<int> &lastSourcePort)
+{
+    std::vector<double> roundTripMicroseconds{};
+    roundTripMicroseconds.reserve(NUMBER_OF_ROUND_TRIPS);
+    int lost{0};
+    for (int i = 0; i < NUMBER_OF_ROUND_TRIPS; i++) {
+        std::string request{"ping:" + std::to_string(i)};
+        auto startTime = std::chrono::steady_clock::now();
+        udpDuplex->writeLine(request);
+        std::string expectedResponse{request + UDPClient::DEFAULT_LINE_ENDING};
+        std::string response{};
+        while ((response != expectedResponse) && (std::chrono::steady_clock::now() - startTime < std::chrono::milliseconds(100))) {
+            response = udpDuplex->readLine();
+        }
+        if (response != expectedResponse) {
+            lost++;
+            continue;
+        }
+        roundTripMicroseconds.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count());
+    }
+    if (roundTripMicroseconds.empty()) {
+        std::cout << "layout=" << name << " lost=" << lost << " result=fail" << std::endl;
+        return false;
+    }
+    std::sort(roundTripMicroseconds.begin(), roundTripMicroseconds.end());
+    double total{0};
+    for (auto &it : roundTripMicroseconds) {
+        total += it;
+    }
+    auto percentile = [&roundTripMicroseconds](double fraction) {
+        return roundTripMicroseconds[static_cast<size_t>(fraction * (roundTripMicroseconds.size() - 1))];
+    };
+    std::cout << "layout=" << name
+              << " fds=" << fileDescriptorsUsed
+              << " reply_source_port=" << lastSourcePort.load()
+              << " round_trips=" << roundTripMicroseconds.size()
+              << " lost=" << lost
+              << " mean_us=" << (total / roundTripMicroseconds.size())
+              << " p50_us=" << percentile(0.50)
+              << " p99_us=" << percentile(0.99)
+              << " max_us=" << roundTripMicroseconds.back() << std::endl;
+    return (lost == 0);
+}
+
+int main()
+{
+    int echoSocket{socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)};
+    sockaddr_in echoAddress{};
+    echoAddress.sin_family = AF_INET;
+    echoAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    echoAddress.sin_port = htons(ECHO_PORT_NUMBER);
+    timeval echoTimeout{0, 50000};
+    setsockopt(echoSocket, SOL_SOCKET, SO_RCVTIMEO, &echoTimeout, sizeof(echoTimeout));
+    if (bind(echoSocket, reinterpret_cast<sockaddr *>(&echoAddress), sizeof(echoAddress)) != 0) {
+        std::cout << "FAILED: could not bind echo peer to port " << ECHO_PORT_NUMBER << std::endl;
+        return 1;
+    }
+    std::atomic<bool> stopEcho{false};
+    std::atomic<int> lastSourcePort{0};
+    std::thread echoThread{runEchoPeer, echoSocket, &stopEcho, &lastSourcePort};
+
+    bool allPassed{true};
+    {
+        int fileDescriptorsBefore{openFileDescriptorCount()};
+        UDPDuplex udpDuplex{"127.0.0.1", ECHO_PORT_NUMBER, SHARED_SERVER_PORT_NUMBER, UDPSocketLayout::Shared};
+        int fileDescriptorsUsed{openFileDescriptorCount() - fileDescriptorsBefore};
+        allPassed &= runBenchmark("shared", &udpDuplex, fileDescriptorsUsed, lastSourcePort);
+        allPassed &= (lastSourcePort.load() == SHARED_SERVER_PORT_NUMBER);
+    }
+    {
+        //Replies land on the unbound client socket (an ephemeral port), and the
+        //server socket is held open but never read
+        int fileDescriptorsBefore{openFileDescriptorCount()};
+        UDPDuplex udpDuplex{"127.0.0.1", ECHO_PORT_NUMBER, SEPARATE_SERVER_PORT_NUMBER, UDPSocketLayout::Separate};
+        int fileDescriptorsUsed{openFileDescriptorCount() - fileDescriptorsBefore};
+        allPassed &= runBenchmark("separate", &udpDuplex, fileDescriptorsUsed, lastSourcePort);
+        bool serverPortKept{udpDuplex.serverPortNumber() == SEPARATE_SERVER_PORT_NUMBER};
+        std::cout << "layout=separate server_port=" << udpDuplex.serverPortNumber() << " result=" << (serverPortKept ? "pass" : "fail") << std::endl;
+        allPassed &= serverPortKept;
+    }
+    stopEcho.store(true);
+    echoThread.join();
+    close(echoSocket);
+    std::cout << "result=" << (allPassed ? "pass" : "fail") << std::endl;
+    return (allPassed ? 0 : 1);
+}
@@ -0,0 +1,66 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <udpduplex.h>
+#include <crc32c.h>
+
+//Sends checksummed datagrams through a UDPClient, plus raw datagrams that are
+//either missing their trailer or corrupted after the checksum was computed,
+//and checks that only the good ones reach the reader
+static const uint16_t SERVER_PORT_NUMBER{9890};
+static const int NUMBER_OF_GOOD_DATAGRAMS{100};
+static const int NUMBER_OF_BAD_DATAGRAMS{50};
+
+int main()
+{
+    UDPServer udpServer{SERVER_PORT_NUMBER};
+    udpServer.setTimeout(UDPServer::DEFAULT_TIMEOUT);
+    udpServer.setIntegrityCheckEnabled(true);
+    udpServer.startListening();
+
+    UDPClient udpClient{"127.0.0.1", SERVER_PORT_NUMBER};
+    udpClient.setIntegrityCheckEnabled(true);
+    int rawSocket{socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)};
+    sockaddr_in serverAddress{};
+    serverAddress.sin_family = AF_INET;
+    serverAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    serverAddress.sin_port = htons(SERVER_PORT_NUMBER);
+
+    for (int i = 0; i < NUMBER_OF_GOOD_DATAGRAMS; i++) {
+        udpClient.writeLine("good:" + std::to_string(i));
+        if (i < NUMBER_OF_BAD_DATAGRAMS) {
+            std::string badDatagram{CRC32C::appendTrailer("bad:" + std::to_string(i))};
+            if ((i % 2) == 0) {
+                badDatagram[1] ^= 0x20;
+            } else {
+                badDatagram.resize(badDatagram.length() - CRC32C::TRAILER_SIZE);
+            }
+            sendto(rawSocket, badDatagram.data(), badDatagram.length(), 0, reinterpret_cast<sockaddr *>(&serverAddress), sizeof(serverAddress));
+        }
+    }
+    close(rawSocket);
+
+    int goodReceived{0};
+    int badReceived{0};
+    auto lastReceiveTime = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - lastReceiveTime < std::chrono::milliseconds(250)) {
+        std::string message{udpServer.readLine()};
+        if (message.length() == 0) {
+            continue;
+        }
+        lastReceiveTime = std::chrono::steady_clock::now();
+        if (message.find("good:") == 0) {
+            goodReceived++;
+        } else {
+            badReceived++;
+        }
+    }
+    udpServer.stopListening();
+    bool passed{(goodReceived == NUMBER_OF_GOOD_DATAGRAMS) && (badReceived == 0) && (udpServer.integrityFailureCount() == NUMBER_OF_BAD_DATAGRAMS)};
+    std::cout << "good_received=" << goodReceived
+              << " bad_received=" << badReceived
+              << " integrity_failures=" << udpServer.integrityFailureCount()
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return (passed ? 0 : 1);
+}
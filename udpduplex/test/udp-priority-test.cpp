@@ -0,0 +1,176 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <future>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <algorithm>
+#include <udpduplex.h>
+
+//Floods a UDPServer with bulk telemetry while a slow reader drains it, and sends a
+//control datagram every CONTROL_INTERVAL bulk datagrams. Control datagrams start
+//with '!' and carry their send time so the reader can measure end to end latency.
+//With control datagrams in their own class, strict or weighted, their average latency
+//has to come in at least MINIMUM_LATENCY_RATIO times lower than with one FIFO queue
+static const uint16_t BASE_SERVER_PORT_NUMBER{9880};
+static const int NUMBER_OF_BULK_DATAGRAMS{20000};
+static const int CONTROL_INTERVAL{200};
+static const auto SIMULATED_PROCESSING_TIME = std::chrono::microseconds(20);
+//Usually 50 to 500 here, since a FIFO control datagram waits behind milliseconds of bulk
+static const long long MINIMUM_LATENCY_RATIO{10};
+
+enum class QueueMode { Fifo, Strict, Weighted };
+
+struct ControlLatency
+{
+    int sent;
+    int received;
+    long long averageMicroseconds;
+    long long maximumMicroseconds;
+};
+
+std::string queueModeToString(QueueMode queueMode)
+{
+    if (queueMode == QueueMode::Fifo) {
+        return "fifo";
+    } else if (queueMode == QueueMode::Strict) {
+        return "strict";
+    } else {
+        return "weighted";
+    }
+}
+
+long long steadyMicroseconds()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int sendTraffic(uint16_t serverPortNumber)
+{
+    int socketNumber{socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)};
+    sockaddr_in serverAddress{};
+    serverAddress.sin_family = AF_INET;
+    serverAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    serverAddress.sin_port = htons(serverPortNumber);
+    int controlDatagramsSent{0};
+    for (int i = 0; i < NUMBER_OF_BULK_DATAGRAMS; i++) {
+        std::string message{"bulk:" + std::to_string(i) + ":" + std::string(64, 'x')};
+        if ((i % CONTROL_INTERVAL) == 0) {
+            message = "!" + std::to_string(steadyMicroseconds());
+            controlDatagramsSent++;
+        }
+        sendto(socketNumber, message.c_str(), message.length(), 0, reinterpret_cast<sockaddr *>(&serverAddress), sizeof(serverAddress));
+        if ((i % 16) == 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+    close(socketNumber);
+    return controlDatagramsSent;
+}
+
+ControlLatency runTest(QueueMode queueMode, uint16_t serverPortNumber)
+{
+    UDPServer udpServer{serverPortNumber};
+    udpServer.setTimeout(UDPServer::DEFAULT_TIMEOUT);
+    if (queueMode != QueueMode::Fifo) {
+        udpServer.setDatagramClassifier(2, [](const sockaddr_in &, const std::string &message) -> unsigned int {
+            return ((message.length() != 0) && (message[0] == '!')) ? 0 : 1;
+        });
+    }
+    if (queueMode == QueueMode::Weighted) {
+        udpServer.setPriorityClassWeight(0, 1);
+        udpServer.setPriorityClassWeight(1, 4);
+    }
+    udpServer.startListening();
+    auto senderFuture = std::async(std::launch::async, sendTraffic, serverPortNumber);
+    int controlDatagramsReceived{0};
+    long long totalControlLatency{0};
+    long long maximumControlLatency{0};
+    auto lastReceiveTime = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - lastReceiveTime < std::chrono::milliseconds(500)) {
+        UDPDatagram datagram{udpServer.readDatagram()};
+        std::string message{datagram.message()};
+        if (message.length() == 0) {
+            continue;
+        }
+        lastReceiveTime = std::chrono::steady_clock::now();
+        if (message[0] == '!') {
+            long long latency{steadyMicroseconds() - std::stoll(message.substr(1))};
+            totalControlLatency += latency;
+            maximumControlLatency = std::max(maximumControlLatency, latency);
+            controlDatagramsReceived++;
+        }
+        auto busyUntil = std::chrono::steady_clock::now() + SIMULATED_PROCESSING_TIME;
+        while (std::chrono::steady_clock::now() < busyUntil) { }
+    }
+    int controlDatagramsSent{senderFuture.get()};
+    for (unsigned int priorityClass = 0; priorityClass < udpServer.priorityClassCount(); priorityClass++) {
+        UDPPriorityClassStatistics statistics{udpServer.priorityClassStatistics(priorityClass)};
+        std::cout << "mode=" << queueModeToString(queueMode)
+                  << " class=" << priorityClass
+                  << " enqueued=" << statistics.enqueuedCount
+                  << " dequeued=" << statistics.dequeuedCount
+                  << " max_depth=" << statistics.maximumDepth
+                  << " avg_queue_latency_us=" << statistics.averageLatency.count()
+                  << " max_queue_latency_us=" << statistics.maximumLatency.count() << std::endl;
+    }
+    ControlLatency controlLatency{};
+    controlLatency.sent = controlDatagramsSent;
+    controlLatency.received = controlDatagramsReceived;
+    controlLatency.averageMicroseconds = (controlDatagramsReceived ? (totalControlLatency / controlDatagramsReceived) : 0);
+    controlLatency.maximumMicroseconds = maximumControlLatency;
+    std::cout << "mode=" << queueModeToString(queueMode)
+              << " control_sent=" << controlLatency.sent
+              << " control_received=" << controlLatency.received
+              << " control_avg_latency_us=" << controlLatency.averageMicroseconds
+              << " control_max_latency_us=" << controlLatency.maximumMicroseconds << std::endl;
+    udpServer.stopListening();
+    return controlLatency;
+}
+
+//Every control datagram has to arrive, and a prioritized one has to spend far less time
+//waiting behind bulk traffic than it does in the FIFO run
+bool prioritizedBeatsFifo(QueueMode queueMode, const ControlLatency &prioritized, const ControlLatency &fifo)
+{
+    bool passed{(prioritized.received == prioritized.sent) && (fifo.received == fifo.sent) &&
+                (prioritized.averageMicroseconds * MINIMUM_LATENCY_RATIO <= fifo.averageMicroseconds)};
+    std::cout << "mode=" << queueModeToString(queueMode)
+              << " fifo_avg_latency_us=" << fifo.averageMicroseconds
+              << " avg_latency_ratio=" << (static_cast<double>(fifo.averageMicroseconds) / std::max<long long>(prioritized.averageMicroseconds, 1))
+              << " minimum_ratio=" << MINIMUM_LATENCY_RATIO
+              << " result=" << (passed ? "pass" : "fail") << std::endl;
+    return passed;
+}
+
+//Weights can only be set once a classifier exists, so replacing the classifier must
+//not throw them away
+bool weightsSurviveReclassification(uint16_t serverPortNumber)
+{
+    UDPServer udpServer{serverPortNumber};
+    auto byFirstByte = [](const sockaddr_in &, const std::string &message) -> unsigned int {
+        return ((message.length() != 0) && (message[0] == '!')) ? 0 : 1;
+    };
+    udpServer.setDatagramClassifier(2, byFirstByte);
+    udpServer.setPriorityClassWeight(0, 1);
+    udpServer.setPriorityClassWeight(1, 4);
+    udpServer.setDatagramClassifier(3, byFirstByte);
+    bool kept{(udpServer.priorityClassWeight(0) == 1) && (udpServer.priorityClassWeight(1) == 4) && (udpServer.priorityClassWeight(2) == 0)};
+    udpServer.setDatagramClassifier(1, byFirstByte);
+    kept = kept && (udpServer.priorityClassWeight(0) == 1);
+    std::cout << "mode=reclassify weights_kept=" << (kept ? "true" : "false") << " result=" << (kept ? "pass" : "fail") << std::endl;
+    return kept;
+}
+
+int main()
+{
+    uint16_t serverPortNumber{BASE_SERVER_PORT_NUMBER};
+    ControlLatency fifo{runTest(QueueMode::Fifo, serverPortNumber++)};
+    bool allPassed{true};
+    for (QueueMode queueMode : {QueueMode::Strict, QueueMode::Weighted}) {
+        ControlLatency prioritized{runTest(queueMode, serverPortNumber++)};
+        allPassed = prioritizedBeatsFifo(queueMode, prioritized, fifo) && allPassed;
+    }
+    allPassed = weightsSurviveReclassification(serverPortNumber) && allPassed;
+    return (allPassed ? 0 : 1);
+}
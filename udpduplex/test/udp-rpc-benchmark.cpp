@@ -0,0 +1,97 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <chrono>
+#include <cstring>
+#include <udpduplex.h>
+#include <udprpcclient.h>
+
+//Loopback responder that echoes every request back to its source address after a
+//fixed delay, standing in for a device on a high-RTT link
+static const uint16_t RESPONDER_PORT_NUMBER{9870};
+static const auto SIMULATED_ROUND_TRIP_TIME = std::chrono::milliseconds(4);
+static const int NUMBER_OF_REQUESTS{500};
+
+static bool shutEmDown{false};
+
+void delayedResponder()
+{
+    struct PendingReply
+    {
+        std::chrono::steady_clock::time_point sendTime;
+        sockaddr_in address;
+        std::string message;
+    };
+    int socketNumber{socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)};
+    sockaddr_in bindAddress{};
+    bindAddress.sin_family = AF_INET;
+    bindAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bindAddress.sin_port = htons(RESPONDER_PORT_NUMBER);
+    if (bind(socketNumber, reinterpret_cast<sockaddr *>(&bindAddress), sizeof(bindAddress)) != 0) {
+        std::cout << "Unable to bind responder to port " << RESPONDER_PORT_NUMBER << std::endl;
+        return;
+    }
+    timeval tv{};
+    tv.tv_usec = 100;
+    setsockopt(socketNumber, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    std::deque<PendingReply> pendingReplies;
+    char buffer[65535];
+    while (!shutEmDown) {
+        sockaddr_in fromAddress{};
+        socklen_t fromLength{sizeof(fromAddress)};
+        ssize_t received{recvfrom(socketNumber, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr *>(&fromAddress), &fromLength)};
+        if (received > 0) {
+            pendingReplies.push_back(PendingReply{std::chrono::steady_clock::now() + SIMULATED_ROUND_TRIP_TIME, fromAddress, std::string{buffer, static_cast<size_t>(received)}});
+        }
+        auto now = std::chrono::steady_clock::now();
+        while ((!pendingReplies.empty()) && (pendingReplies.front().sendTime <= now)) {
+            sendto(socketNumber, pendingReplies.front().message.data(), pendingReplies.front().message.size(), 0,
+                   reinterpret_cast<sockaddr *>(&pendingReplies.front().address), sizeof(pendingReplies.front().address));
+            pendingReplies.pop_front();
+        }
+    }
+    close(socketNumber);
+}
+
+void runBenchmark(std::shared_ptr<UDPDuplex> udpDuplex, size_t maximumInFlight)
+{
+    UDPRpcClient rpcClient{udpDuplex, maximumInFlight};
+    std::vector<std::future<UDPRpcResponse>> responses;
+    responses.reserve(NUMBER_OF_REQUESTS);
+    auto startTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < NUMBER_OF_REQUESTS; i++) {
+        responses.emplace_back(rpcClient.request("read:" + std::to_string(i), std::chrono::milliseconds(5000)));
+    }
+    int succeeded{0};
+    long long totalRoundTripTime{0};
+    for (auto &it : responses) {
+        UDPRpcResponse response{it.get()};
+        if (response.status() == UDPRpcStatus::Success) {
+            succeeded++;
+            totalRoundTripTime += response.roundTripTime().count();
+        }
+    }
+    double elapsedSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()};
+    std::cout << "window=" << maximumInFlight
+              << " requests=" << NUMBER_OF_REQUESTS
+              << " succeeded=" << succeeded
+              << " elapsed_s=" << elapsedSeconds
+              << " requests_per_s=" << (succeeded / elapsedSeconds)
+              << " mean_rtt_us=" << (succeeded ? (totalRoundTripTime / succeeded) : 0) << std::endl;
+}
+
+int main()
+{
+    auto responderFuture = std::async(std::launch::async, delayedResponder);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::shared_ptr<UDPDuplex> udpDuplex{std::make_shared<UDPDuplex>("127.0.0.1", RESPONDER_PORT_NUMBER, 9871)};
+    for (size_t maximumInFlight : {1, 4, 16, 64}) {
+        runBenchmark(udpDuplex, maximumInFlight);
+    }
+    shutEmDown = true;
+    responderFuture.wait();
+    return 0;
+}
@@ -28,8 +28,11 @@
 #include <limits>
 #include <mutex>
 #include <memory.h>
+#include <sys/uio.h>
 
 #include "udpduplex.h"
+#include "crc32c.h"
+#include "lzcodec.h"
 
 inline bool endsWith(const std::string &stringToCheck, const std::string &matchString)
 {
@@ -60,6 +63,42 @@ static std::string toStdString(const struct sockaddr_in &sock) {
     return returnString;
 }
 
+//Compressed datagrams start with DATAGRAM_COMPRESSED_FLAG followed by an LZCodec block
+//Datagrams that were not worth compressing go out as-is, unless they happen to start with
+//one of the flag bytes, in which case DATAGRAM_UNCOMPRESSED_FLAG is prepended. Anything
+//else is passed through untouched, so peers without compression enabled still interoperate
+static const char DATAGRAM_UNCOMPRESSED_FLAG{'\x01'};
+static const char DATAGRAM_COMPRESSED_FLAG{'\x02'};
+static const size_t MINIMUM_COMPRESSIBLE_DATAGRAM_LENGTH{32};
+
+static std::string compressDatagram(const std::string &datagram)
+{
+    if (datagram.length() >= MINIMUM_COMPRESSIBLE_DATAGRAM_LENGTH) {
+        std::string compressed{LZCodec::compress(datagram)};
+        //Only worth it if at least an eighth of the datagram is saved
+        if (compressed.length() + 1 <= datagram.length() - (datagram.length() / 8)) {
+            return DATAGRAM_COMPRESSED_FLAG + compressed;
+        }
+    }
+    if ((datagram.length() != 0) && ((datagram[0] == DATAGRAM_UNCOMPRESSED_FLAG) || (datagram[0] == DATAGRAM_COMPRESSED_FLAG))) {
+        return DATAGRAM_UNCOMPRESSED_FLAG + datagram;
+    }
+    return datagram;
+}
+
+static bool expandDatagram(std::string *datagram, size_t maximumLength)
+{
+    if (datagram->length() == 0) {
+        return true;
+    } else if ((*datagram)[0] == DATAGRAM_UNCOMPRESSED_FLAG) {
+        datagram->erase(0, 1);
+        return true;
+    } else if ((*datagram)[0] == DATAGRAM_COMPRESSED_FLAG) {
+        return LZCodec::decompress(datagram->data() + 1, datagram->length() - 1, datagram, maximumLength);
+    }
+    return true;
+}
+
 template <typename T> static inline std::string tQuoted(const T &t) {
     return "\"" + toStdString(t) + "\"";
 }
@@ -192,6 +231,205 @@ T doUserSelectParameter(const std::string &name,
     }
 }
 
+const constexpr unsigned int UDPDatagramQueue::MAXIMUM_PRIORITY_CLASS_COUNT;
+
+UDPDatagramQueue::UDPDatagramQueue() :
+    m_priorityClasses{},
+    m_putBackDatagrams{},
+    m_classifier{nullptr},
+    m_size{0}
+{
+    this->m_priorityClasses.resize(1, PriorityClass{});
+}
+
+void UDPDatagramQueue::emplace_back(const struct sockaddr_in &socketAddress, const std::string &message)
+{
+    unsigned int priorityClass{0};
+    if (this->m_classifier) {
+        priorityClass = std::min<unsigned int>(this->m_classifier(socketAddress, message), this->m_priorityClasses.size() - 1);
+    }
+    PriorityClass &targetClass = this->m_priorityClasses[priorityClass];
+    targetClass.datagrams.push_back(QueuedDatagram{UDPDatagram{socketAddress, message}, std::chrono::steady_clock::now()});
+    targetClass.enqueuedCount++;
+    targetClass.maximumDepth = std::max(targetClass.maximumDepth, targetClass.datagrams.size());
+    this->m_size++;
+}
+
+void UDPDatagramQueue::emplace_front(const struct sockaddr_in &socketAddress, const std::string &message)
+{
+    this->m_putBackDatagrams.emplace_front(socketAddress, message);
+    this->m_size++;
+}
+
+void UDPDatagramQueue::push_front(const UDPDatagram &datagram)
+{
+    this->m_putBackDatagrams.push_front(datagram);
+    this->m_size++;
+}
+
+const UDPDatagram &UDPDatagramQueue::front() const
+{
+    static const UDPDatagram EMPTY_DATAGRAM{};
+    if (!this->m_putBackDatagrams.empty()) {
+        return this->m_putBackDatagrams.front();
+    }
+    size_t priorityClass{this->nextPriorityClass()};
+    if (priorityClass == this->m_priorityClasses.size()) {
+        return EMPTY_DATAGRAM;
+    }
+    return this->m_priorityClasses[priorityClass].datagrams.front().datagram;
+}
+
+void UDPDatagramQueue::pop_front()
+{
+    if (!this->m_putBackDatagrams.empty()) {
+        this->m_putBackDatagrams.pop_front();
+        this->m_size--;
+        return;
+    }
+    size_t priorityClass{this->nextPriorityClass()};
+    if (priorityClass == this->m_priorityClasses.size()) {
+        return;
+    }
+    PriorityClass &sourceClass = this->m_priorityClasses[priorityClass];
+    if (sourceClass.weight != 0) {
+        if (sourceClass.credits == 0) {
+            //Every backlogged weighted class has used up its share, so start a new round
+            for (auto &it : this->m_priorityClasses) {
+                it.credits = it.weight;
+            }
+        }
+        sourceClass.credits--;
+    }
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sourceClass.datagrams.front().enqueueTime);
+    sourceClass.totalLatency += latency;
+    sourceClass.maximumLatency = std::max(sourceClass.maximumLatency, latency);
+    sourceClass.dequeuedCount++;
+    sourceClass.datagrams.pop_front();
+    this->m_size--;
+}
+
+size_t UDPDatagramQueue::nextPriorityClass() const
+{
+    size_t exhaustedClass{this->m_priorityClasses.size()};
+    for (size_t i = 0; i < this->m_priorityClasses.size(); i++) {
+        const PriorityClass &priorityClass = this->m_priorityClasses[i];
+        if (priorityClass.datagrams.empty()) {
+            continue;
+        }
+        if ((priorityClass.weight == 0) || (priorityClass.credits != 0)) {
+            return i;
+        }
+        if (exhaustedClass == this->m_priorityClasses.size()) {
+            exhaustedClass = i;
+        }
+    }
+    return exhaustedClass;
+}
+
+size_t UDPDatagramQueue::size() const
+{
+    return this->m_size;
+}
+
+void UDPDatagramQueue::clear()
+{
+    for (auto &it : this->m_priorityClasses) {
+        it.datagrams.clear();
+        it.credits = it.weight;
+    }
+    this->m_putBackDatagrams.clear();
+    this->m_size = 0;
+}
+
+void UDPDatagramQueue::setClassifier(unsigned int priorityClassCount, const UDPDatagramClassifier &classifier)
+{
+    if ((priorityClassCount == 0) || (priorityClassCount > UDPDatagramQueue::MAXIMUM_PRIORITY_CLASS_COUNT)) {
+        throw std::runtime_error("In UDPDatagramQueue::setClassifier(unsigned int, const UDPDatagramClassifier &): Priority class count must be between 1 and "
+                                 + std::to_string(UDPDatagramQueue::MAXIMUM_PRIORITY_CLASS_COUNT)
+                                 + " ("
+                                 + std::to_string(priorityClassCount)
+                                 + ")");
+    }
+    //Reclassify anything still waiting, in the order it arrived
+    std::vector<QueuedDatagram> waitingDatagrams{};
+    for (auto &it : this->m_priorityClasses) {
+        waitingDatagrams.insert(waitingDatagrams.end(), it.datagrams.begin(), it.datagrams.end());
+    }
+    std::stable_sort(waitingDatagrams.begin(), waitingDatagrams.end(), [](const QueuedDatagram &lhs, const QueuedDatagram &rhs) {
+        return lhs.enqueueTime < rhs.enqueueTime;
+    });
+    this->m_classifier = classifier;
+    //Classes that still exist keep their weight, credits and statistics, new ones start unweighted
+    for (auto &it : this->m_priorityClasses) {
+        it.datagrams.clear();
+    }
+    this->m_priorityClasses.resize(priorityClassCount, PriorityClass{});
+    for (auto &it : waitingDatagrams) {
+        unsigned int priorityClass{0};
+        if (this->m_classifier) {
+            priorityClass = std::min<unsigned int>(this->m_classifier(it.datagram.socketAddress(), it.datagram.message()), priorityClassCount - 1);
+        }
+        this->m_priorityClasses[priorityClass].datagrams.push_back(it);
+        this->m_priorityClasses[priorityClass].maximumDepth = std::max(this->m_priorityClasses[priorityClass].maximumDepth,
+                                                                       this->m_priorityClasses[priorityClass].datagrams.size());
+    }
+}
+
+unsigned int UDPDatagramQueue::priorityClassCount() const
+{
+    return this->m_priorityClasses.size();
+}
+
+void UDPDatagramQueue::setPriorityClassWeight(unsigned int priorityClass, unsigned int weight)
+{
+    this->checkPriorityClass("setPriorityClassWeight(unsigned int, unsigned int)", priorityClass);
+    this->m_priorityClasses[priorityClass].weight = weight;
+    this->m_priorityClasses[priorityClass].credits = weight;
+}
+
+unsigned int UDPDatagramQueue::priorityClassWeight(unsigned int priorityClass) const
+{
+    this->checkPriorityClass("priorityClassWeight(unsigned int)", priorityClass);
+    return this->m_priorityClasses[priorityClass].weight;
+}
+
+UDPPriorityClassStatistics UDPDatagramQueue::priorityClassStatistics(unsigned int priorityClass) const
+{
+    this->checkPriorityClass("priorityClassStatistics(unsigned int)", priorityClass);
+    const PriorityClass &sourceClass = this->m_priorityClasses[priorityClass];
+    UDPPriorityClassStatistics statistics{};
+    statistics.depth = sourceClass.datagrams.size();
+    statistics.maximumDepth = sourceClass.maximumDepth;
+    statistics.enqueuedCount = sourceClass.enqueuedCount;
+    statistics.dequeuedCount = sourceClass.dequeuedCount;
+    statistics.averageLatency = (sourceClass.dequeuedCount == 0) ? std::chrono::microseconds{0} : std::chrono::microseconds{sourceClass.totalLatency.count() / static_cast<long long>(sourceClass.dequeuedCount)};
+    statistics.maximumLatency = sourceClass.maximumLatency;
+    return statistics;
+}
+
+void UDPDatagramQueue::resetPriorityClassStatistics()
+{
+    for (auto &it : this->m_priorityClasses) {
+        it.maximumDepth = it.datagrams.size();
+        it.enqueuedCount = 0;
+        it.dequeuedCount = 0;
+        it.totalLatency = std::chrono::microseconds{0};
+        it.maximumLatency = std::chrono::microseconds{0};
+    }
+}
+
+void UDPDatagramQueue::checkPriorityClass(const std::string &functionName, unsigned int priorityClass) const
+{
+    if (priorityClass >= this->m_priorityClasses.size()) {
+        throw std::runtime_error("In UDPDatagramQueue::" + functionName + ": Priority class "
+                                 + std::to_string(priorityClass)
+                                 + " is out of range (only "
+                                 + std::to_string(this->m_priorityClasses.size())
+                                 + " priority classes are configured)");
+    }
+}
+
 const uint16_t UDPServer::BROADCAST{1};
 
 UDPServer::UDPServer() :
@@ -202,15 +440,42 @@ UDPServer::UDPServer() :
 
 UDPServer::UDPServer(uint16_t portNumber) :
     m_socketAddress{},
-    m_isListening{false},
     m_socketNumber{0},
+    m_ownsSocket{true},
+    m_isListening{false},
     m_timeout{UDPServer::DEFAULT_TIMEOUT},
     m_datagramQueue{},
-    m_shutEmDown{false}
+    m_shutEmDown{false},
+    m_isEchoServer{false},
+    m_integrityCheckEnabled{false},
+    m_integrityFailureCount{0},
+    m_compressionEnabled{false},
+    m_decompressionFailureCount{0},
+    m_oversizeDatagramCount{0},
+    m_listenerThreadConfiguration{}
 {
     this->initialize(portNumber);
 }
 
+UDPServer::UDPServer(int sharedSocketNumber, const struct sockaddr_in &socketAddress) :
+    m_socketAddress(socketAddress),
+    m_socketNumber{sharedSocketNumber},
+    m_ownsSocket{false},
+    m_isListening{false},
+    m_timeout{UDPServer::DEFAULT_TIMEOUT},
+    m_datagramQueue{},
+    m_shutEmDown{false},
+    m_isEchoServer{false},
+    m_integrityCheckEnabled{false},
+    m_integrityFailureCount{0},
+    m_compressionEnabled{false},
+    m_decompressionFailureCount{0},
+    m_oversizeDatagramCount{0},
+    m_listenerThreadConfiguration{}
+{
+
+}
+
 bool constexpr UDPServer::isValidPortNumber(int portNumber)
 {
     return ((portNumber > 0) && (portNumber < std::numeric_limits<uint16_t>::max()));
@@ -325,28 +590,7 @@ void UDPServer::startListening(int socketNumber)
 {
     if (!this->m_isListening) {
         this->m_isListening = true;
-#if defined(__ANDROID__)
-        if (this->m_asyncFuture) {
-            this->m_asyncFuture.join();
-            delete this->m_asyncFuture;
-        }
-        this->m_asyncFuture = new std::thread{&static_cast<void (UDPServer::*)(int)>(&UDPServer::asyncDatagramListener),
-                                              this,
-                                              socketNumber};
-#else
-    try {
-        do {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        } while (this->m_asyncFuture.wait_for(std::chrono::milliseconds(0)) != std::future_status::ready);
-        //this->m_asyncFuture.reset();
-    } catch (std::exception &e) {
-        
-    }
-    this->m_asyncFuture = std::async(std::launch::async,
-                                    static_cast<void (UDPServer::*)(int)>(&UDPServer::asyncDatagramListener),
-                                    this,
-                                    socketNumber);
-#endif
+        this->launchListener([this, socketNumber]() { this->asyncDatagramListener(socketNumber); });
     }
 }
 
@@ -354,13 +598,18 @@ void UDPServer::startListening()
 {
     if (!this->m_isListening) {
         this->m_isListening = true;
+        this->launchListener([this]() { this->asyncDatagramListener(); });
+    }
+}
+
+void UDPServer::launchListener(const std::function<void()> &listener)
+{
 #if defined(__ANDROID__)
-        if (this->m_asyncFuture) {
-            this->m_asyncFuture.join();
-            delete this->m_asyncFuture;
-        }
-        this->m_asyncFuture = new std::thread{&static_cast<void (UDPServer::*)()>(&UDPServer::asyncDatagramListener),
-                                              this};
+    if (this->m_asyncFuture) {
+        this->m_asyncFuture->join();
+        delete this->m_asyncFuture;
+        this->m_asyncFuture = nullptr;
+    }
 #else
     try {
         do {
@@ -370,10 +619,16 @@ void UDPServer::startListening()
     } catch (std::exception &e) {
         
     }
-    this->m_asyncFuture = std::async(std::launch::async,
-                                    static_cast<void (UDPServer::*)()>(&UDPServer::asyncDatagramListener),
-                                    this);
 #endif
+    try {
+#if defined(__ANDROID__)
+        this->m_asyncFuture = this->m_listenerThreadConfiguration.launchThread(listener);
+#else
+        this->m_asyncFuture = this->m_listenerThreadConfiguration.launch(listener);
+#endif
+    } catch (std::exception &e) {
+        this->m_isListening = false;
+        throw std::runtime_error("In UDPServer::startListening(): Unable to start the listener on port " + std::to_string(this->portNumber()) + ": " + e.what());
     }
 }
 
@@ -399,6 +654,16 @@ void UDPServer::stopListening()
 #endif
 }
 
+void UDPServer::setListenerThreadConfiguration(const ThreadConfiguration &threadConfiguration)
+{
+    this->m_listenerThreadConfiguration = threadConfiguration;
+}
+
+ThreadConfiguration UDPServer::listenerThreadConfiguration() const
+{
+    return this->m_listenerThreadConfiguration;
+}
+
 bool UDPServer::isListening() const
 {
     return this->m_isListening;
@@ -419,11 +684,11 @@ void UDPServer::asyncDatagramListener()
                             0,
                             reinterpret_cast<sockaddr *>(&receivedAddress),
                             &socketSize)};
-        if ((returnValue == EAGAIN) || (returnValue == EWOULDBLOCK) || (returnValue == -1)) {
+        if (returnValue == -1) {
             //No data;
         } else {
-            receivedString = std::string{lowLevelReceiveBuffer};
-            if (receivedString.length() > 0) {
+            receivedString = std::string{lowLevelReceiveBuffer, static_cast<size_t>(returnValue)};
+            if ((this->unwrapDatagram(&receivedString)) && (receivedString.length() > 0)) {
                 ioMutexLock.lock();
                 this->m_datagramQueue.emplace_back(receivedAddress, receivedString);
                 ioMutexLock.unlock();
@@ -449,11 +714,11 @@ void UDPServer::asyncDatagramListener(int socketNumber)
                             0,
                             reinterpret_cast<sockaddr *>(&receivedAddress),
                             &socketSize)};
-        if ((returnValue == EAGAIN) || (returnValue == EWOULDBLOCK) || (returnValue == -1)) {
+        if (returnValue == -1) {
             //No data;
         } else {
-            receivedString = std::string{lowLevelReceiveBuffer};
-            if (receivedString.length() > 0) {
+            receivedString = std::string{lowLevelReceiveBuffer, static_cast<size_t>(returnValue)};
+            if ((this->unwrapDatagram(&receivedString)) && (receivedString.length() > 0)) {
                 ioMutexLock.lock();
                 this->m_datagramQueue.emplace_back(receivedAddress, receivedString);
                 ioMutexLock.unlock();
@@ -476,11 +741,11 @@ void UDPServer::syncDatagramListener(int socketNumber)
                         0,
                         reinterpret_cast<sockaddr *>(&receivedAddress),
                         &socketSize)};
-    if ((returnValue == EAGAIN) || (returnValue == EWOULDBLOCK) || (returnValue == -1)) {
+    if (returnValue == -1) {
         return;
     }
-    receivedString = std::string{lowLevelReceiveBuffer};
-    if (receivedString.length() > 0) {
+    receivedString = std::string{lowLevelReceiveBuffer, static_cast<size_t>(returnValue)};
+    if ((this->unwrapDatagram(&receivedString)) && (receivedString.length() > 0)) {
         ioMutexLock.lock();
         this->m_datagramQueue.emplace_back(receivedAddress, receivedString);
         ioMutexLock.unlock();
@@ -496,9 +761,13 @@ void UDPServer::respondTo(struct sockaddr_in *address, const std::string &receiv
         throw std::runtime_error("In UDPServer::respondTo(struct sockaddr_in *, const std::string &): sockaddr_in is a nullptr");
     }
     auto udpSocketIndex = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    std::string responseString{this->m_compressionEnabled ? compressDatagram(receivedString) : receivedString};
+    if (this->m_integrityCheckEnabled) {
+        responseString = CRC32C::appendTrailer(responseString);
+    }
     ssize_t bytesWritten{sendto(udpSocketIndex, 
-                        receivedString.c_str(), 
-                        strlen(receivedString.c_str()),
+                        responseString.data(), 
+                        responseString.length(),
                         MSG_DONTWAIT,
                         reinterpret_cast<sockaddr*>(address),
                         sizeof(*address)) };
@@ -509,8 +778,74 @@ void UDPServer::respondTo(struct sockaddr_in *address, const std::string &receiv
     */
 }
 
+bool UDPServer::unwrapDatagram(std::string *receivedString)
+{
+    if (!this->verifyIntegrity(receivedString)) {
+        return false;
+    }
+    if ((!this->m_compressionEnabled) || (expandDatagram(receivedString, UDPServer::MAXIMUM_BUFFER_SIZE))) {
+        return true;
+    }
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    this->m_decompressionFailureCount++;
+    return false;
+}
+
+bool UDPServer::compressionEnabled() const
+{
+    return this->m_compressionEnabled;
+}
+
+void UDPServer::setCompressionEnabled(bool compressionEnabled)
+{
+    this->m_compressionEnabled = compressionEnabled;
+}
+
+unsigned long long UDPServer::decompressionFailureCount() const
+{
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    return this->m_decompressionFailureCount;
+}
+
+unsigned long long UDPServer::oversizeDatagramCount() const
+{
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    return this->m_oversizeDatagramCount;
+}
+
+bool UDPServer::verifyIntegrity(std::string *receivedString)
+{
+    if ((!this->m_integrityCheckEnabled) || (CRC32C::verifyAndStripTrailer(receivedString))) {
+        return true;
+    }
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    this->m_integrityFailureCount++;
+    return false;
+}
+
+bool UDPServer::integrityCheckEnabled() const
+{
+    return this->m_integrityCheckEnabled;
+}
+
+void UDPServer::setIntegrityCheckEnabled(bool integrityCheckEnabled)
+{
+    this->m_integrityCheckEnabled = integrityCheckEnabled;
+}
+
+unsigned long long UDPServer::integrityFailureCount() const
+{
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    return this->m_integrityFailureCount;
+}
+
 void UDPServer::syncDatagramListener()
 {
+    if (this->m_isListening) {
+        //The async listener is already draining the socket into the receive queue,
+        //so reads only need to look at the queue (and not sit in recvfrom() each time)
+        return;
+    }
     std::unique_lock<std::mutex> ioMutexLock{this->m_ioMutex, std::defer_lock};
     char lowLevelReceiveBuffer[UDPServer::RECEIVED_BUFFER_MAX];
     memset(lowLevelReceiveBuffer, 0, UDPServer::RECEIVED_BUFFER_MAX);
@@ -523,11 +858,11 @@ void UDPServer::syncDatagramListener()
                         0,
                         reinterpret_cast<sockaddr *>(&receivedAddress),
                         &socketSize)};
-    if ((returnValue == EAGAIN) || (returnValue == EWOULDBLOCK) || (returnValue == -1)) {
+    if (returnValue == -1) {
         return;
     }
-    receivedString = std::string{lowLevelReceiveBuffer};
-    if (receivedString.length() > 0) {
+    receivedString = std::string{lowLevelReceiveBuffer, static_cast<size_t>(returnValue)};
+    if ((this->unwrapDatagram(&receivedString)) && (receivedString.length() > 0)) {
         ioMutexLock.lock();
         this->m_datagramQueue.emplace_back(receivedAddress, receivedString);
         ioMutexLock.unlock();
@@ -693,6 +1028,42 @@ void UDPServer::putBack(const std::string &str)
     this->m_datagramQueue.emplace_front(newDatagramAddress, newDatagramMessage);
 }
 
+void UDPServer::setDatagramClassifier(unsigned int priorityClassCount, const UDPDatagramClassifier &classifier)
+{
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    this->m_datagramQueue.setClassifier(priorityClassCount, classifier);
+}
+
+unsigned int UDPServer::priorityClassCount() const
+{
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    return this->m_datagramQueue.priorityClassCount();
+}
+
+void UDPServer::setPriorityClassWeight(unsigned int priorityClass, unsigned int weight)
+{
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    this->m_datagramQueue.setPriorityClassWeight(priorityClass, weight);
+}
+
+unsigned int UDPServer::priorityClassWeight(unsigned int priorityClass) const
+{
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    return this->m_datagramQueue.priorityClassWeight(priorityClass);
+}
+
+UDPPriorityClassStatistics UDPServer::priorityClassStatistics(unsigned int priorityClass) const
+{
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    return this->m_datagramQueue.priorityClassStatistics(priorityClass);
+}
+
+void UDPServer::resetPriorityClassStatistics()
+{
+    std::lock_guard<std::mutex> ioMutexLock{this->m_ioMutex};
+    this->m_datagramQueue.resetPriorityClassStatistics();
+}
+
 uint16_t UDPServer::doUserSelectPortNumber()
 {
     return doUserEnterNumericParameter("Server Port Number",
@@ -818,6 +1189,79 @@ UDPDatagram UDPServer::readDatagram(int socketNumber)
     }
 }
 
+ssize_t UDPServer::readDatagram(char *buffer, size_t length)
+{
+    return this->readDatagram(this->m_socketNumber, buffer, length);
+}
+
+ssize_t UDPServer::readDatagram(int socketNumber, char *buffer, size_t length)
+{
+    if ((!buffer) || (length == 0)) {
+        return 0;
+    }
+    std::unique_lock<std::mutex> ioMutexLock{this->m_ioMutex};
+    if ((this->m_isListening) || (this->m_datagramQueue.size() > 0)) {
+        //Datagrams that are already queued (or put back) come out first
+        if (this->m_datagramQueue.size() == 0) {
+            return 0;
+        }
+        std::string message{this->m_datagramQueue.front().message()};
+        this->m_datagramQueue.pop_front();
+        if (message.length() > length) {
+            this->m_oversizeDatagramCount++;
+            return 0;
+        }
+        memcpy(buffer, message.data(), message.length());
+        return message.length();
+    }
+    ioMutexLock.unlock();
+    sockaddr_in receivedAddress{};
+    platform_socklen_t socketSize{sizeof(receivedAddress)};
+    //MSG_TRUNC returns the real length of the datagram, even when only length bytes of it fit
+    ssize_t returnValue{recvfrom(socketNumber,
+                        buffer,
+                        length,
+                        MSG_TRUNC,
+                        reinterpret_cast<sockaddr *>(&receivedAddress),
+                        &socketSize)};
+    if (returnValue <= 0) {
+        return 0;
+    }
+    size_t receivedLength{static_cast<size_t>(returnValue)};
+    if (receivedLength > length) {
+        ioMutexLock.lock();
+        this->m_oversizeDatagramCount++;
+        return 0;
+    }
+    if (this->m_compressionEnabled) {
+        std::string receivedString{buffer, receivedLength};
+        if (!this->unwrapDatagram(&receivedString)) {
+            return 0;
+        }
+        if (receivedString.length() > length) {
+            ioMutexLock.lock();
+            this->m_oversizeDatagramCount++;
+            return 0;
+        }
+        memcpy(buffer, receivedString.data(), receivedString.length());
+        return receivedString.length();
+    }
+    if (this->m_integrityCheckEnabled) {
+        uint32_t receivedCrc{0};
+        if (receivedLength >= CRC32C::TRAILER_SIZE) {
+            receivedLength -= CRC32C::TRAILER_SIZE;
+            for (size_t i = 0; i < CRC32C::TRAILER_SIZE; i++) {
+                receivedCrc |= (static_cast<uint32_t>(static_cast<unsigned char>(buffer[receivedLength + i])) << (8 * i));
+            }
+        }
+        if ((static_cast<size_t>(returnValue) < CRC32C::TRAILER_SIZE) || (CRC32C::compute(buffer, receivedLength) != receivedCrc)) {
+            ioMutexLock.lock();
+            this->m_integrityFailureCount++;
+            return 0;
+        }
+    }
+    return receivedLength;
+}
 
 std::string UDPServer::readLine(int socketNumber)
 {
@@ -834,7 +1278,9 @@ std::string UDPServer::readLine(int socketNumber)
 UDPServer::~UDPServer()
 {
     this->stopListening();
-    shutdown(this->m_socketNumber, SHUT_RDWR);
+    if (this->m_ownsSocket) {
+        shutdown(this->m_socketNumber, SHUT_RDWR);
+    }
 }
 
 //Loopback
@@ -876,9 +1322,11 @@ UDPClient::UDPClient(const std::string &hostName, uint16_t portNumber) :
 UDPClient::UDPClient(const std::string &hostName, uint16_t portNumber, uint16_t returnAddressPortNumber) :
     m_destinationAddress{},
     m_returnAddress{},
-    m_udpSocketIndex{0},
     m_timeout{DEFAULT_TIMEOUT},
-    m_lineEnding{DEFAULT_LINE_ENDING}
+    m_udpSocketIndex{0},
+    m_lineEnding{DEFAULT_LINE_ENDING},
+    m_integrityCheckEnabled{false},
+    m_compressionEnabled{false}
 {
     this->initialize(hostName,
                      portNumber,
@@ -925,6 +1373,26 @@ std::string UDPClient::lineEnding() const
     return this->m_lineEnding;
 }
 
+bool UDPClient::integrityCheckEnabled() const
+{
+    return this->m_integrityCheckEnabled;
+}
+
+void UDPClient::setIntegrityCheckEnabled(bool integrityCheckEnabled)
+{
+    this->m_integrityCheckEnabled = integrityCheckEnabled;
+}
+
+bool UDPClient::compressionEnabled() const
+{
+    return this->m_compressionEnabled;
+}
+
+void UDPClient::setCompressionEnabled(bool compressionEnabled)
+{
+    this->m_compressionEnabled = compressionEnabled;
+}
+
 void UDPClient::setTimeout(unsigned long int timeout)
 {
     this->m_timeout = timeout;
@@ -1018,6 +1486,14 @@ void UDPClient::initialize(const std::string &hostName, uint16_t portNumber, uin
     
 }
 
+void UDPClient::bindToReturnAddress()
+{
+    this->m_returnAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(this->m_udpSocketIndex, reinterpret_cast<sockaddr*>(&this->m_returnAddress), sizeof(this->m_returnAddress)) != 0) {
+       throw std::runtime_error("ERROR: UDPClient could not bind socket to address " + tQuoted(toStdString(this->m_returnAddress)) + " (is something else using it?)");
+    }
+}
+
 int UDPClient::resolveAddressHelper(const std::string &hostName, int family, const std::string &service, sockaddr_storage* addressPtr)
 {
     int result{0};
@@ -1065,16 +1541,24 @@ ssize_t UDPClient::writeLine(const std::string &hostName, uint16_t portNumber, c
     if (!endsWith(copyString, this->m_lineEnding)) {
         copyString += this->m_lineEnding;
     }
+    if (this->m_compressionEnabled) {
+        copyString = compressDatagram(copyString);
+    }
+    if (this->m_integrityCheckEnabled) {
+        copyString = CRC32C::appendTrailer(copyString);
+    }
     unsigned int retryCount{0};
     do {
         ssize_t bytesWritten{sendto(this->m_udpSocketIndex, 
-                            copyString.c_str(), 
-                            strlen(copyString.c_str()),
+                            copyString.data(), 
+                            copyString.length(),
                             MSG_DONTWAIT,
                             reinterpret_cast<sockaddr*>(&this->m_destinationAddress),
                             sizeof(this->m_destinationAddress)) };
-        if ((bytesWritten != -1) && (errno != EAGAIN) && (errno != EWOULDBLOCK))  {
+        if (bytesWritten != -1) {
             return bytesWritten;
+        } else if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+            return 0;
         }
     } while (retryCount++ < UDPClient::SEND_RETRY_COUNT);
     return 0;
@@ -1082,7 +1566,52 @@ ssize_t UDPClient::writeLine(const std::string &hostName, uint16_t portNumber, c
 
 ssize_t UDPClient::writeLine(const std::string &str)
 {
-    this->writeLine(this->hostName(), this->portNumber(), str);
+    return this->writeLine(this->hostName(), this->portNumber(), str);
+}
+
+ssize_t UDPClient::write(const void *data, size_t length)
+{
+    if (this->m_compressionEnabled) {
+        std::string datagram{compressDatagram(std::string(static_cast<const char *>(data), length))};
+        if (this->m_integrityCheckEnabled) {
+            datagram = CRC32C::appendTrailer(datagram);
+        }
+        return this->sendSegments(datagram.data(), datagram.length(), nullptr, 0);
+    }
+    if (!this->m_integrityCheckEnabled) {
+        return this->sendSegments(data, length, nullptr, 0);
+    }
+    //The trailer goes out as a second segment of the same datagram, so the payload is not copied
+    uint32_t crc{CRC32C::compute(data, length)};
+    unsigned char trailer[CRC32C::TRAILER_SIZE];
+    for (size_t i = 0; i < CRC32C::TRAILER_SIZE; i++) {
+        trailer[i] = static_cast<unsigned char>((crc >> (8 * i)) & 0xFF);
+    }
+    return this->sendSegments(data, length, trailer, CRC32C::TRAILER_SIZE);
+}
+
+ssize_t UDPClient::sendSegments(const void *first, size_t firstLength, const void *second, size_t secondLength)
+{
+    struct iovec segments[2];
+    segments[0].iov_base = const_cast<void *>(first);
+    segments[0].iov_len = firstLength;
+    segments[1].iov_base = const_cast<void *>(second);
+    segments[1].iov_len = secondLength;
+    struct msghdr message{};
+    message.msg_name = &this->m_destinationAddress;
+    message.msg_namelen = sizeof(this->m_destinationAddress);
+    message.msg_iov = segments;
+    message.msg_iovlen = ((secondLength > 0) ? 2 : 1);
+    unsigned int retryCount{0};
+    do {
+        ssize_t bytesWritten{sendmsg(this->m_udpSocketIndex, &message, MSG_DONTWAIT)};
+        if (bytesWritten != -1) {
+            return bytesWritten;
+        } else if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+            return 0;
+        }
+    } while (retryCount++ < UDPClient::SEND_RETRY_COUNT);
+    return 0;
 }
 
 bool constexpr UDPClient::isValidPortNumber(int portNumber)
@@ -1187,9 +1716,10 @@ UDPDuplex::UDPDuplex(const std::string &clientHostName, uint16_t clientPortNumbe
 
 
 UDPDuplex::UDPDuplex(const std::string &clientHostName, uint16_t clientPortNumber, uint16_t serverPortNumber, uint16_t clientReturnAddressPortNumber, UDPObjectType udpObjectType) :
-    m_udpClient{nullptr},
     m_udpServer{nullptr},
-    m_udpObjectType{udpObjectType}
+    m_udpClient{nullptr},
+    m_udpObjectType{udpObjectType},
+    m_socketLayout{UDPSocketLayout::Separate}
 {
     if ((this->m_udpObjectType == UDPObjectType::Client) || (this->m_udpObjectType == UDPObjectType::Duplex)) {
         this->m_udpClient = std::unique_ptr<UDPClient>{new UDPClient{clientHostName, 
@@ -1206,6 +1736,33 @@ UDPDuplex::UDPDuplex(const std::string &clientHostName, uint16_t clientPortNumbe
     this->setServerTimeout(UDPDuplex::DEFAULT_SERVER_TIMEOUT);
 }
 
+UDPDuplex::UDPDuplex(const std::string &clientHostName, uint16_t clientPortNumber, uint16_t serverPortNumber, UDPSocketLayout socketLayout) :
+    m_udpServer{nullptr},
+    m_udpClient{nullptr},
+    m_udpObjectType{UDPObjectType::Duplex},
+    m_socketLayout{socketLayout}
+{
+    if (this->m_socketLayout == UDPSocketLayout::Separate) {
+        this->m_udpClient = std::unique_ptr<UDPClient>{new UDPClient{clientHostName, 
+                                                                     clientPortNumber,
+                                                                     UDPDuplex::DEFAULT_CLIENT_RETURN_ADDRESS_PORT_NUMBER}};
+        this->m_udpServer = std::unique_ptr<UDPServer>{new UDPServer{serverPortNumber}};
+    } else {
+        this->m_udpClient = std::unique_ptr<UDPClient>{new UDPClient{clientHostName, 
+                                                                     clientPortNumber,
+                                                                     serverPortNumber}};
+        this->m_udpClient->bindToReturnAddress();
+        this->m_udpServer = std::unique_ptr<UDPServer>{new UDPServer{this->m_udpClient->m_udpSocketIndex, 
+                                                                     this->m_udpClient->m_returnAddress}};
+    }
+    this->setServerTimeout(UDPDuplex::DEFAULT_SERVER_TIMEOUT);
+}
+
+UDPSocketLayout UDPDuplex::socketLayout() const
+{
+    return this->m_socketLayout;
+}
+
 std::string UDPDuplex::lineEnding() const
 {
     if (this->m_udpObjectType == UDPObjectType::Server) {
@@ -1453,6 +2010,26 @@ ssize_t UDPDuplex::writeLine(const std::string &str)
     }
 }
 
+ssize_t UDPDuplex::write(const void *data, size_t length)
+{
+    if ((this->m_udpObjectType == UDPObjectType::Client) || (this->m_udpObjectType == UDPObjectType::Duplex)) {
+        return this->m_udpClient->write(data, length);
+    } else {
+        return 0;
+    }
+}
+
+ssize_t UDPDuplex::readDatagram(char *buffer, size_t length)
+{
+    if (this->m_udpObjectType == UDPObjectType::Server) {
+        return this->m_udpServer->readDatagram(buffer, length);
+    } else if (this->m_udpObjectType == UDPObjectType::Duplex) {
+        return this->m_udpServer->readDatagram(this->m_udpClient->m_udpSocketIndex, buffer, length);
+    } else {
+        return 0;
+    }
+}
+
 UDPDatagram UDPDuplex::readDatagram()
 {
     if (this->m_udpObjectType == UDPObjectType::Server) {
@@ -1579,6 +2156,135 @@ char UDPDuplex::peekByte()
         return 0;
     }
 }
+
+void UDPDuplex::setDatagramClassifier(unsigned int priorityClassCount, const UDPDatagramClassifier &classifier)
+{
+    if ((this->m_udpObjectType == UDPObjectType::Server) || (this->m_udpObjectType == UDPObjectType::Duplex)) {
+        this->m_udpServer->setDatagramClassifier(priorityClassCount, classifier);
+    }
+}
+
+unsigned int UDPDuplex::priorityClassCount() const
+{
+    if ((this->m_udpObjectType == UDPObjectType::Server) || (this->m_udpObjectType == UDPObjectType::Duplex)) {
+        return this->m_udpServer->priorityClassCount();
+    } else {
+        return 0;
+    }
+}
+
+void UDPDuplex::setPriorityClassWeight(unsigned int priorityClass, unsigned int weight)
+{
+    if ((this->m_udpObjectType == UDPObjectType::Server) || (this->m_udpObjectType == UDPObjectType::Duplex)) {
+        this->m_udpServer->setPriorityClassWeight(priorityClass, weight);
+    }
+}
+
+unsigned int UDPDuplex::priorityClassWeight(unsigned int priorityClass) const
+{
+    if ((this->m_udpObjectType == UDPObjectType::Server) || (this->m_udpObjectType == UDPObjectType::Duplex)) {
+        return this->m_udpServer->priorityClassWeight(priorityClass);
+    } else {
+        return 0;
+    }
+}
+
+UDPPriorityClassStatistics UDPDuplex::priorityClassStatistics(unsigned int priorityClass) const
+{
+    if ((this->m_udpObjectType == UDPObjectType::Server) || (this->m_udpObjectType == UDPObjectType::Duplex)) {
+        return this->m_udpServer->priorityClassStatistics(priorityClass);
+    } else {
+        return UDPPriorityClassStatistics{};
+    }
+}
+
+void UDPDuplex::resetPriorityClassStatistics()
+{
+    if ((this->m_udpObjectType == UDPObjectType::Server) || (this->m_udpObjectType == UDPObjectType::Duplex)) {
+        this->m_udpServer->resetPriorityClassStatistics();
+    }
+}
+
+void UDPDuplex::setIntegrityCheckEnabled(bool integrityCheckEnabled)
+{
+    if (this->m_udpClient) {
+        this->m_udpClient->setIntegrityCheckEnabled(integrityCheckEnabled);
+    }
+    if (this->m_udpServer) {
+        this->m_udpServer->setIntegrityCheckEnabled(integrityCheckEnabled);
+    }
+}
+
+bool UDPDuplex::integrityCheckEnabled() const
+{
+    if (this->m_udpClient) {
+        return this->m_udpClient->integrityCheckEnabled();
+    } else {
+        return this->m_udpServer->integrityCheckEnabled();
+    }
+}
+
+unsigned long long UDPDuplex::integrityFailureCount() const
+{
+    if ((this->m_udpObjectType == UDPObjectType::Server) || (this->m_udpObjectType == UDPObjectType::Duplex)) {
+        return this->m_udpServer->integrityFailureCount();
+    } else {
+        return 0;
+    }
+}
+
+void UDPDuplex::setCompressionEnabled(bool compressionEnabled)
+{
+    if (this->m_udpClient) {
+        this->m_udpClient->setCompressionEnabled(compressionEnabled);
+    }
+    if (this->m_udpServer) {
+        this->m_udpServer->setCompressionEnabled(compressionEnabled);
+    }
+}
+
+bool UDPDuplex::compressionEnabled() const
+{
+    if (this->m_udpClient) {
+        return this->m_udpClient->compressionEnabled();
+    } else {
+        return this->m_udpServer->compressionEnabled();
+    }
+}
+
+unsigned long long UDPDuplex::decompressionFailureCount() const
+{
+    if ((this->m_udpObjectType == UDPObjectType::Server) || (this->m_udpObjectType == UDPObjectType::Duplex)) {
+        return this->m_udpServer->decompressionFailureCount();
+    } else {
+        return 0;
+    }
+}
+
+unsigned long long UDPDuplex::oversizeDatagramCount() const
+{
+    if ((this->m_udpObjectType == UDPObjectType::Server) || (this->m_udpObjectType == UDPObjectType::Duplex)) {
+        return this->m_udpServer->oversizeDatagramCount();
+    } else {
+        return 0;
+    }
+}
+
+void UDPDuplex::setListenerThreadConfiguration(const ThreadConfiguration &threadConfiguration)
+{
+    if (this->m_udpServer) {
+        this->m_udpServer->setListenerThreadConfiguration(threadConfiguration);
+    }
+}
+
+ThreadConfiguration UDPDuplex::listenerThreadConfiguration() const
+{
+    if (this->m_udpServer) {
+        return this->m_udpServer->listenerThreadConfiguration();
+    } else {
+        return ThreadConfiguration{};
+    }
+}
     
 ssize_t UDPDuplex::available()
 {
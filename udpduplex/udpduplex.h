@@ -24,7 +24,11 @@
 #include <memory>
 #include <sstream>
 #include <deque>
+#include <cstring>
 #include <future>
+#include <vector>
+#include <chrono>
+#include <functional>
 
 #if defined (_WIN32)
 
@@ -40,6 +44,7 @@
 #endif //defined(_WIN32)
 
 #include "ibytestream.h"
+#include "threadconfiguration.h"
 
 enum class UDPObjectType {
     Duplex,
@@ -47,6 +52,14 @@ enum class UDPObjectType {
     Client
 };
 
+//Separate: the duplex sends from its UDPClient socket and keeps a second socket for its UDPServer
+//Shared: one socket, bound to the server port number, is used to both send and receive, so
+//peers can reply straight to the source address of a datagram
+enum class UDPSocketLayout {
+    Separate,
+    Shared
+};
+
 
 #if defined(__ANDROID__)
     using platform_socklen_t = socklen_t;
@@ -99,6 +112,75 @@ private:
 };
 
 
+//Classifies a received datagram into a priority class, 0 being the highest priority
+//Called on the listener thread for every datagram, so it should be cheap (a header byte, a source port)
+using UDPDatagramClassifier = std::function<unsigned int(const struct sockaddr_in &, const std::string &)>;
+
+struct UDPPriorityClassStatistics
+{
+    size_t depth;
+    size_t maximumDepth;
+    unsigned long long enqueuedCount;
+    unsigned long long dequeuedCount;
+    std::chrono::microseconds averageLatency;
+    std::chrono::microseconds maximumLatency;
+};
+
+//Receive queue split into a fixed number of priority classes. Reads drain the highest
+//class with data first. A class with a weight of 0 is served strictly by priority, while
+//backlogged classes with a non-zero weight share the reads in proportion to their weights
+//Datagrams that are put back always come out first, regardless of class
+//Not thread safe on its own, UDPServer guards it with its io mutex
+class UDPDatagramQueue
+{
+public:
+    UDPDatagramQueue();
+
+    void emplace_back(const struct sockaddr_in &socketAddress, const std::string &message);
+    void emplace_front(const struct sockaddr_in &socketAddress, const std::string &message);
+    void push_front(const UDPDatagram &datagram);
+    const UDPDatagram &front() const;
+    void pop_front();
+    size_t size() const;
+    void clear();
+
+    void setClassifier(unsigned int priorityClassCount, const UDPDatagramClassifier &classifier);
+    unsigned int priorityClassCount() const;
+    void setPriorityClassWeight(unsigned int priorityClass, unsigned int weight);
+    unsigned int priorityClassWeight(unsigned int priorityClass) const;
+    UDPPriorityClassStatistics priorityClassStatistics(unsigned int priorityClass) const;
+    void resetPriorityClassStatistics();
+
+    static const constexpr unsigned int MAXIMUM_PRIORITY_CLASS_COUNT{8};
+
+private:
+    struct QueuedDatagram
+    {
+        UDPDatagram datagram;
+        std::chrono::steady_clock::time_point enqueueTime;
+    };
+
+    struct PriorityClass
+    {
+        std::deque<QueuedDatagram> datagrams;
+        unsigned int weight;
+        unsigned int credits;
+        size_t maximumDepth;
+        unsigned long long enqueuedCount;
+        unsigned long long dequeuedCount;
+        std::chrono::microseconds totalLatency;
+        std::chrono::microseconds maximumLatency;
+    };
+
+    std::vector<PriorityClass> m_priorityClasses;
+    std::deque<UDPDatagram> m_putBackDatagrams;
+    UDPDatagramClassifier m_classifier;
+    size_t m_size;
+
+    size_t nextPriorityClass() const;
+    void checkPriorityClass(const std::string &functionName, unsigned int priorityClass) const;
+};
+
 class UDPServer
 {
 friend class UDPDuplex;
@@ -109,6 +191,11 @@ public:
 
     char readByte();
     UDPDatagram readDatagram();
+    //Copies the payload of the next datagram into buffer and returns its length, or 0 on
+    //timeout. While the server is not listening, the datagram is received straight into
+    //buffer, so nothing is allocated unless compression is enabled. A datagram longer than
+    //length is dropped and counted (see oversizeDatagramCount()), and 0 is returned
+    ssize_t readDatagram(char *buffer, size_t length);
     std::string readLine();
     std::string readUntil(const std::string &until);
     std::string readUntil(const char *until);
@@ -143,6 +230,34 @@ public:
     char peekByte();
     UDPDatagram peekDatagram();
 
+    //Changing the classifier keeps the weights of the priority classes that still exist
+    void setDatagramClassifier(unsigned int priorityClassCount, const UDPDatagramClassifier &classifier);
+    unsigned int priorityClassCount() const;
+    void setPriorityClassWeight(unsigned int priorityClass, unsigned int weight);
+    unsigned int priorityClassWeight(unsigned int priorityClass) const;
+    UDPPriorityClassStatistics priorityClassStatistics(unsigned int priorityClass) const;
+    void resetPriorityClassStatistics();
+
+    //When enabled, every datagram must end in a CRC32C trailer (see crc32c.h)
+    //Datagrams that fail the check are dropped and counted
+    bool integrityCheckEnabled() const;
+    void setIntegrityCheckEnabled(bool integrityCheckEnabled);
+    unsigned long long integrityFailureCount() const;
+
+    //When enabled, datagrams compressed by a peer (see UDPClient::setCompressionEnabled())
+    //are expanded on receipt. Uncompressed datagrams are still accepted
+    bool compressionEnabled() const;
+    void setCompressionEnabled(bool compressionEnabled);
+    unsigned long long decompressionFailureCount() const;
+
+    //Datagrams readDatagram(char *, size_t) dropped because they did not fit in the buffer
+    unsigned long long oversizeDatagramCount() const;
+
+    //Where and how the listener thread runs (see threadconfiguration.h)
+    //Takes effect the next time listening starts
+    void setListenerThreadConfiguration(const ThreadConfiguration &threadConfiguration);
+    ThreadConfiguration listenerThreadConfiguration() const;
+
     static uint16_t doUserSelectPortNumber();
     static std::shared_ptr<UDPServer> doUserSelectUDPServer();
 
@@ -152,13 +267,23 @@ public:
 private:
     struct sockaddr_in m_socketAddress;
     int m_socketNumber;
+    bool m_ownsSocket;
     bool m_isListening;
     long m_timeout;
-    std::deque<UDPDatagram> m_datagramQueue;
-    std::mutex m_ioMutex;
+    UDPDatagramQueue m_datagramQueue;
+    mutable std::mutex m_ioMutex;
     bool m_shutEmDown;
     std::string m_lineEnding;
     bool m_isEchoServer;
+    bool m_integrityCheckEnabled;
+    unsigned long long m_integrityFailureCount;
+    bool m_compressionEnabled;
+    unsigned long long m_decompressionFailureCount;
+    unsigned long long m_oversizeDatagramCount;
+    ThreadConfiguration m_listenerThreadConfiguration;
+
+    //Used by UDPDuplex to receive on its UDPClient socket (see UDPSocketLayout::Shared)
+    UDPServer(int sharedSocketNumber, const struct sockaddr_in &socketAddress);
 
     void initialize(uint16_t portNumber);
 #if defined(__ANDROID__)
@@ -172,6 +297,7 @@ private:
 
     char readByte(int socketNumber);
     UDPDatagram readDatagram(int socketNumber);
+    ssize_t readDatagram(int socketNumber, char *buffer, size_t length);
     std::string readLine(int socketNumber);
     std::string readUntil(int socketNumber, const std::string &until);
     std::string readUntil(int socketNumber, const char *until);
@@ -186,8 +312,11 @@ private:
     void setTimeout(int socketNumber, long timeout);
 
     void startListening(int socketNumber);
+    void launchListener(const std::function<void()> &listener);
 
     void respondTo(struct sockaddr_in *address, const std::string &str);
+    bool verifyIntegrity(std::string *receivedString);
+    bool unwrapDatagram(std::string *receivedString);
 
     static const uint16_t BROADCAST;
     static const constexpr size_t RECEIVED_BUFFER_MAX{65535};
@@ -213,6 +342,9 @@ public:
     ssize_t writeLine(const std::string &str);
     ssize_t writeLine(const std::string &hostName, uint16_t portNumber, const char *str);
     ssize_t writeLine(const std::string &hostName, uint16_t portNumber, const std::string &str);
+    //Sends exactly length bytes as one datagram, without adding the line ending. Nothing
+    //is copied or allocated unless compression is enabled
+    ssize_t write(const void *data, size_t length);
     uint16_t portNumber() const;
     std::string hostName() const;
     uint16_t returnAddressPortNumber() const;
@@ -224,6 +356,15 @@ public:
     std::string lineEnding() const;
     void setLineEnding(const std::string &lineEnding);
 
+    //When enabled, a CRC32C trailer (see crc32c.h) is appended to every datagram sent
+    bool integrityCheckEnabled() const;
+    void setIntegrityCheckEnabled(bool integrityCheckEnabled);
+
+    //When enabled, datagrams are compressed with LZCodec (see lzcodec.h) and sent with a
+    //leading flag byte, unless compressing would save less than an eighth of the datagram
+    bool compressionEnabled() const;
+    void setCompressionEnabled(bool compressionEnabled);
+
     void openPort();
     void closePort();
     bool isOpen() const;
@@ -246,9 +387,13 @@ private:
     unsigned int m_timeout;
     int m_udpSocketIndex;
     std::string m_lineEnding;
+    bool m_integrityCheckEnabled;
+    bool m_compressionEnabled;
     
     ssize_t writeByte(char toSend);
     ssize_t writeByte(const std::string &hostName, uint16_t portNumber, char toSend);
+    ssize_t sendSegments(const void *first, size_t firstLength, const void *second, size_t secondLength);
+    void bindToReturnAddress();
     int resolveAddressHelper(const std::string &hostName, int family, const std::string &service, sockaddr_storage* addressPtr);
     void initialize(const std::string &hostName, uint16_t portNumber, uint16_t returnAddressPortNumber);
 
@@ -265,12 +410,15 @@ public:
     UDPDuplex(const std::string &clientHostName, uint16_t clientPortNumber, UDPObjectType udpObjectType = UDPObjectType::Duplex);
     UDPDuplex(const std::string &clientHostName, uint16_t clientPortNumber, uint16_t serverPortNumber, UDPObjectType udpObjectType = UDPObjectType::Duplex);
     UDPDuplex(const std::string &clientHostName, uint16_t clientPortNumber, uint16_t serverPortNumber, uint16_t clientReturnAddressPortNumber, UDPObjectType udpObjectType = UDPObjectType::Duplex);
+    UDPDuplex(const std::string &clientHostName, uint16_t clientPortNumber, uint16_t serverPortNumber, UDPSocketLayout socketLayout);
 
     /*Client/Sender*/
     ssize_t writeLine(const std::string &str);
     ssize_t writeLine(const char *str);
     ssize_t writeLine(const std::string &hostName, uint16_t portNumber, const char *str);
     ssize_t writeLine(const std::string &hostName, uint16_t portNumber, const std::string &str);
+    //See UDPClient::write(const void *, size_t)
+    ssize_t write(const void *data, size_t length);
 
     void setClientHostName(const std::string &hostName);
     void setClientTimeout(long timeout);
@@ -285,6 +433,8 @@ public:
     /*Host/Server*/
     char readByte();
     UDPDatagram readDatagram();
+    //See UDPServer::readDatagram(char *, size_t)
+    ssize_t readDatagram(char *buffer, size_t length);
     std::string readLine();
     std::string readUntil(const std::string &until);
     std::string readUntil(const char *until);
@@ -302,6 +452,25 @@ public:
     std::string peek();
     char peekByte();
 
+    void setDatagramClassifier(unsigned int priorityClassCount, const UDPDatagramClassifier &classifier);
+    unsigned int priorityClassCount() const;
+    void setPriorityClassWeight(unsigned int priorityClass, unsigned int weight);
+    unsigned int priorityClassWeight(unsigned int priorityClass) const;
+    UDPPriorityClassStatistics priorityClassStatistics(unsigned int priorityClass) const;
+    void resetPriorityClassStatistics();
+
+    void setIntegrityCheckEnabled(bool integrityCheckEnabled);
+    bool integrityCheckEnabled() const;
+    unsigned long long integrityFailureCount() const;
+
+    void setCompressionEnabled(bool compressionEnabled);
+    bool compressionEnabled() const;
+    unsigned long long decompressionFailureCount() const;
+    unsigned long long oversizeDatagramCount() const;
+
+    void setListenerThreadConfiguration(const ThreadConfiguration &threadConfiguration);
+    ThreadConfiguration listenerThreadConfiguration() const;
+
     void flushRXTX();
     void flushRX();
     void flushTX();
@@ -327,6 +496,7 @@ public:
     std::string lineEnding() const;
 
     UDPObjectType udpObjectType() const;
+    UDPSocketLayout socketLayout() const;
 
     static uint16_t doUserSelectClientPortNumber();
     static std::string doUserSelectClientHostName();
@@ -348,6 +518,7 @@ private:
     std::unique_ptr<UDPServer> m_udpServer;
     std::unique_ptr<UDPClient> m_udpClient;
     UDPObjectType m_udpObjectType;
+    UDPSocketLayout m_socketLayout;
 
     int resolveAddressHelper(const std::string &hostName, int family, const std::string &service, sockaddr_storage* addressPtr);
 
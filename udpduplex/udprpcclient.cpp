@@ -0,0 +1,336 @@
+/***********************************************************************
+*    udprpcclient.cpp:                                                 *
+*    UDPRpcClient, for pipelined request/response over a UDPDuplex     *
+*    Copyright (c) 2017 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the implementation of a UDPRpcClient class        *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+#include <utility>
+
+#include "udprpcclient.h"
+
+const constexpr size_t UDPRpcClient::DEFAULT_MAXIMUM_IN_FLIGHT;
+const constexpr long UDPRpcClient::DEFAULT_DEADLINE;
+const constexpr char UDPRpcClient::CORRELATION_ID_PREFIX;
+const constexpr char UDPRpcClient::CORRELATION_ID_SEPARATOR;
+
+UDPRpcClient::UDPRpcClient(std::shared_ptr<UDPDuplex> udpDuplex) :
+    UDPRpcClient{udpDuplex, UDPRpcClient::DEFAULT_MAXIMUM_IN_FLIGHT}
+{
+
+}
+
+UDPRpcClient::UDPRpcClient(std::shared_ptr<UDPDuplex> udpDuplex, size_t maximumInFlight) :
+    UDPRpcClient{udpDuplex, maximumInFlight, ThreadConfiguration{}}
+{
+
+}
+
+UDPRpcClient::UDPRpcClient(std::shared_ptr<UDPDuplex> udpDuplex, size_t maximumInFlight, const ThreadConfiguration &listenerThreadConfiguration) :
+    m_udpDuplex{udpDuplex},
+    m_inFlightRequests{},
+    m_waitingRequests{},
+    m_nextCorrelationId{1},
+    m_maximumInFlight{(maximumInFlight == 0) ? 1 : maximumInFlight},
+    m_defaultDeadline{UDPRpcClient::DEFAULT_DEADLINE},
+    m_completedCount{0},
+    m_timedOutCount{0},
+    m_unmatchedResponseCount{0},
+    m_shutEmDown{false}
+{
+    if (!this->m_udpDuplex) {
+        throw std::runtime_error("In UDPRpcClient::UDPRpcClient(std::shared_ptr<UDPDuplex>, size_t, const ThreadConfiguration &): UDPDuplex is a nullptr");
+    }
+    if (this->m_udpDuplex->udpObjectType() != UDPObjectType::Duplex) {
+        throw std::runtime_error("In UDPRpcClient::UDPRpcClient(std::shared_ptr<UDPDuplex>, size_t, const ThreadConfiguration &): UDPDuplex must be able to both send and receive (" + UDPDuplex::udpObjectTypeToString(this->m_udpDuplex->udpObjectType()) + ")");
+    }
+    this->m_inFlightRequests.reserve(this->m_maximumInFlight);
+    try {
+#if defined(__ANDROID__)
+        this->m_asyncFuture = listenerThreadConfiguration.launchThread([this]() { this->asyncResponseListener(); });
+#else
+        this->m_asyncFuture = listenerThreadConfiguration.launch([this]() { this->asyncResponseListener(); });
+#endif
+    } catch (std::exception &e) {
+        throw std::runtime_error("In UDPRpcClient::UDPRpcClient(std::shared_ptr<UDPDuplex>, size_t, const ThreadConfiguration &): Unable to start the listener: " + std::string{e.what()});
+    }
+}
+
+UDPRpcClient::~UDPRpcClient()
+{
+    this->m_shutEmDown = true;
+#if defined(__ANDROID__)
+    if (this->m_asyncFuture) {
+        this->m_asyncFuture->join();
+        delete this->m_asyncFuture;
+    }
+#else
+    if (this->m_asyncFuture.valid()) {
+        this->m_asyncFuture.wait();
+    }
+#endif
+    this->cancelAll();
+}
+
+std::future<UDPRpcResponse> UDPRpcClient::request(const std::string &message)
+{
+    return this->request(message, this->defaultDeadline());
+}
+
+std::future<UDPRpcResponse> UDPRpcClient::request(const std::string &message, std::chrono::milliseconds deadline)
+{
+    std::shared_ptr<std::promise<UDPRpcResponse>> promise{std::make_shared<std::promise<UDPRpcResponse>>()};
+    std::future<UDPRpcResponse> returnFuture{promise->get_future()};
+    this->request(message, deadline, [promise](const UDPRpcResponse &response) { promise->set_value(response); });
+    return returnFuture;
+}
+
+void UDPRpcClient::request(const std::string &message, const CompletionCallback &callback)
+{
+    return this->request(message, this->defaultDeadline(), callback);
+}
+
+void UDPRpcClient::request(const std::string &message, std::chrono::milliseconds deadline, const CompletionCallback &callback)
+{
+    std::vector<std::pair<CompletionCallback, UDPRpcResponse>> completions{};
+    {
+        std::lock_guard<std::mutex> requestLock{this->m_requestMutex};
+        PendingRequest pendingRequest{};
+        pendingRequest.correlationId = this->m_nextCorrelationId++;
+        if (this->m_nextCorrelationId == 0) {
+            this->m_nextCorrelationId = 1;
+        }
+        pendingRequest.message = message;
+        pendingRequest.sentTime = std::chrono::steady_clock::now();
+        pendingRequest.deadline = pendingRequest.sentTime + deadline;
+        pendingRequest.callback = callback;
+        this->m_waitingRequests.push_back(std::move(pendingRequest));
+        this->sendWaitingRequests(&completions);
+    }
+    for (auto &it : completions) {
+        it.first(it.second);
+    }
+}
+
+void UDPRpcClient::cancelAll()
+{
+    std::vector<std::pair<CompletionCallback, UDPRpcResponse>> completions{};
+    {
+        std::lock_guard<std::mutex> requestLock{this->m_requestMutex};
+        for (auto &it : this->m_inFlightRequests) {
+            completions.emplace_back(it.second.callback, UDPRpcResponse{it.first, UDPRpcStatus::Cancelled, "", elapsedSince(it.second.sentTime)});
+        }
+        for (auto &it : this->m_waitingRequests) {
+            completions.emplace_back(it.callback, UDPRpcResponse{it.correlationId, UDPRpcStatus::Cancelled, "", elapsedSince(it.sentTime)});
+        }
+        this->m_inFlightRequests.clear();
+        this->m_waitingRequests.clear();
+    }
+    for (auto &it : completions) {
+        it.first(it.second);
+    }
+}
+
+void UDPRpcClient::sendWaitingRequests(std::vector<std::pair<CompletionCallback, UDPRpcResponse>> *completions)
+{
+    //Caller must hold m_requestMutex
+    while ((!this->m_waitingRequests.empty()) && (this->m_inFlightRequests.size() < this->m_maximumInFlight)) {
+        PendingRequest pendingRequest{std::move(this->m_waitingRequests.front())};
+        this->m_waitingRequests.pop_front();
+        steady_time_point now{std::chrono::steady_clock::now()};
+        if (now >= pendingRequest.deadline) {
+            this->m_timedOutCount++;
+            completions->emplace_back(pendingRequest.callback, UDPRpcResponse{pendingRequest.correlationId, UDPRpcStatus::TimedOut, "", elapsedSince(pendingRequest.sentTime)});
+            continue;
+        }
+        pendingRequest.sentTime = now;
+        this->m_udpDuplex->writeLine(encode(pendingRequest.correlationId, pendingRequest.message));
+        uint32_t correlationId{pendingRequest.correlationId};
+        this->m_inFlightRequests.emplace(correlationId, std::move(pendingRequest));
+    }
+}
+
+void UDPRpcClient::expireRequests(steady_time_point now, std::vector<std::pair<CompletionCallback, UDPRpcResponse>> *completions)
+{
+    //Caller must hold m_requestMutex
+    for (auto iter = this->m_inFlightRequests.begin(); iter != this->m_inFlightRequests.end(); ) {
+        if (now >= iter->second.deadline) {
+            this->m_timedOutCount++;
+            completions->emplace_back(iter->second.callback, UDPRpcResponse{iter->first, UDPRpcStatus::TimedOut, "", elapsedSince(iter->second.sentTime)});
+            iter = this->m_inFlightRequests.erase(iter);
+        } else {
+            iter++;
+        }
+    }
+    while ((!this->m_waitingRequests.empty()) && (now >= this->m_waitingRequests.front().deadline)) {
+        this->m_timedOutCount++;
+        completions->emplace_back(this->m_waitingRequests.front().callback, UDPRpcResponse{this->m_waitingRequests.front().correlationId, UDPRpcStatus::TimedOut, "", elapsedSince(this->m_waitingRequests.front().sentTime)});
+        this->m_waitingRequests.pop_front();
+    }
+}
+
+void UDPRpcClient::asyncResponseListener()
+{
+    std::vector<std::pair<CompletionCallback, UDPRpcResponse>> completions{};
+    std::string message{""};
+    do {
+        completions.clear();
+        UDPDatagram datagram{this->m_udpDuplex->readDatagram()};
+        std::string received{datagram.message()};
+        {
+            std::lock_guard<std::mutex> requestLock{this->m_requestMutex};
+            if (received.length() != 0) {
+                uint32_t correlationId{0};
+                auto found = this->m_inFlightRequests.end();
+                if (decode(received, &correlationId, &message)) {
+                    found = this->m_inFlightRequests.find(correlationId);
+                }
+                if (found == this->m_inFlightRequests.end()) {
+                    this->m_unmatchedResponseCount++;
+                } else {
+                    this->m_completedCount++;
+                    completions.emplace_back(found->second.callback, UDPRpcResponse{correlationId, UDPRpcStatus::Success, stripLineEnding(message), elapsedSince(found->second.sentTime)});
+                    this->m_inFlightRequests.erase(found);
+                }
+            }
+            this->expireRequests(std::chrono::steady_clock::now(), &completions);
+            this->sendWaitingRequests(&completions);
+        }
+        for (auto &it : completions) {
+            it.first(it.second);
+        }
+    } while (!this->m_shutEmDown);
+}
+
+std::string UDPRpcClient::encode(uint32_t correlationId, const std::string &message)
+{
+    char header[16];
+    int headerLength{snprintf(header, sizeof(header), "%c%x%c", CORRELATION_ID_PREFIX, correlationId, CORRELATION_ID_SEPARATOR)};
+    std::string returnString{};
+    returnString.reserve(headerLength + message.length());
+    returnString.append(header, headerLength);
+    returnString.append(message);
+    return returnString;
+}
+
+bool UDPRpcClient::decode(const std::string &datagram, uint32_t *correlationId, std::string *message)
+{
+    if ((datagram.length() < 3) || (datagram[0] != CORRELATION_ID_PREFIX)) {
+        return false;
+    }
+    size_t separatorPosition{datagram.find(CORRELATION_ID_SEPARATOR, 1)};
+    if ((separatorPosition == std::string::npos) || (separatorPosition == 1) || (separatorPosition > 9)) {
+        return false;
+    }
+    uint32_t parsedId{0};
+    for (size_t i = 1; i < separatorPosition; i++) {
+        char c{datagram[i]};
+        parsedId <<= 4;
+        if ((c >= '0') && (c <= '9')) {
+            parsedId |= static_cast<uint32_t>(c - '0');
+        } else if ((c >= 'a') && (c <= 'f')) {
+            parsedId |= static_cast<uint32_t>(c - 'a' + 10);
+        } else if ((c >= 'A') && (c <= 'F')) {
+            parsedId |= static_cast<uint32_t>(c - 'A' + 10);
+        } else {
+            return false;
+        }
+    }
+    if (correlationId) {
+        *correlationId = parsedId;
+    }
+    if (message) {
+        message->assign(datagram, separatorPosition + 1, std::string::npos);
+    }
+    return true;
+}
+
+std::string UDPRpcClient::stripLineEnding(const std::string &str)
+{
+    size_t endPosition{str.length()};
+    while ((endPosition > 0) && ((str[endPosition - 1] == '\r') || (str[endPosition - 1] == '\n'))) {
+        endPosition--;
+    }
+    return str.substr(0, endPosition);
+}
+
+std::chrono::microseconds UDPRpcClient::elapsedSince(steady_time_point timePoint)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - timePoint);
+}
+
+size_t UDPRpcClient::maximumInFlight() const
+{
+    std::lock_guard<std::mutex> requestLock{this->m_requestMutex};
+    return this->m_maximumInFlight;
+}
+
+void UDPRpcClient::setMaximumInFlight(size_t maximumInFlight)
+{
+    std::vector<std::pair<CompletionCallback, UDPRpcResponse>> completions{};
+    {
+        std::lock_guard<std::mutex> requestLock{this->m_requestMutex};
+        this->m_maximumInFlight = ((maximumInFlight == 0) ? 1 : maximumInFlight);
+        this->m_inFlightRequests.reserve(this->m_maximumInFlight);
+        this->sendWaitingRequests(&completions);
+    }
+    for (auto &it : completions) {
+        it.first(it.second);
+    }
+}
+
+std::chrono::milliseconds UDPRpcClient::defaultDeadline() const
+{
+    std::lock_guard<std::mutex> requestLock{this->m_requestMutex};
+    return this->m_defaultDeadline;
+}
+
+void UDPRpcClient::setDefaultDeadline(std::chrono::milliseconds deadline)
+{
+    std::lock_guard<std::mutex> requestLock{this->m_requestMutex};
+    this->m_defaultDeadline = deadline;
+}
+
+size_t UDPRpcClient::inFlight() const
+{
+    std::lock_guard<std::mutex> requestLock{this->m_requestMutex};
+    return this->m_inFlightRequests.size();
+}
+
+size_t UDPRpcClient::queued() const
+{
+    std::lock_guard<std::mutex> requestLock{this->m_requestMutex};
+    return this->m_waitingRequests.size();
+}
+
+unsigned long long UDPRpcClient::completedCount() const
+{
+    std::lock_guard<std::mutex> requestLock{this->m_requestMutex};
+    return this->m_completedCount;
+}
+
+unsigned long long UDPRpcClient::timedOutCount() const
+{
+    std::lock_guard<std::mutex> requestLock{this->m_requestMutex};
+    return this->m_timedOutCount;
+}
+
+unsigned long long UDPRpcClient::unmatchedResponseCount() const
+{
+    std::lock_guard<std::mutex> requestLock{this->m_requestMutex};
+    return this->m_unmatchedResponseCount;
+}
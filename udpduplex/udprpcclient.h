@@ -0,0 +1,146 @@
+/***********************************************************************
+*    udprpcclient.h:                                                   *
+*    UDPRpcClient, for pipelined request/response over a UDPDuplex     *
+*    Copyright (c) 2017 Tyler Lewis                                    *
+************************************************************************
+*    This is a header file for tjlutils:                               *
+*    https://github.com/tlewiscpp/tjlutils                            *
+*    This file may be distributed with the entire tjlutils library,    *
+*    but may also be distributed as a standalone file                  *
+*    The source code is released under the GNU LGPL                    *
+*    This file holds the declarations of a UDPRpcClient class          *
+*    It tags each outgoing request with a correlation id, keeps up to  *
+*    a configurable number of requests in flight at once, and matches  *
+*    responses back to their requests as datagrams arrive. Requests    *
+*    complete through a callback or a std::future, or time out when    *
+*    their deadline passes                                             *
+*                                                                      *
+*    Wire format: "#<correlation id in hex>:<message>". The responding *
+*    device must echo the "#<id>:" prefix at the front of its reply    *
+*                                                                      *
+*    You should have received a copy of the GNU Lesser General         *
+*    Public license along with tjlutils                                *
+*    If not, see <http://www.gnu.org/licenses/>                        *
+***********************************************************************/
+
+#ifndef TJLUTILS_UDPRPCCLIENT_H
+#define TJLUTILS_UDPRPCCLIENT_H
+
+#include <memory>
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <future>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+
+#include "udpduplex.h"
+
+enum class UDPRpcStatus { Success, TimedOut, Cancelled };
+
+class UDPRpcResponse
+{
+public:
+    UDPRpcResponse(uint32_t correlationId, UDPRpcStatus status, const std::string &message, std::chrono::microseconds roundTripTime) :
+        m_correlationId{correlationId},
+        m_status{status},
+        m_message{message},
+        m_roundTripTime{roundTripTime}
+    {
+
+    }
+
+    uint32_t correlationId() const { return this->m_correlationId; }
+    UDPRpcStatus status() const { return this->m_status; }
+    std::string message() const { return this->m_message; }
+    std::chrono::microseconds roundTripTime() const { return this->m_roundTripTime; }
+
+private:
+    uint32_t m_correlationId;
+    UDPRpcStatus m_status;
+    std::string m_message;
+    std::chrono::microseconds m_roundTripTime;
+};
+
+//The thread that reads responses and times requests out is started with
+//listenerThreadConfiguration, if given
+class UDPRpcClient
+{
+public:
+    using CompletionCallback = std::function<void(const UDPRpcResponse &)>;
+
+    UDPRpcClient(std::shared_ptr<UDPDuplex> udpDuplex);
+    UDPRpcClient(std::shared_ptr<UDPDuplex> udpDuplex, size_t maximumInFlight);
+    UDPRpcClient(std::shared_ptr<UDPDuplex> udpDuplex, size_t maximumInFlight, const ThreadConfiguration &listenerThreadConfiguration);
+    ~UDPRpcClient();
+
+    UDPRpcClient(const UDPRpcClient &other) = delete;
+    UDPRpcClient &operator=(const UDPRpcClient &rhs) = delete;
+
+    std::future<UDPRpcResponse> request(const std::string &message);
+    std::future<UDPRpcResponse> request(const std::string &message, std::chrono::milliseconds deadline);
+    void request(const std::string &message, const CompletionCallback &callback);
+    void request(const std::string &message, std::chrono::milliseconds deadline, const CompletionCallback &callback);
+
+    void cancelAll();
+
+    size_t maximumInFlight() const;
+    void setMaximumInFlight(size_t maximumInFlight);
+    std::chrono::milliseconds defaultDeadline() const;
+    void setDefaultDeadline(std::chrono::milliseconds deadline);
+
+    size_t inFlight() const;
+    size_t queued() const;
+    unsigned long long completedCount() const;
+    unsigned long long timedOutCount() const;
+    unsigned long long unmatchedResponseCount() const;
+
+    static std::string encode(uint32_t correlationId, const std::string &message);
+    static bool decode(const std::string &datagram, uint32_t *correlationId, std::string *message);
+
+    static const constexpr size_t DEFAULT_MAXIMUM_IN_FLIGHT{16};
+    static const constexpr long DEFAULT_DEADLINE{1000};
+    static const constexpr char CORRELATION_ID_PREFIX{'#'};
+    static const constexpr char CORRELATION_ID_SEPARATOR{':'};
+
+private:
+    using steady_time_point = std::chrono::steady_clock::time_point;
+
+    struct PendingRequest
+    {
+        uint32_t correlationId;
+        std::string message;
+        steady_time_point sentTime;
+        steady_time_point deadline;
+        CompletionCallback callback;
+    };
+
+    std::shared_ptr<UDPDuplex> m_udpDuplex;
+    std::unordered_map<uint32_t, PendingRequest> m_inFlightRequests;
+    std::deque<PendingRequest> m_waitingRequests;
+    mutable std::mutex m_requestMutex;
+    uint32_t m_nextCorrelationId;
+    size_t m_maximumInFlight;
+    std::chrono::milliseconds m_defaultDeadline;
+    unsigned long long m_completedCount;
+    unsigned long long m_timedOutCount;
+    unsigned long long m_unmatchedResponseCount;
+    bool m_shutEmDown;
+
+#if defined(__ANDROID__)
+    std::thread *m_asyncFuture;
+#else
+    std::future<void> m_asyncFuture;
+#endif
+
+    void asyncResponseListener();
+    void sendWaitingRequests(std::vector<std::pair<CompletionCallback, UDPRpcResponse>> *completions);
+    void expireRequests(steady_time_point now, std::vector<std::pair<CompletionCallback, UDPRpcResponse>> *completions);
+
+    static std::string stripLineEnding(const std::string &str);
+    static std::chrono::microseconds elapsedSince(steady_time_point timePoint);
+};
+
+#endif //TJLUTILS_UDPRPCCLIENT_H